@@ -149,6 +149,7 @@
         'cpu_unittest.cc',
         'debug/leak_tracker_unittest.cc',
         'debug/stack_trace_unittest.cc',
+        'debug/trace_event_binary_unittest.cc',
         'debug/trace_event_unittest.cc',
         'debug/trace_event_win_unittest.cc',
         'dir_reader_posix_unittest.cc',
@@ -160,6 +161,7 @@
         'file_version_info_unittest.cc',
         'gmock_unittest.cc',
         'id_map_unittest.cc',
+        'incoming_task_queue_unittest.cc',
         'i18n/break_iterator_unittest.cc',
         'i18n/char_iterator_unittest.cc',
         'i18n/case_conversion_unittest.cc',
@@ -201,6 +203,7 @@
         'message_pump_libevent_unittest.cc',
         'metrics/field_trial_unittest.cc',
         'metrics/histogram_unittest.cc',
+        'metrics/shared_histogram_allocator_unittest.cc',
         'metrics/stats_table_unittest.cc',
         'observer_list_unittest.cc',
         'path_service_unittest.cc',
@@ -215,6 +218,7 @@
         'rand_util_unittest.cc',
         'scoped_native_library_unittest.cc',
         'scoped_temp_dir_unittest.cc',
+        'segmented_pickle_unittest.cc',
         'sha1_unittest.cc',
         'shared_memory_unittest.cc',
         'stack_container_unittest.cc',
@@ -500,6 +504,25 @@
         },
       ],
     },
+    {
+      'target_name': 'base_perftests',
+      'type': 'executable',
+      'dependencies': [
+        'base',
+        'test_support_perf',
+        '../testing/gtest.gyp:gtest',
+      ],
+      'sources': [
+        'debug/trace_event_binary_perftest.cc',
+        'incoming_task_queue_perftest.cc',
+        'json/json_reader_perftest.cc',
+        'metrics/histogram_perftest.cc',
+        'test/sequenced_worker_pool_owner.cc',
+        'test/sequenced_worker_pool_owner.h',
+        'threading/sequenced_worker_pool_perftest.cc',
+        'values_perftest.cc',
+      ],
+    },
     {
       'target_name': 'test_support_perf',
       'type': 'static_library',
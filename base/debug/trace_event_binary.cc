@@ -0,0 +1,380 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/debug/trace_event_binary.h"
+
+#include <string.h>
+
+#include <vector>
+
+#include "base/debug/trace_event.h"
+#include "base/file_path.h"
+#include "base/file_util.h"
+#include "base/format_macros.h"
+#include "base/logging.h"
+#include "base/stringprintf.h"
+
+namespace base {
+namespace debug {
+
+namespace {
+
+const size_t kMagicSize = sizeof(kTraceBinaryMagic) - 1;
+
+void WriteVarint(uint64 value, std::string* out) {
+  while (value >= 0x80) {
+    out->push_back(static_cast<char>((value & 0x7f) | 0x80));
+    value >>= 7;
+  }
+  out->push_back(static_cast<char>(value));
+}
+
+void WriteSignedVarint(int64 value, std::string* out) {
+  // Zigzag encoding keeps small negative numbers small.
+  WriteVarint((static_cast<uint64>(value) << 1) ^
+              static_cast<uint64>(value >> 63), out);
+}
+
+void WriteByte(unsigned char value, std::string* out) {
+  out->push_back(static_cast<char>(value));
+}
+
+// Reads a fragment from a string, tracking the position. Every read fails
+// cleanly, rather than running off the end, on malformed input.
+class BinaryTraceReader {
+ public:
+  BinaryTraceReader(const std::string& data, size_t pos)
+      : data_(data), pos_(pos) {}
+
+  bool ReadVarint(uint64* value) {
+    *value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+      if (pos_ >= data_.size())
+        return false;
+      unsigned char byte = static_cast<unsigned char>(data_[pos_++]);
+      *value |= static_cast<uint64>(byte & 0x7f) << shift;
+      if (!(byte & 0x80))
+        return true;
+    }
+    return false;
+  }
+
+  bool ReadSignedVarint(int64* value) {
+    uint64 encoded;
+    if (!ReadVarint(&encoded))
+      return false;
+    *value = static_cast<int64>(encoded >> 1) ^
+        -static_cast<int64>(encoded & 1);
+    return true;
+  }
+
+  bool ReadSize(size_t* value) {
+    uint64 wide;
+    if (!ReadVarint(&wide) || wide > data_.size())
+      return false;
+    *value = static_cast<size_t>(wide);
+    return true;
+  }
+
+  bool ReadByte(unsigned char* value) {
+    if (pos_ >= data_.size())
+      return false;
+    *value = static_cast<unsigned char>(data_[pos_++]);
+    return true;
+  }
+
+  bool ReadBytes(size_t length, std::string* value) {
+    if (length > data_.size() - pos_)
+      return false;
+    value->assign(data_, pos_, length);
+    pos_ += length;
+    return true;
+  }
+
+  size_t pos() const { return pos_; }
+
+ private:
+  const std::string& data_;
+  size_t pos_;
+
+  DISALLOW_COPY_AND_ASSIGN(BinaryTraceReader);
+};
+
+// Reads a string reference; |*value| is NULL for a NULL string.
+bool ReadStringRef(BinaryTraceReader* reader,
+                   const std::vector<std::string>& strings,
+                   const char** value) {
+  uint64 index;
+  if (!reader->ReadVarint(&index) || index > strings.size())
+    return false;
+  *value = index ? strings[index - 1].c_str() : NULL;
+  return true;
+}
+
+bool ReadArgValue(BinaryTraceReader* reader,
+                  const std::vector<std::string>& strings,
+                  unsigned char type,
+                  TraceEvent::TraceValue* value) {
+  switch (type) {
+    case TRACE_VALUE_TYPE_BOOL: {
+      unsigned char byte;
+      if (!reader->ReadByte(&byte))
+        return false;
+      value->as_bool = byte != 0;
+      return true;
+    }
+    case TRACE_VALUE_TYPE_UINT:
+    case TRACE_VALUE_TYPE_POINTER: {
+      uint64 wide;
+      if (!reader->ReadVarint(&wide))
+        return false;
+      value->as_uint = wide;
+      return true;
+    }
+    case TRACE_VALUE_TYPE_INT: {
+      int64 wide;
+      if (!reader->ReadSignedVarint(&wide))
+        return false;
+      value->as_int = wide;
+      return true;
+    }
+    case TRACE_VALUE_TYPE_DOUBLE: {
+      uint64 bits = 0;
+      for (int i = 0; i < 8; ++i) {
+        unsigned char byte;
+        if (!reader->ReadByte(&byte))
+          return false;
+        bits |= static_cast<uint64>(byte) << (8 * i);
+      }
+      memcpy(&value->as_double, &bits, sizeof(bits));
+      return true;
+    }
+    case TRACE_VALUE_TYPE_STRING:
+    case TRACE_VALUE_TYPE_COPY_STRING:
+      return ReadStringRef(reader, strings, &value->as_string);
+    default:
+      return false;
+  }
+}
+
+// Converts the fragment starting at |*pos|, and advances |*pos| past it.
+bool ConvertFragment(const std::string& binary,
+                     size_t* pos,
+                     bool* append_comma,
+                     std::string* json) {
+  if (binary.compare(*pos, kMagicSize, kTraceBinaryMagic) != 0)
+    return false;
+  BinaryTraceReader reader(binary, *pos + kMagicSize);
+
+  unsigned char version;
+  int64 process_id;
+  size_t string_count;
+  if (!reader.ReadByte(&version) || version != kTraceBinaryVersion ||
+      !reader.ReadSignedVarint(&process_id) ||
+      !reader.ReadSize(&string_count)) {
+    return false;
+  }
+
+  std::vector<std::string> strings(string_count);
+  for (size_t i = 0; i < string_count; ++i) {
+    size_t length;
+    if (!reader.ReadSize(&length) || !reader.ReadBytes(length, &strings[i]))
+      return false;
+  }
+
+  size_t event_count;
+  if (!reader.ReadSize(&event_count))
+    return false;
+  int64 timestamp = 0;
+  for (size_t i = 0; i < event_count; ++i) {
+    uint64 thread_id;
+    int64 timestamp_delta;
+    unsigned char phase;
+    const char* category;
+    const char* name;
+    unsigned char flags;
+    if (!reader.ReadVarint(&thread_id) ||
+        !reader.ReadSignedVarint(&timestamp_delta) ||
+        !reader.ReadByte(&phase) ||
+        !ReadStringRef(&reader, strings, &category) ||
+        !ReadStringRef(&reader, strings, &name) ||
+        !reader.ReadByte(&flags) ||
+        !category || !name) {
+      return false;
+    }
+    uint64 id = 0;
+    if ((flags & TRACE_EVENT_FLAG_HAS_ID) && !reader.ReadVarint(&id))
+      return false;
+    timestamp += timestamp_delta;
+
+    if (*append_comma)
+      *json += ",";
+    *append_comma = true;
+    // Keep this in sync with TraceEvent::AppendAsJSON().
+    StringAppendF(json,
+        "{\"cat\":\"%s\",\"pid\":%i,\"tid\":%i,\"ts\":%" PRId64 ","
+        "\"ph\":\"%c\",\"name\":\"%s\",\"args\":{",
+        category,
+        static_cast<int>(process_id),
+        static_cast<int>(thread_id),
+        timestamp,
+        phase,
+        name);
+
+    unsigned char num_args;
+    if (!reader.ReadByte(&num_args) || num_args > kTraceMaxNumArgs)
+      return false;
+    for (int arg = 0; arg < num_args; ++arg) {
+      const char* arg_name;
+      unsigned char arg_type;
+      TraceEvent::TraceValue arg_value;
+      if (!ReadStringRef(&reader, strings, &arg_name) || !arg_name ||
+          !reader.ReadByte(&arg_type) ||
+          !ReadArgValue(&reader, strings, arg_type, &arg_value)) {
+        return false;
+      }
+      if (arg > 0)
+        *json += ",";
+      *json += "\"";
+      *json += arg_name;
+      *json += "\":";
+      TraceEvent::AppendValueAsJSON(arg_type, arg_value, json);
+    }
+    *json += "}";
+
+    if (flags & TRACE_EVENT_FLAG_HAS_ID)
+      StringAppendF(json, ",\"id\":\"%" PRIx64 "\"", id);
+    *json += "}";
+  }
+
+  *pos = reader.pos();
+  return true;
+}
+
+}  // namespace
+
+TraceBinaryWriter::TraceBinaryWriter(int process_id)
+    : process_id_(process_id),
+      string_count_(0),
+      event_count_(0),
+      previous_timestamp_(0) {
+}
+
+TraceBinaryWriter::~TraceBinaryWriter() {
+}
+
+void TraceBinaryWriter::AddEvent(const TraceEvent& event) {
+  int64 timestamp = event.timestamp().ToInternalValue();
+  WriteVarint(static_cast<uint32>(event.thread_id()), &events_);
+  WriteSignedVarint(timestamp - previous_timestamp_, &events_);
+  previous_timestamp_ = timestamp;
+  WriteByte(static_cast<unsigned char>(event.phase()), &events_);
+  WriteStringRef(TraceLog::GetCategoryName(event.category_enabled()));
+  WriteStringRef(event.name());
+  WriteByte(event.flags(), &events_);
+  if (event.flags() & TRACE_EVENT_FLAG_HAS_ID)
+    WriteVarint(event.id(), &events_);
+
+  int num_args = 0;
+  while (num_args < kTraceMaxNumArgs && event.arg_name(num_args))
+    ++num_args;
+  WriteByte(static_cast<unsigned char>(num_args), &events_);
+  for (int i = 0; i < num_args; ++i) {
+    WriteStringRef(event.arg_name(i));
+    unsigned char type = event.arg_type(i);
+    TraceEvent::TraceValue value = event.arg_value(i);
+    WriteByte(type, &events_);
+    switch (type) {
+      case TRACE_VALUE_TYPE_BOOL:
+        WriteByte(value.as_bool ? 1 : 0, &events_);
+        break;
+      case TRACE_VALUE_TYPE_UINT:
+      case TRACE_VALUE_TYPE_POINTER:
+        // The union member is 64 bits wide, so this also covers pointers.
+        WriteVarint(value.as_uint, &events_);
+        break;
+      case TRACE_VALUE_TYPE_INT:
+        WriteSignedVarint(value.as_int, &events_);
+        break;
+      case TRACE_VALUE_TYPE_DOUBLE: {
+        uint64 bits;
+        memcpy(&bits, &value.as_double, sizeof(bits));
+        for (int byte = 0; byte < 8; ++byte)
+          WriteByte(static_cast<unsigned char>(bits >> (8 * byte)), &events_);
+        break;
+      }
+      case TRACE_VALUE_TYPE_STRING:
+      case TRACE_VALUE_TYPE_COPY_STRING:
+        WriteStringRef(value.as_string);
+        break;
+      default:
+        NOTREACHED() << "Don't know how to encode this value";
+        break;
+    }
+  }
+  ++event_count_;
+}
+
+void TraceBinaryWriter::Finish(std::string* out) {
+  out->reserve(out->size() + kMagicSize + 16 + strings_.size() +
+               events_.size());
+  out->append(kTraceBinaryMagic, kMagicSize);
+  WriteByte(kTraceBinaryVersion, out);
+  WriteSignedVarint(process_id_, out);
+  WriteVarint(string_count_, out);
+  out->append(strings_);
+  WriteVarint(event_count_, out);
+  out->append(events_);
+
+  string_indices_.clear();
+  strings_.clear();
+  string_count_ = 0;
+  events_.clear();
+  event_count_ = 0;
+  previous_timestamp_ = 0;
+}
+
+void TraceBinaryWriter::WriteStringRef(const char* str) {
+  if (!str) {
+    WriteVarint(0, &events_);
+    return;
+  }
+  std::pair<base::hash_map<uintptr_t, size_t>::iterator, bool> inserted =
+      string_indices_.insert(std::make_pair(reinterpret_cast<uintptr_t>(str),
+                                            string_count_ + 1));
+  if (inserted.second) {
+    size_t length = strlen(str);
+    WriteVarint(length, &strings_);
+    strings_.append(str, length);
+    ++string_count_;
+  }
+  WriteVarint(inserted.first->second, &events_);
+}
+
+bool IsBinaryTrace(const std::string& data) {
+  return data.compare(0, kMagicSize, kTraceBinaryMagic) == 0;
+}
+
+bool ConvertBinaryTraceToJSON(const std::string& binary, std::string* json) {
+  bool append_comma = false;
+  size_t pos = 0;
+  while (pos < binary.size()) {
+    if (!ConvertFragment(binary, &pos, &append_comma, json))
+      return false;
+  }
+  return true;
+}
+
+void AppendTraceFragmentToFile(
+    const FilePath& path,
+    const scoped_refptr<RefCountedString>& fragment) {
+  const std::string& data = fragment->data();
+  if (file_util::AppendToFile(path, data.data(),
+                              static_cast<int>(data.size())) == -1) {
+    DLOG(ERROR) << "Failed to write trace to " << path.value();
+  }
+}
+
+}  // namespace debug
+}  // namespace base
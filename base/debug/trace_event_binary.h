@@ -0,0 +1,101 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// A compact binary encoding of TraceEvents, used by TraceLog::Flush() when
+// the output format is TraceLog::OUTPUT_FORMAT_BINARY. Encoding an event is a
+// handful of varint writes, which is much cheaper than formatting it as JSON.
+//
+// The output is a series of self-contained fragments:
+//
+//   fragment  := magic version pid string_count string* event_count event*
+//   magic     := "TRCB"
+//   version   := byte (kTraceBinaryVersion)
+//   string    := varint(length) bytes
+//   event     := varint(tid) zigzag(ts - previous ts) byte(phase)
+//                string_ref(category) string_ref(name) byte(flags)
+//                [varint(id) if flags has TRACE_EVENT_FLAG_HAS_ID]
+//                byte(num_args) arg*
+//   arg       := string_ref(name) byte(type) value
+//   string_ref:= varint(index into the fragment's strings + 1), 0 for NULL
+//
+// Integers are unsigned LEB128 varints; signed values are zigzag encoded
+// first. Doubles are stored as their 8 IEEE-754 bytes, least significant
+// first. Since every fragment carries its own string table, fragments can be
+// sent separately or simply concatenated, e.g. appended to a file as they
+// arrive, and ConvertBinaryTraceToJSON() accepts either.
+
+#ifndef BASE_DEBUG_TRACE_EVENT_BINARY_H_
+#define BASE_DEBUG_TRACE_EVENT_BINARY_H_
+#pragma once
+
+#include <string>
+
+#include "base/base_export.h"
+#include "base/basictypes.h"
+#include "base/hash_tables.h"
+#include "base/memory/ref_counted_memory.h"
+
+class FilePath;
+
+namespace base {
+namespace debug {
+
+class TraceEvent;
+
+const char kTraceBinaryMagic[] = "TRCB";
+const unsigned char kTraceBinaryVersion = 1;
+
+// Accumulates events into one binary fragment.
+class BASE_EXPORT TraceBinaryWriter {
+ public:
+  explicit TraceBinaryWriter(int process_id);
+  ~TraceBinaryWriter();
+
+  void AddEvent(const TraceEvent& event);
+
+  size_t event_count() const { return event_count_; }
+
+  // Appends the fragment holding every event added since the last call to
+  // |out|, and resets the writer.
+  void Finish(std::string* out);
+
+ private:
+  void WriteStringRef(const char* str);
+
+  int process_id_;
+  // Strings are interned by address; the same text at two addresses (copied
+  // strings, mostly) is simply stored twice.
+  base::hash_map<uintptr_t, size_t> string_indices_;
+  std::string strings_;
+  size_t string_count_;
+  std::string events_;
+  size_t event_count_;
+  int64 previous_timestamp_;
+
+  DISALLOW_COPY_AND_ASSIGN(TraceBinaryWriter);
+};
+
+// Returns true if |data| starts with a binary trace fragment.
+BASE_EXPORT bool IsBinaryTrace(const std::string& data);
+
+// Converts one or more concatenated binary fragments into the comma-separated
+// JSON objects TraceLog produces in OUTPUT_FORMAT_JSON, appending them to
+// |json|. Returns false if |binary| is malformed.
+BASE_EXPORT bool ConvertBinaryTraceToJSON(const std::string& binary,
+                                          std::string* json);
+
+// Appends |fragment| to the file at |path|. Bind it to a path to stream a
+// flush straight to disk:
+//   TraceLog::GetInstance()->SetOutputCallback(
+//       base::Bind(&AppendTraceFragmentToFile, path));
+// The file must exist. Meant for OUTPUT_FORMAT_BINARY, whose fragments can
+// be concatenated.
+BASE_EXPORT void AppendTraceFragmentToFile(
+    const FilePath& path,
+    const scoped_refptr<RefCountedString>& fragment);
+
+}  // namespace debug
+}  // namespace base
+
+#endif  // BASE_DEBUG_TRACE_EVENT_BINARY_H_
@@ -0,0 +1,87 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/debug/trace_event_binary.h"
+
+#include <string>
+#include <vector>
+
+#include "base/debug/trace_event.h"
+#include "base/perftimer.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace base {
+namespace debug {
+
+namespace {
+
+const int kProcessId = 42;
+const size_t kNumEvents = 500000;
+// TraceLog serializes its buffers in batches of this many events.
+const size_t kEventsPerFragment = 1000;
+
+// Fills |events| with instant events carrying an int and a string argument,
+// spread over a few threads.
+void MakeEvents(std::vector<TraceEvent>* events) {
+  const char* arg_names[] = { "count", "label" };
+  unsigned char arg_types[2];
+  unsigned long long arg_values[2];
+  trace_event_internal::SetTraceValue(12345, &arg_types[0], &arg_values[0]);
+  trace_event_internal::SetTraceValue("label", &arg_types[1], &arg_values[1]);
+  events->reserve(kNumEvents);
+  for (size_t i = 0; i < kNumEvents; ++i) {
+    events->push_back(TraceEvent(static_cast<int>(i % 8),
+                                 TimeTicks::FromInternalValue(1000 + i),
+                                 TRACE_EVENT_PHASE_INSTANT,
+                                 TraceLog::GetCategoryEnabled("binary_perf"),
+                                 "event", 0,
+                                 2, arg_names, arg_types, arg_values,
+                                 TRACE_EVENT_FLAG_NONE));
+  }
+}
+
+}  // namespace
+
+TEST(TraceEventBinaryPerfTest, SerializeJSON) {
+  std::vector<TraceEvent> events;
+  MakeEvents(&events);
+
+  size_t bytes = 0;
+  PerfTimer timer;
+  for (size_t i = 0; i < kNumEvents; i += kEventsPerFragment) {
+    std::string json;
+    TraceEvent::AppendEventsAsJSON(events, i, kEventsPerFragment, &json);
+    bytes += json.size();
+  }
+  LogPerfResult("TraceEvent_SerializeJSON",
+                timer.Elapsed().InMillisecondsF() * 1000000 / kNumEvents,
+                "ns/event");
+  LogPerfResult("TraceEvent_SerializeJSON_Size",
+                static_cast<double>(bytes) / kNumEvents, "bytes/event");
+}
+
+TEST(TraceEventBinaryPerfTest, SerializeBinary) {
+  std::vector<TraceEvent> events;
+  MakeEvents(&events);
+
+  size_t bytes = 0;
+  PerfTimer timer;
+  TraceBinaryWriter writer(kProcessId);
+  for (size_t i = 0; i < kNumEvents; ++i) {
+    writer.AddEvent(events[i]);
+    if (writer.event_count() == kEventsPerFragment) {
+      std::string binary;
+      writer.Finish(&binary);
+      bytes += binary.size();
+    }
+  }
+  LogPerfResult("TraceEvent_SerializeBinary",
+                timer.Elapsed().InMillisecondsF() * 1000000 / kNumEvents,
+                "ns/event");
+  LogPerfResult("TraceEvent_SerializeBinary_Size",
+                static_cast<double>(bytes) / kNumEvents, "bytes/event");
+}
+
+}  // namespace debug
+}  // namespace base
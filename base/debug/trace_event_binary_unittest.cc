@@ -0,0 +1,166 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/debug/trace_event_binary.h"
+
+#include <vector>
+
+#include "base/debug/trace_event.h"
+#include "base/stringprintf.h"
+#include "base/string_util.h"
+#include "base/time.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace base {
+namespace debug {
+
+namespace {
+
+const int kProcessId = 42;
+
+TraceEvent MakeEvent(int thread_id,
+                     int64 timestamp_us,
+                     char phase,
+                     const char* name,
+                     unsigned long long id,
+                     int num_args,
+                     const char** arg_names,
+                     const unsigned char* arg_types,
+                     const unsigned long long* arg_values,
+                     unsigned char flags) {
+  return TraceEvent(thread_id,
+                    TimeTicks::FromInternalValue(timestamp_us),
+                    phase,
+                    TraceLog::GetCategoryEnabled("binary_test"),
+                    name, id,
+                    num_args, arg_names, arg_types, arg_values,
+                    flags);
+}
+
+// A representative set of events covering every argument type.
+void MakeEvents(std::vector<TraceEvent>* events) {
+  const char* arg_names[] = { "a", "b" };
+  unsigned char arg_types[2];
+  unsigned long long arg_values[2];
+
+  events->push_back(MakeEvent(1, 1000, TRACE_EVENT_PHASE_BEGIN, "plain",
+                              0, 0, NULL, NULL, NULL, TRACE_EVENT_FLAG_NONE));
+
+  trace_event_internal::SetTraceValue(true, &arg_types[0], &arg_values[0]);
+  trace_event_internal::SetTraceValue(-7, &arg_types[1], &arg_values[1]);
+  events->push_back(MakeEvent(2, 900, TRACE_EVENT_PHASE_INSTANT, "bool_int",
+                              0, 2, arg_names, arg_types, arg_values,
+                              TRACE_EVENT_FLAG_NONE));
+
+  trace_event_internal::SetTraceValue(12345678901ull, &arg_types[0],
+                                      &arg_values[0]);
+  trace_event_internal::SetTraceValue(3.5, &arg_types[1], &arg_values[1]);
+  events->push_back(MakeEvent(-3, 5000, TRACE_EVENT_PHASE_END, "uint_double",
+                              0, 2, arg_names, arg_types, arg_values,
+                              TRACE_EVENT_FLAG_NONE));
+
+  static int pointee;
+  trace_event_internal::SetTraceValue(&pointee, &arg_types[0],
+                                      &arg_values[0]);
+  trace_event_internal::SetTraceValue("quoted \"string\"", &arg_types[1],
+                                      &arg_values[1]);
+  events->push_back(MakeEvent(1, 5001, TRACE_EVENT_PHASE_ASYNC_BEGIN,
+                              "pointer_string", 0xfeedbeeffeedbeefull,
+                              2, arg_names, arg_types, arg_values,
+                              TRACE_EVENT_FLAG_HAS_ID));
+
+  const char* null_string = NULL;
+  trace_event_internal::SetTraceValue(null_string, &arg_types[0],
+                                      &arg_values[0]);
+  trace_event_internal::SetTraceValue(std::string("copied"), &arg_types[1],
+                                      &arg_values[1]);
+  events->push_back(MakeEvent(1, 5002, TRACE_EVENT_PHASE_INSTANT,
+                              "copy_name", 0, 2, arg_names, arg_types,
+                              arg_values, TRACE_EVENT_FLAG_COPY));
+}
+
+// The JSON TraceLog would produce, with the pid swapped for kProcessId.
+std::string ExpectedJSON(const std::vector<TraceEvent>& events) {
+  std::string json;
+  TraceEvent::AppendEventsAsJSON(events, 0, events.size(), &json);
+  std::string pid = StringPrintf("\"pid\":%i,",
+                                 TraceLog::GetInstance()->process_id());
+  std::string fake_pid = StringPrintf("\"pid\":%i,", kProcessId);
+  ReplaceSubstringsAfterOffset(&json, 0, pid, fake_pid);
+  return json;
+}
+
+}  // namespace
+
+class TraceEventBinaryTest : public testing::Test {
+ protected:
+  virtual void SetUp() OVERRIDE {
+    // Serializing events as JSON needs the TraceLog, which earlier tests may
+    // have torn down.
+    TraceLog::Resurrect();
+  }
+};
+
+TEST_F(TraceEventBinaryTest, RoundTripMatchesJSON) {
+  std::vector<TraceEvent> events;
+  MakeEvents(&events);
+
+  TraceBinaryWriter writer(kProcessId);
+  for (size_t i = 0; i < events.size(); ++i)
+    writer.AddEvent(events[i]);
+  EXPECT_EQ(events.size(), writer.event_count());
+  std::string binary;
+  writer.Finish(&binary);
+  EXPECT_EQ(0u, writer.event_count());
+  EXPECT_TRUE(IsBinaryTrace(binary));
+
+  std::string json;
+  ASSERT_TRUE(ConvertBinaryTraceToJSON(binary, &json));
+  EXPECT_EQ(ExpectedJSON(events), json);
+}
+
+TEST_F(TraceEventBinaryTest, ConcatenatedFragments) {
+  std::vector<TraceEvent> events;
+  MakeEvents(&events);
+
+  // Each fragment has its own string table.
+  TraceBinaryWriter writer(kProcessId);
+  std::string binary;
+  for (size_t i = 0; i < events.size(); ++i) {
+    writer.AddEvent(events[i]);
+    if (i % 2)
+      writer.Finish(&binary);
+  }
+  writer.Finish(&binary);
+
+  std::string json;
+  ASSERT_TRUE(ConvertBinaryTraceToJSON(binary, &json));
+  EXPECT_EQ(ExpectedJSON(events), json);
+}
+
+TEST_F(TraceEventBinaryTest, RejectsMalformedInput) {
+  std::string json;
+  EXPECT_FALSE(IsBinaryTrace(""));
+  EXPECT_FALSE(IsBinaryTrace("[{\"cat\":\"x\"}]"));
+  EXPECT_TRUE(ConvertBinaryTraceToJSON("", &json));
+  EXPECT_FALSE(ConvertBinaryTraceToJSON("TRCX", &json));
+
+  std::vector<TraceEvent> events;
+  MakeEvents(&events);
+  TraceBinaryWriter writer(kProcessId);
+  for (size_t i = 0; i < events.size(); ++i)
+    writer.AddEvent(events[i]);
+  std::string binary;
+  writer.Finish(&binary);
+
+  // Every truncation must be detected without reading past the end.
+  for (size_t length = 1; length < binary.size(); ++length) {
+    json.clear();
+    EXPECT_FALSE(ConvertBinaryTraceToJSON(binary.substr(0, length), &json))
+        << "length " << length;
+  }
+}
+
+}  // namespace debug
+}  // namespace base
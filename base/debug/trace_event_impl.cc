@@ -5,18 +5,19 @@
 #include "base/debug/trace_event_impl.h"
 
 #include <algorithm>
+#include <queue>
 
 #include "base/bind.h"
 #include "base/debug/trace_event.h"
+#include "base/debug/trace_event_binary.h"
 #include "base/file_util.h"
 #include "base/format_macros.h"
-#include "base/lazy_instance.h"
 #include "base/memory/singleton.h"
 #include "base/process_util.h"
 #include "base/stringprintf.h"
 #include "base/string_tokenizer.h"
 #include "base/threading/platform_thread.h"
-#include "base/threading/thread_local.h"
+#include "base/threading/thread_local_storage.h"
 #include "base/utf_string_conversions.h"
 #include "base/stl_util.h"
 #include "base/sys_info.h"
@@ -42,6 +43,11 @@ namespace debug {
 // before throwing them away.
 const size_t kTraceEventBufferSize = 500000;
 const size_t kTraceEventBatchSize = 1000;
+// Events are buffered per thread in chunks of this many events. Threads only
+// synchronize with each other when they need a new chunk.
+const size_t kTraceEventChunkSize = 64;
+const size_t kTraceEventBufferChunks =
+    kTraceEventBufferSize / kTraceEventChunkSize;
 
 #define TRACE_EVENT_MAX_CATEGORIES 100
 
@@ -64,54 +70,93 @@ const int g_category_categories_exhausted = 1;
 const int g_category_metadata = 2;
 int g_category_index = 3; // skip initial 3 categories
 
-// The most-recently captured name of the current thread
-LazyInstance<ThreadLocalPointer<const char> >::Leaky
-    g_current_thread_name = LAZY_INSTANCE_INITIALIZER;
+// Holds the calling thread's TraceLog::ThreadLocalEventBuffer.
+ThreadLocalStorage::StaticSlot g_event_buffer_slot = TLS_INITIALIZER;
 
-void AppendValueAsJSON(unsigned char type,
-                       TraceEvent::TraceValue value,
-                       std::string* out) {
-  std::string::size_type start_pos;
-  switch (type) {
-    case TRACE_VALUE_TYPE_BOOL:
-      *out += value.as_bool ? "true" : "false";
-      break;
-    case TRACE_VALUE_TYPE_UINT:
-      StringAppendF(out, "%" PRIu64, static_cast<uint64>(value.as_uint));
-      break;
-    case TRACE_VALUE_TYPE_INT:
-      StringAppendF(out, "%" PRId64, static_cast<int64>(value.as_int));
-      break;
-    case TRACE_VALUE_TYPE_DOUBLE:
-      StringAppendF(out, "%f", value.as_double);
-      break;
-    case TRACE_VALUE_TYPE_POINTER:
-      // JSON only supports double and int numbers.
-      // So as not to lose bits from a 64-bit pointer, output as a hex string.
-      StringAppendF(out, "\"%" PRIx64 "\"", static_cast<uint64>(
-                                     reinterpret_cast<intptr_t>(
-                                     value.as_pointer)));
-      break;
-    case TRACE_VALUE_TYPE_STRING:
-    case TRACE_VALUE_TYPE_COPY_STRING:
-      *out += "\"";
-      start_pos = out->size();
-      *out += value.as_string ? value.as_string : "NULL";
-      // insert backslash before special characters for proper json format.
-      while ((start_pos = out->find_first_of("\\\"", start_pos)) !=
-             std::string::npos) {
-        out->insert(start_pos, 1, '\\');
-        // skip inserted escape character and following character.
-        start_pos += 2;
-      }
-      *out += "\"";
-      break;
-    default:
-      NOTREACHED() << "Don't know how to print this value";
-      break;
-  }
+// Generation of the live TraceLog, or 0 if there is none.
+subtle::Atomic32 g_live_generation = 0;
+int g_next_generation = 1;
+
+// Event handles returned by AddTraceEvent() encode the chunk sequence number
+// and the index within the chunk, and must fit in a non-negative int.
+const int kChunkSeqMask = 0x1ffffff;
+
+bool TimestampLess(const TraceEvent& a, const TraceEvent& b) {
+  return a.timestamp() < b.timestamp();
 }
 
+// A sequence of events already in timestamp order, such as the events of one
+// chunk, that Flush() merges with the others.
+struct EventRun {
+  const TraceEvent* next;
+  const TraceEvent* end;
+  // Position of the run among all runs. Ties between runs are broken by it,
+  // which gives the same order as a stable sort of the runs put end to end.
+  size_t order;
+};
+
+// Makes std::priority_queue return the run with the earliest next event.
+struct LaterEventRun {
+  bool operator()(const EventRun& a, const EventRun& b) const {
+    if (a.next->timestamp() != b.next->timestamp())
+      return b.next->timestamp() < a.next->timestamp();
+    return a.order > b.order;
+  }
+};
+
+// Serializes events in batches of kTraceEventBatchSize and hands each batch
+// to the output callback as soon as it is complete.
+class FlushBatcher {
+ public:
+  FlushBatcher(TraceLog::OutputFormat format,
+               const TraceLog::OutputCallback& callback,
+               int process_id)
+      : format_(format),
+        callback_(callback),
+        binary_writer_(process_id),
+        json_event_count_(0) {
+  }
+
+  void Add(const TraceEvent& event) {
+    if (format_ == TraceLog::OUTPUT_FORMAT_BINARY) {
+      binary_writer_.AddEvent(event);
+      if (binary_writer_.event_count() == kTraceEventBatchSize)
+        Finish();
+    } else {
+      if (json_event_count_ > 0)
+        json_ += ",";
+      event.AppendAsJSON(&json_);
+      if (++json_event_count_ == kTraceEventBatchSize)
+        Finish();
+    }
+  }
+
+  // Sends out the current batch, if not empty.
+  void Finish() {
+    scoped_refptr<RefCountedString> fragment = new RefCountedString();
+    if (format_ == TraceLog::OUTPUT_FORMAT_BINARY) {
+      if (!binary_writer_.event_count())
+        return;
+      binary_writer_.Finish(&fragment->data());
+    } else {
+      if (!json_event_count_)
+        return;
+      fragment->data().swap(json_);
+      json_event_count_ = 0;
+    }
+    callback_.Run(fragment);
+  }
+
+ private:
+  TraceLog::OutputFormat format_;
+  TraceLog::OutputCallback callback_;
+  TraceBinaryWriter binary_writer_;
+  std::string json_;
+  size_t json_event_count_;
+
+  DISALLOW_COPY_AND_ASSIGN(FlushBatcher);
+};
+
 }  // namespace
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -234,6 +279,51 @@ void TraceEvent::AppendEventsAsJSON(const std::vector<TraceEvent>& events,
   }
 }
 
+// static
+void TraceEvent::AppendValueAsJSON(unsigned char type,
+                                   TraceValue value,
+                                   std::string* out) {
+  std::string::size_type start_pos;
+  switch (type) {
+    case TRACE_VALUE_TYPE_BOOL:
+      *out += value.as_bool ? "true" : "false";
+      break;
+    case TRACE_VALUE_TYPE_UINT:
+      StringAppendF(out, "%" PRIu64, static_cast<uint64>(value.as_uint));
+      break;
+    case TRACE_VALUE_TYPE_INT:
+      StringAppendF(out, "%" PRId64, static_cast<int64>(value.as_int));
+      break;
+    case TRACE_VALUE_TYPE_DOUBLE:
+      StringAppendF(out, "%f", value.as_double);
+      break;
+    case TRACE_VALUE_TYPE_POINTER:
+      // JSON only supports double and int numbers.
+      // So as not to lose bits from a 64-bit pointer, output as a hex string.
+      StringAppendF(out, "\"%" PRIx64 "\"", static_cast<uint64>(
+                                     reinterpret_cast<intptr_t>(
+                                     value.as_pointer)));
+      break;
+    case TRACE_VALUE_TYPE_STRING:
+    case TRACE_VALUE_TYPE_COPY_STRING:
+      *out += "\"";
+      start_pos = out->size();
+      *out += value.as_string ? value.as_string : "NULL";
+      // insert backslash before special characters for proper json format.
+      while ((start_pos = out->find_first_of("\\\"", start_pos)) !=
+             std::string::npos) {
+        out->insert(start_pos, 1, '\\');
+        // skip inserted escape character and following character.
+        start_pos += 2;
+      }
+      *out += "\"";
+      break;
+    default:
+      NOTREACHED() << "Don't know how to print this value";
+      break;
+  }
+}
+
 void TraceEvent::AppendAsJSON(std::string* out) const {
   int64 time_int64 = timestamp_.ToInternalValue();
   int process_id = TraceLog::GetInstance()->process_id();
@@ -300,6 +390,17 @@ void TraceResultBuffer::Start() {
 }
 
 void TraceResultBuffer::AddFragment(const std::string& trace_fragment) {
+  if (IsBinaryTrace(trace_fragment)) {
+    std::string json;
+    if (!ConvertBinaryTraceToJSON(trace_fragment, &json)) {
+      DLOG(ERROR) << "Dropping malformed binary trace fragment";
+      return;
+    }
+    if (json.empty())
+      return;
+    AddFragment(json);
+    return;
+  }
   if (append_comma_)
     output_callback_.Run(",");
   append_comma_ = true;
@@ -310,6 +411,154 @@ void TraceResultBuffer::Finish() {
   output_callback_.Run("]");
 }
 
+////////////////////////////////////////////////////////////////////////////////
+//
+// TraceLog::TraceBufferChunk
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// Only the owning thread appends to a chunk, and it publishes each event by
+// storing the new size with release semantics, so the flushing thread can read
+// the published prefix while the owner keeps appending. Everything other than
+// appending happens with TraceLog::lock_ held.
+class TraceLog::TraceBufferChunk {
+ public:
+  explicit TraceBufferChunk(int seq) : size_(0), flushed_(0), seq_(seq) {}
+
+  void Reset(int seq) {
+    for (size_t i = 0; i < size(); ++i)
+      events_[i] = TraceEvent();
+    subtle::NoBarrier_Store(&size_, 0);
+    flushed_ = 0;
+    seq_ = seq;
+  }
+
+  // Called on the owning thread only.
+  bool IsFull() const {
+    return subtle::NoBarrier_Load(&size_) ==
+        static_cast<subtle::Atomic32>(kTraceEventChunkSize);
+  }
+
+  // Called on the owning thread only. Returns the handle of the new event.
+  int Add(const TraceEvent& event) {
+    DCHECK(!IsFull());
+    subtle::Atomic32 index = subtle::NoBarrier_Load(&size_);
+    events_[index] = event;
+    subtle::Release_Store(&size_, index + 1);
+    return (seq_ & kChunkSeqMask) * static_cast<int>(kTraceEventChunkSize) +
+        index;
+  }
+
+  // Returns true and sets |*index| if |handle| refers to an event in this
+  // chunk that has not been flushed yet.
+  bool FindUnflushed(int handle, size_t* index) const {
+    int chunk_size = static_cast<int>(kTraceEventChunkSize);
+    if (handle / chunk_size != (seq_ & kChunkSeqMask))
+      return false;
+    *index = static_cast<size_t>(handle % chunk_size);
+    return *index >= flushed_ && *index < size();
+  }
+
+  // Removes the event at |index|, shifting later events down. Called on the
+  // owning thread with TraceLog::lock_ held.
+  void Remove(size_t index) {
+    size_t old_size = size();
+    DCHECK_LT(index, old_size);
+    for (size_t i = index + 1; i < old_size; ++i)
+      events_[i - 1] = events_[i];
+    events_[old_size - 1] = TraceEvent();
+    subtle::Release_Store(&size_, static_cast<subtle::Atomic32>(old_size - 1));
+  }
+
+  // Appends the events that have not been flushed yet to |events|, and marks
+  // them as flushed if |consume| is set.
+  void CollectEvents(bool consume, std::vector<TraceEvent>* events) {
+    size_t end = size();
+    for (size_t i = flushed_; i < end; ++i)
+      events->push_back(events_[i]);
+    if (consume)
+      flushed_ = end;
+  }
+
+  bool HasUnflushedEvents() const { return flushed_ < size(); }
+  size_t flushed() const { return flushed_; }
+
+  size_t size() const {
+    return static_cast<size_t>(subtle::Acquire_Load(&size_));
+  }
+  const TraceEvent& GetEventAt(size_t index) const { return events_[index]; }
+
+ private:
+  TraceEvent events_[kTraceEventChunkSize];
+  subtle::Atomic32 size_;
+  // Events before this index have already been passed to Flush().
+  size_t flushed_;
+  int seq_;
+
+  DISALLOW_COPY_AND_ASSIGN(TraceBufferChunk);
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// TraceLog::ThreadLocalEventBuffer
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// Owned by its thread through |g_event_buffer_slot|, and registered with the
+// TraceLog of the matching generation so that Flush() can reach the chunk it
+// is filling. |chunk_| is only replaced with TraceLog::lock_ held.
+class TraceLog::ThreadLocalEventBuffer {
+ public:
+  ThreadLocalEventBuffer(TraceLog* trace_log, int generation)
+      : trace_log_(trace_log),
+        generation_(generation),
+        thread_id_(static_cast<int>(PlatformThread::CurrentId())),
+        thread_name_(NULL),
+        chunk_(NULL) {
+  }
+
+  ~ThreadLocalEventBuffer() {
+    delete chunk_;
+  }
+
+  // TLS destructor: hands the partially filled chunk over to the TraceLog so
+  // its events survive the thread.
+  static void OnThreadExit(void* value) {
+    ThreadLocalEventBuffer* buffer =
+        static_cast<ThreadLocalEventBuffer*>(value);
+    if (buffer->generation_ == subtle::Acquire_Load(&g_live_generation))
+      buffer->trace_log_->UnregisterThreadLocalEventBuffer(buffer);
+    delete buffer;
+  }
+
+  // Keeps the TraceLog's thread name table up to date. Note this will not
+  // detect a thread name change within the same char* buffer address: we
+  // favor common case performance over corner case correctness.
+  void CheckThreadName() {
+    const char* new_name = PlatformThread::GetName();
+    if (new_name != thread_name_ && new_name && *new_name) {
+      thread_name_ = new_name;
+      trace_log_->UpdateThreadName(thread_id_, new_name);
+    }
+  }
+
+  int generation() const { return generation_; }
+  int thread_id() const { return thread_id_; }
+
+  TraceBufferChunk* chunk() const { return chunk_; }
+  void set_chunk(TraceBufferChunk* chunk) { chunk_ = chunk; }
+
+ private:
+  TraceLog* trace_log_;
+  int generation_;
+  int thread_id_;
+  // The most recently captured name of this thread.
+  const char* thread_name_;
+  TraceBufferChunk* chunk_;
+
+  DISALLOW_COPY_AND_ASSIGN(ThreadLocalEventBuffer);
+};
+
 ////////////////////////////////////////////////////////////////////////////////
 //
 // TraceLog
@@ -322,8 +571,14 @@ TraceLog* TraceLog::GetInstance() {
 }
 
 TraceLog::TraceLog()
-    : enabled_(false)
-    , dispatching_to_observer_list_(false) {
+    : enabled_(false),
+      output_format_(OUTPUT_FORMAT_JSON),
+      recording_mode_(RECORD_UNTIL_FULL),
+      num_chunks_(0),
+      next_chunk_seq_(0),
+      buffer_full_(0),
+      generation_(g_next_generation++),
+      dispatching_to_observer_list_(false) {
   // Trace is enabled or disabled on one thread while other threads are
   // accessing the enabled flag. We don't care whether edge-case events are
   // traced or not, so we allow races on the enabled flag to keep the trace
@@ -340,9 +595,16 @@ TraceLog::TraceLog()
 #else
   SetProcessID(static_cast<int>(base::GetCurrentProcId()));
 #endif
+  if (!g_event_buffer_slot.initialized())
+    g_event_buffer_slot.Initialize(&ThreadLocalEventBuffer::OnThreadExit);
+  subtle::Release_Store(&g_live_generation, generation_);
 }
 
 TraceLog::~TraceLog() {
+  // Buffers still registered belong to live threads, which delete them the
+  // next time they trace or when they exit.
+  subtle::Release_Store(&g_live_generation, 0);
+  STLDeleteElements(&logged_chunks_);
 }
 
 const unsigned char* TraceLog::GetCategoryEnabled(const char* name) {
@@ -447,7 +709,6 @@ void TraceLog::SetEnabled(const std::vector<std::string>& included_categories,
                     OnTraceLogWillEnable());
   dispatching_to_observer_list_ = false;
 
-  logged_events_.reserve(1024);
   enabled_ = true;
   included_categories_ = included_categories;
   excluded_categories_ = excluded_categories;
@@ -535,7 +796,13 @@ void TraceLog::RemoveEnabledStateObserver(
 }
 
 float TraceLog::GetBufferPercentFull() const {
-  return (float)((double)logged_events_.size()/(double)kTraceEventBufferSize);
+  return std::min(1.0f, static_cast<float>(num_chunks_) /
+                            static_cast<float>(kTraceEventBufferChunks));
+}
+
+void TraceLog::SetRecordingMode(RecordingMode mode) {
+  AutoLock lock(lock_);
+  recording_mode_ = mode;
 }
 
 void TraceLog::SetOutputCallback(const TraceLog::OutputCallback& cb) {
@@ -548,29 +815,68 @@ void TraceLog::SetBufferFullCallback(const TraceLog::BufferFullCallback& cb) {
   buffer_full_callback_ = cb;
 }
 
+void TraceLog::SetOutputFormat(OutputFormat format) {
+  AutoLock lock(lock_);
+  output_format_ = format;
+}
+
 void TraceLog::Flush() {
+  std::vector<TraceBufferChunk*> previous_logged_chunks;
   std::vector<TraceEvent> previous_logged_events;
   OutputCallback output_callback_copy;
+  OutputFormat output_format;
   {
     AutoLock lock(lock_);
-    previous_logged_events.swap(logged_events_);
+    TakeEventsForFlush(&previous_logged_chunks, &previous_logged_events);
     output_callback_copy = output_callback_;
+    output_format = output_format_;
   }  // release lock
 
-  if (output_callback_copy.is_null())
+  if (output_callback_copy.is_null()) {
+    STLDeleteElements(&previous_logged_chunks);
     return;
+  }
+
+  // Each chunk holds the events of one thread in timestamp order, and so do
+  // the events copied from live chunks once sorted. Merging these runs writes
+  // every event in timestamp order without gathering them all in one vector
+  // first. Each chunk is freed as soon as its last event is serialized.
+  std::stable_sort(previous_logged_events.begin(),
+                   previous_logged_events.end(),
+                   &TimestampLess);
+  std::priority_queue<EventRun, std::vector<EventRun>, LaterEventRun> runs;
+  for (size_t i = 0; i < previous_logged_chunks.size(); ++i) {
+    TraceBufferChunk* chunk = previous_logged_chunks[i];
+    if (chunk->flushed() == chunk->size()) {
+      delete chunk;
+      previous_logged_chunks[i] = NULL;
+      continue;
+    }
+    EventRun run = { &chunk->GetEventAt(chunk->flushed()),
+                     &chunk->GetEventAt(0) + chunk->size(), i };
+    runs.push(run);
+  }
+  if (!previous_logged_events.empty()) {
+    EventRun run = { &previous_logged_events[0],
+                     &previous_logged_events[0] + previous_logged_events.size(),
+                     previous_logged_chunks.size() };
+    runs.push(run);
+  }
 
-  for (size_t i = 0;
-       i < previous_logged_events.size();
-       i += kTraceEventBatchSize) {
-    scoped_refptr<RefCountedString> json_events_str_ptr =
-        new RefCountedString();
-    TraceEvent::AppendEventsAsJSON(previous_logged_events,
-                                   i,
-                                   kTraceEventBatchSize,
-                                   &(json_events_str_ptr->data()));
-    output_callback_copy.Run(json_events_str_ptr);
+  FlushBatcher batcher(output_format, output_callback_copy, process_id_);
+  while (!runs.empty()) {
+    EventRun run = runs.top();
+    runs.pop();
+    batcher.Add(*run.next);
+    if (++run.next != run.end) {
+      runs.push(run);
+    } else if (run.order < previous_logged_chunks.size()) {
+      delete previous_logged_chunks[run.order];
+      previous_logged_chunks[run.order] = NULL;
+    }
   }
+  previous_logged_chunks.clear();
+  batcher.Finish();
 }
 
 int TraceLog::AddTraceEvent(char phase,
@@ -586,81 +892,220 @@ int TraceLog::AddTraceEvent(char phase,
                             unsigned char flags) {
   DCHECK(name);
   TimeTicks now = TimeTicks::NowFromSystemTraceTime();
-  BufferFullCallback buffer_full_callback_copy;
-  int ret_begin_id = -1;
-  {
-    AutoLock lock(lock_);
-    if (!*category_enabled)
-      return -1;
-    if (logged_events_.size() >= kTraceEventBufferSize)
+  if (!*category_enabled)
+    return -1;
+
+  ThreadLocalEventBuffer* buffer = GetThreadLocalEventBuffer();
+  TraceBufferChunk* chunk = buffer->chunk();
+  if (!chunk && subtle::NoBarrier_Load(&buffer_full_))
+    return -1;
+
+  buffer->CheckThreadName();
+
+  if (threshold_begin_id > -1 &&
+      !CheckThreshold(buffer, threshold_begin_id, now, threshold)) {
+    return -1;
+  }
+
+  if (flags & TRACE_EVENT_FLAG_MANGLE_ID)
+    id ^= process_id_hash_;
+
+  if (!chunk || chunk->IsFull()) {
+    bool buffer_became_full = false;
+    BufferFullCallback buffer_full_callback_copy;
+    {
+      AutoLock lock(lock_);
+      chunk = SwapChunk(buffer, &buffer_became_full);
+      if (buffer_became_full)
+        buffer_full_callback_copy = buffer_full_callback_;
+    }  // release lock
+    if (!buffer_full_callback_copy.is_null())
+      buffer_full_callback_copy.Run();
+    if (!chunk)
       return -1;
+  }
 
-    int thread_id = static_cast<int>(PlatformThread::CurrentId());
+  return chunk->Add(TraceEvent(buffer->thread_id(),
+                               now, phase, category_enabled, name, id,
+                               num_args, arg_names, arg_types, arg_values,
+                               flags));
+}
 
-    const char* new_name = PlatformThread::GetName();
-    // Check if the thread name has been set or changed since the previous
-    // call (if any), but don't bother if the new name is empty. Note this will
-    // not detect a thread name change within the same char* buffer address: we
-    // favor common case performance over corner case correctness.
-    if (new_name != g_current_thread_name.Get().Get() &&
-        new_name && *new_name) {
-      g_current_thread_name.Get().Set(new_name);
-      base::hash_map<int, std::string>::iterator existing_name =
-          thread_names_.find(thread_id);
-      if (existing_name == thread_names_.end()) {
-        // This is a new thread id, and a new name.
-        thread_names_[thread_id] = new_name;
-      } else {
-        // This is a thread id that we've seen before, but potentially with a
-        // new name.
-        std::vector<base::StringPiece> existing_names;
-        Tokenize(existing_name->second, ",", &existing_names);
-        bool found = std::find(existing_names.begin(),
-                               existing_names.end(),
-                               new_name) != existing_names.end();
-        if (!found) {
-          existing_name->second.push_back(',');
-          existing_name->second.append(new_name);
-        }
-      }
-    }
+TraceLog::ThreadLocalEventBuffer* TraceLog::GetThreadLocalEventBuffer() {
+  ThreadLocalEventBuffer* buffer =
+      static_cast<ThreadLocalEventBuffer*>(g_event_buffer_slot.Get());
+  if (buffer && buffer->generation() == generation_)
+    return buffer;
+
+  // Either this thread has not traced yet, or its buffer belongs to a
+  // TraceLog that has since been deleted.
+  delete buffer;
+  buffer = new ThreadLocalEventBuffer(this, generation_);
+  g_event_buffer_slot.Set(buffer);
+  RegisterThreadLocalEventBuffer(buffer);
+  return buffer;
+}
 
-    if (threshold_begin_id > -1) {
-      DCHECK(phase == TRACE_EVENT_PHASE_END);
-      size_t begin_i = static_cast<size_t>(threshold_begin_id);
-      // Return now if there has been a flush since the begin event was posted.
-      if (begin_i >= logged_events_.size())
-        return -1;
-      // Determine whether to drop the begin/end pair.
-      TimeDelta elapsed = now - logged_events_[begin_i].timestamp();
-      if (elapsed < TimeDelta::FromMicroseconds(threshold)) {
-        // Remove begin event and do not add end event.
-        // This will be expensive if there have been other events in the
-        // mean time (should be rare).
-        logged_events_.erase(logged_events_.begin() + begin_i);
-        return -1;
-      }
+void TraceLog::RegisterThreadLocalEventBuffer(ThreadLocalEventBuffer* buffer) {
+  AutoLock lock(lock_);
+  thread_buffers_.push_back(buffer);
+}
+
+void TraceLog::UnregisterThreadLocalEventBuffer(
+    ThreadLocalEventBuffer* buffer) {
+  AutoLock lock(lock_);
+  std::vector<ThreadLocalEventBuffer*>::iterator it =
+      std::find(thread_buffers_.begin(), thread_buffers_.end(), buffer);
+  DCHECK(it != thread_buffers_.end());
+  thread_buffers_.erase(it);
+  if (buffer->chunk()) {
+    RetireChunk(buffer->chunk());
+    buffer->set_chunk(NULL);
+  }
+}
+
+void TraceLog::UpdateThreadName(int thread_id, const char* new_name) {
+  AutoLock lock(lock_);
+  base::hash_map<int, std::string>::iterator existing_name =
+      thread_names_.find(thread_id);
+  if (existing_name == thread_names_.end()) {
+    // This is a new thread id, and a new name.
+    thread_names_[thread_id] = new_name;
+  } else {
+    // This is a thread id that we've seen before, but potentially with a
+    // new name.
+    std::vector<base::StringPiece> existing_names;
+    Tokenize(existing_name->second, ",", &existing_names);
+    bool found = std::find(existing_names.begin(),
+                           existing_names.end(),
+                           new_name) != existing_names.end();
+    if (!found) {
+      existing_name->second.push_back(',');
+      existing_name->second.append(new_name);
     }
+  }
+}
 
-    if (flags & TRACE_EVENT_FLAG_MANGLE_ID)
-      id ^= process_id_hash_;
+TraceLog::TraceBufferChunk* TraceLog::SwapChunk(
+    ThreadLocalEventBuffer* buffer,
+    bool* buffer_became_full) {
+  lock_.AssertAcquired();
+  if (buffer->chunk()) {
+    RetireChunk(buffer->chunk());
+    buffer->set_chunk(NULL);
+  }
+
+  TraceBufferChunk* chunk = NULL;
+  int seq = next_chunk_seq_++;
+  if (num_chunks_ < kTraceEventBufferChunks) {
+    chunk = new TraceBufferChunk(seq);
+    ++num_chunks_;
+  } else if (recording_mode_ == RECORD_CONTINUOUSLY) {
+    if (!logged_chunks_.empty()) {
+      // Recycle the oldest chunk; its events are lost.
+      chunk = logged_chunks_.front();
+      logged_chunks_.pop_front();
+      chunk->Reset(seq);
+    } else {
+      // Every chunk is being filled by some thread. Rather than starve this
+      // one, go over budget.
+      chunk = new TraceBufferChunk(seq);
+      ++num_chunks_;
+    }
+  } else if (!subtle::NoBarrier_Load(&buffer_full_)) {
+    subtle::NoBarrier_Store(&buffer_full_, 1);
+    *buffer_became_full = true;
+  }
+  buffer->set_chunk(chunk);
+  return chunk;
+}
 
-    ret_begin_id = static_cast<int>(logged_events_.size());
-    logged_events_.push_back(
-        TraceEvent(thread_id,
-                   now, phase, category_enabled, name, id,
-                   num_args, arg_names, arg_types, arg_values,
-                   flags));
+void TraceLog::RetireChunk(TraceBufferChunk* chunk) {
+  lock_.AssertAcquired();
+  if (chunk->HasUnflushedEvents()) {
+    logged_chunks_.push_back(chunk);
+  } else {
+    delete chunk;
+    --num_chunks_;
+  }
+}
 
-    if (logged_events_.size() == kTraceEventBufferSize) {
-      buffer_full_callback_copy = buffer_full_callback_;
+bool TraceLog::CheckThreshold(ThreadLocalEventBuffer* buffer,
+                              int threshold_begin_id,
+                              TimeTicks now,
+                              long long threshold) {
+  // Threshold events are rare, so they take the lock: this keeps Flush() from
+  // reading the chunk while the begin event is removed.
+  AutoLock lock(lock_);
+  TraceBufferChunk* chunk = buffer->chunk();
+  size_t begin_i = 0;
+  if (!chunk || !chunk->FindUnflushed(threshold_begin_id, &begin_i)) {
+    // The begin event was logged into an earlier chunk by this thread.
+    chunk = NULL;
+    for (std::deque<TraceBufferChunk*>::reverse_iterator it =
+             logged_chunks_.rbegin();
+         it != logged_chunks_.rend(); ++it) {
+      if ((*it)->FindUnflushed(threshold_begin_id, &begin_i)) {
+        chunk = *it;
+        break;
+      }
     }
-  }  // release lock
+  }
+  // Return now if there has been a flush since the begin event was posted.
+  if (!chunk)
+    return false;
+
+  // Determine whether to drop the begin/end pair.
+  TimeDelta elapsed = now - chunk->GetEventAt(begin_i).timestamp();
+  if (elapsed < TimeDelta::FromMicroseconds(threshold)) {
+    // Remove begin event and do not add end event.
+    // This will be expensive if there have been other events in the
+    // mean time (should be rare).
+    chunk->Remove(begin_i);
+    return false;
+  }
+  return true;
+}
 
-  if (!buffer_full_callback_copy.is_null())
-    buffer_full_callback_copy.Run();
+void TraceLog::CollectEvents(std::vector<TraceEvent>* events) {
+  lock_.AssertAcquired();
+  for (size_t i = 0; i < logged_chunks_.size(); ++i)
+    logged_chunks_[i]->CollectEvents(false, events);
+  for (size_t i = 0; i < thread_buffers_.size(); ++i) {
+    if (thread_buffers_[i]->chunk())
+      thread_buffers_[i]->chunk()->CollectEvents(false, events);
+  }
+  events->insert(events->end(), metadata_events_.begin(),
+                 metadata_events_.end());
+}
 
-  return ret_begin_id;
+void TraceLog::TakeEventsForFlush(std::vector<TraceBufferChunk*>* chunks,
+                                  std::vector<TraceEvent>* events) {
+  lock_.AssertAcquired();
+  chunks->assign(logged_chunks_.begin(), logged_chunks_.end());
+  num_chunks_ -= logged_chunks_.size();
+  logged_chunks_.clear();
+  // Chunks that threads are still filling stay with them; copy out what they
+  // hold so far.
+  for (size_t i = 0; i < thread_buffers_.size(); ++i) {
+    if (thread_buffers_[i]->chunk())
+      thread_buffers_[i]->chunk()->CollectEvents(true, events);
+  }
+  events->insert(events->end(), metadata_events_.begin(),
+                 metadata_events_.end());
+  metadata_events_.clear();
+  subtle::NoBarrier_Store(&buffer_full_, 0);
+}
+
+size_t TraceLog::GetEventsSize() {
+  events_for_testing_.clear();
+  {
+    AutoLock lock(lock_);
+    CollectEvents(&events_for_testing_);
+  }
+  std::stable_sort(events_for_testing_.begin(), events_for_testing_.end(),
+                   &TimestampLess);
+  return events_for_testing_.size();
 }
 
 void TraceLog::AddTraceEventEtw(char phase,
@@ -736,7 +1181,7 @@ void TraceLog::AddThreadNameMetadataEvents() {
       unsigned char arg_type;
       unsigned long long arg_value;
       trace_event_internal::SetTraceValue(it->second, &arg_type, &arg_value);
-      logged_events_.push_back(
+      metadata_events_.push_back(
           TraceEvent(it->first,
                      TimeTicks(), TRACE_EVENT_PHASE_METADATA,
                      &g_category_enabled[g_category_metadata],
@@ -9,9 +9,11 @@
 
 #include "build/build_config.h"
 
+#include <deque>
 #include <string>
 #include <vector>
 
+#include "base/atomicops.h"
 #include "base/callback.h"
 #include "base/hash_tables.h"
 #include "base/memory/ref_counted_memory.h"
@@ -82,7 +84,22 @@ class BASE_EXPORT TraceEvent {
                                  std::string* out);
   void AppendAsJSON(std::string* out) const;
 
+  // Appends the JSON representation of an argument value of type |type|.
+  static void AppendValueAsJSON(unsigned char type,
+                                TraceValue value,
+                                std::string* out);
+
   TimeTicks timestamp() const { return timestamp_; }
+  int thread_id() const { return thread_id_; }
+  char phase() const { return phase_; }
+  const unsigned char* category_enabled() const { return category_enabled_; }
+  unsigned long long id() const { return id_; }
+  unsigned char flags() const { return flags_; }
+
+  // Arguments are stored in order; the first unused one has a NULL name.
+  const char* arg_name(int index) const { return arg_names_[index]; }
+  unsigned char arg_type(int index) const { return arg_types_[index]; }
+  TraceValue arg_value(int index) const { return arg_values_[index]; }
 
   // Exposed for unittesting:
 
@@ -155,6 +172,15 @@ class BASE_EXPORT TraceResultBuffer {
 
 class BASE_EXPORT TraceLog {
  public:
+  // Controls what happens once the trace buffer is full.
+  enum RecordingMode {
+    // Stop recording new events (the default).
+    RECORD_UNTIL_FULL,
+    // Keep recording, discarding the oldest events to make room. The buffer
+    // then always holds the most recent stretch of the trace.
+    RECORD_CONTINUOUSLY
+  };
+
   static TraceLog* GetInstance();
 
   // Get set of known categories. This can change as new code paths are reached.
@@ -214,6 +240,10 @@ class BASE_EXPORT TraceLog {
 
   float GetBufferPercentFull() const;
 
+  // Sets how the buffer behaves once full. May be called at any time; it is
+  // normally set before tracing is enabled.
+  void SetRecordingMode(RecordingMode mode);
+
   // When enough events are collected, they are handed (in bulk) to
   // the output callback. If no callback is set, the output will be
   // silently dropped. The callback must be thread safe. The string format is
@@ -225,11 +255,23 @@ class BASE_EXPORT TraceLog {
 
   // The trace buffer does not flush dynamically, so when it fills up,
   // subsequent trace events will be dropped. This callback is generated when
-  // the trace buffer is full. The callback must be thread safe.
+  // the trace buffer is full. The callback must be thread safe. It is never
+  // run in RECORD_CONTINUOUSLY mode.
   typedef base::Callback<void(void)> BufferFullCallback;
   void SetBufferFullCallback(const BufferFullCallback& cb);
 
-  // Flushes all logged data to the callback.
+  // Format of the strings passed to the OutputCallback. TraceResultBuffer
+  // accepts either.
+  enum OutputFormat {
+    // Comma-separated JSON objects (the default).
+    OUTPUT_FORMAT_JSON,
+    // Binary fragments, see trace_event_binary.h. Much cheaper to produce.
+    OUTPUT_FORMAT_BINARY
+  };
+  void SetOutputFormat(OutputFormat format);
+
+  // Flushes all logged data to the callback in timestamp order, streaming it
+  // out in batches so that only one batch is ever held in serialized form.
   void Flush();
 
   // Called by TRACE_EVENT* macros, don't call this directly.
@@ -237,7 +279,7 @@ class BASE_EXPORT TraceLog {
   static const char* GetCategoryName(const unsigned char* category_enabled);
 
   // Called by TRACE_EVENT* macros, don't call this directly.
-  // Returns the index in the internal vector of the event if it was added, or
+  // Returns an opaque non-negative handle for the event if it was added, or
   //         -1 if the event was not added.
   // On end events, the return value of the begin event can be specified along
   // with a threshold in microseconds. If the elapsed time between begin and end
@@ -274,11 +316,12 @@ class BASE_EXPORT TraceLog {
   // Allows resurrecting our singleton instance post-AtExit processing.
   static void Resurrect();
 
-  // Allow tests to inspect TraceEvents.
-  size_t GetEventsSize() const { return logged_events_.size(); }
+  // Allow tests to inspect TraceEvents. GetEventsSize() takes a snapshot of
+  // the events logged so far, in timestamp order, which GetEventAt() indexes.
+  size_t GetEventsSize();
   const TraceEvent& GetEventAt(size_t index) const {
-    DCHECK(index < logged_events_.size());
-    return logged_events_[index];
+    DCHECK(index < events_for_testing_.size());
+    return events_for_testing_[index];
   }
 
   void SetProcessID(int process_id);
@@ -288,19 +331,71 @@ class BASE_EXPORT TraceLog {
   // by the Singleton class.
   friend struct StaticMemorySingletonTraits<TraceLog>;
 
+  // A fixed-size block of events written by a single thread.
+  class TraceBufferChunk;
+  // Per-thread state: the chunk the thread is currently filling.
+  class ThreadLocalEventBuffer;
+
   TraceLog();
   ~TraceLog();
   const unsigned char* GetCategoryEnabledInternal(const char* name);
   void AddThreadNameMetadataEvents();
   void AddClockSyncMetadataEvents();
 
-  // TODO(nduca): switch to per-thread trace buffers to reduce thread
-  // synchronization.
+  // Returns the calling thread's event buffer, creating it if needed.
+  ThreadLocalEventBuffer* GetThreadLocalEventBuffer();
+  // Called on thread exit, and when a buffer is created or destroyed.
+  void RegisterThreadLocalEventBuffer(ThreadLocalEventBuffer* buffer);
+  void UnregisterThreadLocalEventBuffer(ThreadLocalEventBuffer* buffer);
+  void UpdateThreadName(int thread_id, const char* new_name);
+
+  // Retires |buffer|'s current chunk, if any, into |logged_chunks_| and hands
+  // it a fresh one. Returns the new chunk, or NULL if the buffer is full. Sets
+  // |*buffer_became_full| if this call is the one that filled the buffer.
+  TraceBufferChunk* SwapChunk(ThreadLocalEventBuffer* buffer,
+                              bool* buffer_became_full);
+  void RetireChunk(TraceBufferChunk* chunk);
+
+  // Handles the END half of a TRACE_EVENT_IF_LONGER_THAN pair. Returns false
+  // if the END event should not be added.
+  bool CheckThreshold(ThreadLocalEventBuffer* buffer,
+                      int threshold_begin_id,
+                      TimeTicks now,
+                      long long threshold);
+
+  // Appends copies of every event logged so far, except those already
+  // flushed, to |events|.
+  void CollectEvents(std::vector<TraceEvent>* events);
+
+  // Moves the chunks and events not yet flushed out of the TraceLog. Events
+  // in |*chunks| before TraceBufferChunk::flushed() were flushed earlier.
+  void TakeEventsForFlush(std::vector<TraceBufferChunk*>* chunks,
+                          std::vector<TraceEvent>* events);
+
+  // Protects everything below except where noted. AddTraceEvent() does not
+  // take it unless the calling thread's chunk is full.
   Lock lock_;
   bool enabled_;
   OutputCallback output_callback_;
   BufferFullCallback buffer_full_callback_;
-  std::vector<TraceEvent> logged_events_;
+  OutputFormat output_format_;
+  RecordingMode recording_mode_;
+  // Chunks that threads have filled (or abandoned on exit), oldest first.
+  std::deque<TraceBufferChunk*> logged_chunks_;
+  // Buffers of all threads that have logged an event.
+  std::vector<ThreadLocalEventBuffer*> thread_buffers_;
+  std::vector<TraceEvent> metadata_events_;
+  // Chunks that are either in |logged_chunks_| or being filled by a thread.
+  // Read without the lock by GetBufferPercentFull().
+  size_t num_chunks_;
+  int next_chunk_seq_;
+  // Non-zero once the buffer is full in RECORD_UNTIL_FULL mode; cleared by
+  // Flush(). Lets threads without a chunk drop events without locking.
+  subtle::Atomic32 buffer_full_;
+  // Distinguishes this TraceLog from earlier incarnations (see Resurrect())
+  // so that stale per-thread buffers are not used.
+  int generation_;
+  std::vector<TraceEvent> events_for_testing_;
   std::vector<std::string> included_categories_;
   std::vector<std::string> excluded_categories_;
   bool dispatching_to_observer_list_;
@@ -578,6 +578,19 @@ void ValidateAllTraceMacrosCreatedData(const ListValue& trace_parsed) {
   }
 }
 
+// Checks that the events in |trace_parsed| are in timestamp order.
+void ValidateTimestampOrder(const ListValue& trace_parsed) {
+  double previous_ts = 0;
+  for (size_t i = 0; i < trace_parsed.GetSize(); i++) {
+    DictionaryValue* dict = NULL;
+    double ts = 0;
+    ASSERT_TRUE(trace_parsed.GetDictionary(i, &dict));
+    ASSERT_TRUE(dict->GetDouble("ts", &ts));
+    EXPECT_LE(previous_ts, ts) << "event " << i;
+    previous_ts = ts;
+  }
+}
+
 void TraceManyInstantEvents(int thread_id, int num_events,
                             WaitableEvent* task_complete_event) {
   for (int i = 0; i < num_events; i++) {
@@ -643,6 +656,19 @@ TEST_F(TraceEventTestFixture, DataCaptured) {
   ValidateAllTraceMacrosCreatedData(trace_parsed_);
 }
 
+// Test that binary output is converted back to the same JSON.
+TEST_F(TraceEventTestFixture, DataCapturedBinary) {
+  ManualTestSetUp();
+  TraceLog::GetInstance()->SetOutputFormat(TraceLog::OUTPUT_FORMAT_BINARY);
+  TraceLog::GetInstance()->SetEnabled(true);
+
+  TraceWithAllMacroVariants(NULL);
+
+  TraceLog::GetInstance()->SetEnabled(false);
+
+  ValidateAllTraceMacrosCreatedData(trace_parsed_);
+}
+
 class MockEnabledStateChangedObserver :
       public base::debug::TraceLog::EnabledStateChangedObserver {
  public:
@@ -1105,6 +1131,114 @@ TEST_F(TraceEventTestFixture, DataCapturedManyThreads) {
 
   ValidateInstantEventPresentOnEveryThread(trace_parsed_,
                                            num_threads, num_events);
+  // The threads filled their chunks concurrently, so the flush has to merge
+  // them to keep the events in timestamp order.
+  ValidateTimestampOrder(trace_parsed_);
+}
+
+// Test that events still sitting in the buffer of a live thread are flushed.
+TEST_F(TraceEventTestFixture, DataCapturedFromRunningThreads) {
+  ManualTestSetUp();
+  TraceLog::GetInstance()->SetEnabled(true);
+
+  const int num_threads = 4;
+  // Not a multiple of the per-thread chunk size, so that each thread is left
+  // with a partially filled chunk.
+  const int num_events = 1000;
+  Thread* threads[num_threads];
+  WaitableEvent* task_complete_events[num_threads];
+  for (int i = 0; i < num_threads; i++) {
+    threads[i] = new Thread(StringPrintf("Thread %d", i).c_str());
+    task_complete_events[i] = new WaitableEvent(false, false);
+    threads[i]->Start();
+    threads[i]->message_loop()->PostTask(
+        FROM_HERE, base::Bind(&TraceManyInstantEvents,
+                              i, num_events, task_complete_events[i]));
+  }
+
+  for (int i = 0; i < num_threads; i++)
+    task_complete_events[i]->Wait();
+
+  // Flush while the threads are still alive.
+  TraceLog::GetInstance()->SetEnabled(false);
+
+  for (int i = 0; i < num_threads; i++) {
+    threads[i]->Stop();
+    delete threads[i];
+    delete task_complete_events[i];
+  }
+
+  ValidateInstantEventPresentOnEveryThread(trace_parsed_,
+                                           num_threads, num_events);
+  ValidateTimestampOrder(trace_parsed_);
+}
+
+// Fills the trace buffer with "old" events, returning how many were recorded.
+static int FillTraceBuffer(bool* buffer_full) {
+  TraceLog* tracer = TraceLog::GetInstance();
+  int num_events = 0;
+  while (tracer->GetBufferPercentFull() < 1.0f && !*buffer_full) {
+    TRACE_EVENT_INSTANT0("all", "old");
+    ++num_events;
+  }
+  return num_events;
+}
+
+static void SetTrue(bool* value) {
+  *value = true;
+}
+
+TEST_F(TraceEventTestFixture, RecordUntilFull) {
+  ManualTestSetUp();
+  TraceLog* tracer = TraceLog::GetInstance();
+  // Parsing half a million events as JSON would make the test slow.
+  tracer->SetOutputCallback(TraceLog::OutputCallback());
+  bool buffer_full = false;
+  tracer->SetBufferFullCallback(base::Bind(&SetTrue, &buffer_full));
+  tracer->SetEnabled(true);
+
+  int num_old_events = FillTraceBuffer(&buffer_full);
+  for (int i = 0; i < num_old_events; ++i)
+    TRACE_EVENT_INSTANT0("all", "new");
+  EXPECT_TRUE(buffer_full);
+  EXPECT_EQ(1.0f, tracer->GetBufferPercentFull());
+
+  // The buffer stopped taking events once full.
+  size_t num_events = tracer->GetEventsSize();
+  ASSERT_GT(num_events, 0u);
+  EXPECT_LT(num_events, static_cast<size_t>(2 * num_old_events));
+  EXPECT_STREQ("old", tracer->GetEventAt(0).name());
+
+  tracer->SetEnabled(false);
+  EXPECT_EQ(0.0f, tracer->GetBufferPercentFull());
+  tracer->SetBufferFullCallback(TraceLog::BufferFullCallback());
+}
+
+TEST_F(TraceEventTestFixture, RecordContinuously) {
+  ManualTestSetUp();
+  TraceLog* tracer = TraceLog::GetInstance();
+  tracer->SetOutputCallback(TraceLog::OutputCallback());
+  bool buffer_full = false;
+  tracer->SetBufferFullCallback(base::Bind(&SetTrue, &buffer_full));
+  tracer->SetRecordingMode(TraceLog::RECORD_CONTINUOUSLY);
+  tracer->SetEnabled(true);
+
+  int num_old_events = FillTraceBuffer(&buffer_full);
+  // Enough new events to displace every old one.
+  for (int i = 0; i < num_old_events + 1000; ++i)
+    TRACE_EVENT_INSTANT0("all", "new");
+  EXPECT_FALSE(buffer_full);
+  EXPECT_EQ(1.0f, tracer->GetBufferPercentFull());
+
+  // Only the most recent events are kept.
+  size_t num_events = tracer->GetEventsSize();
+  ASSERT_GT(num_events, 0u);
+  EXPECT_LE(num_events, static_cast<size_t>(num_old_events) + 1000);
+  EXPECT_STREQ("new", tracer->GetEventAt(0).name());
+  EXPECT_STREQ("new", tracer->GetEventAt(num_events - 1).name());
+
+  tracer->SetEnabled(false);
+  tracer->SetBufferFullCallback(TraceLog::BufferFullCallback());
 }
 
 // Test that thread and process names show up in the trace
@@ -0,0 +1,76 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/incoming_task_queue.h"
+
+#include "base/logging.h"
+
+namespace base {
+
+IncomingTaskQueue::Node::Node(const PendingTask& pending_task)
+    : pending_task(pending_task),
+      next(NULL) {
+}
+
+IncomingTaskQueue::IncomingTaskQueue() : head_(0) {
+}
+
+IncomingTaskQueue::~IncomingTaskQueue() {
+  // Tasks that were never taken are simply destroyed; the owner is expected to
+  // have drained the queue (see MessageLoop::~MessageLoop).
+  Node* node = reinterpret_cast<Node*>(subtle::NoBarrier_Load(&head_));
+  while (node) {
+    Node* next = node->next;
+    delete node;
+    node = next;
+  }
+}
+
+bool IncomingTaskQueue::Push(const PendingTask& pending_task) {
+  Node* node = new Node(pending_task);
+  subtle::AtomicWord old_head = subtle::NoBarrier_Load(&head_);
+  for (;;) {
+    node->next = reinterpret_cast<Node*>(old_head);
+    // Release semantics publish the fully constructed node to the consumer.
+    subtle::AtomicWord prev = subtle::Release_CompareAndSwap(
+        &head_, old_head, reinterpret_cast<subtle::AtomicWord>(node));
+    if (prev == old_head)
+      return old_head == 0;
+    old_head = prev;
+  }
+}
+
+bool IncomingTaskQueue::TakeAll(TaskQueue* queue) {
+  DCHECK(queue);
+  if (!subtle::NoBarrier_Load(&head_))
+    return false;
+
+  subtle::AtomicWord taken = subtle::NoBarrier_AtomicExchange(&head_, 0);
+  // Pairs with the release in Push() so the nodes' contents are visible.
+  subtle::MemoryBarrier();
+
+  // The chain is newest-first; reverse it to recover posting order.
+  Node* reversed = NULL;
+  Node* node = reinterpret_cast<Node*>(taken);
+  while (node) {
+    Node* next = node->next;
+    node->next = reversed;
+    reversed = node;
+    node = next;
+  }
+
+  while (reversed) {
+    Node* next = reversed->next;
+    queue->push(reversed->pending_task);
+    delete reversed;
+    reversed = next;
+  }
+  return true;
+}
+
+bool IncomingTaskQueue::IsEmpty() const {
+  return subtle::Acquire_Load(&head_) == 0;
+}
+
+}  // namespace base
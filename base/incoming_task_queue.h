@@ -0,0 +1,60 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BASE_INCOMING_TASK_QUEUE_H_
+#define BASE_INCOMING_TASK_QUEUE_H_
+#pragma once
+
+#include "base/atomicops.h"
+#include "base/base_export.h"
+#include "base/basictypes.h"
+#include "base/pending_task.h"
+
+namespace base {
+
+// A multi-producer, single-consumer queue of PendingTasks.  Any thread may
+// Push() without taking a lock; the single consuming thread drains everything
+// that has been pushed so far with one atomic exchange in TakeAll().
+//
+// Internally this is an intrusive singly-linked stack: producers CAS new nodes
+// onto |head_|, and the consumer detaches the whole chain at once and reverses
+// it, so tasks come out in the order they were pushed.  Because the consumer
+// never pops individual nodes there is no ABA hazard, and because only the
+// consumer frees nodes there is no reclamation problem.
+class BASE_EXPORT IncomingTaskQueue {
+ public:
+  IncomingTaskQueue();
+  ~IncomingTaskQueue();
+
+  // Appends a copy of |pending_task|.  May be called on any thread.  Returns
+  // true if the queue was empty before this call, in which case the caller is
+  // responsible for waking up the consumer.
+  bool Push(const PendingTask& pending_task);
+
+  // Moves every task pushed so far onto the back of |queue|, oldest first.
+  // Returns false if there was nothing to move.  Must only be called on the
+  // consuming thread.
+  bool TakeAll(TaskQueue* queue);
+
+  // Returns true if nothing is queued.  The answer is only a snapshot when
+  // producers are active on other threads.
+  bool IsEmpty() const;
+
+ private:
+  struct Node {
+    explicit Node(const PendingTask& pending_task);
+
+    PendingTask pending_task;
+    Node* next;
+  };
+
+  // Most recently pushed node, or NULL.  Holds a Node*.
+  subtle::AtomicWord head_;
+
+  DISALLOW_COPY_AND_ASSIGN(IncomingTaskQueue);
+};
+
+}  // namespace base
+
+#endif  // BASE_INCOMING_TASK_QUEUE_H_
@@ -0,0 +1,106 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/basictypes.h"
+#include "base/bind.h"
+#include "base/location.h"
+#include "base/memory/scoped_vector.h"
+#include "base/message_loop.h"
+#include "base/perftimer.h"
+#include "base/stringprintf.h"
+#include "base/synchronization/waitable_event.h"
+#include "base/threading/simple_thread.h"
+#include "base/threading/thread.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace base {
+
+namespace {
+
+const int kTotalTasks = 320000;
+
+// Counts tasks run on the consumer thread and signals once |expected| have
+// run.  Only touched on the consumer thread.
+class RunCounter {
+ public:
+  RunCounter(int expected, WaitableEvent* done)
+      : expected_(expected), run_(0), done_(done) {}
+
+  void Run() {
+    if (++run_ == expected_)
+      done_->Signal();
+  }
+
+ private:
+  int expected_;
+  int run_;
+  WaitableEvent* done_;
+
+  DISALLOW_COPY_AND_ASSIGN(RunCounter);
+};
+
+// Posts |count| tasks to |target| from its own thread.
+class PostingDelegate : public DelegateSimpleThread::Delegate {
+ public:
+  PostingDelegate(MessageLoop* target, RunCounter* counter, int count)
+      : target_(target), counter_(counter), count_(count) {}
+
+  virtual void Run() OVERRIDE {
+    for (int i = 0; i < count_; ++i) {
+      target_->PostTask(FROM_HERE,
+                        Bind(&RunCounter::Run, Unretained(counter_)));
+    }
+  }
+
+ private:
+  MessageLoop* target_;
+  RunCounter* counter_;
+  int count_;
+
+  DISALLOW_COPY_AND_ASSIGN(PostingDelegate);
+};
+
+// Posts |kTotalTasks| tasks to |consumer| from |producers| threads and logs
+// how many are posted and run per second.
+void RunPostTaskContention(Thread* consumer, int producers) {
+  const int tasks_per_producer = kTotalTasks / producers;
+
+  WaitableEvent done(false, false);
+  RunCounter counter(producers * tasks_per_producer, &done);
+
+  ScopedVector<PostingDelegate> delegates;
+  ScopedVector<DelegateSimpleThread> threads;
+  for (int i = 0; i < producers; ++i) {
+    delegates.push_back(new PostingDelegate(consumer->message_loop(),
+                                            &counter, tasks_per_producer));
+    threads.push_back(new DelegateSimpleThread(delegates[i], "producer"));
+  }
+
+  PerfTimer timer;
+  for (int i = 0; i < producers; ++i)
+    threads[i]->Start();
+  for (int i = 0; i < producers; ++i)
+    threads[i]->Join();
+  done.Wait();
+  LogPerfResult(StringPrintf("IncomingTaskQueue_PostTask_%dproducers",
+                             producers).c_str(),
+                producers * tasks_per_producer / timer.Elapsed().InSecondsF(),
+                "tasks/s");
+}
+
+}  // namespace
+
+// Post/run throughput of a single MessageLoop as the number of posting
+// threads grows.
+TEST(IncomingTaskQueuePerfTest, PostTaskContention) {
+  const int kProducerCounts[] = { 1, 2, 4, 8, 16, 32 };
+
+  Thread consumer("consumer");
+  ASSERT_TRUE(consumer.Start());
+  for (size_t i = 0; i < arraysize(kProducerCounts); ++i)
+    RunPostTaskContention(&consumer, kProducerCounts[i]);
+  consumer.Stop();
+}
+
+}  // namespace base
@@ -0,0 +1,132 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/incoming_task_queue.h"
+
+#include "base/bind.h"
+#include "base/location.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/memory/scoped_vector.h"
+#include "base/threading/simple_thread.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace base {
+
+namespace {
+
+void DoNothing() {
+}
+
+PendingTask MakeTask(int sequence_num) {
+  PendingTask pending_task(FROM_HERE, Bind(&DoNothing));
+  pending_task.sequence_num = sequence_num;
+  return pending_task;
+}
+
+// Pushes |count| tasks tagged with |id| into a shared queue.
+class PushingDelegate : public DelegateSimpleThread::Delegate {
+ public:
+  PushingDelegate(IncomingTaskQueue* queue, int id, int count)
+      : queue_(queue), id_(id), count_(count) {}
+
+  virtual void Run() OVERRIDE {
+    for (int i = 0; i < count_; ++i)
+      queue_->Push(MakeTask(id_ * count_ + i));
+  }
+
+ private:
+  IncomingTaskQueue* queue_;
+  int id_;
+  int count_;
+};
+
+}  // namespace
+
+TEST(IncomingTaskQueueTest, Empty) {
+  IncomingTaskQueue queue;
+  EXPECT_TRUE(queue.IsEmpty());
+
+  TaskQueue out;
+  EXPECT_FALSE(queue.TakeAll(&out));
+  EXPECT_TRUE(out.empty());
+}
+
+TEST(IncomingTaskQueueTest, PushReportsWasEmpty) {
+  IncomingTaskQueue queue;
+  EXPECT_TRUE(queue.Push(MakeTask(0)));
+  EXPECT_FALSE(queue.Push(MakeTask(1)));
+  EXPECT_FALSE(queue.IsEmpty());
+
+  TaskQueue out;
+  EXPECT_TRUE(queue.TakeAll(&out));
+  EXPECT_TRUE(queue.IsEmpty());
+
+  // Once drained, the next push must report the transition again so that the
+  // message loop gets woken up.
+  EXPECT_TRUE(queue.Push(MakeTask(2)));
+  EXPECT_TRUE(queue.TakeAll(&out));
+}
+
+TEST(IncomingTaskQueueTest, TakeAllPreservesOrder) {
+  IncomingTaskQueue queue;
+  TaskQueue out;
+  out.push(MakeTask(-1));
+
+  for (int i = 0; i < 10; ++i)
+    queue.Push(MakeTask(i));
+  EXPECT_TRUE(queue.TakeAll(&out));
+
+  // Existing contents are kept and new tasks are appended in posting order.
+  ASSERT_EQ(11u, out.size());
+  EXPECT_EQ(-1, out.front().sequence_num);
+  out.pop();
+  for (int i = 0; i < 10; ++i) {
+    EXPECT_EQ(i, out.front().sequence_num);
+    out.pop();
+  }
+}
+
+TEST(IncomingTaskQueueTest, DestructorReleasesPendingTasks) {
+  scoped_ptr<IncomingTaskQueue> queue(new IncomingTaskQueue);
+  for (int i = 0; i < 10; ++i)
+    queue->Push(MakeTask(i));
+  queue.reset();
+}
+
+TEST(IncomingTaskQueueTest, ConcurrentProducersKeepPerProducerOrder) {
+  const int kProducers = 8;
+  const int kTasksPerProducer = 10000;
+
+  IncomingTaskQueue queue;
+  ScopedVector<PushingDelegate> delegates;
+  ScopedVector<DelegateSimpleThread> threads;
+  for (int i = 0; i < kProducers; ++i) {
+    delegates.push_back(new PushingDelegate(&queue, i, kTasksPerProducer));
+    threads.push_back(new DelegateSimpleThread(delegates[i], "producer"));
+  }
+
+  // Drain while the producers are running to exercise concurrent TakeAll().
+  for (int i = 0; i < kProducers; ++i)
+    threads[i]->Start();
+  TaskQueue out;
+  while (out.size() < static_cast<size_t>(kProducers * kTasksPerProducer))
+    queue.TakeAll(&out);
+  for (int i = 0; i < kProducers; ++i)
+    threads[i]->Join();
+  EXPECT_TRUE(queue.IsEmpty());
+
+  int next[kProducers] = { 0 };
+  while (!out.empty()) {
+    int producer = out.front().sequence_num / kTasksPerProducer;
+    int index = out.front().sequence_num % kTasksPerProducer;
+    ASSERT_LT(producer, kProducers);
+    EXPECT_EQ(next[producer], index);
+    next[producer] = index + 1;
+    out.pop();
+  }
+  for (int i = 0; i < kProducers; ++i)
+    EXPECT_EQ(kTasksPerProducer, next[i]);
+}
+
+}  // namespace base
@@ -4,6 +4,11 @@
 
 #include "base/json/json_reader.h"
 
+#include <string.h>
+
+#include <vector>
+
+#include "base/compiler_specific.h"
 #include "base/float_util.h"
 #include "base/logging.h"
 #include "base/memory/scoped_ptr.h"
@@ -61,6 +66,132 @@ bool ReadHexDigits(base::JSONReader::Token& token, int digits) {
   return true;
 }
 
+// Returns the first '"' or '\\' in [pos, end), or |end| if there is none.
+// Most strings are long runs of other characters, so this looks at a word at
+// a time, using the usual trick to find a zero byte in each word XORed with
+// the characters sought.
+const char* FindQuoteOrBackslash(const char* pos, const char* end) {
+  const uint64 kOnes = GG_UINT64_C(0x0101010101010101);
+  const uint64 kHighBits = kOnes * 0x80;
+  const uint64 kQuotes = kOnes * '"';
+  const uint64 kBackslashes = kOnes * '\\';
+  while (end - pos >= static_cast<ptrdiff_t>(sizeof(uint64))) {
+    uint64 word;
+    memcpy(&word, pos, sizeof(word));
+    uint64 quotes = word ^ kQuotes;
+    uint64 backslashes = word ^ kBackslashes;
+    if ((((quotes - kOnes) & ~quotes) |
+         ((backslashes - kOnes) & ~backslashes)) & kHighBits) {
+      break;
+    }
+    pos += sizeof(word);
+  }
+  while (pos != end && *pos != '"' && *pos != '\\')
+    ++pos;
+  return pos;
+}
+
+// Builds a Value tree out of the values JSONReader hands it.
+class ValueBuilder : public base::JSONReader::Delegate {
+ public:
+  ValueBuilder() {}
+  virtual ~ValueBuilder() {
+    // Parsing stopped early; free what never made it into the tree.
+    for (size_t i = 0; i < dictionary_entries_.size(); ++i) {
+      for (size_t j = 0; j < dictionary_entries_[i].size(); ++j)
+        delete dictionary_entries_[i][j].second;
+    }
+  }
+
+  // Returns the root of the tree, which the caller owns.
+  base::Value* Release() { return root_.release(); }
+
+  virtual bool OnNull() OVERRIDE {
+    return Add(base::Value::CreateNullValue());
+  }
+
+  virtual bool OnBoolean(bool value) OVERRIDE {
+    return Add(base::Value::CreateBooleanValue(value));
+  }
+
+  virtual bool OnInteger(int value) OVERRIDE {
+    return Add(base::Value::CreateIntegerValue(value));
+  }
+
+  virtual bool OnDouble(double value) OVERRIDE {
+    return Add(base::Value::CreateDoubleValue(value));
+  }
+
+  virtual bool OnString(const base::StringPiece& value) OVERRIDE {
+    return Add(base::Value::CreateStringValue(value.as_string()));
+  }
+
+  virtual bool OnDictionaryBegin() OVERRIDE {
+    AddContainer(new base::DictionaryValue);
+    dictionary_entries_.push_back(DictionaryEntries());
+    return true;
+  }
+
+  virtual bool OnDictionaryKey(const base::StringPiece& key) OVERRIDE {
+    key.CopyToString(&key_);
+    return true;
+  }
+
+  virtual bool OnDictionaryEnd() OVERRIDE {
+    static_cast<base::DictionaryValue*>(containers_.back())->
+        SetEntriesWithoutPathExpansion(&dictionary_entries_.back());
+    dictionary_entries_.pop_back();
+    containers_.pop_back();
+    return true;
+  }
+
+  virtual bool OnListBegin() OVERRIDE {
+    return AddContainer(new base::ListValue);
+  }
+
+  virtual bool OnListEnd() OVERRIDE {
+    containers_.pop_back();
+    return true;
+  }
+
+ private:
+  // Adds |value| to the innermost open container, or makes it the root.
+  bool Add(base::Value* value) {
+    if (containers_.empty()) {
+      DCHECK(!root_.get());
+      root_.reset(value);
+    } else if (containers_.back()->IsType(base::Value::TYPE_LIST)) {
+      static_cast<base::ListValue*>(containers_.back())->Append(value);
+    } else {
+      dictionary_entries_.back().push_back(std::make_pair(key_, value));
+    }
+    return true;
+  }
+
+  bool AddContainer(base::Value* container) {
+    Add(container);
+    containers_.push_back(container);
+    return true;
+  }
+
+  scoped_ptr<base::Value> root_;
+
+  // The lists and dictionaries being filled in, innermost last.  They are
+  // owned by |root_|, or by the entries of their parent dictionary until it
+  // ends.
+  std::vector<base::Value*> containers_;
+
+  // The entries of each open dictionary, innermost last.  They are added to
+  // the dictionary in one go, in key order, when it ends.
+  typedef std::vector<std::pair<std::string, base::Value*> > DictionaryEntries;
+  std::vector<DictionaryEntries> dictionary_entries_;
+
+  // The key of the next value added to a dictionary.
+  std::string key_;
+
+  DISALLOW_COPY_AND_ASSIGN(ValueBuilder);
+};
+
 }  // namespace
 
 namespace base {
@@ -88,6 +219,8 @@ JSONReader::JSONReader()
       end_pos_(NULL),
       stack_depth_(0),
       allow_trailing_comma_(false),
+      delegate_(NULL),
+      stopped_(false),
       error_code_(JSON_NO_ERROR),
       error_line_(0),
       error_col_(0) {}
@@ -156,10 +289,25 @@ std::string JSONReader::GetErrorMessage() const {
 
 Value* JSONReader::JsonToValue(const std::string& json, bool check_root,
                                bool allow_trailing_comma) {
+  ValueBuilder builder;
+  if (!ParseJson(json, check_root, allow_trailing_comma, &builder))
+    return NULL;
+  return builder.Release();
+}
+
+bool JSONReader::Parse(const std::string& json,
+                       int options,
+                       Delegate* delegate) {
+  return ParseJson(json, false, (options & JSON_ALLOW_TRAILING_COMMAS) != 0,
+                   delegate);
+}
+
+bool JSONReader::ParseJson(const std::string& json, bool check_root,
+                           bool allow_trailing_comma, Delegate* delegate) {
   // The input must be in UTF-8.
   if (!IsStringUTF8(json.data())) {
     error_code_ = JSON_UNSUPPORTED_ENCODING;
-    return NULL;
+    return false;
   }
 
   start_pos_ = json.data();
@@ -167,7 +315,7 @@ Value* JSONReader::JsonToValue(const std::string& json, bool check_root,
 
   // When the input JSON string starts with a UTF-8 Byte-Order-Mark (U+FEFF)
   // or <0xEF 0xBB 0xBF>, advance the start position to avoid the
-  // JSONReader::BuildValue() function from mis-treating a Unicode BOM as an
+  // JSONReader::ParseValue() function from mis-treating a Unicode BOM as an
   // invalid character and returning NULL.
   if (json.size() >= 3 && static_cast<uint8>(start_pos_[0]) == 0xEF &&
       static_cast<uint8>(start_pos_[1]) == 0xBB &&
@@ -178,22 +326,25 @@ Value* JSONReader::JsonToValue(const std::string& json, bool check_root,
   json_pos_ = start_pos_;
   allow_trailing_comma_ = allow_trailing_comma;
   stack_depth_ = 0;
+  delegate_ = delegate;
+  stopped_ = false;
   error_code_ = JSON_NO_ERROR;
 
-  scoped_ptr<Value> root(BuildValue(check_root));
-  if (root.get()) {
+  if (ParseValue(check_root)) {
     if (ParseToken().type == Token::END_OF_INPUT) {
-      return root.release();
+      return true;
     } else {
       SetErrorCode(JSON_UNEXPECTED_DATA_AFTER_ROOT, json_pos_);
     }
   }
+  if (stopped_)
+    return false;
 
   // Default to calling errors "syntax errors".
   if (error_code_ == 0)
     SetErrorCode(JSON_SYNTAX_ERROR, json_pos_);
 
-  return NULL;
+  return false;
 }
 
 // static
@@ -206,11 +357,11 @@ std::string JSONReader::FormatErrorMessage(int line, int column,
   return description;
 }
 
-Value* JSONReader::BuildValue(bool is_root) {
+bool JSONReader::ParseValue(bool is_root) {
   ++stack_depth_;
   if (stack_depth_ > kStackLimit) {
     SetErrorCode(JSON_TOO_MUCH_NESTING, json_pos_);
-    return NULL;
+    return false;
   }
 
   Token token = ParseToken();
@@ -218,51 +369,54 @@ Value* JSONReader::BuildValue(bool is_root) {
   if (is_root && token.type != Token::OBJECT_BEGIN &&
       token.type != Token::ARRAY_BEGIN) {
     SetErrorCode(JSON_BAD_ROOT_ELEMENT_TYPE, json_pos_);
-    return NULL;
+    return false;
   }
 
-  scoped_ptr<Value> node;
-
   switch (token.type) {
     case Token::END_OF_INPUT:
     case Token::INVALID_TOKEN:
-      return NULL;
+      return false;
 
     case Token::NULL_TOKEN:
-      node.reset(Value::CreateNullValue());
+      if (!delegate_->OnNull())
+        return StopParsing();
       break;
 
     case Token::BOOL_TRUE:
-      node.reset(Value::CreateBooleanValue(true));
+      if (!delegate_->OnBoolean(true))
+        return StopParsing();
       break;
 
     case Token::BOOL_FALSE:
-      node.reset(Value::CreateBooleanValue(false));
+      if (!delegate_->OnBoolean(false))
+        return StopParsing();
       break;
 
     case Token::NUMBER:
-      node.reset(DecodeNumber(token));
-      if (!node.get())
-        return NULL;
+      if (!DecodeNumber(token))
+        return false;
       break;
 
     case Token::STRING:
-      node.reset(DecodeString(token));
-      if (!node.get())
-        return NULL;
-      break;
+      {
+        StringPiece decoded;
+        if (!DecodeString(token, &decoded))
+          return false;
+        if (!delegate_->OnString(decoded))
+          return StopParsing();
+        break;
+      }
 
     case Token::ARRAY_BEGIN:
       {
+        if (!delegate_->OnListBegin())
+          return StopParsing();
         json_pos_ += token.length;
         token = ParseToken();
 
-        node.reset(new ListValue());
         while (token.type != Token::ARRAY_END) {
-          Value* array_node = BuildValue(false);
-          if (!array_node)
-            return NULL;
-          static_cast<ListValue*>(node.get())->Append(array_node);
+          if (!ParseValue(false))
+            return false;
 
           // After a list value, we expect a comma or the end of the list.
           token = ParseToken();
@@ -274,54 +428,51 @@ Value* JSONReader::BuildValue(bool is_root) {
             if (token.type == Token::ARRAY_END) {
               if (!allow_trailing_comma_) {
                 SetErrorCode(JSON_TRAILING_COMMA, json_pos_);
-                return NULL;
+                return false;
               }
               // Trailing comma OK, stop parsing the Array.
               break;
             }
           } else if (token.type != Token::ARRAY_END) {
             // Unexpected value after list value.  Bail out.
-            return NULL;
+            return false;
           }
         }
         if (token.type != Token::ARRAY_END) {
-          return NULL;
+          return false;
         }
+        if (!delegate_->OnListEnd())
+          return StopParsing();
         break;
       }
 
     case Token::OBJECT_BEGIN:
       {
+        if (!delegate_->OnDictionaryBegin())
+          return StopParsing();
         json_pos_ += token.length;
         token = ParseToken();
 
-        node.reset(new DictionaryValue);
         while (token.type != Token::OBJECT_END) {
           if (token.type != Token::STRING) {
             SetErrorCode(JSON_UNQUOTED_DICTIONARY_KEY, json_pos_);
-            return NULL;
+            return false;
           }
-          scoped_ptr<Value> dict_key_value(DecodeString(token));
-          if (!dict_key_value.get())
-            return NULL;
-
-          // Convert the key into a wstring.
-          std::string dict_key;
-          bool success = dict_key_value->GetAsString(&dict_key);
-          DCHECK(success);
+          StringPiece dict_key;
+          if (!DecodeString(token, &dict_key))
+            return false;
+          if (!delegate_->OnDictionaryKey(dict_key))
+            return StopParsing();
 
           json_pos_ += token.length;
           token = ParseToken();
           if (token.type != Token::OBJECT_PAIR_SEPARATOR)
-            return NULL;
+            return false;
 
           json_pos_ += token.length;
           token = ParseToken();
-          Value* dict_value = BuildValue(false);
-          if (!dict_value)
-            return NULL;
-          static_cast<DictionaryValue*>(node.get())->SetWithoutPathExpansion(
-              dict_key, dict_value);
+          if (!ParseValue(false))
+            return false;
 
           // After a key/value pair, we expect a comma or the end of the
           // object.
@@ -334,30 +485,36 @@ Value* JSONReader::BuildValue(bool is_root) {
             if (token.type == Token::OBJECT_END) {
               if (!allow_trailing_comma_) {
                 SetErrorCode(JSON_TRAILING_COMMA, json_pos_);
-                return NULL;
+                return false;
               }
               // Trailing comma OK, stop parsing the Object.
               break;
             }
           } else if (token.type != Token::OBJECT_END) {
             // Unexpected value after last object value.  Bail out.
-            return NULL;
+            return false;
           }
         }
         if (token.type != Token::OBJECT_END)
-          return NULL;
-
+          return false;
+        if (!delegate_->OnDictionaryEnd())
+          return StopParsing();
         break;
       }
 
     default:
       // We got a token that's not a value.
-      return NULL;
+      return false;
   }
   json_pos_ += token.length;
 
   --stack_depth_;
-  return node.release();
+  return true;
+}
+
+bool JSONReader::StopParsing() {
+  stopped_ = true;
+  return false;
 }
 
 JSONReader::Token JSONReader::ParseNumberToken() {
@@ -397,24 +554,51 @@ JSONReader::Token JSONReader::ParseNumberToken() {
   return token;
 }
 
-Value* JSONReader::DecodeNumber(const Token& token) {
+bool JSONReader::DecodeNumber(const Token& token) {
+  // Most numbers are integers short enough that they can't overflow, which
+  // are converted in place.
+  const char* pos = token.begin;
+  const char* end = token.begin + token.length;
+  bool negative = *pos == '-';
+  if (negative)
+    ++pos;
+  if (end - pos <= 9) {
+    int num_int = 0;
+    for (; pos != end && IsAsciiDigit(*pos); ++pos)
+      num_int = num_int * 10 + (*pos - '0');
+    if (pos == end) {
+      if (!delegate_->OnInteger(negative ? -num_int : num_int))
+        return StopParsing();
+      return true;
+    }
+  }
+
   const std::string num_string(token.begin, token.length);
 
   int num_int;
-  if (StringToInt(num_string, &num_int))
-    return Value::CreateIntegerValue(num_int);
+  if (StringToInt(num_string, &num_int)) {
+    if (!delegate_->OnInteger(num_int))
+      return StopParsing();
+    return true;
+  }
 
   double num_double;
-  if (StringToDouble(num_string, &num_double) && base::IsFinite(num_double))
-    return Value::CreateDoubleValue(num_double);
+  if (StringToDouble(num_string, &num_double) && base::IsFinite(num_double)) {
+    if (!delegate_->OnDouble(num_double))
+      return StopParsing();
+    return true;
+  }
 
-  return NULL;
+  return false;
 }
 
 JSONReader::Token JSONReader::ParseStringToken() {
   Token token(Token::STRING, json_pos_, 1);
-  char c = token.NextChar();
   while (json_pos_ + token.length < end_pos_) {
+    // Skip straight to the next character that needs a closer look.
+    token.length = static_cast<int>(
+        FindQuoteOrBackslash(json_pos_ + token.length, end_pos_) - json_pos_);
+    char c = token.NextChar();
     if ('\\' == c) {
       ++token.length;
       c = token.NextChar();
@@ -449,74 +633,87 @@ JSONReader::Token JSONReader::ParseStringToken() {
     } else if ('"' == c) {
       ++token.length;
       return token;
+    } else {
+      // Reached the end of the input.
+      break;
     }
     ++token.length;
-    c = token.NextChar();
   }
   return Token::CreateInvalidToken();
 }
 
-Value* JSONReader::DecodeString(const Token& token) {
-  std::string decoded_str;
+bool JSONReader::DecodeString(const Token& token, StringPiece* decoded) {
+  const char* pos = token.begin + 1;
+  const char* contents_end = token.begin + token.length - 1;
+  const char* escape = static_cast<const char*>(
+      memchr(pos, '\\', contents_end - pos));
+  if (!escape) {
+    // Most strings have no escapes, so are used straight from the input.
+    decoded->set(pos, contents_end - pos);
+    return true;
+  }
+
+  std::string& decoded_str = decoded_string_;
+  decoded_str.clear();
   decoded_str.reserve(token.length - 2);
 
-  for (int i = 1; i < token.length - 1; ++i) {
+  while (escape) {
+    // Copy everything up to the escape at once.
+    decoded_str.append(pos, escape);
+    int i = static_cast<int>(escape - token.begin) + 1;
     char c = *(token.begin + i);
-    if ('\\' == c) {
-      ++i;
-      c = *(token.begin + i);
-      switch (c) {
-        case '"':
-        case '/':
-        case '\\':
-          decoded_str.push_back(c);
-          break;
-        case 'b':
-          decoded_str.push_back('\b');
-          break;
-        case 'f':
-          decoded_str.push_back('\f');
-          break;
-        case 'n':
-          decoded_str.push_back('\n');
-          break;
-        case 'r':
-          decoded_str.push_back('\r');
-          break;
-        case 't':
-          decoded_str.push_back('\t');
-          break;
-        case 'v':
-          decoded_str.push_back('\v');
-          break;
-
-        case 'x': {
-          if (i + 2 >= token.length)
-            return NULL;
-          int hex_digit = 0;
-          if (!HexStringToInt(StringPiece(token.begin + i + 1, 2), &hex_digit))
-            return NULL;
-          decoded_str.push_back(hex_digit);
-          i += 2;
-          break;
-        }
-        case 'u':
-          if (!ConvertUTF16Units(token, &i, &decoded_str))
-            return NULL;
-          break;
+    switch (c) {
+      case '"':
+      case '/':
+      case '\\':
+        decoded_str.push_back(c);
+        break;
+      case 'b':
+        decoded_str.push_back('\b');
+        break;
+      case 'f':
+        decoded_str.push_back('\f');
+        break;
+      case 'n':
+        decoded_str.push_back('\n');
+        break;
+      case 'r':
+        decoded_str.push_back('\r');
+        break;
+      case 't':
+        decoded_str.push_back('\t');
+        break;
+      case 'v':
+        decoded_str.push_back('\v');
+        break;
 
-        default:
-          // We should only have valid strings at this point.  If not,
-          // ParseStringToken didn't do its job.
-          NOTREACHED();
-          return NULL;
+      case 'x': {
+        if (i + 2 >= token.length)
+          return false;
+        int hex_digit = 0;
+        if (!HexStringToInt(StringPiece(token.begin + i + 1, 2), &hex_digit))
+          return false;
+        decoded_str.push_back(hex_digit);
+        i += 2;
+        break;
       }
-    } else {
-      // Not escaped
-      decoded_str.push_back(c);
+      case 'u':
+        if (!ConvertUTF16Units(token, &i, &decoded_str))
+          return false;
+        break;
+
+      default:
+        // We should only have valid strings at this point.  If not,
+        // ParseStringToken didn't do its job.
+        NOTREACHED();
+        return false;
     }
+    pos = token.begin + i + 1;
+    escape = static_cast<const char*>(memchr(pos, '\\', contents_end - pos));
   }
-  return Value::CreateStringValue(decoded_str);
+  decoded_str.append(pos, contents_end);
+  decoded->set(decoded_str.data(), decoded_str.size());
+  return true;
 }
 
 bool JSONReader::ConvertUTF16Units(const Token& token,
@@ -6,6 +6,10 @@
 // base/values.h).
 // http://www.ietf.org/rfc/rfc4627.txt?number=4627
 //
+// Callers that only need a few values out of a large document can instead
+// have the values handed to a JSONReader::Delegate as they are parsed (see
+// JSONReader::Parse()), which builds no Value tree at all.
+//
 // Known limitations/deviations from the RFC:
 // - Only knows how to parse ints within the range of a signed 32 bit int and
 //   decimal numbers within a double.
@@ -33,6 +37,7 @@
 
 #include "base/base_export.h"
 #include "base/basictypes.h"
+#include "base/string_piece.h"
 
 // Chromium and Chromium OS check out gtest to different places, so we're
 // unable to compile on both if we include gtest_prod.h here.  Instead, include
@@ -114,6 +119,32 @@ class BASE_EXPORT JSONReader {
     JSON_UNQUOTED_DICTIONARY_KEY,
   };
 
+  // Receives the contents of a JSON document from Parse(), in document order.
+  // A dictionary is reported as OnDictionaryBegin(), then an OnDictionaryKey()
+  // followed by the value for each entry, then OnDictionaryEnd(); a list
+  // likewise, without the keys.  Every method returns false to stop parsing,
+  // for instance once the value the delegate was looking for has been seen.
+  //
+  // The StringPieces passed in are only valid for the duration of the call:
+  // they point either into the input or, for strings with escapes, into a
+  // buffer the reader reuses.
+  class BASE_EXPORT Delegate {
+   public:
+    virtual bool OnNull() = 0;
+    virtual bool OnBoolean(bool value) = 0;
+    virtual bool OnInteger(int value) = 0;
+    virtual bool OnDouble(double value) = 0;
+    virtual bool OnString(const StringPiece& value) = 0;
+    virtual bool OnDictionaryBegin() = 0;
+    virtual bool OnDictionaryKey(const StringPiece& key) = 0;
+    virtual bool OnDictionaryEnd() = 0;
+    virtual bool OnListBegin() = 0;
+    virtual bool OnListEnd() = 0;
+
+   protected:
+    virtual ~Delegate() {}
+  };
+
   // String versions of parse error codes.
   static const char* kBadRootElementType;
   static const char* kInvalidEscape;
@@ -166,6 +197,14 @@ class BASE_EXPORT JSONReader {
   Value* JsonToValue(const std::string& json, bool check_root,
                      bool allow_trailing_comma);
 
+  // Parses |json|, respecting |options| (JSONParserOptions), and hands its
+  // values to |delegate| instead of building a Value.  Returns true if the
+  // whole input was parsed.  Returns false if it is not properly formed, in
+  // which case error_code() and GetErrorMessage() tell why, or if |delegate|
+  // stopped parsing, in which case error_code() is JSON_NO_ERROR.  Note that
+  // |delegate| may have seen part of the document before an error is found.
+  bool Parse(const std::string& json, int options, Delegate* delegate);
+
  private:
   FRIEND_TEST_ALL_PREFIXES(JSONReaderTest, Reading);
   FRIEND_TEST_ALL_PREFIXES(JSONReaderTest, ErrorMessages);
@@ -173,10 +212,18 @@ class BASE_EXPORT JSONReader {
   static std::string FormatErrorMessage(int line, int column,
                                         const std::string& description);
 
-  // Recursively build Value.  Returns NULL if we don't have a valid JSON
-  // string.  If |is_root| is true, we verify that the root element is either
-  // an object or an array.
-  Value* BuildValue(bool is_root);
+  // Parses |json| for JsonToValue() and Parse().
+  bool ParseJson(const std::string& json, bool check_root,
+                 bool allow_trailing_comma, Delegate* delegate);
+
+  // Recursively parses a value, handing it to |delegate_|.  Returns false if
+  // we don't have a valid JSON string, or if the delegate stopped parsing.
+  // If |is_root| is true, we verify that the root element is either an
+  // object or an array.
+  bool ParseValue(bool is_root);
+
+  // Records that |delegate_| asked to stop, and returns false.
+  bool StopParsing();
 
   // Parses a sequence of characters into a Token::NUMBER. If the sequence of
   // characters is not a valid number, returns a Token::INVALID_TOKEN. Note
@@ -184,9 +231,10 @@ class BASE_EXPORT JSONReader {
   // int/double.
   Token ParseNumberToken();
 
-  // Try and convert the substring that token holds into an int or a double. If
-  // we can (ie., no overflow), return the value, else return NULL.
-  Value* DecodeNumber(const Token& token);
+  // Try and convert the substring that token holds into an int or a double,
+  // and hand it to |delegate_|.  Returns false if we can't (ie., overflow), or
+  // if the delegate stopped parsing.
+  bool DecodeNumber(const Token& token);
 
   // Parses a sequence of characters into a Token::STRING. If the sequence of
   // characters is not a valid string, returns a Token::INVALID_TOKEN. Note
@@ -194,9 +242,10 @@ class BASE_EXPORT JSONReader {
   // actual wstring.
   Token ParseStringToken();
 
-  // Convert the substring into a value string.  This should always succeed
-  // (otherwise ParseStringToken would have failed).
-  Value* DecodeString(const Token& token);
+  // Convert the substring into a string, which points into the input if there
+  // are no escapes and into |decoded_string_| otherwise.  Returns false if
+  // the escapes don't make a valid string.
+  bool DecodeString(const Token& token, StringPiece* decoded);
 
   // Helper function for DecodeString that consumes UTF16 [0,2] code units and
   // convers them to UTF8 code untis.  |token| is the string token in which the
@@ -242,6 +291,15 @@ class BASE_EXPORT JSONReader {
   // A parser flag that allows trailing commas in objects and arrays.
   bool allow_trailing_comma_;
 
+  // Receives the parsed values.
+  Delegate* delegate_;
+
+  // Set once |delegate_| asks to stop parsing.
+  bool stopped_;
+
+  // Holds the last string decoded from a token with escapes.
+  std::string decoded_string_;
+
   // Contains the error code for the last call to JsonToValue(), if any.
   JsonParseError error_code_;
   int error_line_;
@@ -0,0 +1,111 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/json/json_reader.h"
+
+#include <string>
+
+#include "base/basictypes.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/perftimer.h"
+#include "base/string_piece.h"
+#include "base/stringprintf.h"
+#include "base/values.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace base {
+
+namespace {
+
+const int kEntries = 10000;
+const int kIterations = 5;
+
+// Counts values without storing them, like a caller looking for a few keys.
+class CountingDelegate : public JSONReader::Delegate {
+ public:
+  CountingDelegate() : count_(0) {}
+
+  int count() const { return count_; }
+
+  virtual bool OnNull() OVERRIDE { return Count(); }
+  virtual bool OnBoolean(bool value) OVERRIDE { return Count(); }
+  virtual bool OnInteger(int value) OVERRIDE { return Count(); }
+  virtual bool OnDouble(double value) OVERRIDE { return Count(); }
+  virtual bool OnString(const StringPiece& value) OVERRIDE { return Count(); }
+  virtual bool OnDictionaryBegin() OVERRIDE { return Count(); }
+  virtual bool OnDictionaryKey(const StringPiece& key) OVERRIDE {
+    return true;
+  }
+  virtual bool OnDictionaryEnd() OVERRIDE { return true; }
+  virtual bool OnListBegin() OVERRIDE { return Count(); }
+  virtual bool OnListEnd() OVERRIDE { return true; }
+
+ private:
+  bool Count() {
+    ++count_;
+    return true;
+  }
+
+  int count_;
+
+  DISALLOW_COPY_AND_ASSIGN(CountingDelegate);
+};
+
+// Returns a pretty printed list of |entries| records, much like a large
+// preferences file.
+std::string MakeLargeJSON(int entries) {
+  std::string json = "[\n";
+  for (int i = 0; i < entries; ++i) {
+    StringAppendF(&json,
+        "   {\n"
+        "      \"id\": %d,\n"
+        "      \"name\": \"entry number %d\",\n"
+        "      \"url\": \"http://www.example.com/path/to/page%d.html\",\n"
+        "      \"score\": %d.25,\n"
+        "      \"enabled\": %s,\n"
+        "      \"note\": \"line one\\nline \\\"two\\\"\",\n"
+        "      \"tags\": [ \"alpha\", \"beta\", %d, null ]\n"
+        "   }%s\n",
+        i, i, i, i, i % 2 ? "true" : "false", -i,
+        i + 1 < entries ? "," : "");
+  }
+  json.append("]\n");
+  return json;
+}
+
+double Megabytes(const std::string& json) {
+  return static_cast<double>(json.size()) * kIterations / 1e6;
+}
+
+}  // namespace
+
+// Builds a Value tree out of a large document.
+TEST(JSONReaderPerfTest, ReadValueTree) {
+  const std::string json = MakeLargeJSON(kEntries);
+
+  PerfTimer timer;
+  for (int i = 0; i < kIterations; ++i) {
+    scoped_ptr<Value> root(JSONReader::Read(json));
+    ASSERT_TRUE(root.get());
+  }
+  LogPerfResult("JSONReader_ValueTree",
+                Megabytes(json) / timer.Elapsed().InSecondsF(), "MB/s");
+}
+
+// Streams through the same document without building anything.
+TEST(JSONReaderPerfTest, StreamingParse) {
+  const std::string json = MakeLargeJSON(kEntries);
+
+  PerfTimer timer;
+  for (int i = 0; i < kIterations; ++i) {
+    CountingDelegate delegate;
+    JSONReader reader;
+    ASSERT_TRUE(reader.Parse(json, JSON_PARSE_RFC, &delegate));
+    ASSERT_EQ(1 + kEntries * 12, delegate.count());
+  }
+  LogPerfResult("JSONReader_Streaming",
+                Megabytes(json) / timer.Elapsed().InSecondsF(), "MB/s");
+}
+
+}  // namespace base
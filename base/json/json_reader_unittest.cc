@@ -8,7 +8,9 @@
 #include "base/file_util.h"
 #include "base/memory/scoped_ptr.h"
 #include "base/path_service.h"
+#include "base/string_number_conversions.h"
 #include "base/string_piece.h"
+#include "base/stringprintf.h"
 #include "base/utf_string_conversions.h"
 #include "base/values.h"
 #include "build/build_config.h"
@@ -16,6 +18,120 @@
 
 namespace base {
 
+namespace {
+
+// Logs the values it is handed, and stops parsing at |stop_key|.
+class LoggingDelegate : public JSONReader::Delegate {
+ public:
+  explicit LoggingDelegate(const std::string& stop_key)
+      : stop_key_(stop_key),
+        last_string_(NULL) {}
+
+  const std::string& log() const { return log_; }
+
+  // The input pointer of the last string seen.
+  const char* last_string() const { return last_string_; }
+
+  virtual bool OnNull() OVERRIDE {
+    return Log("null");
+  }
+  virtual bool OnBoolean(bool value) OVERRIDE {
+    return Log(value ? "true" : "false");
+  }
+  virtual bool OnInteger(int value) OVERRIDE {
+    return Log("int:" + IntToString(value));
+  }
+  virtual bool OnDouble(double value) OVERRIDE {
+    return Log("double:" + DoubleToString(value));
+  }
+  virtual bool OnString(const StringPiece& value) OVERRIDE {
+    last_string_ = value.data();
+    return Log("string:" + value.as_string());
+  }
+  virtual bool OnDictionaryBegin() OVERRIDE {
+    return Log("{");
+  }
+  virtual bool OnDictionaryKey(const StringPiece& key) OVERRIDE {
+    if (key == stop_key_)
+      return false;
+    return Log("key:" + key.as_string());
+  }
+  virtual bool OnDictionaryEnd() OVERRIDE {
+    return Log("}");
+  }
+  virtual bool OnListBegin() OVERRIDE {
+    return Log("[");
+  }
+  virtual bool OnListEnd() OVERRIDE {
+    return Log("]");
+  }
+
+ private:
+  bool Log(const std::string& event) {
+    if (!log_.empty())
+      log_.push_back(' ');
+    log_.append(event);
+    return true;
+  }
+
+  std::string stop_key_;
+  std::string log_;
+  const char* last_string_;
+};
+
+// Counts values without storing them, like a caller looking for a few keys.
+class CountingDelegate : public JSONReader::Delegate {
+ public:
+  CountingDelegate() : count_(0) {}
+
+  int count() const { return count_; }
+
+  virtual bool OnNull() OVERRIDE { return Count(); }
+  virtual bool OnBoolean(bool value) OVERRIDE { return Count(); }
+  virtual bool OnInteger(int value) OVERRIDE { return Count(); }
+  virtual bool OnDouble(double value) OVERRIDE { return Count(); }
+  virtual bool OnString(const StringPiece& value) OVERRIDE { return Count(); }
+  virtual bool OnDictionaryBegin() OVERRIDE { return Count(); }
+  virtual bool OnDictionaryKey(const StringPiece& key) OVERRIDE {
+    return true;
+  }
+  virtual bool OnDictionaryEnd() OVERRIDE { return true; }
+  virtual bool OnListBegin() OVERRIDE { return Count(); }
+  virtual bool OnListEnd() OVERRIDE { return true; }
+
+ private:
+  bool Count() {
+    ++count_;
+    return true;
+  }
+
+  int count_;
+};
+
+// Returns a pretty printed list of |entries| records, much like a large
+// preferences file.
+std::string MakeLargeJSON(int entries) {
+  std::string json = "[\n";
+  for (int i = 0; i < entries; ++i) {
+    StringAppendF(&json,
+        "   {\n"
+        "      \"id\": %d,\n"
+        "      \"name\": \"entry number %d\",\n"
+        "      \"url\": \"http://www.example.com/path/to/page%d.html\",\n"
+        "      \"score\": %d.25,\n"
+        "      \"enabled\": %s,\n"
+        "      \"note\": \"line one\\nline \\\"two\\\"\",\n"
+        "      \"tags\": [ \"alpha\", \"beta\", %d, null ]\n"
+        "   }%s\n",
+        i, i, i, i, i % 2 ? "true" : "false", -i,
+        i + 1 < entries ? "," : "");
+  }
+  json.append("]\n");
+  return json;
+}
+
+}  // namespace
+
 TEST(JSONReaderTest, Reading) {
   // some whitespace checking
   scoped_ptr<Value> root;
@@ -607,4 +723,93 @@ TEST(JSONReaderTest, ErrorMessages) {
   EXPECT_EQ(JSONReader::JSON_INVALID_ESCAPE, error_code);
 }
 
+TEST(JSONReaderTest, StreamingParse) {
+  const std::string json =
+      "{\"a\": [1, -2.5, \"x\\ny\", true, null], \"b\": {}, "
+      "\"c\": \"plain\"}";
+  LoggingDelegate delegate("");
+  JSONReader reader;
+  EXPECT_TRUE(reader.Parse(json, JSON_PARSE_RFC, &delegate));
+  EXPECT_EQ(JSONReader::JSON_NO_ERROR, reader.error_code());
+  EXPECT_EQ("{ key:a [ int:1 double:-2.5 string:x\ny true null ] "
+            "key:b { } key:c string:plain }", delegate.log());
+
+  // Strings without escapes are not copied.
+  EXPECT_EQ(json.data() + json.find("plain"), delegate.last_string());
+
+  // A scalar root is fine, as it is for Read().
+  LoggingDelegate scalar_delegate("");
+  EXPECT_TRUE(reader.Parse("  \"\\u20ac\" ", JSON_PARSE_RFC,
+                           &scalar_delegate));
+  EXPECT_EQ("string:\xe2\x82\xac", scalar_delegate.log());
+}
+
+TEST(JSONReaderTest, StreamingParseStops) {
+  // Stopping is not an error, even if the rest of the input is invalid.
+  LoggingDelegate delegate("stop");
+  JSONReader reader;
+  EXPECT_FALSE(reader.Parse("{\"a\": 1, \"stop\": [1, 2], garbage",
+                            JSON_PARSE_RFC, &delegate));
+  EXPECT_EQ(JSONReader::JSON_NO_ERROR, reader.error_code());
+  EXPECT_EQ("{ key:a int:1", delegate.log());
+}
+
+TEST(JSONReaderTest, StreamingParseErrors) {
+  JSONReader reader;
+  LoggingDelegate delegate("");
+  EXPECT_FALSE(reader.Parse("[1,]", JSON_PARSE_RFC, &delegate));
+  EXPECT_EQ(JSONReader::JSON_TRAILING_COMMA, reader.error_code());
+
+  LoggingDelegate lenient_delegate("");
+  EXPECT_TRUE(reader.Parse("[1,]", JSON_ALLOW_TRAILING_COMMAS,
+                           &lenient_delegate));
+  EXPECT_EQ("[ int:1 ]", lenient_delegate.log());
+
+  LoggingDelegate bad_delegate("");
+  EXPECT_FALSE(reader.Parse("{\"a\": 1} 2", JSON_PARSE_RFC, &bad_delegate));
+  EXPECT_EQ(JSONReader::JSON_UNEXPECTED_DATA_AFTER_ROOT, reader.error_code());
+}
+
+// Keys may come in any order, and a repeated key keeps its last value.
+TEST(JSONReaderTest, DictionaryKeysOutOfOrder) {
+  scoped_ptr<Value> root(JSONReader::Read(
+      "{\"c\": 1, \"a\": {\"z\": true, \"y\": false}, \"b\": 2, "
+      "\"c\": 3}"));
+  ASSERT_TRUE(root.get());
+  ASSERT_TRUE(root->IsType(Value::TYPE_DICTIONARY));
+  DictionaryValue* dict = static_cast<DictionaryValue*>(root.get());
+  EXPECT_EQ(3u, dict->size());
+  int value = 0;
+  EXPECT_TRUE(dict->GetInteger("b", &value));
+  EXPECT_EQ(2, value);
+  EXPECT_TRUE(dict->GetInteger("c", &value));
+  EXPECT_EQ(3, value);
+  bool flag = false;
+  EXPECT_TRUE(dict->GetBoolean("a.z", &flag));
+  EXPECT_TRUE(flag);
+  EXPECT_TRUE(dict->GetBoolean("a.y", &flag));
+  EXPECT_FALSE(flag);
+
+  // Values of dictionaries left open by an error are freed.
+  root.reset(JSONReader::Read("{\"b\": {\"a\": [1, {\"c\": 2}], \"d\": ]"));
+  EXPECT_FALSE(root.get());
+}
+
+// A streaming parse reports the same values that end up in the Value tree.
+TEST(JSONReaderTest, StreamingParseCountsValues) {
+  const int kEntries = 20;
+  const std::string json = MakeLargeJSON(kEntries);
+
+  scoped_ptr<Value> root(JSONReader::Read(json));
+  ASSERT_TRUE(root.get());
+  ASSERT_TRUE(root->IsType(Value::TYPE_LIST));
+  EXPECT_EQ(static_cast<size_t>(kEntries),
+            static_cast<ListValue*>(root.get())->GetSize());
+
+  CountingDelegate delegate;
+  JSONReader reader;
+  ASSERT_TRUE(reader.Parse(json, JSON_PARSE_RFC, &delegate));
+  EXPECT_EQ(1 + kEntries * 12, delegate.count());
+}
+
 }  // namespace base
@@ -362,9 +362,9 @@ void MessageLoop::RemoveTaskObserver(TaskObserver* task_observer) {
 }
 
 void MessageLoop::AssertIdle() const {
-  // We only check |incoming_queue_|, since we don't want to lock |work_queue_|.
-  base::AutoLock lock(incoming_queue_lock_);
-  DCHECK(incoming_queue_.empty());
+  // We only check |incoming_queue_|, since |work_queue_| belongs to the
+  // loop's own thread.
+  DCHECK(incoming_queue_.IsEmpty());
 }
 
 bool MessageLoop::is_running() const {
@@ -460,7 +460,8 @@ void MessageLoop::RunTask(const PendingTask& pending_task) {
                     DidProcessTask(pending_task.time_posted));
 
   tracked_objects::ThreadData::TallyRunOnNamedThreadIfTracking(pending_task,
-      start_time, tracked_objects::ThreadData::NowForEndOfRun());
+      start_time,
+      tracked_objects::ThreadData::NowForEndOfRun(pending_task.birth_tally));
 
   nestable_tasks_allowed_ = true;
 }
@@ -492,19 +493,13 @@ void MessageLoop::AddToDelayedWorkQueue(const PendingTask& pending_task) {
 void MessageLoop::ReloadWorkQueue() {
   // We can improve performance of our loading tasks from incoming_queue_ to
   // work_queue_ by waiting until the last minute (work_queue_ is empty) to
-  // load.  That reduces the number of locks-per-task significantly when our
-  // queues get large.
+  // load.  That reduces the number of atomic exchanges per task significantly
+  // when our queues get large.
   if (!work_queue_.empty())
-    return;  // Wait till we *really* need to lock and load.
+    return;  // Wait till we *really* need to load.
 
-  // Acquire all we can from the inter-thread queue with one lock acquisition.
-  {
-    base::AutoLock lock(incoming_queue_lock_);
-    if (incoming_queue_.empty())
-      return;
-    incoming_queue_.Swap(&work_queue_);  // Constant time
-    DCHECK(incoming_queue_.empty());
-  }
+  // Acquire all we can from the inter-thread queue with one atomic exchange.
+  incoming_queue_.TakeAll(&work_queue_);
 }
 
 bool MessageLoop::DeletePendingTasks() {
@@ -581,22 +576,16 @@ void MessageLoop::AddToIncomingQueue(PendingTask* pending_task) {
   // directly, as it could starve handling of foreign threads.  Put every task
   // into this queue.
 
-  scoped_refptr<base::MessagePump> pump;
-  {
-    base::AutoLock locked(incoming_queue_lock_);
-
-    bool was_empty = incoming_queue_.empty();
-    incoming_queue_.push(*pending_task);
-    pending_task->task.Reset();
-    if (!was_empty)
-      return;  // Someone else should have started the sub-pump.
-
-    pump = pump_;
-  }
   // Since the incoming_queue_ may contain a task that destroys this message
-  // loop, we cannot exit incoming_queue_lock_ until we are done with |this|.
-  // We use a stack-based reference to the message pump so that we can call
-  // ScheduleWork outside of incoming_queue_lock_.
+  // loop, we cannot touch |this| once the task has been pushed.  We take a
+  // stack-based reference to the message pump beforehand so that we can call
+  // ScheduleWork afterwards.
+  scoped_refptr<base::MessagePump> pump(pump_);
+
+  bool was_empty = incoming_queue_.Push(*pending_task);
+  pending_task->task.Reset();
+  if (!was_empty)
+    return;  // Someone else should have started the sub-pump.
 
   pump->ScheduleWork();
 }
@@ -12,6 +12,7 @@
 #include "base/base_export.h"
 #include "base/basictypes.h"
 #include "base/callback_forward.h"
+#include "base/incoming_task_queue.h"
 #include "base/location.h"
 #include "base/memory/ref_counted.h"
 #include "base/message_loop_proxy.h"
@@ -438,8 +439,8 @@ class BASE_EXPORT MessageLoop : public base::MessagePump::Delegate {
   void AddToIncomingQueue(base::PendingTask* pending_task);
 
   // Load tasks from the incoming_queue_ into work_queue_ if the latter is
-  // empty.  The former requires a lock to access, while the latter is directly
-  // accessible on this thread.
+  // empty.  The former is shared with posting threads, while the latter is
+  // directly accessible on this thread.
   void ReloadWorkQueue();
 
   // Delete tasks that haven't run yet without running them.  Used in the
@@ -495,13 +496,11 @@ class BASE_EXPORT MessageLoop : public base::MessagePump::Delegate {
   // A profiling histogram showing the counts of various messages and events.
   base::Histogram* message_histogram_;
 
-  // A null terminated list which creates an incoming_queue of tasks that are
-  // acquired under a mutex for processing on this instance's thread. These
-  // tasks have not yet been sorted out into items for our work_queue_ vs items
-  // that will be handled by the TimerManager.
-  base::TaskQueue incoming_queue_;
-  // Protect access to incoming_queue_.
-  mutable base::Lock incoming_queue_lock_;
+  // A lock-free queue of tasks posted from any thread, drained in batches for
+  // processing on this instance's thread. These tasks have not yet been
+  // sorted out into items for our work_queue_ vs items that will be handled by
+  // the TimerManager.
+  base::IncomingTaskQueue incoming_queue_;
 
   RunState* state_;
 
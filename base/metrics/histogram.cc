@@ -14,12 +14,18 @@
 #include <algorithm>
 #include <string>
 
+#include "base/atomicops.h"
 #include "base/debug/leak_annotations.h"
 #include "base/logging.h"
+#include "base/metrics/shared_histogram_allocator.h"
 #include "base/pickle.h"
 #include "base/stringprintf.h"
 #include "base/synchronization/lock.h"
 
+#if defined(COMPILER_MSVC) && !defined(ARCH_CPU_64_BITS)
+#include <intrin.h>
+#endif
+
 namespace base {
 
 // Static table of checksums for all possible 8 bit bytes.
@@ -71,6 +77,70 @@ const uint32 Histogram::kCrcTable[256] = {0x0, 0x77073096L, 0xee0e612cL,
 
 typedef Histogram::Count Count;
 
+namespace {
+
+// Adds |delta| to |*value| atomically.  base/atomicops.h only has Atomic64
+// on 64-bit builds, so 32-bit builds use the compiler's 64-bit
+// compare-and-swap (cmpxchg8b on x86, ldrexd/strexd on ARM).
+void IncreaseInt64(int64* value, int64 delta) {
+#if defined(ARCH_CPU_64_BITS)
+  subtle::NoBarrier_AtomicIncrement(reinterpret_cast<subtle::Atomic64*>(value),
+                                    delta);
+#elif defined(COMPILER_MSVC)
+  int64 old_value = *value;
+  for (;;) {
+    int64 previous = _InterlockedCompareExchange64(value, old_value + delta,
+                                                   old_value);
+    if (previous == old_value)
+      break;
+    old_value = previous;
+  }
+#else
+  __sync_fetch_and_add(value, delta);
+#endif
+}
+
+// Reads |*value| without tearing it, even while another thread is adding to
+// it with IncreaseInt64().
+int64 LoadInt64(const int64* value) {
+#if defined(ARCH_CPU_64_BITS)
+  return subtle::NoBarrier_Load(
+      reinterpret_cast<const volatile subtle::Atomic64*>(value));
+#elif defined(COMPILER_MSVC)
+  return _InterlockedCompareExchange64(const_cast<int64*>(value), 0, 0);
+#else
+  return __sync_val_compare_and_swap(const_cast<int64*>(value), 0, 0);
+#endif
+}
+
+// Count is an int, which is what Atomic32 is on every platform we support.
+COMPILE_ASSERT(sizeof(Count) == sizeof(subtle::Atomic32),
+               count_must_be_atomic32_sized);
+
+Count IncreaseCount(Count* count, Count delta) {
+  return subtle::NoBarrier_AtomicIncrement(
+      reinterpret_cast<subtle::Atomic32*>(count), delta);
+}
+
+// Records |count| samples of |value| in |bucket| and the matching tallies.
+void AccumulateSample(Histogram::Sample value,
+                      Count count,
+                      Count* bucket,
+                      int64* sum,
+                      int64* redundant_count) {
+  DCHECK(count == 1 || count == -1);
+  Count new_count = IncreaseCount(bucket, count);
+  IncreaseInt64(sum, static_cast<int64>(count) * value);
+  IncreaseInt64(redundant_count, count);
+  DCHECK_GE(new_count, 0);
+}
+
+bool HistogramNameLess(const Histogram* a, const Histogram* b) {
+  return a->histogram_name() < b->histogram_name();
+}
+
+}  // namespace
+
 // static
 const size_t Histogram::kBucketCount_MAX = 16384u;
 
@@ -149,7 +219,17 @@ void Histogram::AddBoolean(bool value) {
 }
 
 void Histogram::AddSampleSet(const SampleSet& sample) {
-  sample_.Add(sample);
+  if (!shared_samples_) {
+    sample_.Add(sample);
+    return;
+  }
+  sample.CheckSize(*this);
+  IncreaseInt64(&shared_samples_->sum, sample.sum());
+  IncreaseInt64(&shared_samples_->redundant_count, sample.redundant_count());
+  for (size_t index = 0; index < bucket_count(); ++index) {
+    if (sample.counts(index))
+      IncreaseCount(&shared_samples_->counts[index], sample.counts(index));
+  }
 }
 
 void Histogram::SetRangeDescriptions(const DescriptionPair descriptions[]) {
@@ -393,11 +473,17 @@ size_t Histogram::bucket_count() const {
   return bucket_count_;
 }
 
-// Do a safe atomic snapshot of sample data.
-// This implementation assumes we are on a safe single thread.
+// Do a safe snapshot of sample data, even while other threads add samples.
 void Histogram::SnapshotSample(SampleSet* sample) const {
-  // Note locking not done in this version!!!
-  *sample = sample_;
+  // No locking needed: the tallies are read atomically, and a sample landing
+  // between the bucket and tally reads is allowed for by FindCorruption().
+  *sample = SampleSet();
+  sample->Resize(*this);
+  if (!shared_samples_) {
+    sample->Add(sample_);
+    return;
+  }
+  sample->AddSharedSamples(*shared_samples_);
 }
 
 bool Histogram::HasConstructorArguments(Sample minimum,
@@ -428,7 +514,8 @@ Histogram::Histogram(const std::string& name, Sample minimum,
     flags_(kNoFlags),
     cached_ranges_(new CachedRanges(bucket_count + 1, 0)),
     range_checksum_(0),
-    sample_() {
+    sample_(),
+    shared_samples_(NULL) {
   Initialize();
 }
 
@@ -441,7 +528,8 @@ Histogram::Histogram(const std::string& name, TimeDelta minimum,
     flags_(kNoFlags),
     cached_ranges_(new CachedRanges(bucket_count + 1, 0)),
     range_checksum_(0),
-    sample_() {
+    sample_(),
+    shared_samples_(NULL) {
   Initialize();
 }
 
@@ -553,7 +641,12 @@ const std::string Histogram::GetAsciiBucketRange(size_t i) const {
 
 // Update histogram data with new sample.
 void Histogram::Accumulate(Sample value, Count count, size_t index) {
-  // Note locking not done in this version!!!
+  // No locking needed: the sample set uses atomic increments.
+  if (shared_samples_) {
+    AccumulateSample(value, count, &shared_samples_->counts[index],
+                     &shared_samples_->sum, &shared_samples_->redundant_count);
+    return;
+  }
   sample_.Accumulate(value, count, index);
 }
 
@@ -582,6 +675,15 @@ uint32 Histogram::CalculateRangeChecksum() const {
   return checksum;
 }
 
+void Histogram::UseSharedSamples(SharedSamples* shared) {
+  DCHECK(!shared_samples_);
+  shared->sum = sample_.sum();
+  shared->redundant_count = sample_.redundant_count();
+  for (size_t index = 0; index < bucket_count(); ++index)
+    shared->counts[index] = sample_.counts(index);
+  shared_samples_ = shared;
+}
+
 void Histogram::Initialize() {
   sample_.Resize(*this);
   if (declared_min_ < 1)
@@ -720,13 +822,7 @@ void Histogram::SampleSet::CheckSize(const Histogram& histogram) const {
 
 void Histogram::SampleSet::Accumulate(Sample value,  Count count,
                                       size_t index) {
-  DCHECK(count == 1 || count == -1);
-  counts_[index] += count;
-  sum_ += count * value;
-  redundant_count_ += count;
-  DCHECK_GE(counts_[index], 0);
-  DCHECK_GE(sum_, 0);
-  DCHECK_GE(redundant_count_, 0);
+  AccumulateSample(value, count, &counts_[index], &sum_, &redundant_count_);
 }
 
 Count Histogram::SampleSet::TotalCount() const {
@@ -741,10 +837,25 @@ Count Histogram::SampleSet::TotalCount() const {
 
 void Histogram::SampleSet::Add(const SampleSet& other) {
   DCHECK_EQ(counts_.size(), other.counts_.size());
-  sum_ += other.sum_;
-  redundant_count_ += other.redundant_count_;
-  for (size_t index = 0; index < counts_.size(); ++index)
-    counts_[index] += other.counts_[index];
+  IncreaseInt64(&sum_, LoadInt64(&other.sum_));
+  IncreaseInt64(&redundant_count_, LoadInt64(&other.redundant_count_));
+  for (size_t index = 0; index < counts_.size(); ++index) {
+    if (other.counts_[index])
+      IncreaseCount(&counts_[index], other.counts_[index]);
+  }
+}
+
+void Histogram::SampleSet::AddSharedSamples(const SharedSamples& shared) {
+  DCHECK(!counts_.empty());
+  IncreaseInt64(&sum_, LoadInt64(&shared.sum));
+  IncreaseInt64(&redundant_count_, LoadInt64(&shared.redundant_count));
+  for (size_t index = 0; index < counts_.size(); ++index) {
+    Count count = subtle::NoBarrier_Load(
+        reinterpret_cast<const volatile subtle::Atomic32*>(
+            &shared.counts[index]));
+    if (count)
+      IncreaseCount(&counts_[index], count);
+  }
 }
 
 void Histogram::SampleSet::Subtract(const SampleSet& other) {
@@ -1121,6 +1232,9 @@ Histogram* StatisticsRecorder::RegisterOrDeleteDuplicate(Histogram* histogram) {
     ANNOTATE_LEAKING_OBJECT_PTR(histogram);  // see crbug.com/79322
     RegisterOrDeleteDuplicateRanges(histogram);
     ++number_of_histograms_;
+    SharedHistogramAllocator* allocator = SharedHistogramAllocator::GetGlobal();
+    if (allocator)
+      allocator->AddHistogram(histogram);
   } else {
     delete histogram;  // We already have one by this name.
     histogram = it->second;
@@ -1288,12 +1402,16 @@ void StatisticsRecorder::GetSnapshot(const std::string& query,
   base::AutoLock auto_lock(*lock_);
   if (!histograms_)
     return;
+  size_t original_size = snapshot->size();
   for (HistogramMap::iterator it = histograms_->begin();
        histograms_->end() != it;
        ++it) {
     if (it->first.find(query) != std::string::npos)
       snapshot->push_back(it->second);
   }
+  // The registry is unordered; keep the output stable and readable.
+  std::sort(snapshot->begin() + original_size, snapshot->end(),
+            &HistogramNameLess);
 }
 
 CachedRanges::CachedRanges(size_t bucket_count, int initial_value)
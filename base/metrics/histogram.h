@@ -50,6 +50,7 @@
 #include "base/base_export.h"
 #include "base/compiler_specific.h"
 #include "base/gtest_prod_util.h"
+#include "base/hash_tables.h"
 #include "base/logging.h"
 #include "base/time.h"
 
@@ -59,6 +60,7 @@ class PickleIterator;
 namespace base {
 
 class Lock;
+class SharedHistogramAllocator;
 //------------------------------------------------------------------------------
 // Histograms are often put in areas where they are called many many times, and
 // performance is critical.  As a result, they are designed to have a very low
@@ -379,6 +381,14 @@ class BASE_EXPORT Histogram {
     const char* description;  // Null means end of a list of pairs.
   };
 
+  // The layout of a histogram's samples when a SharedHistogramAllocator keeps
+  // them in shared memory, in place of |sample_|.
+  struct SharedSamples {
+    int64 sum;
+    int64 redundant_count;
+    Count counts[1];  // Actually bucket_count() entries.
+  };
+
   //----------------------------------------------------------------------------
   // Statistic values, developed over the life of the histogram.
 
@@ -391,7 +401,8 @@ class BASE_EXPORT Histogram {
     void Resize(const Histogram& histogram);
     void CheckSize(const Histogram& histogram) const;
 
-    // Accessor for histogram to make routine additions.
+    // Accessor for histogram to make routine additions.  Uses atomic
+    // increments, so concurrent calls from several threads are not lost.
     void Accumulate(Sample value, Count count, size_t index);
 
     // Accessor methods.
@@ -400,10 +411,18 @@ class BASE_EXPORT Histogram {
     int64 sum() const { return sum_; }
     int64 redundant_count() const { return redundant_count_; }
 
-    // Arithmetic manipulation of corresponding elements of the set.
+    // Arithmetic manipulation of corresponding elements of the set.  Add() is
+    // atomic in the same way as Accumulate(); Subtract() is not, and is meant
+    // for snapshots.
     void Add(const SampleSet& other);
     void Subtract(const SampleSet& other);
 
+    // Adds the samples in |shared|, which other threads or processes may be
+    // recording into: every tally is read atomically, so a 64-bit one can't
+    // be seen half-updated on 32-bit builds.  The set must already be
+    // Resize()d to the histogram's bucket count.
+    void AddSharedSamples(const SharedSamples& shared);
+
     bool Serialize(Pickle* pickle) const;
     bool Deserialize(PickleIterator* iter);
 
@@ -423,10 +442,9 @@ class BASE_EXPORT Histogram {
     // To help identify memory corruption, we reduntantly save the number of
     // samples we've accumulated into all of our buckets.  We can compare this
     // count to the sum of the counts in all buckets, and detect problems.  Note
-    // that due to races in histogram accumulation (if a histogram is indeed
-    // updated on several threads simultaneously), the tallies might mismatch,
-    // and also the snapshotting code may asynchronously get a mismatch (though
-    // generally either race based mismatch cause is VERY rare).
+    // that the snapshotting code may asynchronously get a mismatch, since a
+    // snapshot can land between the bucket and tally updates of an addition
+    // (though this is VERY rare).
     int64 redundant_count_;
   };
 
@@ -569,9 +587,10 @@ class BASE_EXPORT Histogram {
   virtual const std::string GetAsciiBucketRange(size_t it) const;
 
   //----------------------------------------------------------------------------
-  // Methods to override to create thread safe histogram.
+  // Methods to override to customize sample recording.
   //----------------------------------------------------------------------------
-  // Update all our internal data, including histogram
+  // Update all our internal data, including histogram.  Thread safe without
+  // locking; see SampleSet::Accumulate().
   virtual void Accumulate(Sample value, Count count, size_t index);
 
   //----------------------------------------------------------------------------
@@ -594,10 +613,16 @@ class BASE_EXPORT Histogram {
   FRIEND_TEST_ALL_PREFIXES(HistogramTest, Crc32TableTest);
 
   friend class StatisticsRecorder;  // To allow it to delete duplicates.
+  friend class SharedHistogramAllocator;  // To move samples to shared memory.
 
   // Post constructor initialization.
   void Initialize();
 
+  // Records all samples, including those already taken, into |shared|
+  // instead of |sample_| from now on.  Must be called before the histogram is
+  // handed out.
+  void UseSharedSamples(SharedSamples* shared);
+
   // Checksum function for accumulating range values into a checksum.
   static uint32 Crc32(uint32 sum, Sample range);
 
@@ -657,6 +682,10 @@ class BASE_EXPORT Histogram {
   // sample.
   SampleSet sample_;
 
+  // When non-NULL, samples are recorded here, in shared memory, and |sample_|
+  // is unused.
+  SharedSamples* shared_samples_;
+
   DISALLOW_COPY_AND_ASSIGN(Histogram);
 };
 
@@ -836,13 +865,14 @@ class BASE_EXPORT StatisticsRecorder {
 
 
  private:
-  // We keep all registered histograms in a map, from name to histogram.
-  typedef std::map<std::string, Histogram*> HistogramMap;
+  // We keep all registered histograms in a hash map, from name to histogram.
+  // Snapshots are sorted by name when they are taken.
+  typedef base::hash_map<std::string, Histogram*> HistogramMap;
 
-  // We keep all |cached_ranges_| in a map, from checksum to a list of
+  // We keep all |cached_ranges_| in a hash map, from checksum to a list of
   // |cached_ranges_|.  Checksum is calculated from the |ranges_| in
   // |cached_ranges_|.
-  typedef std::map<uint32, std::list<CachedRanges*>*> RangesMap;
+  typedef base::hash_map<uint32, std::list<CachedRanges*>*> RangesMap;
 
   static HistogramMap* histograms_;
 
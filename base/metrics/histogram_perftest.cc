@@ -0,0 +1,160 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/memory/scoped_vector.h"
+#include "base/metrics/histogram.h"
+#include "base/perftimer.h"
+#include "base/stringprintf.h"
+#include "base/synchronization/lock.h"
+#include "base/threading/simple_thread.h"
+#include "base/time.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace base {
+
+namespace {
+
+const int kSamplesPerThread = 1000000;
+const int kMaxSample = 10000;
+const int kBucketCount = 50;
+
+// Baseline for Histogram::Add(): the same tallies kept with plain arithmetic,
+// optionally under a lock, which is how a histogram shared between threads
+// would otherwise be protected.
+class BaselineCounts {
+ public:
+  explicit BaselineCounts(bool use_lock)
+      : use_lock_(use_lock),
+        counts_(kBucketCount),
+        sum_(0),
+        redundant_count_(0) {
+  }
+
+  void Add(int value) {
+    if (use_lock_)
+      lock_.Acquire();
+    ++counts_[value * kBucketCount / kMaxSample];
+    sum_ += value;
+    ++redundant_count_;
+    if (use_lock_)
+      lock_.Release();
+  }
+
+  int64 redundant_count() const { return redundant_count_; }
+
+ private:
+  const bool use_lock_;
+  Lock lock_;
+  std::vector<int> counts_;
+  int64 sum_;
+  int64 redundant_count_;
+
+  DISALLOW_COPY_AND_ASSIGN(BaselineCounts);
+};
+
+// Records |kSamplesPerThread| samples spread over every bucket of |Target|,
+// which is a Histogram or BaselineCounts.
+template <typename Target>
+class Recorder : public DelegateSimpleThread::Delegate {
+ public:
+  explicit Recorder(Target* target) : target_(target) {}
+
+  virtual void Run() OVERRIDE {
+    for (int i = 0; i < kSamplesPerThread; ++i)
+      target_->Add(i % kMaxSample);
+  }
+
+ private:
+  Target* target_;
+};
+
+// Records samples into |target| from |num_threads| threads at once and logs
+// the throughput as |name|.
+template <typename Target>
+void RunAddBenchmark(const std::string& name, Target* target,
+                     int num_threads) {
+  ScopedVector<Recorder<Target> > recorders;
+  ScopedVector<DelegateSimpleThread> threads;
+  for (int i = 0; i < num_threads; ++i) {
+    recorders.push_back(new Recorder<Target>(target));
+    threads.push_back(new DelegateSimpleThread(recorders[i], "recorder"));
+  }
+
+  PerfTimer timer;
+  for (int i = 0; i < num_threads; ++i)
+    threads[i]->Start();
+  for (int i = 0; i < num_threads; ++i)
+    threads[i]->Join();
+  TimeDelta elapsed = timer.Elapsed();
+
+  LogPerfResult(name.c_str(),
+                num_threads * kSamplesPerThread / elapsed.InSecondsF(),
+                "samples/s");
+}
+
+const int kThreadCounts[] = { 1, 2, 4, 8 };
+
+}  // namespace
+
+// Measures sample recording throughput as more threads share a histogram.
+TEST(HistogramPerfTest, ConcurrentAdd) {
+  StatisticsRecorder recorder;
+  for (size_t i = 0; i < arraysize(kThreadCounts); ++i) {
+    int num_threads = kThreadCounts[i];
+    Histogram* histogram = Histogram::FactoryGet(
+        StringPrintf("PerfTest.Add%d", num_threads), 1, kMaxSample,
+        kBucketCount, Histogram::kNoFlags);
+    RunAddBenchmark(StringPrintf("Histogram_Add_%dthreads", num_threads),
+                    histogram, num_threads);
+
+    Histogram::SampleSet snapshot;
+    histogram->SnapshotSample(&snapshot);
+    EXPECT_EQ(num_threads * kSamplesPerThread, snapshot.TotalCount());
+  }
+}
+
+// Baselines for ConcurrentAdd: unsynchronized increments on one thread, which
+// is what Add() cost before it became atomic, and lock-protected increments
+// shared between threads.
+TEST(HistogramPerfTest, ConcurrentAddBaseline) {
+  BaselineCounts unsynchronized(false);
+  RunAddBenchmark("Histogram_Add_Baseline_Unsynchronized", &unsynchronized, 1);
+
+  for (size_t i = 0; i < arraysize(kThreadCounts); ++i) {
+    int num_threads = kThreadCounts[i];
+    BaselineCounts locked(true);
+    RunAddBenchmark(
+        StringPrintf("Histogram_Add_Baseline_Locked_%dthreads", num_threads),
+        &locked, num_threads);
+    EXPECT_EQ(num_threads * kSamplesPerThread, locked.redundant_count());
+  }
+}
+
+// Measures looking up existing histograms by name, which is what every
+// UMA_HISTOGRAM_* macro does the first time it runs on a given call site.
+TEST(HistogramPerfTest, FactoryGetLookup) {
+  StatisticsRecorder recorder;
+  const int kHistograms = 2000;
+  const int kLookups = 1000000;
+  std::vector<std::string> names;
+  for (int i = 0; i < kHistograms; ++i) {
+    names.push_back(StringPrintf("PerfTest.Lookup.%d", i));
+    Histogram::FactoryGet(names.back(), 1, 1000, 50, Histogram::kNoFlags);
+  }
+
+  PerfTimer timer;
+  for (int i = 0; i < kLookups; ++i) {
+    Histogram::FactoryGet(names[i % kHistograms], 1, 1000, 50,
+                          Histogram::kNoFlags);
+  }
+  TimeDelta elapsed = timer.Elapsed();
+  LogPerfResult("Histogram_FactoryGet", kLookups / elapsed.InSecondsF(),
+                "lookups/s");
+}
+
+}  // namespace base
@@ -8,7 +8,9 @@
 #include <vector>
 
 #include "base/memory/scoped_ptr.h"
+#include "base/memory/scoped_vector.h"
 #include "base/metrics/histogram.h"
+#include "base/threading/simple_thread.h"
 #include "base/time.h"
 #include "testing/gtest/include/gtest/gtest.h"
 
@@ -450,4 +452,66 @@ TEST(HistogramTest, CachedRangesTest) {
   EXPECT_FALSE(cached_ranges1->Equals(cached_ranges3));
 }
 
+// Adds |count| samples of |value| to a histogram.
+class AddingDelegate : public DelegateSimpleThread::Delegate {
+ public:
+  AddingDelegate(Histogram* histogram, int value, int count)
+      : histogram_(histogram), value_(value), count_(count) {}
+
+  virtual void Run() OVERRIDE {
+    for (int i = 0; i < count_; ++i)
+      histogram_->Add(value_);
+  }
+
+ private:
+  Histogram* histogram_;
+  int value_;
+  int count_;
+};
+
+// Samples added from several threads at once must all be counted.
+TEST(HistogramTest, ConcurrentAddsAreNotLost) {
+  StatisticsRecorder recorder;
+  Histogram* histogram(Histogram::FactoryGet(
+      "ConcurrentHistogram", 1, 1000, 10, Histogram::kNoFlags));
+
+  const int kThreads = 4;
+  const int kSamplesPerThread = 100000;
+  ScopedVector<AddingDelegate> delegates;
+  ScopedVector<DelegateSimpleThread> threads;
+  for (int i = 0; i < kThreads; ++i) {
+    // Every thread hits the same bucket to maximize contention.
+    delegates.push_back(
+        new AddingDelegate(histogram, 5, kSamplesPerThread));
+    threads.push_back(new DelegateSimpleThread(delegates[i], "adder"));
+  }
+  for (int i = 0; i < kThreads; ++i)
+    threads[i]->Start();
+  for (int i = 0; i < kThreads; ++i)
+    threads[i]->Join();
+
+  Histogram::SampleSet snapshot;
+  histogram->SnapshotSample(&snapshot);
+  EXPECT_EQ(kThreads * kSamplesPerThread, snapshot.TotalCount());
+  EXPECT_EQ(kThreads * kSamplesPerThread, snapshot.redundant_count());
+  EXPECT_EQ(5 * kThreads * kSamplesPerThread, snapshot.sum());
+  EXPECT_EQ(Histogram::NO_INCONSISTENCIES,
+            histogram->FindCorruption(snapshot));
+}
+
+// Histograms are kept in a hash map; snapshots must still come out sorted.
+TEST(HistogramTest, SnapshotIsSortedByName) {
+  StatisticsRecorder recorder;
+  const char* kNames[] = { "Sort.C", "Sort.A", "Other", "Sort.B" };
+  for (size_t i = 0; i < arraysize(kNames); ++i)
+    Histogram::FactoryGet(kNames[i], 1, 1000, 10, Histogram::kNoFlags);
+
+  StatisticsRecorder::Histograms snapshot;
+  StatisticsRecorder::GetSnapshot("Sort.", &snapshot);
+  ASSERT_EQ(3u, snapshot.size());
+  EXPECT_EQ("Sort.A", snapshot[0]->histogram_name());
+  EXPECT_EQ("Sort.B", snapshot[1]->histogram_name());
+  EXPECT_EQ("Sort.C", snapshot[2]->histogram_name());
+}
+
 }  // namespace base
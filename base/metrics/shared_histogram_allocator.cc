@@ -0,0 +1,315 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/metrics/shared_histogram_allocator.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "base/atomicops.h"
+#include "base/logging.h"
+
+namespace base {
+
+// The first bytes of the segment.
+struct SharedHistogramAllocator::SegmentHeader {
+  uint32 cookie;  // kSegmentCookie once formatted.
+  uint32 size;  // Size of the whole segment.
+  subtle::Atomic32 freeptr;  // Offset of the first unallocated byte.
+  uint32 reserved;  // Keeps records 8-byte aligned.
+};
+
+// The start of each histogram's record.  It is followed by the histogram's
+// Histogram::SharedSamples, with |bucket_count| counts, then its
+// |bucket_count| + 1 ranges, then its NUL-terminated name.
+struct SharedHistogramAllocator::RecordHeader {
+  // Size of the whole record, a multiple of kAlignment.  Written as soon as
+  // the record is allocated, so readers can step over it.
+  subtle::Atomic32 size;
+  // Set, with release semantics, once the rest of the record is written.
+  subtle::Atomic32 ready;
+  int32 type;  // Histogram::ClassType.
+  int32 flags;
+  Histogram::Sample minimum;
+  Histogram::Sample maximum;
+  uint32 bucket_count;
+  uint32 range_checksum;
+};
+
+namespace {
+
+const uint32 kSegmentCookie = 0x48495354;  // "HIST"
+
+// Records are aligned for the int64 tallies in Histogram::SharedSamples.
+const uint32 kAlignment = 8;
+
+SharedHistogramAllocator* g_allocator = NULL;
+
+size_t SamplesSize(size_t bucket_count) {
+  return offsetof(Histogram::SharedSamples, counts) +
+      bucket_count * sizeof(Histogram::Count);
+}
+
+size_t RangesOffset(size_t header_size, size_t bucket_count) {
+  return header_size + SamplesSize(bucket_count);
+}
+
+size_t NameOffset(size_t header_size, size_t bucket_count) {
+  return RangesOffset(header_size, bucket_count) +
+      (bucket_count + 1) * sizeof(Histogram::Sample);
+}
+
+// Finds or creates this process' histogram matching a record.  Returns NULL
+// if the record's description is invalid.
+Histogram* GetOrCreateHistogram(const std::string& name,
+                                int type,
+                                Histogram::Sample minimum,
+                                Histogram::Sample maximum,
+                                size_t bucket_count,
+                                const Histogram::Sample* ranges,
+                                int flags) {
+  // The same checks as Histogram::DeserializeHistogramInfo() makes, as the
+  // record may have been written by a compromised process.
+  if (bucket_count < 2 || bucket_count >= Histogram::kBucketCount_MAX)
+    return NULL;
+  if (type != Histogram::CUSTOM_HISTOGRAM &&
+      (maximum <= 0 || minimum <= 0 || maximum <= minimum ||
+       bucket_count < 3 ||
+       bucket_count > static_cast<size_t>(maximum - minimum) + 2)) {
+    return NULL;
+  }
+  Histogram::Flags local_flags = static_cast<Histogram::Flags>(
+      flags & ~Histogram::kIPCSerializationSourceFlag);
+
+  switch (type) {
+    case Histogram::HISTOGRAM:
+      return Histogram::FactoryGet(name, minimum, maximum, bucket_count,
+                                   local_flags);
+    case Histogram::LINEAR_HISTOGRAM:
+      return LinearHistogram::FactoryGet(name, minimum, maximum, bucket_count,
+                                         local_flags);
+    case Histogram::BOOLEAN_HISTOGRAM:
+      return BooleanHistogram::FactoryGet(name, local_flags);
+    case Histogram::CUSTOM_HISTOGRAM: {
+      // The last range is always kSampleType_MAX, which the factory adds.
+      std::vector<Histogram::Sample> custom_ranges(ranges,
+                                                   ranges + bucket_count);
+      for (size_t i = 0; i < custom_ranges.size(); ++i) {
+        if (custom_ranges[i] < 0 ||
+            custom_ranges[i] >= Histogram::kSampleType_MAX) {
+          return NULL;
+        }
+      }
+      return CustomHistogram::FactoryGet(name, custom_ranges, local_flags);
+    }
+    default:
+      return NULL;
+  }
+}
+
+}  // namespace
+
+const uint32 SharedHistogramAllocator::kMinimumSize = 1024;
+
+SharedHistogramAllocator::~SharedHistogramAllocator() {
+  DCHECK_NE(this, g_allocator);
+}
+
+// static
+SharedHistogramAllocator* SharedHistogramAllocator::CreateAnonymous(
+    uint32 size) {
+  if (size < kMinimumSize)
+    return NULL;
+  scoped_ptr<SharedMemory> shared_memory(new SharedMemory());
+  if (!shared_memory->CreateAndMapAnonymous(size))
+    return NULL;
+  // Fresh shared memory is zero filled, so only the header needs writing.
+  SegmentHeader* header =
+      reinterpret_cast<SegmentHeader*>(shared_memory->memory());
+  header->cookie = kSegmentCookie;
+  header->size = size;
+  subtle::Release_Store(&header->freeptr, sizeof(SegmentHeader));
+  return new SharedHistogramAllocator(shared_memory.release(), size);
+}
+
+// static
+SharedHistogramAllocator* SharedHistogramAllocator::CreateFromHandle(
+    SharedMemoryHandle handle,
+    uint32 size) {
+  scoped_ptr<SharedMemory> shared_memory(new SharedMemory(handle, false));
+  if (size < kMinimumSize || !shared_memory->Map(size))
+    return NULL;
+  const SegmentHeader* header =
+      reinterpret_cast<const SegmentHeader*>(shared_memory->memory());
+  if (header->cookie != kSegmentCookie || header->size != size) {
+    DLOG(ERROR) << "Not a histogram segment of size " << size;
+    return NULL;
+  }
+  return new SharedHistogramAllocator(shared_memory.release(), size);
+}
+
+// static
+void SharedHistogramAllocator::SetGlobal(
+    SharedHistogramAllocator* allocator) {
+  g_allocator = allocator;
+}
+
+// static
+SharedHistogramAllocator* SharedHistogramAllocator::GetGlobal() {
+  return g_allocator;
+}
+
+bool SharedHistogramAllocator::AddHistogram(Histogram* histogram) {
+  // Such histograms could not be recreated by the reader.
+  if (histogram->histogram_type() == Histogram::NOT_VALID_IN_RENDERER)
+    return false;
+
+  const std::string& name = histogram->histogram_name();
+  const size_t bucket_count = histogram->bucket_count();
+  const size_t name_offset = NameOffset(sizeof(RecordHeader), bucket_count);
+  size_t size = name_offset + name.size() + 1;
+  size = (size + kAlignment - 1) & ~static_cast<size_t>(kAlignment - 1);
+  if (size > size_)
+    return false;
+  uint32 offset = Allocate(static_cast<uint32>(size));
+  if (!offset)
+    return false;
+
+  char* record_base = base() + offset;
+  RecordHeader* record = reinterpret_cast<RecordHeader*>(record_base);
+  subtle::Release_Store(&record->size, static_cast<subtle::Atomic32>(size));
+  record->type = histogram->histogram_type();
+  record->flags = histogram->flags();
+  record->minimum = histogram->declared_min();
+  record->maximum = histogram->declared_max();
+  record->bucket_count = static_cast<uint32>(bucket_count);
+  record->range_checksum = histogram->range_checksum();
+  Histogram::Sample* ranges = reinterpret_cast<Histogram::Sample*>(
+      record_base + RangesOffset(sizeof(RecordHeader), bucket_count));
+  for (size_t i = 0; i <= bucket_count; ++i)
+    ranges[i] = histogram->ranges(i);
+  memcpy(record_base + name_offset, name.c_str(), name.size() + 1);
+
+  histogram->UseSharedSamples(reinterpret_cast<Histogram::SharedSamples*>(
+      record_base + sizeof(RecordHeader)));
+  subtle::Release_Store(&record->ready, 1);
+  return true;
+}
+
+void SharedHistogramAllocator::MergeHistogramDeltas() {
+  const uint32 end = used();
+  uint32 offset = sizeof(SegmentHeader);
+  while (offset < end) {
+    uint32 record_size = MergeRecord(offset, end);
+    if (!record_size)
+      break;
+    offset += record_size;
+  }
+}
+
+uint32 SharedHistogramAllocator::used() const {
+  uint32 freeptr =
+      static_cast<uint32>(subtle::Acquire_Load(&header()->freeptr));
+  return std::min(freeptr, size_);
+}
+
+SharedHistogramAllocator::SharedHistogramAllocator(
+    SharedMemory* shared_memory,
+    uint32 size)
+    : shared_memory_(shared_memory),
+      size_(size) {
+}
+
+uint32 SharedHistogramAllocator::Allocate(uint32 size) {
+  DCHECK_EQ(0u, size % kAlignment);
+  subtle::Atomic32* freeptr = &header()->freeptr;
+  uint32 offset = static_cast<uint32>(subtle::NoBarrier_Load(freeptr));
+  while (true) {
+    if (offset > size_ || size > size_ - offset)
+      return 0;
+    uint32 previous = static_cast<uint32>(subtle::NoBarrier_CompareAndSwap(
+        freeptr, offset, offset + size));
+    if (previous == offset)
+      return offset;
+    offset = previous;
+  }
+}
+
+uint32 SharedHistogramAllocator::MergeRecord(uint32 offset, uint32 end) {
+  if (end - offset < sizeof(RecordHeader))
+    return 0;
+  char* record_base = base() + offset;
+  RecordHeader* shared_record = reinterpret_cast<RecordHeader*>(record_base);
+  uint32 size = static_cast<uint32>(subtle::Acquire_Load(&shared_record->size));
+  if (size < sizeof(RecordHeader) || size % kAlignment ||
+      size > end - offset) {
+    // Either not written yet or garbage; nothing past it can be found.
+    return 0;
+  }
+  // Skip records still being written, or whose writer died part way.
+  if (!subtle::Acquire_Load(&shared_record->ready))
+    return size;
+
+  // The writer may still scribble over the record, so validate a copy.
+  RecordHeader record;
+  memcpy(&record, shared_record, sizeof(record));
+  const size_t bucket_count = record.bucket_count;
+  if (bucket_count >= Histogram::kBucketCount_MAX ||
+      NameOffset(sizeof(RecordHeader), bucket_count) >= size) {
+    DLOG(ERROR) << "Corrupt histogram record at " << offset;
+    return size;
+  }
+  const char* name_start =
+      record_base + NameOffset(sizeof(RecordHeader), bucket_count);
+  const char* name_end = static_cast<const char*>(
+      memchr(name_start, 0, record_base + size - name_start));
+  if (!name_end) {
+    DLOG(ERROR) << "Corrupt histogram name at " << offset;
+    return size;
+  }
+  std::string name(name_start, name_end);
+  const Histogram::Sample* ranges = reinterpret_cast<const Histogram::Sample*>(
+      record_base + RangesOffset(sizeof(RecordHeader), bucket_count));
+
+  Histogram* histogram = GetOrCreateHistogram(
+      name, record.type, record.minimum, record.maximum, bucket_count, ranges,
+      record.flags);
+  if (!histogram || histogram->bucket_count() != bucket_count ||
+      histogram->range_checksum() != record.range_checksum) {
+    DLOG(ERROR) << "Histogram record does not match: " << name;
+    return size;
+  }
+
+  Histogram::SharedSamples* samples =
+      reinterpret_cast<Histogram::SharedSamples*>(
+          record_base + sizeof(RecordHeader));
+  if (histogram->shared_samples_ == samples) {
+    // Single process mode: this is the histogram recording into the record.
+    return size;
+  }
+
+  Histogram::SampleSet snapshot;
+  snapshot.Resize(*histogram);
+  snapshot.AddSharedSamples(*samples);
+  Histogram::SampleSet& logged = logged_samples_[offset];
+  logged.Resize(*histogram);
+  for (size_t index = 0; index < bucket_count; ++index) {
+    // Counts only grow, so this can only be corruption.
+    if (snapshot.counts(index) < logged.counts(index)) {
+      DLOG(ERROR) << "Histogram counts went backwards: " << name;
+      return size;
+    }
+  }
+  Histogram::SampleSet delta(snapshot);
+  delta.Subtract(logged);
+  logged = snapshot;
+  histogram->AddSampleSet(delta);
+  return size;
+}
+
+}  // namespace base
@@ -0,0 +1,117 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// SharedHistogramAllocator keeps histogram samples in a shared memory segment
+// so that another process can read them in place.  Child processes normally
+// report histograms by pickling a snapshot of each one
+// (Histogram::SerializeHistogramInfo()) and sending it over IPC, a full copy
+// that grows with the number of histograms.  With an allocator, the browser
+// creates a segment per child and shares it:
+//
+//   // Browser:
+//   SharedHistogramAllocator* allocator =
+//       SharedHistogramAllocator::CreateAnonymous(kSize);
+//   allocator->shared_memory()->ShareToProcess(child, &handle);
+//   // ... send |handle| to the child ...
+//
+//   // Child, early during startup:
+//   SharedHistogramAllocator::SetGlobal(
+//       SharedHistogramAllocator::CreateFromHandle(handle, kSize));
+//
+// From then on every histogram the child registers with the
+// StatisticsRecorder records its samples into the segment, and the browser
+// periodically calls MergeHistogramDeltas() to fold them into its own
+// histograms.  Since the browser holds its own mapping, samples recorded just
+// before the child crashes are not lost.
+//
+// The segment is an append-only arena: a header followed by one record per
+// histogram, each holding the histogram's description and its
+// Histogram::SharedSamples.  Records are allocated with a compare-and-swap on
+// the header's free offset and are never freed, so writers need no lock.
+// Readers treat everything in the segment as untrusted, since the child
+// writing it may be compromised.
+
+#ifndef BASE_METRICS_SHARED_HISTOGRAM_ALLOCATOR_H_
+#define BASE_METRICS_SHARED_HISTOGRAM_ALLOCATOR_H_
+#pragma once
+
+#include "base/base_export.h"
+#include "base/basictypes.h"
+#include "base/hash_tables.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/metrics/histogram.h"
+#include "base/shared_memory.h"
+
+namespace base {
+
+class BASE_EXPORT SharedHistogramAllocator {
+ public:
+  // Segments smaller than this cannot hold even one small histogram.
+  static const uint32 kMinimumSize;
+
+  ~SharedHistogramAllocator();
+
+  // Creates and formats a new anonymous segment of |size| bytes.  Returns
+  // NULL on failure.
+  static SharedHistogramAllocator* CreateAnonymous(uint32 size);
+
+  // Maps a segment created by CreateAnonymous() in another process.  Returns
+  // NULL if it can't be mapped or doesn't hold an allocator of |size| bytes.
+  static SharedHistogramAllocator* CreateFromHandle(SharedMemoryHandle handle,
+                                                    uint32 size);
+
+  // Sets the allocator that histograms registered from now on record into.
+  // It is not owned, and must outlive those histograms, which in practice
+  // means it is leaked just like they are.  Pass NULL to stop.
+  static void SetGlobal(SharedHistogramAllocator* allocator);
+  static SharedHistogramAllocator* GetGlobal();
+
+  // Moves |histogram|'s samples into the segment.  Called by the
+  // StatisticsRecorder when the histogram is first registered, before anyone
+  // else can see it.  Returns false if the segment is full, in which case the
+  // histogram keeps recording into its own memory (and is reported the old
+  // way).
+  bool AddHistogram(Histogram* histogram);
+
+  // Adds the samples each histogram in the segment has recorded since the
+  // previous call to the histogram of the same name in this process,
+  // creating it if needed.  Works whether or not the writing process is still
+  // alive.  Not thread safe; call it from one thread.
+  void MergeHistogramDeltas();
+
+  SharedMemory* shared_memory() { return shared_memory_.get(); }
+
+  // Bytes of the segment in use, including the header.
+  uint32 used() const;
+
+ private:
+  struct RecordHeader;
+  struct SegmentHeader;
+
+  SharedHistogramAllocator(SharedMemory* shared_memory, uint32 size);
+
+  // Reserves |size| bytes, or returns 0 if the segment is full.
+  uint32 Allocate(uint32 size);
+
+  // Reads and validates the record at |offset|, and merges its new samples.
+  // Returns the record's size, or 0 if iteration can't go past it.
+  uint32 MergeRecord(uint32 offset, uint32 end);
+
+  char* base() const { return static_cast<char*>(shared_memory_->memory()); }
+  SegmentHeader* header() const {
+    return reinterpret_cast<SegmentHeader*>(base());
+  }
+
+  scoped_ptr<SharedMemory> shared_memory_;
+  const uint32 size_;
+
+  // The samples merged so far from each record, keyed by record offset.
+  base::hash_map<uint32, Histogram::SampleSet> logged_samples_;
+
+  DISALLOW_COPY_AND_ASSIGN(SharedHistogramAllocator);
+};
+
+}  // namespace base
+
+#endif  // BASE_METRICS_SHARED_HISTOGRAM_ALLOCATOR_H_
@@ -0,0 +1,214 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/metrics/shared_histogram_allocator.h"
+
+#include <string.h>
+
+#include <vector>
+
+#include "base/memory/scoped_ptr.h"
+#include "base/metrics/histogram.h"
+#include "base/process_util.h"
+#include "base/stringprintf.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace base {
+
+namespace {
+
+const uint32 kSegmentSize = 64 * 1024;
+
+// Maps the segment of |allocator| a second time, as the browser does.
+SharedHistogramAllocator* CreateReader(SharedHistogramAllocator* allocator,
+                                       uint32 size) {
+  SharedMemoryHandle handle;
+  if (!allocator->shared_memory()->ShareToProcess(GetCurrentProcessHandle(),
+                                                  &handle)) {
+    return NULL;
+  }
+  return SharedHistogramAllocator::CreateFromHandle(handle, size);
+}
+
+}  // namespace
+
+class SharedHistogramAllocatorTest : public testing::Test {
+ protected:
+  virtual void SetUp() OVERRIDE {
+    writer_.reset(SharedHistogramAllocator::CreateAnonymous(kSegmentSize));
+    ASSERT_TRUE(writer_.get());
+    reader_.reset(CreateReader(writer_.get(), kSegmentSize));
+    ASSERT_TRUE(reader_.get());
+  }
+
+  virtual void TearDown() OVERRIDE {
+    SharedHistogramAllocator::SetGlobal(NULL);
+  }
+
+  // Creates histograms of every kind in a "child" StatisticsRecorder that
+  // records into |writer_|.  Histograms are leaked, so they remain usable
+  // after the recorder goes away.
+  void CreateChildHistograms() {
+    StatisticsRecorder child_recorder;
+    SharedHistogramAllocator::SetGlobal(writer_.get());
+    exponential_ = Histogram::FactoryGet(
+        "Shared.Exponential", 1, 1000, 20, Histogram::kNoFlags);
+    linear_ = LinearHistogram::FactoryGet(
+        "Shared.Linear", 1, 10, 11, Histogram::kUmaTargetedHistogramFlag);
+    boolean_ = BooleanHistogram::FactoryGet(
+        "Shared.Boolean", Histogram::kNoFlags);
+    std::vector<Histogram::Sample> custom_ranges;
+    custom_ranges.push_back(5);
+    custom_ranges.push_back(50);
+    custom_ranges.push_back(500);
+    custom_ = CustomHistogram::FactoryGet(
+        "Shared.Custom", custom_ranges, Histogram::kNoFlags);
+    SharedHistogramAllocator::SetGlobal(NULL);
+  }
+
+  scoped_ptr<SharedHistogramAllocator> writer_;
+  scoped_ptr<SharedHistogramAllocator> reader_;
+  Histogram* exponential_;
+  Histogram* linear_;
+  Histogram* boolean_;
+  Histogram* custom_;
+};
+
+TEST_F(SharedHistogramAllocatorTest, RejectsBadSegments) {
+  EXPECT_FALSE(SharedHistogramAllocator::CreateAnonymous(
+      SharedHistogramAllocator::kMinimumSize - 1));
+
+  // A segment of the wrong size.
+  scoped_ptr<SharedHistogramAllocator> reader(
+      CreateReader(writer_.get(), kSegmentSize / 2));
+  EXPECT_FALSE(reader.get());
+
+  // Shared memory that was never formatted.
+  SharedMemory plain_memory;
+  ASSERT_TRUE(plain_memory.CreateAndMapAnonymous(kSegmentSize));
+  SharedMemoryHandle handle;
+  ASSERT_TRUE(plain_memory.ShareToProcess(GetCurrentProcessHandle(),
+                                          &handle));
+  reader.reset(SharedHistogramAllocator::CreateFromHandle(handle,
+                                                          kSegmentSize));
+  EXPECT_FALSE(reader.get());
+}
+
+TEST_F(SharedHistogramAllocatorTest, MergesDeltas) {
+  uint32 empty_size = writer_->used();
+  CreateChildHistograms();
+  EXPECT_LT(empty_size, writer_->used());
+
+  exponential_->Add(10);
+  exponential_->Add(999);
+  linear_->Add(5);
+  boolean_->AddBoolean(true);
+  custom_->Add(60);
+
+  // The child's own view of its samples is unchanged.
+  Histogram::SampleSet child_snapshot;
+  exponential_->SnapshotSample(&child_snapshot);
+  EXPECT_EQ(2, child_snapshot.TotalCount());
+  EXPECT_EQ(1009, child_snapshot.sum());
+
+  StatisticsRecorder browser_recorder;
+  reader_->MergeHistogramDeltas();
+  reader_->MergeHistogramDeltas();  // Nothing new; must not double count.
+
+  const char* kNames[] = {
+    "Shared.Exponential", "Shared.Linear", "Shared.Boolean", "Shared.Custom"
+  };
+  Histogram* children[] = { exponential_, linear_, boolean_, custom_ };
+  for (size_t i = 0; i < arraysize(kNames); ++i) {
+    Histogram* histogram = NULL;
+    ASSERT_TRUE(StatisticsRecorder::FindHistogram(kNames[i], &histogram))
+        << kNames[i];
+    EXPECT_NE(children[i], histogram);
+    EXPECT_EQ(children[i]->histogram_type(), histogram->histogram_type());
+    EXPECT_EQ(children[i]->range_checksum(), histogram->range_checksum());
+    EXPECT_EQ(children[i]->flags(), histogram->flags());
+    Histogram::SampleSet child, browser;
+    children[i]->SnapshotSample(&child);
+    histogram->SnapshotSample(&browser);
+    EXPECT_EQ(child.TotalCount(), browser.TotalCount()) << kNames[i];
+    EXPECT_EQ(child.sum(), browser.sum()) << kNames[i];
+    for (size_t bucket = 0; bucket < histogram->bucket_count(); ++bucket)
+      EXPECT_EQ(child.counts(bucket), browser.counts(bucket));
+  }
+
+  // Only new samples are added by the next merge.
+  exponential_->Add(10);
+  reader_->MergeHistogramDeltas();
+  Histogram* histogram = NULL;
+  ASSERT_TRUE(StatisticsRecorder::FindHistogram("Shared.Exponential",
+                                                &histogram));
+  Histogram::SampleSet browser;
+  histogram->SnapshotSample(&browser);
+  EXPECT_EQ(3, browser.TotalCount());
+  EXPECT_EQ(1019, browser.sum());
+}
+
+TEST_F(SharedHistogramAllocatorTest, SamplesSurviveWriterExit) {
+  CreateChildHistograms();
+  exponential_->Add(42);
+  // The child goes away, taking its mapping with it.  Its histograms point
+  // into the unmapped segment, so they must not be touched from here on.
+  writer_.reset();
+
+  StatisticsRecorder browser_recorder;
+  reader_->MergeHistogramDeltas();
+  Histogram* histogram = NULL;
+  ASSERT_TRUE(StatisticsRecorder::FindHistogram("Shared.Exponential",
+                                                &histogram));
+  Histogram::SampleSet browser;
+  histogram->SnapshotSample(&browser);
+  EXPECT_EQ(1, browser.TotalCount());
+  EXPECT_EQ(42, browser.sum());
+}
+
+TEST_F(SharedHistogramAllocatorTest, FullSegmentFallsBackToLocalMemory) {
+  scoped_ptr<SharedHistogramAllocator> small(
+      SharedHistogramAllocator::CreateAnonymous(
+          SharedHistogramAllocator::kMinimumSize));
+  ASSERT_TRUE(small.get());
+
+  StatisticsRecorder recorder;
+  SharedHistogramAllocator::SetGlobal(small.get());
+  std::vector<Histogram*> histograms;
+  for (int i = 0; i < 20; ++i) {
+    histograms.push_back(Histogram::FactoryGet(
+        StringPrintf("Shared.Full%d", i), 1, 1000, 50, Histogram::kNoFlags));
+  }
+  SharedHistogramAllocator::SetGlobal(NULL);
+  EXPECT_LE(small->used(), SharedHistogramAllocator::kMinimumSize);
+
+  // Every histogram works, whether or not it fit in the segment.
+  for (size_t i = 0; i < histograms.size(); ++i) {
+    histograms[i]->Add(7);
+    Histogram::SampleSet snapshot;
+    histograms[i]->SnapshotSample(&snapshot);
+    EXPECT_EQ(1, snapshot.TotalCount());
+  }
+}
+
+// The reader must survive whatever a compromised child writes.
+TEST_F(SharedHistogramAllocatorTest, IgnoresCorruptRecords) {
+  CreateChildHistograms();
+  exponential_->Add(10);
+
+  // Overwrite every record's description with junk, one word at a time.
+  char* memory = static_cast<char*>(writer_->shared_memory()->memory());
+  std::vector<char> original(memory, memory + writer_->used());
+  for (size_t offset = 16; offset + 4 <= original.size(); offset += 4) {
+    memcpy(memory, &original[0], original.size());
+    uint32 junk = 0xfffffff0;
+    memcpy(memory + offset, &junk, sizeof(junk));
+
+    StatisticsRecorder browser_recorder;
+    reader_->MergeHistogramDeltas();
+  }
+  memcpy(memory, &original[0], original.size());
+}
+
+}  // namespace base
@@ -8,6 +8,14 @@
 
 #if defined(OS_WIN)
 #include <mmsystem.h>  // Declare timeGetTime()... after including build_config.
+#elif defined(OS_LINUX) || defined(OS_ANDROID)
+#include <time.h>
+
+// Older C libraries don't know about the coarse clock, though the kernel
+// (2.6.32 and later) may.
+#ifndef CLOCK_MONOTONIC_COARSE
+#define CLOCK_MONOTONIC_COARSE 6
+#endif
 #endif
 
 namespace tracked_objects {
@@ -63,6 +71,21 @@ TrackedTime TrackedTime::Now() {
 #endif  // OS_WIN
 }
 
+// static
+TrackedTime TrackedTime::NowCoarse() {
+#if defined(OS_LINUX) || defined(OS_ANDROID)
+  // This is the clock behind TimeTicks::Now(), as of the last scheduler tick,
+  // read from the vDSO without taking the clock source's slow path.
+  struct timespec ts;
+  if (clock_gettime(CLOCK_MONOTONIC_COARSE, &ts) == 0) {
+    return TrackedTime(base::TimeTicks::FromInternalValue(
+        static_cast<int64>(ts.tv_sec) * base::Time::kMicrosecondsPerSecond +
+        ts.tv_nsec / base::Time::kNanosecondsPerMicrosecond));
+  }
+#endif
+  return Now();
+}
+
 Duration TrackedTime::operator-(const TrackedTime& other) const {
   return Duration(ms_ - other.ms_);
 }
@@ -52,6 +52,12 @@ class BASE_EXPORT TrackedTime {  // Similar to base::TimeTicks.
   explicit TrackedTime(const base::TimeTicks& time);
 
   static TrackedTime Now();
+
+  // Like Now(), but much cheaper to read on Linux, where it uses
+  // CLOCK_MONOTONIC_COARSE: the same clock, advancing only once per scheduler
+  // tick (1 to 10 ms).  Elsewhere, or on kernels without that clock, it is
+  // just Now().
+  static TrackedTime NowCoarse();
   Duration operator-(const TrackedTime& other) const;
   TrackedTime operator+(const Duration& other) const;
   bool is_null() const;
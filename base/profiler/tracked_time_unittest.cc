@@ -77,7 +77,7 @@ TEST(TrackedTimeTest, TrackedTimerDisabled) {
   EXPECT_TRUE(track_now.is_null());
   track_now = ThreadData::NowForStartOfRun(NULL);
   EXPECT_TRUE(track_now.is_null());
-  track_now = ThreadData::NowForEndOfRun();
+  track_now = ThreadData::NowForEndOfRun(NULL);
   EXPECT_TRUE(track_now.is_null());
 }
 
@@ -107,4 +107,26 @@ TEST(TrackedTimeTest, TrackedTimerEnabled) {
   EXPECT_GE(0, after.InMilliseconds());
 }
 
+TEST(TrackedTimeTest, TrackedTimerCoarse) {
+  base::TimeTicks ticks_before = base::TimeTicks::Now();
+  TrackedTime coarse = TrackedTime::NowCoarse();
+  base::TimeTicks ticks_after = base::TimeTicks::Now();
+
+  // The coarse clock may lag by a scheduler tick, but never runs ahead.
+  EXPECT_GE(0, (coarse - TrackedTime(ticks_after)).InMilliseconds());
+  EXPECT_GE(20, (TrackedTime(ticks_before) - coarse).InMilliseconds());
+}
+
+TEST(TrackedTimeTest, TrackedTimerCoarseEnabled) {
+  if (!ThreadData::InitializeAndSetTrackingStatus(
+      ThreadData::PROFILING_CHILDREN_ACTIVE))
+    return;
+  ThreadData::SetUseCoarseClock(true);
+  base::TimeTicks ticks_after;
+  TrackedTime now = ThreadData::Now();
+  ticks_after = base::TimeTicks::Now();
+  ThreadData::SetUseCoarseClock(false);
+  EXPECT_GE(0, (now - TrackedTime(ticks_after)).InMilliseconds());
+}
+
 }  // namespace tracked_objects
@@ -0,0 +1,132 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/segmented_pickle.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#if defined(OS_POSIX)
+#include <sys/uio.h>
+#endif
+
+#include "base/logging.h"
+
+namespace {
+
+// Pads external blobs out to the alignment Pickle keeps its values at.
+const char kPadding[sizeof(uint32)] = { 0 };
+
+size_t PaddingSize(size_t length) {
+  return (sizeof(uint32) - length % sizeof(uint32)) % sizeof(uint32);
+}
+
+void AddSegment(const char* data,
+                size_t size,
+                std::vector<SegmentedPickle::Segment>* segments) {
+  if (!size)
+    return;
+  SegmentedPickle::Segment segment = { data, size };
+  segments->push_back(segment);
+}
+
+}  // namespace
+
+// static
+const size_t SegmentedPickle::kMinExternalSize = 1024;
+
+SegmentedPickle::SegmentedPickle() {
+}
+
+SegmentedPickle::SegmentedPickle(int header_size) : pickle_(header_size) {
+}
+
+SegmentedPickle::~SegmentedPickle() {
+}
+
+bool SegmentedPickle::WriteExternalData(base::RefCountedMemory* data) {
+  const size_t length = data->size();
+  const char* bytes = reinterpret_cast<const char*>(data->front());
+  if (length > static_cast<size_t>(kint32max))
+    return false;
+  if (length < kMinExternalSize)
+    return pickle_.WriteData(bytes, static_cast<int>(length));
+
+  // The header's payload size has to fit everything.
+  uint64 new_size = static_cast<uint64>(size()) + sizeof(uint32) +
+      sizeof(int) + length;
+  if (new_size > kuint32max)
+    return false;
+
+  if (!pickle_.WriteInt(static_cast<int>(length)))
+    return false;
+  External external;
+  external.offset = pickle_.payload_size();
+  external.data = data;
+  externals_.push_back(external);
+  return true;
+}
+
+size_t SegmentedPickle::size() const {
+  return pickle_.size() - pickle_.payload_size() + payload_size();
+}
+
+void SegmentedPickle::GetSegments(std::vector<Segment>* segments) {
+  segments->clear();
+
+  // Only the header's payload size differs from |pickle_|'s.
+  const size_t header_size = pickle_.size() - pickle_.payload_size();
+  header_.assign(static_cast<const char*>(pickle_.data()), header_size);
+  uint32 payload_size32 = static_cast<uint32>(payload_size());
+  memcpy(&header_[offsetof(Pickle::Header, payload_size)], &payload_size32,
+         sizeof(payload_size32));
+  AddSegment(header_.data(), header_size, segments);
+
+  const char* payload =
+      static_cast<const char*>(pickle_.data()) + header_size;
+  size_t offset = 0;
+  for (size_t i = 0; i < externals_.size(); ++i) {
+    const External& external = externals_[i];
+    AddSegment(payload + offset, external.offset - offset, segments);
+    AddSegment(reinterpret_cast<const char*>(external.data->front()),
+               external.data->size(), segments);
+    // Like Pickle, only pad when something follows.
+    if (external.offset < pickle_.payload_size())
+      AddSegment(kPadding, PaddingSize(external.data->size()), segments);
+    offset = external.offset;
+  }
+  AddSegment(payload + offset, pickle_.payload_size() - offset, segments);
+}
+
+#if defined(OS_POSIX)
+void SegmentedPickle::GetIOVecs(std::vector<struct iovec>* iovecs) {
+  std::vector<Segment> segments;
+  GetSegments(&segments);
+  iovecs->resize(segments.size());
+  for (size_t i = 0; i < segments.size(); ++i) {
+    (*iovecs)[i].iov_base = const_cast<char*>(segments[i].data);
+    (*iovecs)[i].iov_len = segments[i].size;
+  }
+}
+#endif
+
+void SegmentedPickle::Flatten(std::string* output) {
+  std::vector<Segment> segments;
+  GetSegments(&segments);
+  output->clear();
+  output->reserve(size());
+  for (size_t i = 0; i < segments.size(); ++i)
+    output->append(segments[i].data, segments[i].size);
+  DCHECK_EQ(size(), output->size());
+}
+
+size_t SegmentedPickle::payload_size() const {
+  size_t size = pickle_.payload_size();
+  for (size_t i = 0; i < externals_.size(); ++i) {
+    size += externals_[i].data->size();
+    if (externals_[i].offset < pickle_.payload_size())
+      size += PaddingSize(externals_[i].data->size());
+  }
+  return size;
+}
@@ -0,0 +1,103 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BASE_SEGMENTED_PICKLE_H_
+#define BASE_SEGMENTED_PICKLE_H_
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "base/base_export.h"
+#include "base/basictypes.h"
+#include "base/memory/ref_counted.h"
+#include "base/memory/ref_counted_memory.h"
+#include "base/pickle.h"
+#include "build/build_config.h"
+
+#if defined(OS_POSIX)
+struct iovec;
+#endif
+
+// SegmentedPickle builds the same bytes as a Pickle, but without copying
+// large blobs into them.  Small values are written to an ordinary Pickle, and
+// blobs written with WriteExternalData() are referenced where they are, so
+// that the pickle is a list of segments to be sent with writev() or sendmsg():
+//
+//   SegmentedPickle pickle;
+//   pickle.pickle()->WriteInt(kImage);
+//   pickle.WriteExternalData(png_bytes);
+//   std::vector<struct iovec> iovecs;
+//   pickle.GetIOVecs(&iovecs);
+//   writev(fd, &iovecs[0], iovecs.size());
+//
+// Whoever receives the bytes reads them as a Pickle with the usual
+// PickleIterator, reading each external blob with ReadData().
+class BASE_EXPORT SegmentedPickle {
+ public:
+  // A contiguous piece of the pickle.
+  struct Segment {
+    const char* data;
+    size_t size;
+  };
+
+  // Blobs smaller than this are copied into the pickle, since that is cheaper
+  // than gathering another segment.
+  static const size_t kMinExternalSize;
+
+  // Uses a Pickle with the default header size.
+  SegmentedPickle();
+
+  // Uses a Pickle with a |header_size| byte header; see Pickle(int).
+  explicit SegmentedPickle(int header_size);
+
+  ~SegmentedPickle();
+
+  // The Pickle the small values are written to, with its usual Write*()
+  // methods.  Custom header fields are set through it too.  Its own data()
+  // leaves out the external blobs.
+  Pickle* pickle() { return &pickle_; }
+
+  // Appends |data| as if by pickle()->WriteData(), but only keeps a reference
+  // to it rather than copying it, unless it is small.  |data| must not change
+  // while the pickle is in use.
+  bool WriteExternalData(base::RefCountedMemory* data);
+
+  // Returns the size of the pickle's data, which is the size of the
+  // equivalent Pickle's data.
+  size_t size() const;
+
+  // Replaces the contents of |segments| with the segments that make up the
+  // pickle's data, in order.  They point into the pickle and into the
+  // external blobs, and are only valid until the next write.
+  void GetSegments(std::vector<Segment>* segments);
+
+#if defined(OS_POSIX)
+  // Like GetSegments(), but fills in iovecs for writev() and sendmsg().
+  void GetIOVecs(std::vector<struct iovec>* iovecs);
+#endif
+
+  // Copies the pickle's data into |output|, for readers in this process.
+  void Flatten(std::string* output);
+
+ private:
+  // A blob that follows the first |offset| bytes of |pickle_|'s payload.
+  struct External {
+    size_t offset;
+    scoped_refptr<base::RefCountedMemory> data;
+  };
+
+  // Returns the size of the pickle's payload.
+  size_t payload_size() const;
+
+  Pickle pickle_;
+  std::vector<External> externals_;
+
+  // The header handed out by GetSegments(), with the whole payload's size.
+  std::string header_;
+
+  DISALLOW_COPY_AND_ASSIGN(SegmentedPickle);
+};
+
+#endif  // BASE_SEGMENTED_PICKLE_H_
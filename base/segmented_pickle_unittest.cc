@@ -0,0 +1,166 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/segmented_pickle.h"
+
+#include <string>
+#include <vector>
+
+#include "base/memory/ref_counted.h"
+#include "base/memory/ref_counted_memory.h"
+#include "base/pickle.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+#if defined(OS_POSIX)
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// Returns a blob of |size| bytes that don't repeat every word.
+base::RefCountedString* MakeBlob(size_t size) {
+  std::string data;
+  for (size_t i = 0; i < size; ++i)
+    data.push_back(static_cast<char>(i * 7 + i / 256));
+  return base::RefCountedString::TakeString(&data);
+}
+
+const char* BlobData(base::RefCountedMemory* blob) {
+  return reinterpret_cast<const char*>(blob->front());
+}
+
+// Writes the same values to |pickle| and |segmented|, ending with |last|.
+void WriteValues(base::RefCountedMemory* large,
+                 base::RefCountedMemory* small,
+                 base::RefCountedMemory* last,
+                 Pickle* pickle,
+                 SegmentedPickle* segmented) {
+  pickle->WriteInt(1);
+  pickle->WriteString("abc");
+  pickle->WriteData(BlobData(large), static_cast<int>(large->size()));
+  pickle->WriteBool(true);
+  pickle->WriteData(BlobData(small), static_cast<int>(small->size()));
+  pickle->WriteUInt16(7);
+  pickle->WriteData(BlobData(last), static_cast<int>(last->size()));
+
+  segmented->pickle()->WriteInt(1);
+  segmented->pickle()->WriteString("abc");
+  EXPECT_TRUE(segmented->WriteExternalData(large));
+  segmented->pickle()->WriteBool(true);
+  EXPECT_TRUE(segmented->WriteExternalData(small));
+  segmented->pickle()->WriteUInt16(7);
+  EXPECT_TRUE(segmented->WriteExternalData(last));
+}
+
+}  // namespace
+
+TEST(SegmentedPickleTest, SameBytesAsPickle) {
+  // Odd sizes, so that the blobs need padding.
+  scoped_refptr<base::RefCountedMemory> large(MakeBlob(5001));
+  scoped_refptr<base::RefCountedMemory> small(MakeBlob(3));
+  scoped_refptr<base::RefCountedMemory> last(MakeBlob(4099));
+  Pickle pickle;
+  SegmentedPickle segmented;
+  WriteValues(large, small, last, &pickle, &segmented);
+
+  EXPECT_EQ(pickle.size(), segmented.size());
+  std::string flat;
+  segmented.Flatten(&flat);
+  ASSERT_EQ(pickle.size(), flat.size());
+  EXPECT_EQ(0, memcmp(pickle.data(), flat.data(), flat.size()));
+
+  // And it reads back with the usual iterator.
+  Pickle read_pickle(flat.data(), static_cast<int>(flat.size()));
+  PickleIterator iter(read_pickle);
+  int int_value;
+  std::string string_value;
+  const char* data;
+  int length;
+  EXPECT_TRUE(iter.ReadInt(&int_value));
+  EXPECT_EQ(1, int_value);
+  EXPECT_TRUE(iter.ReadString(&string_value));
+  EXPECT_EQ("abc", string_value);
+  EXPECT_TRUE(iter.ReadData(&data, &length));
+  ASSERT_EQ(static_cast<int>(large->size()), length);
+  EXPECT_EQ(0, memcmp(BlobData(large), data, length));
+}
+
+TEST(SegmentedPickleTest, ExternalDataIsNotCopied) {
+  scoped_refptr<base::RefCountedMemory> large(MakeBlob(8192));
+  scoped_refptr<base::RefCountedMemory> small(MakeBlob(10));
+  scoped_refptr<base::RefCountedMemory> last(MakeBlob(2048));
+  Pickle pickle;
+  SegmentedPickle segmented;
+  WriteValues(large, small, last, &pickle, &segmented);
+
+  std::vector<SegmentedPickle::Segment> segments;
+  segmented.GetSegments(&segments);
+  int external_segments = 0;
+  size_t total_size = 0;
+  for (size_t i = 0; i < segments.size(); ++i) {
+    if (segments[i].data == BlobData(large) ||
+        segments[i].data == BlobData(last)) {
+      ++external_segments;
+    }
+    // The small blob was copied.
+    EXPECT_NE(BlobData(small), segments[i].data);
+    total_size += segments[i].size;
+  }
+  EXPECT_EQ(2, external_segments);
+  EXPECT_EQ(pickle.size(), total_size);
+
+  // The inline Pickle only holds the small values.
+  EXPECT_LT(segmented.pickle()->size(), 1024u);
+}
+
+TEST(SegmentedPickleTest, CustomHeader) {
+  struct CustomHeader : Pickle::Header {
+    int32 routing;
+  };
+  scoped_refptr<base::RefCountedMemory> blob(MakeBlob(3000));
+  SegmentedPickle segmented(sizeof(CustomHeader));
+  segmented.pickle()->headerT<CustomHeader>()->routing = 42;
+  EXPECT_TRUE(segmented.WriteExternalData(blob));
+
+  std::string flat;
+  segmented.Flatten(&flat);
+  Pickle read_pickle(flat.data(), static_cast<int>(flat.size()));
+  EXPECT_EQ(42, read_pickle.headerT<CustomHeader>()->routing);
+  PickleIterator iter(read_pickle);
+  const char* data;
+  int length;
+  EXPECT_TRUE(iter.ReadData(&data, &length));
+  EXPECT_EQ(3000, length);
+  EXPECT_FALSE(iter.ReadInt(&length));
+}
+
+#if defined(OS_POSIX)
+TEST(SegmentedPickleTest, GatherWrite) {
+  scoped_refptr<base::RefCountedMemory> large(MakeBlob(5001));
+  scoped_refptr<base::RefCountedMemory> small(MakeBlob(3));
+  scoped_refptr<base::RefCountedMemory> last(MakeBlob(4099));
+  Pickle pickle;
+  SegmentedPickle segmented;
+  WriteValues(large, small, last, &pickle, &segmented);
+
+  int fds[2];
+  ASSERT_EQ(0, pipe(fds));
+  std::vector<struct iovec> iovecs;
+  segmented.GetIOVecs(&iovecs);
+  ssize_t written = writev(fds[1], &iovecs[0], iovecs.size());
+  EXPECT_EQ(static_cast<ssize_t>(pickle.size()), written);
+  close(fds[1]);
+
+  std::string received(pickle.size(), '\0');
+  size_t total = 0;
+  while (total < received.size()) {
+    ssize_t bytes = read(fds[0], &received[total], received.size() - total);
+    ASSERT_GT(bytes, 0);
+    total += bytes;
+  }
+  close(fds[0]);
+  EXPECT_EQ(0, memcmp(pickle.data(), received.data(), received.size()));
+}
+#endif
@@ -30,6 +30,11 @@ class SequencedWorkerPoolOwner : public SequencedWorkerPool::TestingObserver {
   SequencedWorkerPoolOwner(size_t max_threads,
                            const std::string& thread_name_prefix);
 
+  // Like above, but creates the pool with |scheduling_mode|.
+  SequencedWorkerPoolOwner(size_t max_threads,
+                           const std::string& thread_name_prefix,
+                           SequencedWorkerPool::SchedulingMode scheduling_mode);
+
   virtual ~SequencedWorkerPoolOwner();
 
   // Don't change the returned pool's testing observer.
@@ -4,6 +4,7 @@
 
 #include "base/threading/sequenced_worker_pool.h"
 
+#include <deque>
 #include <list>
 #include <map>
 #include <set>
@@ -15,6 +16,7 @@
 #include "base/compiler_specific.h"
 #include "base/logging.h"
 #include "base/memory/linked_ptr.h"
+#include "base/memory/scoped_vector.h"
 #include "base/message_loop_proxy.h"
 #include "base/metrics/histogram.h"
 #include "base/stl_util.h"
@@ -23,6 +25,7 @@
 #include "base/synchronization/lock.h"
 #include "base/threading/platform_thread.h"
 #include "base/threading/simple_thread.h"
+#include "base/threading/thread_local.h"
 #include "base/threading/thread_restrictions.h"
 #include "base/time.h"
 #include "base/tracked_objects.h"
@@ -259,6 +262,250 @@ bool SequencedWorkerPoolSequencedTaskRunner::PostDelayedTaskAssertZeroDelay(
                                         delay.InMillisecondsRoundedUp());
 }
 
+// WorkStealingQueue ---------------------------------------------------------
+// The pending-task store used by SCHEDULING_WORK_STEALING.
+//
+// Every worker owns one deque, guarded by its own lock. Workers take from the
+// front of their own deque and steal from the back of the others, so the only
+// contention is between a worker and an occasional thief.
+//
+// Unsequenced tasks go straight into a deque. Tasks with a sequence token wait
+// in a per-sequence FIFO instead, and the sequence is represented in the deques
+// by a single marker entry (a SequencedTask carrying only the token) whenever
+// it has pending tasks and none of them is running. Taking a marker claims the
+// sequence; DidRun() re-queues the marker on the finishing worker's deque if
+// more tasks remain. Blocked tasks are therefore never scanned, and a sequence
+// tends to stay on the thread that ran its previous task.
+class WorkStealingQueue {
+ public:
+  explicit WorkStealingQueue(size_t num_deques);
+  ~WorkStealingQueue();
+
+  // Associates the calling worker thread with deque |deque_index|, so that
+  // tasks it posts land on its own deque.
+  void BindCurrentThread(size_t deque_index);
+
+  // Queues |task|.
+  void Push(const SequencedTask& task);
+
+  // Finds the next runnable task for the worker owning |deque_index|,
+  // stealing from other deques if its own is empty. When |shutting_down| is
+  // set, runnable tasks that don't block shutdown are moved to |discarded|
+  // rather than returned. Returns false if nothing runnable was found.
+  bool Take(size_t deque_index,
+            bool shutting_down,
+            SequencedTask* task,
+            std::vector<SequencedTask>* discarded);
+
+  // Must be called once a task returned by Take() has run. Releases the
+  // task's sequence, re-queueing it on |deque_index| if it has more tasks.
+  void DidRun(size_t deque_index, const SequencedTask& task);
+
+  // Returns whether any deque holds an entry. Only a hint when other threads
+  // are pushing or taking concurrently.
+  bool HasRunnableWork() const;
+
+ private:
+  class Deque {
+   public:
+    Deque() {}
+
+    void PushBack(const SequencedTask& task) {
+      AutoLock lock(lock_);
+      tasks_.push_back(task);
+    }
+
+    bool PopFront(SequencedTask* task) {
+      AutoLock lock(lock_);
+      if (tasks_.empty())
+        return false;
+      *task = tasks_.front();
+      tasks_.pop_front();
+      return true;
+    }
+
+    bool PopBack(SequencedTask* task) {
+      AutoLock lock(lock_);
+      if (tasks_.empty())
+        return false;
+      *task = tasks_.back();
+      tasks_.pop_back();
+      return true;
+    }
+
+   private:
+    Lock lock_;
+    std::deque<SequencedTask> tasks_;
+
+    DISALLOW_COPY_AND_ASSIGN(Deque);
+  };
+
+  // Pushes a deque entry, preferring the calling worker's own deque.
+  void PushEntry(const SequencedTask& entry, Deque* preferred);
+
+  // Pops the next task of the sequence claimed by taking its marker. Returns
+  // false, and releases the sequence, if it has no task left to run.
+  bool ClaimSequence(int sequence_token_id,
+                     bool shutting_down,
+                     SequencedTask* task,
+                     std::vector<SequencedTask>* discarded);
+
+  ScopedVector<Deque> deques_;
+
+  // Deque of the current thread, if it is one of our workers.
+  ThreadLocalPointer<Deque> current_deque_;
+
+  // Spreads posts from non-worker threads across the deques.
+  volatile subtle::Atomic32 next_deque_;
+
+  // Number of entries (tasks and markers) currently in the deques.
+  volatile subtle::Atomic32 deque_entry_count_;
+
+  // Pending tasks of every sequence that has a marker queued or a task
+  // running. A sequence has an entry here exactly as long as it has one of
+  // those.
+  Lock sequences_lock_;
+  std::map<int, std::deque<SequencedTask> > sequences_;
+
+  DISALLOW_COPY_AND_ASSIGN(WorkStealingQueue);
+};
+
+WorkStealingQueue::WorkStealingQueue(size_t num_deques)
+    : next_deque_(0),
+      deque_entry_count_(0) {
+  DCHECK_GT(num_deques, 0u);
+  for (size_t i = 0; i < num_deques; ++i)
+    deques_.push_back(new Deque);
+}
+
+WorkStealingQueue::~WorkStealingQueue() {
+}
+
+void WorkStealingQueue::BindCurrentThread(size_t deque_index) {
+  DCHECK_LT(deque_index, deques_.size());
+  current_deque_.Set(deques_[deque_index]);
+}
+
+void WorkStealingQueue::Push(const SequencedTask& task) {
+  Deque* preferred = current_deque_.Get();
+  if (!task.sequence_token_id) {
+    PushEntry(task, preferred);
+    return;
+  }
+
+  {
+    AutoLock lock(sequences_lock_);
+    std::map<int, std::deque<SequencedTask> >::iterator found =
+        sequences_.find(task.sequence_token_id);
+    if (found != sequences_.end()) {
+      // The sequence is already queued or running; whoever holds it will
+      // get to this task in order.
+      found->second.push_back(task);
+      return;
+    }
+    sequences_[task.sequence_token_id].push_back(task);
+  }
+
+  SequencedTask marker;
+  marker.sequence_token_id = task.sequence_token_id;
+  PushEntry(marker, preferred);
+}
+
+bool WorkStealingQueue::Take(size_t deque_index,
+                             bool shutting_down,
+                             SequencedTask* task,
+                             std::vector<SequencedTask>* discarded) {
+  DCHECK_LT(deque_index, deques_.size());
+  const size_t num_deques = deques_.size();
+  for (size_t i = 0; i < num_deques; ++i) {
+    Deque* deque = deques_[(deque_index + i) % num_deques];
+    SequencedTask entry;
+    // Take the oldest entry from our own deque, but steal the newest from
+    // other workers so that we don't fight their owner for the same end.
+    while (i == 0 ? deque->PopFront(&entry) : deque->PopBack(&entry)) {
+      subtle::Barrier_AtomicIncrement(&deque_entry_count_, -1);
+      if (entry.sequence_token_id) {
+        if (ClaimSequence(entry.sequence_token_id, shutting_down, task,
+                          discarded)) {
+          return true;
+        }
+        continue;
+      }
+      if (shutting_down &&
+          entry.shutdown_behavior != SequencedWorkerPool::BLOCK_SHUTDOWN) {
+        discarded->push_back(entry);
+        continue;
+      }
+      *task = entry;
+      return true;
+    }
+  }
+  return false;
+}
+
+void WorkStealingQueue::DidRun(size_t deque_index, const SequencedTask& task) {
+  if (!task.sequence_token_id)
+    return;
+
+  {
+    AutoLock lock(sequences_lock_);
+    std::map<int, std::deque<SequencedTask> >::iterator found =
+        sequences_.find(task.sequence_token_id);
+    DCHECK(found != sequences_.end());
+    if (found->second.empty()) {
+      sequences_.erase(found);
+      return;
+    }
+  }
+
+  SequencedTask marker;
+  marker.sequence_token_id = task.sequence_token_id;
+  PushEntry(marker, deques_[deque_index]);
+}
+
+bool WorkStealingQueue::HasRunnableWork() const {
+  return subtle::Acquire_Load(&deque_entry_count_) > 0;
+}
+
+void WorkStealingQueue::PushEntry(const SequencedTask& entry,
+                                  Deque* preferred) {
+  Deque* deque = preferred;
+  if (!deque) {
+    subtle::Atomic32 next = subtle::NoBarrier_AtomicIncrement(&next_deque_, 1);
+    deque = deques_[static_cast<uint32>(next) % deques_.size()];
+  }
+  deque->PushBack(entry);
+  // Full barrier: pairs with the waiting-thread check in the pool, see
+  // SequencedWorkerPool::Inner::WakeWorkerIfWaiting().
+  subtle::Barrier_AtomicIncrement(&deque_entry_count_, 1);
+}
+
+bool WorkStealingQueue::ClaimSequence(int sequence_token_id,
+                                      bool shutting_down,
+                                      SequencedTask* task,
+                                      std::vector<SequencedTask>* discarded) {
+  AutoLock lock(sequences_lock_);
+  std::map<int, std::deque<SequencedTask> >::iterator found =
+      sequences_.find(sequence_token_id);
+  DCHECK(found != sequences_.end());
+  std::deque<SequencedTask>& pending = found->second;
+  while (!pending.empty()) {
+    SequencedTask next = pending.front();
+    pending.pop_front();
+    // The previous task of this sequence has completed, so discarding the
+    // next one can't pull anything out from under a running task.
+    if (shutting_down &&
+        next.shutdown_behavior != SequencedWorkerPool::BLOCK_SHUTDOWN) {
+      discarded->push_back(next);
+      continue;
+    }
+    *task = next;
+    return true;
+  }
+  sequences_.erase(found);
+  return false;
+}
+
 }  // namespace
 
 // Worker ---------------------------------------------------------------------
@@ -283,8 +530,11 @@ class SequencedWorkerPool::Worker : public SimpleThread {
     return running_sequence_;
   }
 
+  int thread_number() const { return thread_number_; }
+
  private:
   scoped_refptr<SequencedWorkerPool> worker_pool_;
+  const int thread_number_;
   SequenceToken running_sequence_;
 
   DISALLOW_COPY_AND_ASSIGN(Worker);
@@ -298,6 +548,7 @@ class SequencedWorkerPool::Inner {
   // by it).
   Inner(SequencedWorkerPool* worker_pool, size_t max_threads,
         const std::string& thread_name_prefix,
+        SchedulingMode scheduling_mode,
         TestingObserver* observer);
 
   ~Inner();
@@ -335,6 +586,35 @@ class SequencedWorkerPool::Inner {
   // are idle.  Must be called under lock.
   bool IsIdle() const;
 
+  // Returns whether Shutdown() has been called. Safe to call without the
+  // lock.
+  bool IsShutdownCalled() const;
+
+  // Adds |this_worker| to |threads_| once its thread has started. Must be
+  // called under lock.
+  void RegisterWorker(Worker* this_worker);
+
+  // Runs the given task on |this_worker|'s thread, outside the lock.
+  void RunTask(Worker* this_worker, SequencedTask* task);
+
+  // SCHEDULING_WORK_STEALING counterparts of PostTask() and ThreadLoop(). The
+  // lock is only taken to create threads, to put workers to sleep or wake
+  // them up, and around shutdown.
+  bool PostTaskWorkStealing(const SequencedTask& task);
+  void ThreadLoopWorkStealing(Worker* this_worker);
+
+  // Wakes up a sleeping worker, if there is one, after work has been queued.
+  // Takes the lock only when somebody is actually waiting.
+  void WakeWorkerIfWaiting();
+
+  // Starts another worker if one would be useful. Cheap to call when all the
+  // threads already exist.
+  void StartAdditionalThreadIfHelpful();
+
+  // Called after a BLOCK_SHUTDOWN task leaves the work-stealing queue or
+  // finishes running; wakes up Shutdown() if it may now be able to return.
+  void NotifyShutdownProgress();
+
   // Called from within the lock, this converts the given token name into a
   // token ID, creating a new one if necessary.
   int LockedGetNamedTokenID(const std::string& name);
@@ -425,8 +705,9 @@ class SequencedWorkerPool::Inner {
   // See PrepareToStartAdditionalThreadIfHelpful for more.
   bool thread_being_created_;
 
-  // Number of threads currently waiting for work.
-  size_t waiting_thread_count_;
+  // Number of threads currently waiting for work. Only modified under the
+  // lock, but read without it in SCHEDULING_WORK_STEALING mode.
+  volatile subtle::Atomic32 waiting_thread_count_;
 
   // Number of threads currently running tasks that have the BLOCK_SHUTDOWN
   // flag set.
@@ -448,8 +729,22 @@ class SequencedWorkerPool::Inner {
   std::set<int> current_sequences_;
 
   // Set when Shutdown is called and no further tasks should be
-  // allowed, though we may still be running existing tasks.
-  bool shutdown_called_;
+  // allowed, though we may still be running existing tasks. Only modified
+  // under the lock; see IsShutdownCalled().
+  volatile subtle::Atomic32 shutdown_called_;
+
+  // Non-NULL in SCHEDULING_WORK_STEALING mode, in which case it holds all
+  // pending tasks instead of |pending_tasks_|, and the following counters
+  // replace |pending_task_count_|, |blocking_shutdown_pending_task_count_|
+  // and |blocking_shutdown_thread_count_| so they can be updated without the
+  // lock.
+  scoped_ptr<WorkStealingQueue> work_stealing_queue_;
+  volatile subtle::Atomic32 queued_task_count_;
+  volatile subtle::Atomic32 blocking_shutdown_queued_task_count_;
+  volatile subtle::Atomic32 blocking_shutdown_running_task_count_;
+
+  // Number of entries in |threads_|, readable without the lock.
+  volatile subtle::Atomic32 thread_count_;
 
   TestingObserver* const testing_observer_;
 
@@ -464,7 +759,8 @@ SequencedWorkerPool::Worker::Worker(
     const std::string& prefix)
     : SimpleThread(
           prefix + StringPrintf("Worker%d", thread_number).c_str()),
-      worker_pool_(worker_pool) {
+      worker_pool_(worker_pool),
+      thread_number_(thread_number) {
   Start();
 }
 
@@ -488,6 +784,7 @@ SequencedWorkerPool::Inner::Inner(
     SequencedWorkerPool* worker_pool,
     size_t max_threads,
     const std::string& thread_name_prefix,
+    SchedulingMode scheduling_mode,
     TestingObserver* observer)
     : worker_pool_(worker_pool),
       last_sequence_number_(0),
@@ -502,12 +799,19 @@ SequencedWorkerPool::Inner::Inner(
       blocking_shutdown_thread_count_(0),
       pending_task_count_(0),
       blocking_shutdown_pending_task_count_(0),
-      shutdown_called_(false),
-      testing_observer_(observer) {}
+      shutdown_called_(0),
+      queued_task_count_(0),
+      blocking_shutdown_queued_task_count_(0),
+      blocking_shutdown_running_task_count_(0),
+      thread_count_(0),
+      testing_observer_(observer) {
+  if (scheduling_mode == SCHEDULING_WORK_STEALING)
+    work_stealing_queue_.reset(new WorkStealingQueue(max_threads));
+}
 
 SequencedWorkerPool::Inner::~Inner() {
   // You must call Shutdown() before destroying the pool.
-  DCHECK(shutdown_called_);
+  DCHECK(IsShutdownCalled());
 
   // Need to explicitly join with the threads before they're destroyed or else
   // they will be running when our object is half torn down.
@@ -544,10 +848,18 @@ bool SequencedWorkerPool::Inner::PostTask(
   sequenced.location = from_here;
   sequenced.task = task;
 
+  if (work_stealing_queue_.get()) {
+    if (optional_token_name) {
+      AutoLock lock(lock_);
+      sequenced.sequence_token_id = LockedGetNamedTokenID(*optional_token_name);
+    }
+    return PostTaskWorkStealing(sequenced);
+  }
+
   int create_thread_id = 0;
   {
     AutoLock lock(lock_);
-    if (shutdown_called_)
+    if (IsShutdownCalled())
       return false;
 
     // Now that we have the lock, apply the named token rules.
@@ -604,9 +916,12 @@ void SequencedWorkerPool::Inner::Shutdown() {
   {
     AutoLock lock(lock_);
 
-    if (shutdown_called_)
+    if (IsShutdownCalled())
       return;
-    shutdown_called_ = true;
+    // Full barrier: a poster in PostTaskWorkStealing() either sees the flag
+    // or has already counted its task where CanShutdown() will see it.
+    subtle::NoBarrier_Store(&shutdown_called_, 1);
+    subtle::MemoryBarrier();
 
     // Tickle the threads. This will wake up a waiting one so it will know that
     // it can exit, which in turn will wake up any other waiting ones.
@@ -636,14 +951,14 @@ void SequencedWorkerPool::Inner::Shutdown() {
 }
 
 void SequencedWorkerPool::Inner::ThreadLoop(Worker* this_worker) {
+  if (work_stealing_queue_.get()) {
+    ThreadLoopWorkStealing(this_worker);
+    return;
+  }
+
   {
     AutoLock lock(lock_);
-    DCHECK(thread_being_created_);
-    thread_being_created_ = false;
-    std::pair<ThreadMap::iterator, bool> result =
-        threads_.insert(
-            std::make_pair(this_worker->tid(), make_linked_ptr(this_worker)));
-    DCHECK(result.second);
+    RegisterWorker(this_worker);
 
     while (true) {
 #if defined(OS_MACOSX)
@@ -668,16 +983,7 @@ void SequencedWorkerPool::Inner::ThreadLoop(Worker* this_worker) {
           if (new_thread_id)
             FinishStartingAdditionalThread(new_thread_id);
 
-          this_worker->set_running_sequence(
-              SequenceToken(task.sequence_token_id));
-
-          task.task.Run();
-
-          this_worker->set_running_sequence(SequenceToken());
-
-          // Make sure our task is erased outside the lock for the same reason
-          // we do this with delete_these_oustide_lock.
-          task.task = Closure();
+          RunTask(this_worker, &task);
         }
         DidRunWorkerTask(task);  // Must be done inside the lock.
       } else {
@@ -686,14 +992,14 @@ void SequencedWorkerPool::Inner::ThreadLoop(Worker* this_worker) {
         // shutdown_called_ is set. There may be some tasks stuck
         // behind running ones with the same sequence token, but
         // additional threads won't help this case.
-        if (shutdown_called_)
+        if (IsShutdownCalled())
           break;
-        waiting_thread_count_++;
+        subtle::NoBarrier_AtomicIncrement(&waiting_thread_count_, 1);
         // This is the only time that IsIdle() can go to true.
         if (IsIdle())
           is_idle_cv_.Signal();
         has_work_cv_.Wait();
-        waiting_thread_count_--;
+        subtle::NoBarrier_AtomicIncrement(&waiting_thread_count_, -1);
       }
     }
   }  // Release lock_.
@@ -706,9 +1012,182 @@ void SequencedWorkerPool::Inner::ThreadLoop(Worker* this_worker) {
   can_shutdown_cv_.Signal();
 }
 
+bool SequencedWorkerPool::Inner::PostTaskWorkStealing(
+    const SequencedTask& task) {
+  const bool blocks_shutdown = task.shutdown_behavior == BLOCK_SHUTDOWN;
+
+  // Count the task before looking at the shutdown flag. Together with the
+  // barrier in Shutdown(), this guarantees that either we see the flag, or
+  // CanShutdown() sees this task and waits for it to run.
+  subtle::Barrier_AtomicIncrement(&queued_task_count_, 1);
+  if (blocks_shutdown)
+    subtle::Barrier_AtomicIncrement(&blocking_shutdown_queued_task_count_, 1);
+  if (IsShutdownCalled()) {
+    subtle::Barrier_AtomicIncrement(&queued_task_count_, -1);
+    if (blocks_shutdown) {
+      subtle::Barrier_AtomicIncrement(&blocking_shutdown_queued_task_count_,
+                                      -1);
+      NotifyShutdownProgress();
+    }
+    return false;
+  }
+
+  work_stealing_queue_->Push(task);
+  StartAdditionalThreadIfHelpful();
+  WakeWorkerIfWaiting();
+  return true;
+}
+
+void SequencedWorkerPool::Inner::ThreadLoopWorkStealing(Worker* this_worker) {
+  const size_t deque_index = this_worker->thread_number() - 1;
+  work_stealing_queue_->BindCurrentThread(deque_index);
+  {
+    AutoLock lock(lock_);
+    RegisterWorker(this_worker);
+  }
+
+  while (true) {
+#if defined(OS_MACOSX)
+    base::mac::ScopedNSAutoreleasePool autorelease_pool;
+#endif
+
+    SequencedTask task;
+    std::vector<SequencedTask> discarded;
+    bool found_task = work_stealing_queue_->Take(
+        deque_index, IsShutdownCalled(), &task, &discarded);
+    if (!discarded.empty()) {
+      // None of these block shutdown. Their closures are destroyed here,
+      // outside of any lock, for the same reason as in GetWork().
+      subtle::Barrier_AtomicIncrement(
+          &queued_task_count_, -static_cast<subtle::Atomic32>(discarded.size()));
+      discarded.clear();
+    }
+
+    if (found_task) {
+      if (task.shutdown_behavior == BLOCK_SHUTDOWN) {
+        subtle::Barrier_AtomicIncrement(&blocking_shutdown_running_task_count_,
+                                        1);
+        subtle::Barrier_AtomicIncrement(&blocking_shutdown_queued_task_count_,
+                                        -1);
+      }
+      subtle::Barrier_AtomicIncrement(&queued_task_count_, -1);
+
+      // As in WillRunWorkerTask(), make sure the rest of the queue has a
+      // thread to run on before starting a possibly long task.
+      StartAdditionalThreadIfHelpful();
+
+      RunTask(this_worker, &task);
+      work_stealing_queue_->DidRun(deque_index, task);
+
+      if (task.shutdown_behavior == BLOCK_SHUTDOWN) {
+        subtle::Barrier_AtomicIncrement(&blocking_shutdown_running_task_count_,
+                                        -1);
+        NotifyShutdownProgress();
+      }
+      continue;
+    }
+
+    AutoLock lock(lock_);
+    // Unlike ThreadLoop(), don't leave while BLOCK_SHUTDOWN tasks are still
+    // queued: one may have been counted just before Shutdown() and pushed
+    // after our Take(), and it needs a thread to run on.
+    if (IsShutdownCalled() && CanShutdown())
+      break;
+    subtle::Barrier_AtomicIncrement(&waiting_thread_count_, 1);
+    // This is the only time that IsIdle() can go to true.
+    if (IsIdle())
+      is_idle_cv_.Signal();
+    // Re-check after announcing ourselves as waiting; see
+    // WakeWorkerIfWaiting().
+    if (!work_stealing_queue_->HasRunnableWork())
+      has_work_cv_.Wait();
+    subtle::Barrier_AtomicIncrement(&waiting_thread_count_, -1);
+  }
+
+  // Wake up the next worker so it knows it should exit as well.
+  SignalHasWork();
+
+  // Possibly unblock shutdown.
+  can_shutdown_cv_.Signal();
+}
+
+void SequencedWorkerPool::Inner::WakeWorkerIfWaiting() {
+  // The work has already been published with a full barrier (see
+  // WorkStealingQueue::PushEntry()), and waiting workers re-check the queue
+  // after incrementing the count, so either we see the waiter here or it sees
+  // the work. Taking the lock guarantees the waiter is inside Wait().
+  if (subtle::Acquire_Load(&waiting_thread_count_) != 0) {
+    AutoLock lock(lock_);
+    has_work_cv_.Signal();
+  }
+  // As in the default mode, the observer hears about every post, whether or
+  // not a worker was waiting for it.
+  if (testing_observer_)
+    testing_observer_->OnHasWork();
+}
+
+void SequencedWorkerPool::Inner::StartAdditionalThreadIfHelpful() {
+  if (static_cast<size_t>(subtle::Acquire_Load(&thread_count_)) >=
+      max_threads_) {
+    return;
+  }
+  int create_thread_id = 0;
+  {
+    AutoLock lock(lock_);
+    create_thread_id = PrepareToStartAdditionalThreadIfHelpful();
+  }
+  if (create_thread_id)
+    FinishStartingAdditionalThread(create_thread_id);
+}
+
+void SequencedWorkerPool::Inner::NotifyShutdownProgress() {
+  if (!IsShutdownCalled())
+    return;
+  AutoLock lock(lock_);
+  if (CanShutdown())
+    can_shutdown_cv_.Signal();
+  // Workers that went to sleep because BLOCK_SHUTDOWN tasks were still queued
+  // need to re-evaluate whether they can exit.
+  SignalHasWork();
+}
+
 bool SequencedWorkerPool::Inner::IsIdle() const {
   lock_.AssertAcquired();
-  return pending_task_count_ == 0 && waiting_thread_count_ == threads_.size();
+  size_t pending_task_count = work_stealing_queue_.get() ?
+      static_cast<size_t>(subtle::Acquire_Load(&queued_task_count_)) :
+      pending_task_count_;
+  return pending_task_count == 0 &&
+      static_cast<size_t>(subtle::NoBarrier_Load(&waiting_thread_count_)) ==
+          threads_.size();
+}
+
+bool SequencedWorkerPool::Inner::IsShutdownCalled() const {
+  return subtle::Acquire_Load(&shutdown_called_) != 0;
+}
+
+void SequencedWorkerPool::Inner::RegisterWorker(Worker* this_worker) {
+  lock_.AssertAcquired();
+  DCHECK(thread_being_created_);
+  thread_being_created_ = false;
+  std::pair<ThreadMap::iterator, bool> result =
+      threads_.insert(
+          std::make_pair(this_worker->tid(), make_linked_ptr(this_worker)));
+  DCHECK(result.second);
+  subtle::NoBarrier_Store(&thread_count_,
+                          static_cast<subtle::Atomic32>(threads_.size()));
+}
+
+void SequencedWorkerPool::Inner::RunTask(Worker* this_worker,
+                                         SequencedTask* task) {
+  this_worker->set_running_sequence(SequenceToken(task->sequence_token_id));
+
+  task->task.Run();
+
+  this_worker->set_running_sequence(SequenceToken());
+
+  // Make sure our task is erased outside the lock for the same reason
+  // we do this with delete_these_oustide_lock.
+  task->task = Closure();
 }
 
 int SequencedWorkerPool::Inner::LockedGetNamedTokenID(
@@ -768,7 +1247,7 @@ bool SequencedWorkerPool::Inner::GetWork(
       continue;
     }
 
-    if (shutdown_called_ && i->shutdown_behavior != BLOCK_SHUTDOWN) {
+    if (IsShutdownCalled() && i->shutdown_behavior != BLOCK_SHUTDOWN) {
       // We're shutting down and the task we just found isn't blocking
       // shutdown. Delete it and get more work.
       //
@@ -888,11 +1367,25 @@ int SequencedWorkerPool::Inner::PrepareToStartAdditionalThreadIfHelpful() {
   // given the workload, but in reality fewer may be created because the
   // sequence of thread creation on the background threads is racing with the
   // shutdown call.
-  if (!shutdown_called_ &&
+  //
+  // In SCHEDULING_WORK_STEALING mode a BLOCK_SHUTDOWN task can be counted
+  // just before shutdown starts and queued just after, so if no worker has
+  // ever been started we still start one to run it. Since Shutdown() waits
+  // for |thread_being_created_| to clear, that thread is not leaked.
+  bool shutdown_blocks_creation = IsShutdownCalled();
+  if (work_stealing_queue_.get() && threads_.empty())
+    shutdown_blocks_creation = false;
+  if (!shutdown_blocks_creation &&
       !thread_being_created_ &&
       threads_.size() < max_threads_ &&
-      waiting_thread_count_ == 0) {
+      subtle::NoBarrier_Load(&waiting_thread_count_) == 0) {
     // We could use an additional thread if there's work to be done.
+    if (work_stealing_queue_.get()) {
+      if (!work_stealing_queue_->HasRunnableWork())
+        return 0;
+      thread_being_created_ = true;
+      return static_cast<int>(threads_.size() + 1);
+    }
     for (std::list<SequencedTask>::iterator i = pending_tasks_.begin();
          i != pending_tasks_.end(); ++i) {
       if (IsSequenceTokenRunnable(i->sequence_token_id)) {
@@ -925,6 +1418,11 @@ void SequencedWorkerPool::Inner::SignalHasWork() {
 bool SequencedWorkerPool::Inner::CanShutdown() const {
   lock_.AssertAcquired();
   // See PrepareToStartAdditionalThreadIfHelpful for how thread creation works.
+  if (work_stealing_queue_.get()) {
+    return !thread_being_created_ &&
+           subtle::Acquire_Load(&blocking_shutdown_running_task_count_) == 0 &&
+           subtle::Acquire_Load(&blocking_shutdown_queued_task_count_) == 0;
+  }
   return !thread_being_created_ &&
          blocking_shutdown_thread_count_ == 0 &&
          blocking_shutdown_pending_task_count_ == 0;
@@ -937,16 +1435,39 @@ SequencedWorkerPool::SequencedWorkerPool(
     const std::string& thread_name_prefix)
     : constructor_message_loop_(MessageLoopProxy::current()),
       inner_(new Inner(ALLOW_THIS_IN_INITIALIZER_LIST(this),
-                       max_threads, thread_name_prefix, NULL)) {
+                       max_threads, thread_name_prefix,
+                       SCHEDULING_GLOBAL_QUEUE, NULL)) {
+}
+
+SequencedWorkerPool::SequencedWorkerPool(
+    size_t max_threads,
+    const std::string& thread_name_prefix,
+    TestingObserver* observer)
+    : constructor_message_loop_(MessageLoopProxy::current()),
+      inner_(new Inner(ALLOW_THIS_IN_INITIALIZER_LIST(this),
+                       max_threads, thread_name_prefix,
+                       SCHEDULING_GLOBAL_QUEUE, observer)) {
+}
+
+SequencedWorkerPool::SequencedWorkerPool(
+    size_t max_threads,
+    const std::string& thread_name_prefix,
+    SchedulingMode scheduling_mode)
+    : constructor_message_loop_(MessageLoopProxy::current()),
+      inner_(new Inner(ALLOW_THIS_IN_INITIALIZER_LIST(this),
+                       max_threads, thread_name_prefix,
+                       scheduling_mode, NULL)) {
 }
 
 SequencedWorkerPool::SequencedWorkerPool(
     size_t max_threads,
     const std::string& thread_name_prefix,
+    SchedulingMode scheduling_mode,
     TestingObserver* observer)
     : constructor_message_loop_(MessageLoopProxy::current()),
       inner_(new Inner(ALLOW_THIS_IN_INITIALIZER_LIST(this),
-                       max_threads, thread_name_prefix, observer)) {
+                       max_threads, thread_name_prefix,
+                       scheduling_mode, observer)) {
 }
 
 SequencedWorkerPool::~SequencedWorkerPool() {}
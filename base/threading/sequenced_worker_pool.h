@@ -101,6 +101,20 @@ class BASE_EXPORT SequencedWorkerPool : public TaskRunner {
     BLOCK_SHUTDOWN,
   };
 
+  // Defines how pending tasks are handed out to the worker threads.
+  enum SchedulingMode {
+    // All workers take tasks from a single pending list guarded by one lock.
+    // This is the default.
+    SCHEDULING_GLOBAL_QUEUE,
+
+    // Each worker owns a deque of tasks, and idle workers steal from the
+    // others. Tasks of a sequence wait in a per-sequence queue and only the
+    // next runnable one is exposed to the workers, so sequence ordering and
+    // the shutdown behaviors are the same as in SCHEDULING_GLOBAL_QUEUE, but
+    // posting and running unrelated tasks no longer serialize on one lock.
+    SCHEDULING_WORK_STEALING,
+  };
+
   // Opaque identifier that defines sequencing of tasks posted to the worker
   // pool.
   class SequenceToken {
@@ -144,6 +158,19 @@ class BASE_EXPORT SequencedWorkerPool : public TaskRunner {
                       const std::string& thread_name_prefix,
                       TestingObserver* observer);
 
+  // Like the first constructor, but lets the caller opt into a non-default
+  // |scheduling_mode|.
+  SequencedWorkerPool(size_t max_threads,
+                      const std::string& thread_name_prefix,
+                      SchedulingMode scheduling_mode);
+
+  // Like above, but with |observer| for testing.  Does not take
+  // ownership of |observer|.
+  SequencedWorkerPool(size_t max_threads,
+                      const std::string& thread_name_prefix,
+                      SchedulingMode scheduling_mode,
+                      TestingObserver* observer);
+
   // Returns a unique token that can be used to sequence tasks posted to
   // PostSequencedWorkerTask(). Valid tokens are alwys nonzero.
   SequenceToken GetSequenceToken();
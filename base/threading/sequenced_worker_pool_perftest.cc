@@ -0,0 +1,138 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/bind.h"
+#include "base/memory/ref_counted.h"
+#include "base/memory/scoped_vector.h"
+#include "base/message_loop.h"
+#include "base/perftimer.h"
+#include "base/stringprintf.h"
+#include "base/sys_info.h"
+#include "base/test/sequenced_worker_pool_owner.h"
+#include "base/threading/sequenced_worker_pool.h"
+#include "base/threading/simple_thread.h"
+#include "base/time.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace base {
+
+namespace {
+
+const int kTasksPerPoster = 20000;
+
+// Records, for each task, how long it waited between being posted and
+// starting to run.
+class LatencyRecorder : public RefCountedThreadSafe<LatencyRecorder> {
+ public:
+  explicit LatencyRecorder(size_t num_tasks) : latencies_(num_tasks) {}
+
+  // Each task owns its own slot, so no locking is needed.
+  void Record(size_t slot, TimeTicks posted) {
+    latencies_[slot] = TimeTicks::Now() - posted;
+  }
+
+  TimeDelta Percentile(double fraction) {
+    std::vector<TimeDelta> sorted(latencies_);
+    std::sort(sorted.begin(), sorted.end());
+    size_t index = static_cast<size_t>(fraction * (sorted.size() - 1));
+    return sorted[index];
+  }
+
+ private:
+  friend class RefCountedThreadSafe<LatencyRecorder>;
+  ~LatencyRecorder() {}
+
+  std::vector<TimeDelta> latencies_;
+};
+
+// Posts |kTasksPerPoster| tasks, spread over a handful of sequences plus
+// unsequenced work, to a pool.
+class Poster : public DelegateSimpleThread::Delegate {
+ public:
+  Poster(SequencedWorkerPool* pool, LatencyRecorder* recorder, size_t first)
+      : pool_(pool), recorder_(recorder), first_(first) {
+    for (int i = 0; i < 4; ++i)
+      tokens_.push_back(pool_->GetSequenceToken());
+  }
+
+  virtual void Run() OVERRIDE {
+    for (int i = 0; i < kTasksPerPoster; ++i) {
+      Closure task = Bind(&LatencyRecorder::Record, recorder_,
+                          first_ + i, TimeTicks::Now());
+      // One task in four is sequenced, as in typical browser use.
+      if (i % 4 == 0) {
+        pool_->PostSequencedWorkerTask(tokens_[(i / 4) % tokens_.size()],
+                                       FROM_HERE, task);
+      } else {
+        pool_->PostWorkerTask(FROM_HERE, task);
+      }
+    }
+  }
+
+ private:
+  SequencedWorkerPool* pool_;
+  scoped_refptr<LatencyRecorder> recorder_;
+  size_t first_;
+  std::vector<SequencedWorkerPool::SequenceToken> tokens_;
+};
+
+void RunPoolBenchmark(SequencedWorkerPool::SchedulingMode mode,
+                      const char* mode_name,
+                      int num_posters) {
+  MessageLoop message_loop;
+  const size_t num_workers = SysInfo::NumberOfProcessors();
+  SequencedWorkerPoolOwner owner(num_workers, "perftest", mode);
+
+  const size_t num_tasks = num_posters * kTasksPerPoster;
+  scoped_refptr<LatencyRecorder> recorder(new LatencyRecorder(num_tasks));
+
+  ScopedVector<Poster> posters;
+  ScopedVector<DelegateSimpleThread> threads;
+  for (int i = 0; i < num_posters; ++i) {
+    posters.push_back(new Poster(owner.pool(), recorder,
+                                 i * kTasksPerPoster));
+    threads.push_back(new DelegateSimpleThread(posters[i], "poster"));
+  }
+
+  std::string name = StringPrintf("SequencedWorkerPool_%s_%dposters",
+                                  mode_name, num_posters);
+  PerfTimer timer;
+  for (int i = 0; i < num_posters; ++i)
+    threads[i]->Start();
+  for (int i = 0; i < num_posters; ++i)
+    threads[i]->Join();
+  owner.pool()->FlushForTesting();
+  TimeDelta elapsed = timer.Elapsed();
+
+  LogPerfResult((name + "_throughput").c_str(),
+                num_tasks / elapsed.InSecondsF(), "tasks/s");
+  LogPerfResult((name + "_latency_p50").c_str(),
+                recorder->Percentile(0.5).InMicroseconds(), "us");
+  LogPerfResult((name + "_latency_p99").c_str(),
+                recorder->Percentile(0.99).InMicroseconds(), "us");
+
+  owner.pool()->Shutdown();
+}
+
+}  // namespace
+
+// Compares the single-queue scheduler with the work-stealing one as the
+// number of posting threads grows. Run on a many-core host to see the
+// difference; on one or two cores both designs behave about the same.
+TEST(SequencedWorkerPoolPerfTest, GlobalQueueVsWorkStealing) {
+  const int kPosterCounts[] = { 1, 4, 16 };
+  for (size_t i = 0; i < arraysize(kPosterCounts); ++i) {
+    RunPoolBenchmark(SequencedWorkerPool::SCHEDULING_GLOBAL_QUEUE,
+                     "GlobalQueue", kPosterCounts[i]);
+    RunPoolBenchmark(SequencedWorkerPool::SCHEDULING_WORK_STEALING,
+                     "WorkStealing", kPosterCounts[i]);
+  }
+}
+
+}  // namespace base
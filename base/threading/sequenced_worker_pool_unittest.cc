@@ -151,10 +151,12 @@ class TestTracker : public base::RefCountedThreadSafe<TestTracker> {
   size_t started_events_;
 };
 
-class SequencedWorkerPoolTest : public testing::Test {
+// The tests are run against every scheduling mode.
+class SequencedWorkerPoolTest
+    : public testing::TestWithParam<SequencedWorkerPool::SchedulingMode> {
  public:
   SequencedWorkerPoolTest()
-      : pool_owner_(kNumWorkerThreads, "test"),
+      : pool_owner_(kNumWorkerThreads, "test", GetParam()),
         tracker_(new TestTracker) {
   }
 
@@ -234,7 +236,7 @@ void EnsureTasksToCompleteCountAndUnblock(scoped_refptr<TestTracker> tracker,
 }
 
 // Tests that same-named tokens have the same ID.
-TEST_F(SequencedWorkerPoolTest, NamedTokens) {
+TEST_P(SequencedWorkerPoolTest, NamedTokens) {
   const std::string name1("hello");
   SequencedWorkerPool::SequenceToken token1 =
       pool()->GetNamedSequenceToken(name1);
@@ -262,7 +264,7 @@ TEST_F(SequencedWorkerPoolTest, NamedTokens) {
 
 // Tests that posting a bunch of tasks (many more than the number of worker
 // threads) runs them all.
-TEST_F(SequencedWorkerPoolTest, LotsOfTasks) {
+TEST_P(SequencedWorkerPoolTest, LotsOfTasks) {
   pool()->PostWorkerTask(FROM_HERE,
                          base::Bind(&TestTracker::SlowTask, tracker(), 0));
 
@@ -280,9 +282,9 @@ TEST_F(SequencedWorkerPoolTest, LotsOfTasks) {
 // worker threads) to two pools simultaneously runs them all twice.
 // This test is meant to shake out any concurrency issues between
 // pools (like histograms).
-TEST_F(SequencedWorkerPoolTest, LotsOfTasksTwoPools) {
-  SequencedWorkerPoolOwner pool1(kNumWorkerThreads, "test1");
-  SequencedWorkerPoolOwner pool2(kNumWorkerThreads, "test2");
+TEST_P(SequencedWorkerPoolTest, LotsOfTasksTwoPools) {
+  SequencedWorkerPoolOwner pool1(kNumWorkerThreads, "test1", GetParam());
+  SequencedWorkerPoolOwner pool2(kNumWorkerThreads, "test2", GetParam());
 
   base::Closure slow_task = base::Bind(&TestTracker::SlowTask, tracker(), 0);
   pool1.pool()->PostWorkerTask(FROM_HERE, slow_task);
@@ -306,7 +308,7 @@ TEST_F(SequencedWorkerPoolTest, LotsOfTasksTwoPools) {
 
 // Test that tasks with the same sequence token are executed in order but don't
 // affect other tasks.
-TEST_F(SequencedWorkerPoolTest, Sequence) {
+TEST_P(SequencedWorkerPoolTest, Sequence) {
   // Fill all the worker threads except one.
   const size_t kNumBackgroundTasks = kNumWorkerThreads - 1;
   ThreadBlocker background_blocker;
@@ -367,7 +369,7 @@ TEST_F(SequencedWorkerPoolTest, Sequence) {
 
 // Tests that unrun tasks are discarded properly according to their shutdown
 // mode.
-TEST_F(SequencedWorkerPoolTest, DiscardOnShutdown) {
+TEST_P(SequencedWorkerPoolTest, DiscardOnShutdown) {
   // Start tasks to take all the threads and block them.
   EnsureAllWorkersCreated();
   ThreadBlocker blocker;
@@ -412,7 +414,7 @@ TEST_F(SequencedWorkerPoolTest, DiscardOnShutdown) {
 }
 
 // Tests that CONTINUE_ON_SHUTDOWN tasks don't block shutdown.
-TEST_F(SequencedWorkerPoolTest, ContinueOnShutdown) {
+TEST_P(SequencedWorkerPoolTest, ContinueOnShutdown) {
   scoped_refptr<TaskRunner> runner(pool()->GetTaskRunnerWithShutdownBehavior(
       SequencedWorkerPool::CONTINUE_ON_SHUTDOWN));
   scoped_refptr<SequencedTaskRunner> sequenced_runner(
@@ -461,7 +463,7 @@ TEST_F(SequencedWorkerPoolTest, ContinueOnShutdown) {
 // Ensure all worker threads are created, and then trigger a spurious
 // work signal. This shouldn't cause any other work signals to be
 // triggered. This is a regression test for http://crbug.com/117469.
-TEST_F(SequencedWorkerPoolTest, SpuriousWorkSignal) {
+TEST_P(SequencedWorkerPoolTest, SpuriousWorkSignal) {
   EnsureAllWorkersCreated();
   int old_has_work_call_count = has_work_call_count();
   pool()->SignalHasWorkForTesting();
@@ -470,6 +472,32 @@ TEST_F(SequencedWorkerPoolTest, SpuriousWorkSignal) {
   EXPECT_EQ(old_has_work_call_count + 1, has_work_call_count());
 }
 
+// Posting work while every worker is busy still tells the testing observer
+// that there is work, once per task.
+TEST_P(SequencedWorkerPoolTest, HasWorkSignaledForEveryPost) {
+  const size_t kNumTasks = 5;
+  EnsureAllWorkersCreated();
+  ThreadBlocker blocker;
+  for (size_t i = 0; i < kNumWorkerThreads; i++) {
+    pool()->PostWorkerTask(FROM_HERE,
+                           base::Bind(&TestTracker::BlockTask,
+                                      tracker(), i, &blocker));
+  }
+  tracker()->WaitUntilTasksBlocked(kNumWorkerThreads);
+
+  int old_has_work_call_count = has_work_call_count();
+  for (size_t i = 0; i < kNumTasks; i++) {
+    pool()->PostWorkerTask(FROM_HERE,
+                           base::Bind(&TestTracker::FastTask, tracker(),
+                                      kNumWorkerThreads + i));
+  }
+  EXPECT_EQ(old_has_work_call_count + static_cast<int>(kNumTasks),
+            has_work_call_count());
+
+  blocker.Unblock(kNumWorkerThreads);
+  tracker()->WaitUntilTasksComplete(kNumWorkerThreads + kNumTasks);
+}
+
 void IsRunningOnCurrentThreadTask(
     SequencedWorkerPool::SequenceToken test_positive_token,
     SequencedWorkerPool::SequenceToken test_negative_token,
@@ -486,13 +514,13 @@ void IsRunningOnCurrentThreadTask(
 }
 
 // Verify correctness of the IsRunningSequenceOnCurrentThread method.
-TEST_F(SequencedWorkerPoolTest, IsRunningOnCurrentThread) {
+TEST_P(SequencedWorkerPoolTest, IsRunningOnCurrentThread) {
   SequencedWorkerPool::SequenceToken token1 = pool()->GetSequenceToken();
   SequencedWorkerPool::SequenceToken token2 = pool()->GetSequenceToken();
   SequencedWorkerPool::SequenceToken unsequenced_token;
 
   scoped_refptr<SequencedWorkerPool> unused_pool =
-      new SequencedWorkerPool(2, "unused_pool");
+      new SequencedWorkerPool(2, "unused_pool", GetParam());
   EXPECT_TRUE(token1.Equals(unused_pool->GetSequenceToken()));
   EXPECT_TRUE(token2.Equals(unused_pool->GetSequenceToken()));
 
@@ -522,6 +550,80 @@ TEST_F(SequencedWorkerPoolTest, IsRunningOnCurrentThread) {
   unused_pool->Shutdown();
 }
 
+// Records, per sequence, the order in which tasks ran, and checks that no
+// two tasks of a sequence ever overlap.
+class SequenceOrderChecker
+    : public base::RefCountedThreadSafe<SequenceOrderChecker> {
+ public:
+  explicit SequenceOrderChecker(size_t num_sequences)
+      : runs_(num_sequences), running_(num_sequences, false) {}
+
+  void Run(size_t sequence, int index) {
+    {
+      base::AutoLock lock(lock_);
+      EXPECT_FALSE(running_[sequence]);
+      running_[sequence] = true;
+    }
+    base::PlatformThread::YieldCurrentThread();
+    {
+      base::AutoLock lock(lock_);
+      running_[sequence] = false;
+      runs_[sequence].push_back(index);
+    }
+  }
+
+  std::vector<int> runs(size_t sequence) {
+    base::AutoLock lock(lock_);
+    return runs_[sequence];
+  }
+
+ private:
+  friend class base::RefCountedThreadSafe<SequenceOrderChecker>;
+  ~SequenceOrderChecker() {}
+
+  base::Lock lock_;
+  std::vector<std::vector<int> > runs_;
+  std::vector<bool> running_;
+};
+
+// Interleaves many sequences with unsequenced work and checks that every
+// sequence still runs serially and in posting order.
+TEST_P(SequencedWorkerPoolTest, ManySequencesKeepOrder) {
+  const size_t kNumSequences = 16;
+  const int kTasksPerSequence = 50;
+
+  scoped_refptr<SequenceOrderChecker> checker(
+      new SequenceOrderChecker(kNumSequences));
+  std::vector<SequencedWorkerPool::SequenceToken> tokens;
+  for (size_t i = 0; i < kNumSequences; ++i)
+    tokens.push_back(pool()->GetSequenceToken());
+
+  for (int task = 0; task < kTasksPerSequence; ++task) {
+    for (size_t i = 0; i < kNumSequences; ++i) {
+      pool()->PostSequencedWorkerTask(
+          tokens[i], FROM_HERE,
+          base::Bind(&SequenceOrderChecker::Run, checker, i, task));
+    }
+    pool()->PostWorkerTask(FROM_HERE,
+                           base::Bind(&TestTracker::FastTask, tracker(), task));
+  }
+  pool()->FlushForTesting();
+
+  EXPECT_EQ(static_cast<size_t>(kTasksPerSequence),
+            tracker()->WaitUntilTasksComplete(kTasksPerSequence).size());
+  for (size_t i = 0; i < kNumSequences; ++i) {
+    std::vector<int> runs = checker->runs(i);
+    ASSERT_EQ(static_cast<size_t>(kTasksPerSequence), runs.size());
+    for (int task = 0; task < kTasksPerSequence; ++task)
+      EXPECT_EQ(task, runs[task]);
+  }
+}
+
+INSTANTIATE_TEST_CASE_P(
+    SchedulingModes, SequencedWorkerPoolTest,
+    testing::Values(SequencedWorkerPool::SCHEDULING_GLOBAL_QUEUE,
+                    SequencedWorkerPool::SCHEDULING_WORK_STEALING));
+
 class SequencedWorkerPoolTaskRunnerTestDelegate {
  public:
   SequencedWorkerPoolTaskRunnerTestDelegate() {}
@@ -601,14 +703,15 @@ INSTANTIATE_TYPED_TEST_CASE_P(
 
 class SequencedWorkerPoolSequencedTaskRunnerTestDelegate {
  public:
-  SequencedWorkerPoolSequencedTaskRunnerTestDelegate() {}
+  SequencedWorkerPoolSequencedTaskRunnerTestDelegate()
+      : scheduling_mode_(SequencedWorkerPool::SCHEDULING_GLOBAL_QUEUE) {}
 
   ~SequencedWorkerPoolSequencedTaskRunnerTestDelegate() {
   }
 
   void StartTaskRunner() {
     pool_owner_.reset(new SequencedWorkerPoolOwner(
-        10, "SequencedWorkerPoolSequencedTaskRunnerTest"));
+        10, "SequencedWorkerPoolSequencedTaskRunnerTest", scheduling_mode_));
     task_runner_ = pool_owner_->pool()->GetSequencedTaskRunner(
         pool_owner_->pool()->GetSequenceToken());
   }
@@ -630,7 +733,13 @@ class SequencedWorkerPoolSequencedTaskRunnerTestDelegate {
     return false;
   }
 
+ protected:
+  explicit SequencedWorkerPoolSequencedTaskRunnerTestDelegate(
+      SequencedWorkerPool::SchedulingMode scheduling_mode)
+      : scheduling_mode_(scheduling_mode) {}
+
  private:
+  const SequencedWorkerPool::SchedulingMode scheduling_mode_;
   MessageLoop message_loop_;
   scoped_ptr<SequencedWorkerPoolOwner> pool_owner_;
   scoped_refptr<SequencedTaskRunner> task_runner_;
@@ -644,6 +753,23 @@ INSTANTIATE_TYPED_TEST_CASE_P(
     SequencedWorkerPoolSequencedTaskRunner, SequencedTaskRunnerTest,
     SequencedWorkerPoolSequencedTaskRunnerTestDelegate);
 
+class SequencedWorkerPoolWorkStealingSequencedTaskRunnerTestDelegate
+    : public SequencedWorkerPoolSequencedTaskRunnerTestDelegate {
+ public:
+  SequencedWorkerPoolWorkStealingSequencedTaskRunnerTestDelegate()
+      : SequencedWorkerPoolSequencedTaskRunnerTestDelegate(
+            SequencedWorkerPool::SCHEDULING_WORK_STEALING) {}
+};
+
+INSTANTIATE_TYPED_TEST_CASE_P(
+    SequencedWorkerPoolWorkStealingSequencedTaskRunner, TaskRunnerTest,
+    SequencedWorkerPoolWorkStealingSequencedTaskRunnerTestDelegate);
+
+INSTANTIATE_TYPED_TEST_CASE_P(
+    SequencedWorkerPoolWorkStealingSequencedTaskRunner,
+    SequencedTaskRunnerTest,
+    SequencedWorkerPoolWorkStealingSequencedTaskRunnerTestDelegate);
+
 }  // namespace
 
 }  // namespace base
@@ -6,6 +6,9 @@
 
 #include <math.h>
 #include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
 
 #include "base/format_macros.h"
 #include "base/memory/scoped_ptr.h"
@@ -48,6 +51,10 @@ const ThreadData::Status kInitialStartupState =
 // problem with its presence).
 static const bool kAllowAlternateTimeSourceHandling = true;
 
+// The number of slots a thread's death table starts with.  It doubles each
+// time it gets 3/4 full.
+const size_t kInitialDeathTableCapacity = 32;
+
 }  // namespace
 
 //------------------------------------------------------------------------------
@@ -229,10 +236,67 @@ base::LazyInstance<base::Lock>::Leaky
 // static
 ThreadData::Status ThreadData::status_ = ThreadData::UNINITIALIZED;
 
+// static
+int ThreadData::sampling_interval_ = 1;
+
+// static
+bool ThreadData::use_coarse_clock_ = false;
+
+// An open-addressed hash table of the DeathData for each Births that died on
+// a thread.  Only the owning thread writes it.  A slot's DeathData is zeroed
+// before its key is published, so a reader on another thread sees either a
+// free slot or a valid one.  When the table gets too full, the owner copies
+// it into one twice the size before publishing that; the old table is kept
+// (and freed with the new one) since a reader may still be scanning it.
+struct ThreadData::DeathTable {
+  struct Slot {
+    Slot() : birth(0) {}
+
+    base::subtle::AtomicWord birth;  // The Births*, or 0 if the slot is free.
+    DeathData death_data;
+  };
+
+  DeathTable(size_t capacity, DeathTable* previous)
+      : capacity(capacity),
+        size(0),
+        slots(new Slot[capacity]),
+        previous(previous) {
+    DCHECK_EQ(0u, capacity & (capacity - 1));
+  }
+
+  ~DeathTable() {
+    delete previous;
+  }
+
+  // Returns the slot holding |birth|, or else the free slot where it belongs.
+  // Only called on the owning thread.
+  Slot* Find(const Births* birth) {
+    base::subtle::AtomicWord key = reinterpret_cast<base::subtle::AtomicWord>(
+        birth);
+    // Births are separate heap allocations, so their low bits carry little.
+    size_t index = (static_cast<size_t>(key) >> 4) & (capacity - 1);
+    while (true) {
+      base::subtle::AtomicWord slot_key =
+          base::subtle::NoBarrier_Load(&slots[index].birth);
+      if (slot_key == key || slot_key == 0)
+        return &slots[index];
+      index = (index + 1) & (capacity - 1);
+    }
+  }
+
+  const size_t capacity;  // Always a power of two.
+  size_t size;  // The number of slots in use.
+  scoped_array<Slot> slots;
+  DeathTable* const previous;
+};
+
 ThreadData::ThreadData(const std::string& suggested_name)
     : next_(NULL),
       next_retired_worker_(NULL),
       worker_thread_number_(0),
+      death_table_(reinterpret_cast<base::subtle::AtomicWord>(
+          new DeathTable(kInitialDeathTableCapacity, NULL))),
+      births_until_sample_(0),
       incarnation_count_for_pool_(-1) {
   DCHECK_GE(suggested_name.size(), 0u);
   thread_name_ = suggested_name;
@@ -243,13 +307,19 @@ ThreadData::ThreadData(int thread_number)
     : next_(NULL),
       next_retired_worker_(NULL),
       worker_thread_number_(thread_number),
+      death_table_(reinterpret_cast<base::subtle::AtomicWord>(
+          new DeathTable(kInitialDeathTableCapacity, NULL))),
+      births_until_sample_(0),
       incarnation_count_for_pool_(-1)  {
   CHECK_GT(thread_number, 0);
   base::StringAppendF(&thread_name_, "WorkerThread-%d", thread_number);
   PushToHeadOfList();  // Which sets real incarnation_count_for_pool_.
 }
 
-ThreadData::~ThreadData() {}
+ThreadData::~ThreadData() {
+  delete reinterpret_cast<DeathTable*>(
+      base::subtle::NoBarrier_Load(&death_table_));
+}
 
 void ThreadData::PushToHeadOfList() {
   // Toss in a hint of randomness (atop the uniniitalized value).
@@ -353,6 +423,7 @@ void ThreadData::Snapshot(bool reset_max, ProcessDataSnapshot* process_data) {
   // for which we have not seen a death count.
   BirthCountMap birth_counts;
   ThreadData::SnapshotAllExecutedTasks(reset_max, process_data, &birth_counts);
+  const int interval = sampling_interval_;
 
   // Add births that are still active -- i.e. objects that have tallied a birth,
   // but have not yet tallied a matching death, and hence must be either
@@ -364,6 +435,17 @@ void ThreadData::Snapshot(bool reset_max, ProcessDataSnapshot* process_data) {
           TaskSnapshot(*it->first, DeathData(it->second), "Still_Alive"));
     }
   }
+
+  // Only one in |interval| tasks was tracked, so scale the tallies back up to
+  // estimate the totals.  Maxima and samples are left as observed.
+  if (interval <= 1)
+    return;
+  for (size_t i = 0; i < process_data->tasks.size(); ++i) {
+    DeathDataSnapshot* death_data = &process_data->tasks[i].death_data;
+    death_data->count *= interval;
+    death_data->run_duration_sum *= interval;
+    death_data->queue_duration_sum *= interval;
+  }
 }
 
 Births* ThreadData::TallyABirth(const Location& location) {
@@ -410,15 +492,8 @@ void ThreadData::TallyADeath(const Births& birth,
   if (kAllowAlternateTimeSourceHandling && now_function_)
     queue_duration = 0;
 
-  DeathMap::iterator it = death_map_.find(&birth);
-  DeathData* death_data;
-  if (it != death_map_.end()) {
-    death_data = &it->second;
-  } else {
-    base::AutoLock lock(map_lock_);  // Lock as the map may get relocated now.
-    death_data = &death_map_[&birth];
-  }  // Release lock ASAP.
-  death_data->RecordDeath(queue_duration, run_duration, random_number_);
+  FindOrAddDeathData(&birth)->RecordDeath(queue_duration, run_duration,
+                                         random_number_);
 
   if (!kTrackParentChildLinks)
     return;
@@ -428,6 +503,44 @@ void ThreadData::TallyADeath(const Births& birth,
   }
 }
 
+DeathData* ThreadData::FindOrAddDeathData(const Births* birth) {
+  // Only this thread writes the table, so it needs no barrier to read it.
+  DeathTable* table = reinterpret_cast<DeathTable*>(
+      base::subtle::NoBarrier_Load(&death_table_));
+  DeathTable::Slot* slot = table->Find(birth);
+  if (base::subtle::NoBarrier_Load(&slot->birth))
+    return &slot->death_data;
+
+  // Keep the table at most 3/4 full, so that probe sequences stay short.
+  if (4 * (table->size + 1) > 3 * table->capacity) {
+    table = GrowDeathTable(table);
+    slot = table->Find(birth);
+  }
+  ++table->size;
+  base::subtle::Release_Store(
+      &slot->birth, reinterpret_cast<base::subtle::AtomicWord>(birth));
+  return &slot->death_data;
+}
+
+ThreadData::DeathTable* ThreadData::GrowDeathTable(DeathTable* table) {
+  DeathTable* bigger = new DeathTable(2 * table->capacity, table);
+  for (size_t i = 0; i < table->capacity; ++i) {
+    base::subtle::AtomicWord key =
+        base::subtle::NoBarrier_Load(&table->slots[i].birth);
+    if (!key)
+      continue;
+    DeathTable::Slot* slot = bigger->Find(reinterpret_cast<const Births*>(key));
+    slot->death_data = table->slots[i].death_data;
+    slot->birth = key;
+    ++bigger->size;
+  }
+  // Readers that already hold |table| may keep using it; it lives as long as
+  // |bigger| does.
+  base::subtle::Release_Store(
+      &death_table_, reinterpret_cast<base::subtle::AtomicWord>(bigger));
+  return bigger;
+}
+
 // static
 Births* ThreadData::TallyABirthIfActive(const Location& location) {
   if (!kTrackAllTaskObjects)
@@ -438,6 +551,9 @@ Births* ThreadData::TallyABirthIfActive(const Location& location) {
   ThreadData* current_thread_data = Get();
   if (!current_thread_data)
     return NULL;
+  if (--current_thread_data->births_until_sample_ > 0)
+    return NULL;  // Not sampled.
+  current_thread_data->births_until_sample_ = sampling_interval_;
   return current_thread_data->TallyABirth(location);
 }
 
@@ -477,7 +593,9 @@ void ThreadData::TallyRunOnNamedThreadIfTracking(
   int32 queue_duration = 0;
   int32 run_duration = 0;
   if (!start_of_run.is_null()) {
-    queue_duration = (start_of_run - effective_post_time).InMilliseconds();
+    // The coarse clock may lag the posting time by up to a tick.
+    queue_duration = std::max(
+        0, (start_of_run - effective_post_time).InMilliseconds());
     if (!end_of_run.is_null())
       run_duration = (end_of_run - start_of_run).InMilliseconds();
   }
@@ -515,7 +633,8 @@ void ThreadData::TallyRunOnWorkerThreadIfTracking(
   int32 queue_duration = 0;
   int32 run_duration = 0;
   if (!start_of_run.is_null()) {
-    queue_duration = (start_of_run - time_posted).InMilliseconds();
+    // The coarse clock may lag the posting time by up to a tick.
+    queue_duration = std::max(0, (start_of_run - time_posted).InMilliseconds());
     if (!end_of_run.is_null())
       run_duration = (end_of_run - start_of_run).InMilliseconds();
   }
@@ -608,16 +727,22 @@ void ThreadData::SnapshotMaps(bool reset_max,
                               BirthMap* birth_map,
                               DeathMap* death_map,
                               ParentChildSet* parent_child_set) {
+  DeathTable* table = reinterpret_cast<DeathTable*>(
+      base::subtle::Acquire_Load(&death_table_));
+  for (size_t i = 0; i < table->capacity; ++i) {
+    DeathTable::Slot* slot = &table->slots[i];
+    base::subtle::AtomicWord key = base::subtle::Acquire_Load(&slot->birth);
+    if (!key)
+      continue;
+    (*death_map)[reinterpret_cast<const Births*>(key)] = slot->death_data;
+    if (reset_max)
+      slot->death_data.ResetMax();
+  }
+
   base::AutoLock lock(map_lock_);
   for (BirthMap::const_iterator it = birth_map_.begin();
        it != birth_map_.end(); ++it)
     (*birth_map)[it->first] = it->second;
-  for (DeathMap::iterator it = death_map_.begin();
-       it != death_map_.end(); ++it) {
-    (*death_map)[it->first] = it->second;
-    if (reset_max)
-      it->second.ResetMax();
-  }
 
   if (!kTrackParentChildLinks)
     return;
@@ -638,10 +763,13 @@ void ThreadData::ResetAllThreadData() {
 }
 
 void ThreadData::Reset() {
+  DeathTable* table = reinterpret_cast<DeathTable*>(
+      base::subtle::Acquire_Load(&death_table_));
+  for (size_t i = 0; i < table->capacity; ++i) {
+    if (base::subtle::Acquire_Load(&table->slots[i].birth))
+      table->slots[i].death_data.Clear();
+  }
   base::AutoLock lock(map_lock_);
-  for (DeathMap::iterator it = death_map_.begin();
-       it != death_map_.end(); ++it)
-    it->second.Clear();
   for (BirthMap::iterator it = birth_map_.begin();
        it != birth_map_.end(); ++it)
     it->second->Clear();
@@ -721,6 +849,22 @@ ThreadData::Status ThreadData::status() {
   return status_;
 }
 
+// static
+void ThreadData::SetSamplingInterval(int interval) {
+  DCHECK_GE(interval, 1);
+  sampling_interval_ = std::max(interval, 1);
+}
+
+// static
+int ThreadData::sampling_interval() {
+  return sampling_interval_;
+}
+
+// static
+void ThreadData::SetUseCoarseClock(bool use_coarse_clock) {
+  use_coarse_clock_ = use_coarse_clock;
+}
+
 // static
 bool ThreadData::TrackingStatus() {
   return status_ > DEACTIVATED;
@@ -733,7 +877,9 @@ bool ThreadData::TrackingParentChildStatus() {
 
 // static
 TrackedTime ThreadData::NowForStartOfRun(const Births* parent) {
-  if (kTrackParentChildLinks && parent && status_ > PROFILING_ACTIVE) {
+  if (!parent)
+    return TrackedTime();  // Not tracked, perhaps not sampled.
+  if (kTrackParentChildLinks && status_ > PROFILING_ACTIVE) {
     ThreadData* current_thread_data = Get();
     if (current_thread_data)
       current_thread_data->parent_stack_.push(parent);
@@ -742,7 +888,9 @@ TrackedTime ThreadData::NowForStartOfRun(const Births* parent) {
 }
 
 // static
-TrackedTime ThreadData::NowForEndOfRun() {
+TrackedTime ThreadData::NowForEndOfRun(const Births* birth) {
+  if (!birth)
+    return TrackedTime();
   return Now();
 }
 
@@ -758,7 +906,7 @@ TrackedTime ThreadData::Now() {
   if (kAllowAlternateTimeSourceHandling && now_function_)
     return TrackedTime::FromMilliseconds((*now_function_)());
   if (kTrackAllTaskObjects && TrackingStatus())
-    return TrackedTime::Now();
+    return use_coarse_clock_ ? TrackedTime::NowCoarse() : TrackedTime::Now();
   return TrackedTime();  // Super fast when disabled, or not compiled.
 }
 
@@ -799,6 +947,8 @@ void ThreadData::ShutdownSingleThreadedCleanup(bool leak) {
   // Put most global static back in pristine shape.
   worker_thread_data_creation_count_ = 0;
   cleanup_count_ = 0;
+  sampling_interval_ = 1;
+  use_coarse_clock_ = false;
   tls_index_.Set(NULL);
   status_ = DORMANT_DURING_TESTS;  // Almost UNINITIALIZED.
 
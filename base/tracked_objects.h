@@ -13,6 +13,7 @@
 #include <utility>
 #include <vector>
 
+#include "base/atomicops.h"
 #include "base/base_export.h"
 #include "base/gtest_prod_util.h"
 #include "base/lazy_instance.h"
@@ -101,11 +102,18 @@
 //
 // Each thread maintains a list of data items specific to that thread in a
 // ThreadData instance (for that specific thread only).  The two critical items
-// are lists of DeathData and Births instances.  These lists are maintained in
-// STL maps, which are indexed by Location. As noted earlier, we can compare
+// are lists of DeathData and Births instances.  The Births are maintained in an
+// STL map, which is indexed by Location. As noted earlier, we can compare
 // locations very efficiently as we consider the underlying data (file,
 // function, line) to be atoms, and hence pointer comparison is used rather than
-// (slow) string comparisons.
+// (slow) string comparisons.  The DeathData instances are kept in a small
+// open-addressed hash table, indexed by Births, which only the owning thread
+// writes, and which is read without locks when a snapshot merges all the
+// threads' tallies.
+//
+// To keep the overhead low enough to leave tracking on, only one in every
+// SetSamplingInterval() births may be tracked, and runs may be timed with a
+// cheaper, coarser clock (see SetUseCoarseClock()).
 //
 // To provide a mechanism for iterating over all "known threads," which means
 // threads that have recorded a birth or a death, we create a singly linked list
@@ -423,6 +431,17 @@ class BASE_EXPORT ThreadData {
       const TrackedTime& start_of_run,
       const TrackedTime& end_of_run);
 
+  // Tracks only one in every |interval| births on each thread (the rest get a
+  // NULL Births, and are neither counted nor timed), cutting the cost of
+  // tracking by about that factor.  Snapshot() scales the counts and duration
+  // sums it reports by |interval|, so they remain estimates of the totals.
+  // This is meant to be set once, early during startup.
+  static void SetSamplingInterval(int interval);
+  static int sampling_interval();
+
+  // Times runs with TrackedTime::NowCoarse() rather than TrackedTime::Now().
+  static void SetUseCoarseClock(bool use_coarse_clock);
+
   const std::string thread_name() const;
 
   // Hack: asynchronously clear all birth counts and death tallies data values
@@ -462,9 +481,11 @@ class BASE_EXPORT ThreadData {
   // side effects when we are tracking, so that we can deduce the amount of time
   // accumulated outside of execution of tracked runs.
   // The task that will be tracked is passed in as |parent| so that parent-child
-  // relationships can be (optionally) calculated.
+  // relationships can be (optionally) calculated.  Both return a null time,
+  // without reading the clock, for a task that isn't tracked (NULL |parent| or
+  // |birth|).
   static TrackedTime NowForStartOfRun(const Births* parent);
-  static TrackedTime NowForEndOfRun();
+  static TrackedTime NowForEndOfRun(const Births* birth);
 
   // Provide a time function that does nothing (runs fast) when we don't have
   // the profiler enabled.  It will generally be optimized away when it is
@@ -496,6 +517,9 @@ class BASE_EXPORT ThreadData {
 
   typedef std::map<const BirthOnThread*, int> BirthCountMap;
 
+  // The hash table holding this thread's DeathData.
+  struct DeathTable;
+
   // Worker thread construction creates a name since there is none.
   explicit ThreadData(int thread_number);
 
@@ -522,6 +546,13 @@ class BASE_EXPORT ThreadData {
   // Find a place to record a death on this thread.
   void TallyADeath(const Births& birth, int32 queue_duration, int32 duration);
 
+  // Finds, or adds, the DeathData for |birth| in this thread's death table.
+  // Only called on the owning thread.
+  DeathData* FindOrAddDeathData(const Births* birth);
+
+  // Moves the death table into one twice its size, and returns that.
+  DeathTable* GrowDeathTable(DeathTable* table);
+
   // Snapshot (under a lock) the profiled data for the tasks in each ThreadData
   // instance.  Also updates the |birth_counts| tally for each task to keep
   // track of the number of living instances of the task.  If |reset_max| is
@@ -545,9 +576,10 @@ class BASE_EXPORT ThreadData {
 
   // Using our lock, make a copy of the specified maps.  This call may be made
   // on  non-local threads, which necessitate the use of the lock to prevent
-  // the map(s) from being reallocaed while they are copied. If |reset_max| is
-  // true, then, just after we copy the DeathMap, we will set the max values to
-  // zero in the active DeathMap (not the snapshot).
+  // the map(s) from being reallocaed while they are copied.  The deaths are
+  // gathered from the death table, which needs no lock.  If |reset_max| is
+  // true, then, just after we copy each DeathData, we will set the max values
+  // to zero in the death table (not the snapshot).
   void SnapshotMaps(bool reset_max,
                     BirthMap* birth_map,
                     DeathMap* death_map,
@@ -616,6 +648,12 @@ class BASE_EXPORT ThreadData {
   // We set status_ to SHUTDOWN when we shut down the tracking service.
   static Status status_;
 
+  // Only one in this many births on each thread is tracked.
+  static int sampling_interval_;
+
+  // Whether Now() uses TrackedTime::NowCoarse().
+  static bool use_coarse_clock_;
+
   // Link to next instance (null terminated list). Used to globally track all
   // registered instances (corresponds to all registered threads where we keep
   // data).
@@ -644,16 +682,17 @@ class BASE_EXPORT ThreadData {
 
   // Similar to birth_map_, this records informations about death of tracked
   // instances (i.e., when a tracked instance was destroyed on this thread).
-  // It is locked before changing, and hence other threads may access it by
-  // locking before reading it.
-  DeathMap death_map_;
+  // It holds a DeathTable*, which is only written by this thread, and is
+  // published with release semantics whenever the table grows, so that other
+  // threads can read it without any lock.
+  base::subtle::AtomicWord death_table_;
 
   // A set of parents that created children tasks on this thread. Each pair
   // corresponds to potentially non-local Births (location and thread), and a
   // local Births (that took place on this thread).
   ParentChildSet parent_child_set_;
 
-  // Lock to protect *some* access to BirthMap and DeathMap.  The maps are
+  // Lock to protect *some* access to BirthMap and ParentChildSet.  They are
   // regularly read and written on this thread, but may only be read from other
   // threads.  To support this, we acquire this lock if we are writing from this
   // thread, or reading from another thread.  For reading from this thread we
@@ -677,6 +716,10 @@ class BASE_EXPORT ThreadData {
   // we stir in more and more as we go.
   int32 random_number_;
 
+  // Births to skip on this thread before the next one is tracked; see
+  // SetSamplingInterval().
+  int births_until_sample_;
+
   // Record of what the incarnation_counter_ was when this instance was created.
   // If the incarnation_counter_ has changed, then we avoid pushing into the
   // pool (this is only critical in tests which go through multiple
@@ -8,6 +8,7 @@
 
 #include "base/memory/scoped_ptr.h"
 #include "base/process_util.h"
+#include "base/threading/simple_thread.h"
 #include "base/time.h"
 #include "testing/gtest/include/gtest/gtest.h"
 
@@ -164,7 +165,7 @@ TEST_F(TrackedObjectsTest, TinyStartupShutdown) {
   base::TrackingInfo pending_task(location, kBogusBirthTime);
   TrackedTime start_time(pending_task.time_posted);
   // Finally conclude the outer run.
-  TrackedTime end_time = ThreadData::NowForEndOfRun();
+  TrackedTime end_time = ThreadData::NowForEndOfRun(first_birth);
   ThreadData::TallyRunOnNamedThreadIfTracking(pending_task, start_time,
                                               end_time);
 
@@ -578,4 +579,127 @@ TEST_F(TrackedObjectsTest, DifferentLives) {
   EXPECT_EQ(base::GetCurrentProcId(), process_data.process_id);
 }
 
+TEST_F(TrackedObjectsTest, SampledLifeCycleToSnapshotMainThread) {
+  if (!ThreadData::InitializeAndSetTrackingStatus(
+          ThreadData::PROFILING_CHILDREN_ACTIVE))
+    return;
+  ThreadData::InitializeThreadContext(kMainThreadName);
+  const int kInterval = 3;
+  ThreadData::SetSamplingInterval(kInterval);
+
+  const char kFunction[] = "SampledLifeCycleToSnapshotMainThread";
+  Location location(kFunction, kFile, kLineNumber, NULL);
+  const base::TimeTicks kTimePosted = base::TimeTicks() +
+      base::TimeDelta::FromMilliseconds(1);
+  const TrackedTime kStartOfRun = TrackedTime() +
+      Duration::FromMilliseconds(5);
+  const TrackedTime kEndOfRun = TrackedTime() + Duration::FromMilliseconds(7);
+
+  // Only one task in every |kInterval| is tracked, and the others aren't even
+  // timed.
+  const int kTasks = 2 * kInterval;
+  int tracked_tasks = 0;
+  for (int i = 0; i < kTasks; ++i) {
+    base::TrackingInfo pending_task(location, base::TimeTicks());
+    pending_task.time_posted = kTimePosted;  // Overwrite implied Now().
+    if (!pending_task.birth_tally) {
+      EXPECT_TRUE(ThreadData::NowForStartOfRun(NULL).is_null());
+      continue;
+    }
+    ++tracked_tasks;
+    ThreadData::TallyRunOnNamedThreadIfTracking(pending_task,
+        kStartOfRun, kEndOfRun);
+  }
+  EXPECT_EQ(kTasks / kInterval, tracked_tasks);
+
+  // The snapshot estimates the totals from the sample.
+  ProcessDataSnapshot process_data;
+  ThreadData::Snapshot(false, &process_data);
+  ASSERT_EQ(1u, process_data.tasks.size());
+  EXPECT_EQ(kTasks, process_data.tasks[0].death_data.count);
+  EXPECT_EQ(kTasks * 2, process_data.tasks[0].death_data.run_duration_sum);
+  EXPECT_EQ(2, process_data.tasks[0].death_data.run_duration_max);
+  EXPECT_EQ(kTasks * 4, process_data.tasks[0].death_data.queue_duration_sum);
+  EXPECT_EQ(4, process_data.tasks[0].death_data.queue_duration_max);
+}
+
+// Tallies deaths at many locations, so that the thread's death table has to
+// grow several times.
+TEST_F(TrackedObjectsTest, ManyLocationsToSnapshotMainThread) {
+  if (!ThreadData::InitializeAndSetTrackingStatus(
+          ThreadData::PROFILING_CHILDREN_ACTIVE))
+    return;
+  ThreadData::InitializeThreadContext(kMainThreadName);
+
+  const char kFunction[] = "ManyLocationsToSnapshotMainThread";
+  const int kLocations = 500;
+  for (int line = 1; line <= kLocations; ++line) {
+    Location location(kFunction, kFile, line, NULL);
+    base::TrackingInfo pending_task(location, base::TimeTicks());
+    // Each location runs |line| % 3 + 1 times.
+    for (int run = 0; run <= line % 3; ++run) {
+      const TrackedTime kStartOfRun = TrackedTime() +
+          Duration::FromMilliseconds(line);
+      ThreadData::TallyRunOnNamedThreadIfTracking(
+          pending_task, kStartOfRun, kStartOfRun);
+    }
+  }
+
+  ProcessDataSnapshot process_data;
+  ThreadData::Snapshot(false, &process_data);
+  ASSERT_EQ(static_cast<size_t>(kLocations), process_data.tasks.size());
+  for (size_t i = 0; i < process_data.tasks.size(); ++i) {
+    const TaskSnapshot& task = process_data.tasks[i];
+    EXPECT_EQ(kMainThreadName, task.death_thread_name);
+    EXPECT_EQ(task.birth.location.line_number % 3 + 1, task.death_data.count);
+  }
+}
+
+namespace {
+
+// Runs tasks at many locations on a worker thread.
+class LocationRunner : public base::DelegateSimpleThread::Delegate {
+ public:
+  explicit LocationRunner(int locations) : locations_(locations) {}
+
+  virtual void Run() OVERRIDE {
+    for (int line = 1; line <= locations_; ++line) {
+      Location location("LocationRunner", kFile, line, NULL);
+      Births* birth = ThreadData::TallyABirthIfActive(location);
+      ThreadData::TallyRunOnWorkerThreadIfTracking(
+          birth, TrackedTime(), TrackedTime(), TrackedTime());
+    }
+  }
+
+ private:
+  int locations_;
+};
+
+}  // namespace
+
+// Snapshots, which read other threads' death tables without a lock, may run
+// while those tables grow.
+TEST_F(TrackedObjectsTest, SnapshotWhileDeathTableGrows) {
+  if (!ThreadData::InitializeAndSetTrackingStatus(
+          ThreadData::PROFILING_CHILDREN_ACTIVE))
+    return;
+
+  const int kLocations = 5000;
+  LocationRunner runner(kLocations);
+  base::DelegateSimpleThread thread(&runner, "runner");
+  thread.Start();
+  for (int i = 0; i < 20; ++i) {
+    ProcessDataSnapshot process_data;
+    ThreadData::Snapshot(true, &process_data);
+    EXPECT_GE(static_cast<size_t>(kLocations), process_data.tasks.size());
+  }
+  thread.Join();
+
+  ProcessDataSnapshot process_data;
+  ThreadData::Snapshot(false, &process_data);
+  ASSERT_EQ(static_cast<size_t>(kLocations), process_data.tasks.size());
+  for (size_t i = 0; i < process_data.tasks.size(); ++i)
+    EXPECT_EQ(1, process_data.tasks[i].death_data.count);
+}
+
 }  // namespace tracked_objects
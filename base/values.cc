@@ -60,6 +60,13 @@ Value* CopyWithoutEmptyChildren(Value* node) {
   }
 }
 
+// Orders dictionary entries by key only, so a stable sort keeps the values
+// set for the same key in the order they were given.
+bool EntryKeyLess(const std::pair<std::string, Value*>& lhs,
+                  const std::pair<std::string, Value*>& rhs) {
+  return lhs.first < rhs.first;
+}
+
 // A small functor for comparing Values for std::find_if and similar.
 class ValueEquals {
  public:
@@ -441,6 +448,25 @@ void DictionaryValue::SetWithoutPathExpansion(const std::string& key,
   }
 }
 
+void DictionaryValue::SetEntriesWithoutPathExpansion(
+    std::vector<std::pair<std::string, Value*> >* entries) {
+  // Once sorted, each key goes at or near the end of the map, so inserting
+  // with a hint of end() is amortized constant time for a new dictionary.
+  std::stable_sort(entries->begin(), entries->end(), EntryKeyLess);
+  for (size_t i = 0; i < entries->size(); ++i) {
+    const std::pair<std::string, Value*>& entry = (*entries)[i];
+    ValueMap::iterator current_entry =
+        dictionary_.insert(dictionary_.end(), entry);
+    if (current_entry->second != entry.second) {
+      // If there's an existing value here, we need to delete it, because
+      // we own all our children.
+      delete current_entry->second;
+      current_entry->second = entry.second;
+    }
+  }
+  entries->clear();
+}
+
 bool DictionaryValue::Get(const std::string& path, Value** out_value) const {
   DCHECK(IsStringUTF8(path));
   std::string current_path(path);
@@ -697,10 +723,13 @@ void DictionaryValue::MergeDictionary(const DictionaryValue* dictionary) {
 DictionaryValue* DictionaryValue::DeepCopy() const {
   DictionaryValue* result = new DictionaryValue;
 
+  // The entries come out in key order, so each one goes at the end.
   for (ValueMap::const_iterator current_entry(dictionary_.begin());
        current_entry != dictionary_.end(); ++current_entry) {
-    result->SetWithoutPathExpansion(current_entry->first,
-                                    current_entry->second->DeepCopy());
+    result->dictionary_.insert(
+        result->dictionary_.end(),
+        std::make_pair(current_entry->first,
+                       current_entry->second->DeepCopy()));
   }
 
   return result;
@@ -712,22 +741,18 @@ bool DictionaryValue::Equals(const Value* other) const {
 
   const DictionaryValue* other_dict =
       static_cast<const DictionaryValue*>(other);
-  key_iterator lhs_it(begin_keys());
-  key_iterator rhs_it(other_dict->begin_keys());
-  while (lhs_it != end_keys() && rhs_it != other_dict->end_keys()) {
-    Value* lhs;
-    Value* rhs;
-    if (*lhs_it != *rhs_it ||
-        !GetWithoutPathExpansion(*lhs_it, &lhs) ||
-        !other_dict->GetWithoutPathExpansion(*rhs_it, &rhs) ||
-        !lhs->Equals(rhs)) {
+  if (dictionary_.size() != other_dict->dictionary_.size())
+    return false;
+
+  // Both are ordered by key, so equal dictionaries match entry by entry.
+  ValueMap::const_iterator lhs_it(dictionary_.begin());
+  ValueMap::const_iterator rhs_it(other_dict->dictionary_.begin());
+  for (; lhs_it != dictionary_.end(); ++lhs_it, ++rhs_it) {
+    if (lhs_it->first != rhs_it->first ||
+        !lhs_it->second->Equals(rhs_it->second)) {
       return false;
     }
-    ++lhs_it;
-    ++rhs_it;
   }
-  if (lhs_it != end_keys() || rhs_it != other_dict->end_keys())
-    return false;
 
   return true;
 }
@@ -923,6 +948,7 @@ bool ListValue::GetAsList(const ListValue** out_value) const {
 ListValue* ListValue::DeepCopy() const {
   ListValue* result = new ListValue;
 
+  result->list_.reserve(list_.size());
   for (ValueVector::const_iterator i(list_.begin()); i != list_.end(); ++i)
     result->Append((*i)->DeepCopy());
 
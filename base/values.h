@@ -25,6 +25,7 @@
 #include <iterator>
 #include <map>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "base/base_export.h"
@@ -257,6 +258,14 @@ class BASE_EXPORT DictionaryValue : public Value {
   // be used as paths.
   void SetWithoutPathExpansion(const std::string& key, Value* in_value);
 
+  // Like calling SetWithoutPathExpansion() for each of |entries| in turn, so
+  // the last value given for a key wins.  The entries are sorted first and
+  // then inserted in key order, which is cheaper than inserting them one by
+  // one when building a large dictionary, as JSONReader does.  Takes
+  // ownership of the values and leaves |entries| empty.
+  void SetEntriesWithoutPathExpansion(
+      std::vector<std::pair<std::string, Value*> >* entries);
+
   // Gets the Value associated with the given path starting from this object.
   // A path has the form "<key>" or "<key>.<key>.[...]", where "." indexes
   // into the next DictionaryValue down.  If the path can be resolved
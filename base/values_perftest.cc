@@ -0,0 +1,150 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/perftimer.h"
+#include "base/stringprintf.h"
+#include "base/values.h"
+#include "build/build_config.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+#if defined(OS_LINUX)
+#include <malloc.h>
+#endif
+
+namespace base {
+
+namespace {
+
+const int kEntries = 2000;
+const int kLookupRounds = 200;
+
+// Returns |count| keys like those of a preferences file, in random order.
+std::vector<std::string> MakeKeys(int count) {
+  std::vector<std::string> keys;
+  for (int i = 0; i < count; ++i)
+    keys.push_back(StringPrintf("profile.content_settings.pattern_%d", i));
+  std::random_shuffle(keys.begin(), keys.end());
+  return keys;
+}
+
+// Returns a small dictionary like a content settings exception.
+DictionaryValue* MakeEntry() {
+  DictionaryValue* entry = new DictionaryValue;
+  entry->SetInteger("cookies", 1);
+  entry->SetInteger("images", 2);
+  entry->SetInteger("javascript", 1);
+  entry->SetInteger("plugins", 3);
+  entry->SetBoolean("per_plugin", false);
+  entry->SetString("last_modified", "13000000000000000");
+  return entry;
+}
+
+// Returns a dictionary of small dictionaries, one per key, added one by one.
+DictionaryValue* MakeTree(const std::vector<std::string>& keys) {
+  DictionaryValue* root = new DictionaryValue;
+  for (size_t i = 0; i < keys.size(); ++i)
+    root->SetWithoutPathExpansion(keys[i], MakeEntry());
+  return root;
+}
+
+// Like MakeTree(), but adds all the keys at once, as JSONReader does.
+DictionaryValue* MakeTreeInOneGo(const std::vector<std::string>& keys) {
+  std::vector<std::pair<std::string, Value*> > entries;
+  for (size_t i = 0; i < keys.size(); ++i)
+    entries.push_back(std::make_pair(keys[i], MakeEntry()));
+  DictionaryValue* root = new DictionaryValue;
+  root->SetEntriesWithoutPathExpansion(&entries);
+  return root;
+}
+
+#if defined(OS_LINUX)
+size_t AllocatedBytes() {
+  return mallinfo().uordblks;
+}
+#endif
+
+}  // namespace
+
+// Measures building a large tree, with keys added in order, as when reading
+// a file JSONWriter wrote, and out of order, one by one and all at once.
+TEST(ValuesPerfTest, Build) {
+  std::vector<std::string> keys = MakeKeys(kEntries);
+  std::vector<std::string> sorted_keys(keys);
+  std::sort(sorted_keys.begin(), sorted_keys.end());
+
+#if defined(OS_LINUX)
+  size_t allocated_before = AllocatedBytes();
+#endif
+  PerfTimer timer;
+  scoped_ptr<DictionaryValue> root(MakeTree(sorted_keys));
+  TimeDelta elapsed = timer.Elapsed();
+  LogPerfResult("DictionaryValue_BuildInOrder",
+                kEntries / elapsed.InSecondsF(), "entries/s");
+#if defined(OS_LINUX)
+  LogPerfResult("DictionaryValue_Memory",
+                static_cast<double>(AllocatedBytes() - allocated_before) /
+                    kEntries,
+                "bytes/entry");
+#endif
+
+  PerfTimer random_timer;
+  root.reset(MakeTree(keys));
+  elapsed = random_timer.Elapsed();
+  LogPerfResult("DictionaryValue_BuildOutOfOrder",
+                kEntries / elapsed.InSecondsF(), "entries/s");
+
+  PerfTimer one_go_timer;
+  root.reset(MakeTreeInOneGo(keys));
+  elapsed = one_go_timer.Elapsed();
+  LogPerfResult("DictionaryValue_BuildOutOfOrderInOneGo",
+                kEntries / elapsed.InSecondsF(), "entries/s");
+}
+
+// Measures looking keys up in a large dictionary.
+TEST(ValuesPerfTest, Lookup) {
+  std::vector<std::string> keys = MakeKeys(kEntries);
+  scoped_ptr<DictionaryValue> root(MakeTree(keys));
+
+  PerfTimer timer;
+  int found = 0;
+  for (int round = 0; round < kLookupRounds; ++round) {
+    for (size_t i = 0; i < keys.size(); ++i)
+      found += root->GetWithoutPathExpansion(keys[i], NULL);
+  }
+  TimeDelta elapsed = timer.Elapsed();
+  EXPECT_EQ(kLookupRounds * kEntries, found);
+  LogPerfResult("DictionaryValue_Lookup",
+                kLookupRounds * kEntries / elapsed.InSecondsF(), "lookups/s");
+}
+
+// Measures copying and comparing a large tree, as the prefs code does on
+// every change.
+TEST(ValuesPerfTest, DeepCopyAndEquals) {
+  scoped_ptr<DictionaryValue> root(MakeTree(MakeKeys(kEntries)));
+  const int kRounds = 20;
+
+  PerfTimer copy_timer;
+  for (int round = 0; round < kRounds; ++round)
+    scoped_ptr<DictionaryValue> copy(root->DeepCopy());
+  TimeDelta elapsed = copy_timer.Elapsed();
+  LogPerfResult("DictionaryValue_DeepCopy",
+                kRounds * kEntries / elapsed.InSecondsF(), "entries/s");
+
+  scoped_ptr<DictionaryValue> copy(root->DeepCopy());
+  PerfTimer equals_timer;
+  for (int round = 0; round < kRounds; ++round)
+    EXPECT_TRUE(root->Equals(copy.get()));
+  elapsed = equals_timer.Elapsed();
+  LogPerfResult("DictionaryValue_Equals",
+                kRounds * kEntries / elapsed.InSecondsF(), "entries/s");
+}
+
+}  // namespace base
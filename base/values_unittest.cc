@@ -3,9 +3,12 @@
 // found in the LICENSE file.
 
 #include <limits>
+#include <utility>
+#include <vector>
 
 #include "base/memory/scoped_ptr.h"
 #include "base/string16.h"
+#include "base/stringprintf.h"
 #include "base/utf_string_conversions.h"
 #include "base/values.h"
 #include "testing/gtest/include/gtest/gtest.h"
@@ -755,4 +758,80 @@ TEST(ValuesTest, DictionaryIterator) {
   EXPECT_TRUE(seen2);
 }
 
+// Keys are iterated in order however they were added and removed.
+TEST(ValuesTest, DictionaryKeyOrder) {
+  DictionaryValue dict;
+  const int kKeys = 100;
+  // Adds the keys in a scrambled order; 37 is coprime with kKeys.
+  for (int i = 0; i < kKeys; ++i) {
+    int key = i * 37 % kKeys;
+    dict.SetInteger(StringPrintf("%03d", key), key);
+  }
+  // Replaces every other value, and removes every third key.
+  for (int key = 0; key < kKeys; key += 2)
+    dict.SetInteger(StringPrintf("%03d", key), -key);
+  for (int key = 0; key < kKeys; key += 3)
+    EXPECT_TRUE(dict.RemoveWithoutPathExpansion(StringPrintf("%03d", key),
+                                                NULL));
+  EXPECT_FALSE(dict.RemoveWithoutPathExpansion("000", NULL));
+
+  int expected_key = 0;
+  size_t count = 0;
+  for (DictionaryValue::Iterator it(dict); it.HasNext(); it.Advance()) {
+    if (expected_key % 3 == 0)
+      ++expected_key;
+    EXPECT_EQ(StringPrintf("%03d", expected_key), it.key());
+    int value = 0;
+    EXPECT_TRUE(it.value().GetAsInteger(&value));
+    EXPECT_EQ(expected_key % 2 ? expected_key : -expected_key, value);
+    EXPECT_TRUE(dict.HasKey(it.key()));
+    ++expected_key;
+    ++count;
+  }
+  EXPECT_EQ(count, dict.size());
+  EXPECT_EQ(static_cast<size_t>(kKeys - (kKeys + 2) / 3), count);
+
+  // Copies compare equal, and stop doing so when a value differs.
+  scoped_ptr<DictionaryValue> copy(dict.DeepCopy());
+  EXPECT_TRUE(dict.Equals(copy.get()));
+  copy->SetInteger("001", 2);
+  EXPECT_FALSE(dict.Equals(copy.get()));
+  copy->SetInteger("001", 1);
+  EXPECT_TRUE(dict.Equals(copy.get()));
+  copy->SetInteger("999", 1);
+  EXPECT_FALSE(dict.Equals(copy.get()));
+  EXPECT_FALSE(copy->Equals(&dict));
+}
+
+// Entries added in one go are merged into the existing ones, and the last
+// value for a key wins, as with SetWithoutPathExpansion().
+TEST(ValuesTest, SetEntriesWithoutPathExpansion) {
+  DictionaryValue dict;
+  dict.SetInteger("b", 1);
+  dict.SetInteger("d", 2);
+
+  std::vector<std::pair<std::string, Value*> > entries;
+  entries.push_back(std::make_pair("e", Value::CreateIntegerValue(3)));
+  entries.push_back(std::make_pair("a.b", Value::CreateIntegerValue(4)));
+  entries.push_back(std::make_pair("d", Value::CreateIntegerValue(5)));
+  entries.push_back(std::make_pair("c", Value::CreateIntegerValue(6)));
+  entries.push_back(std::make_pair("e", Value::CreateIntegerValue(7)));
+  dict.SetEntriesWithoutPathExpansion(&entries);
+  EXPECT_TRUE(entries.empty());
+
+  const char* kExpectedKeys[] = { "a.b", "b", "c", "d", "e" };
+  const int kExpectedValues[] = { 4, 1, 6, 5, 7 };
+  ASSERT_EQ(arraysize(kExpectedKeys), dict.size());
+  size_t index = 0;
+  for (DictionaryValue::Iterator it(dict); it.HasNext(); it.Advance()) {
+    EXPECT_EQ(kExpectedKeys[index], it.key());
+    int value = 0;
+    EXPECT_TRUE(it.value().GetAsInteger(&value));
+    EXPECT_EQ(kExpectedValues[index], value);
+    ++index;
+  }
+  EXPECT_TRUE(dict.HasKey("a.b"));
+  EXPECT_FALSE(dict.HasKey("a"));
+}
+
 }  // namespace base
@@ -28,6 +28,7 @@
 #include "chrome/browser/password_manager/password_store.h"
 #include "chrome/browser/password_manager/password_store_factory.h"
 #include "chrome/browser/prefs/pref_member.h"
+#include "chrome/browser/prefs/pref_service.h"
 #include "chrome/browser/prerender/prerender_manager.h"
 #include "chrome/browser/prerender/prerender_manager_factory.h"
 #include "chrome/browser/profiles/profile.h"
@@ -56,6 +57,7 @@
 #include "net/cookies/cookie_store.h"
 #include "net/disk_cache/disk_cache.h"
 #include "net/http/http_cache.h"
+#include "net/socket/ssl_client_socket.h"
 #include "net/url_request/url_request_context.h"
 #include "net/url_request/url_request_context_getter.h"
 #include "webkit/quota/quota_manager.h"
@@ -204,6 +206,10 @@ void BrowsingDataRemover::RemoveImpl(int remove_mask,
                      base::Unretained(this), g_browser_process->io_thread()));
     }
 
+    // The host cache saved at the last shutdown reveals history in the same
+    // way.
+    profile_->GetPrefs()->ClearPref(prefs::kDnsPrefetchingHostCache);
+
     // As part of history deletion we also delete the auto-generated keywords.
     TemplateURLService* keywords_model =
         TemplateURLServiceFactory::GetForProfile(profile_);
@@ -482,6 +488,9 @@ void BrowsingDataRemover::ClearNetworkingHistory(IOThread* io_thread) {
 
   io_thread->ClearHostCache();
 
+  // TLS sessions, including the ones saved to disk, name the servers visited.
+  net::SSLClientSocket::ClearSessionCache();
+
   chrome_browser_net::Predictor* predictor = profile_->GetNetworkPredictor();
   if (predictor) {
     predictor->DiscardInitialNavigationHistory();
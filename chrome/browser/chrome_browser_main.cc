@@ -255,6 +255,9 @@ void InitializeNetworkOptions(const CommandLine& parsed_command_line) {
   if (parsed_command_line.HasSwitch(switches::kEnableHttpPipelining))
     net::HttpStreamFactory::set_http_pipelining_enabled(true);
 
+  if (parsed_command_line.HasSwitch(switches::kEnableWarmSockets))
+    net::internal::ClientSocketPoolBaseHelper::set_warm_sockets_enabled(true);
+
   if (parsed_command_line.HasSwitch(switches::kTestingFixedHttpPort)) {
     int value;
     base::StringToInt(
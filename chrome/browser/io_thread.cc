@@ -12,6 +12,7 @@
 #include "base/compiler_specific.h"
 #include "base/debug/leak_tracker.h"
 #include "base/logging.h"
+#include "base/path_service.h"
 #include "base/stl_util.h"
 #include "base/string_number_conversions.h"
 #include "base/string_split.h"
@@ -29,6 +30,8 @@
 #include "chrome/browser/net/proxy_service_factory.h"
 #include "chrome/browser/net/sdch_dictionary_fetcher.h"
 #include "chrome/browser/prefs/pref_service.h"
+#include "chrome/common/chrome_constants.h"
+#include "chrome/common/chrome_paths.h"
 #include "chrome/common/chrome_switches.h"
 #include "chrome/common/pref_names.h"
 #include "content/public/browser/browser_thread.h"
@@ -58,6 +61,17 @@
 #include "net/ocsp/nss_ocsp.h"
 #endif  // defined(USE_NSS)
 
+#if defined(USE_OPENSSL)
+#include "net/socket/ssl_client_socket.h"
+#include "net/socket/ssl_session_store.h"
+#endif  // defined(USE_OPENSSL)
+
+#if defined(USE_OPENSSL) && (defined(OS_WIN) || defined(OS_MACOSX))
+#include "base/base64.h"
+#include "base/rand_util.h"
+#include "chrome/browser/password_manager/encryptor.h"
+#endif
+
 #if defined(OS_CHROMEOS)
 #include "chrome/browser/chromeos/proxy_config_service_impl.h"
 #endif  // defined(OS_CHROMEOS)
@@ -149,6 +163,21 @@ net::HostResolver* CreateGlobalHostResolver(net::NetLog* net_log) {
       net::CreateSystemHostResolver(parallelism, retry_attempts, net_log);
   }
 
+  // Let the cache serve expired entries while they are refreshed, if asked to.
+  if (command_line.HasSwitch(switches::kHostResolverMaxStaleness) &&
+      global_host_resolver->GetHostCache()) {
+    std::string s =
+        command_line.GetSwitchValueASCII(switches::kHostResolverMaxStaleness);
+    // Parse the switch (it should be a non-negative integer).
+    int n;
+    if (base::StringToInt(s, &n) && n >= 0) {
+      global_host_resolver->GetHostCache()->set_max_staleness(
+          base::TimeDelta::FromSeconds(n));
+    } else {
+      LOG(ERROR) << "Invalid switch for host resolver max staleness: " << s;
+    }
+  }
+
   // Determine if we should disable IPv6 support.
   if (!command_line.HasSwitch(switches::kEnableIPv6)) {
     if (command_line.HasSwitch(switches::kDisableIPv6)) {
@@ -249,6 +278,29 @@ ConstructSystemRequestContext(IOThread::Globals* globals,
   return context;
 }
 
+#if defined(USE_OPENSSL) && (defined(OS_WIN) || defined(OS_MACOSX))
+// Returns the key of the persisted TLS session store, creating one the first
+// time.  The key is kept in local state, protected with Encryptor, which on
+// Windows and Mac encrypts it with a secret of the user's account.
+std::string GetSSLSessionStoreKey(PrefService* local_state) {
+  std::string encoded = local_state->GetString(prefs::kSSLSessionStoreKey);
+  std::string encrypted;
+  std::string key;
+  if (base::Base64Decode(encoded, &encrypted) &&
+      Encryptor::DecryptString(encrypted, &key) &&
+      key.size() == net::SSLSessionStore::kKeySize) {
+    return key;
+  }
+
+  key = base::RandBytesAsString(net::SSLSessionStore::kKeySize);
+  if (Encryptor::EncryptString(key, &encrypted) &&
+      base::Base64Encode(encrypted, &encoded)) {
+    local_state->SetString(prefs::kSSLSessionStoreKey, encoded);
+  }
+  return key;
+}
+#endif
+
 }  // namespace
 
 class SystemURLRequestContextGetter : public net::URLRequestContextGetter {
@@ -338,6 +390,20 @@ IOThread::IOThread(
   ssl_config_service_manager_.reset(
       SSLConfigServiceManager::CreateDefaultManager(local_state));
 
+  // Other platforms' Encryptor uses a fixed password, so the store key, and
+  // with it the sessions, would be readable by anyone who can read the user
+  // data directory.  Sessions are only kept in memory there.
+#if defined(USE_OPENSSL) && (defined(OS_WIN) || defined(OS_MACOSX))
+  FilePath user_data_dir;
+  if (PathService::Get(chrome::DIR_USER_DATA, &user_data_dir)) {
+    ssl_session_store_ = new net::SSLSessionStore(
+        user_data_dir.Append(chrome::kSSLSessionStoreFilename),
+        GetSSLSessionStoreKey(local_state),
+        net::SSLSessionStore::kDefaultMaxEntries,
+        BrowserThread::GetMessageLoopProxyForThread(BrowserThread::FILE));
+  }
+#endif
+
   BrowserThread::SetDelegate(BrowserThread::IO, this);
 }
 
@@ -384,6 +450,10 @@ void IOThread::Init() {
   net::SetMessageLoopForNSSHttpIO();
 #endif  // defined(USE_NSS)
 
+#if defined(USE_OPENSSL)
+  net::SSLClientSocket::SetSessionStore(ssl_session_store_);
+#endif  // defined(USE_OPENSSL)
+
   DCHECK(!globals_);
   globals_ = new Globals;
 
@@ -490,6 +560,14 @@ void IOThread::CleanUp() {
   net::ShutdownNSSHttpIO();
 #endif  // defined(USE_NSS)
 
+#if defined(USE_OPENSSL)
+  // The FILE thread is still running, so the last sessions are written.
+  net::SSLClientSocket::SetSessionStore(NULL);
+  if (ssl_session_store_)
+    ssl_session_store_->Flush();
+  ssl_session_store_ = NULL;
+#endif  // defined(USE_OPENSSL)
+
   system_url_request_context_getter_ = NULL;
 
   // Release objects that the net::URLRequestContext could have been pointing
@@ -517,6 +595,9 @@ void IOThread::RegisterPrefs(PrefService* local_state) {
   local_state->RegisterStringPref(prefs::kAuthNegotiateDelegateWhitelist, "");
   local_state->RegisterStringPref(prefs::kGSSAPILibraryName, "");
   local_state->RegisterBooleanPref(prefs::kEnableReferrers, true);
+#if defined(USE_OPENSSL) && (defined(OS_WIN) || defined(OS_MACOSX))
+  local_state->RegisterStringPref(prefs::kSSLSessionStoreKey, "");
+#endif
 }
 
 net::HttpAuthHandlerFactory* IOThread::CreateDefaultAuthHandlerFactory(
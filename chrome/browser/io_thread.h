@@ -43,6 +43,7 @@ class ProxyConfigService;
 class ProxyService;
 class SdchManager;
 class SSLConfigService;
+class SSLSessionStore;
 class TransportSecurityState;
 class URLRequestContext;
 class URLRequestContextGetter;
@@ -201,6 +202,12 @@ class IOThread : public content::BrowserThreadDelegate {
   // platform and it gets SSL preferences from local_state object.
   scoped_ptr<SSLConfigServiceManager> ssl_config_service_manager_;
 
+#if defined(USE_OPENSSL)
+  // TLS sessions saved in the user data directory, shared by every profile.
+  // NULL where the store could not be protected; see the constructor.
+  scoped_refptr<net::SSLSessionStore> ssl_session_store_;
+#endif
+
   // These member variables are initialized by a task posted to the IO thread,
   // which gets posted by calling certain member functions of IOThread.
   scoped_ptr<net::ProxyConfigService> system_proxy_config_service_;
@@ -6,15 +6,18 @@
 
 #include <stdio.h>
 
+#include "base/bind.h"
 #include "base/file_util.h"
 #include "base/json/json_writer.h"
 #include "base/logging.h"
 #include "base/memory/scoped_ptr.h"
+#include "base/message_loop.h"
 #include "base/threading/thread_restrictions.h"
 #include "base/values.h"
 #include "chrome/browser/ui/webui/net_internals/net_internals_ui.h"
 
-NetLogLogger::NetLogLogger(const FilePath &log_path) {
+NetLogLogger::NetLogLogger(const FilePath &log_path)
+    : thread_("NetLogLogger") {
   if (!log_path.empty()) {
     base::ThreadRestrictions::ScopedAllowIO allow_io;
     file_.Set(file_util::OpenFile(log_path, "w"));
@@ -28,9 +31,15 @@ NetLogLogger::NetLogLogger(const FilePath &log_path) {
     fprintf(file_.get(), "{\"constants\": %s,\n", json.c_str());
     fprintf(file_.get(), "\"events\": [\n");
   }
+  thread_.Start();
 }
 
 NetLogLogger::~NetLogLogger() {
+  // The observer has been removed, so nothing is queued any more.  Stopping
+  // the thread runs the pending WriteEntries() task, if any.
+  base::ThreadRestrictions::ScopedAllowIO allow_io;
+  thread_.Stop();
+  WriteEntries();
 }
 
 void NetLogLogger::StartObserving(net::NetLog* net_log) {
@@ -42,15 +51,45 @@ void NetLogLogger::OnAddEntry(net::NetLog::EventType type,
                               const net::NetLog::Source& source,
                               net::NetLog::EventPhase phase,
                               net::NetLog::EventParameters* params) {
-  scoped_ptr<Value> value(
-      net::NetLog::EntryToDictionaryValue(
-          type, time, source, phase, params, false));
+  // |params| is serialized here rather than on |thread_|: ToValue() reads
+  // objects, such as response headers, that the logging thread may modify
+  // right after this returns.
+  base::Value* entry = net::NetLog::EntryToDictionaryValue(
+      type, time, source, phase, params, false);
+  bool was_empty;
+  {
+    base::AutoLock lock(lock_);
+    was_empty = pending_entries_.empty();
+    pending_entries_.push_back(entry);
+  }
+
+  // WriteEntries() takes everything queued before it runs, so only the entry
+  // that found the queue empty needs to schedule it.
+  if (was_empty) {
+    thread_.message_loop()->PostTask(
+        FROM_HERE,
+        base::Bind(&NetLogLogger::WriteEntries, base::Unretained(this)));
+  }
+}
+
+void NetLogLogger::WriteEntries() {
+  ScopedVector<base::Value> entries;
+  {
+    base::AutoLock lock(lock_);
+    entries.swap(pending_entries_);
+  }
+
+  for (size_t i = 0; i < entries.size(); ++i)
+    WriteEntry(entries[i]);
+}
+
+void NetLogLogger::WriteEntry(const base::Value* entry) {
   // Don't pretty print, so each JSON value occupies a single line, with no
   // breaks (Line breaks in any text field will be escaped).  Using strings
   // instead of integer identifiers allows logs from older versions to be
   // loaded, though a little extra parsing has to be done when loading a log.
   std::string json;
-  base::JSONWriter::Write(value.get(), &json);
+  base::JSONWriter::Write(entry, &json);
   if (!file_.get()) {
     VLOG(1) << json;
   } else {
@@ -7,10 +7,17 @@
 #pragma once
 
 #include "base/memory/scoped_handle.h"
+#include "base/memory/scoped_vector.h"
+#include "base/synchronization/lock.h"
+#include "base/threading/thread.h"
 #include "net/base/net_log.h"
 
 class FilePath;
 
+namespace base {
+class Value;
+}
+
 // NetLogLogger watches the NetLog event stream, and sends all entries to
 // VLOG(1) or a path specified on creation.  This is to debug errors that
 // prevent getting to the about:net-internals page.
@@ -19,8 +26,11 @@ class FilePath;
 // contain a single JSON object, with an extra comma on the end and missing
 // a terminal "]}".
 //
-// Relies on ChromeNetLog only calling an Observer once at a time for
-// thread-safety.
+// OnAddEntry() converts the event to a Value on the calling thread, since its
+// parameters may refer to objects that thread goes on to change, and queues
+// it.  The JSON and file work happen on a thread owned by the logger, so they
+// are kept out from under the NetLog's lock, which is held while observers
+// are called.
 class NetLogLogger : public net::NetLog::ThreadSafeObserver {
  public:
   // If |log_path| is empty or file creation fails, writes to VLOG(1).
@@ -41,8 +51,23 @@ class NetLogLogger : public net::NetLog::ThreadSafeObserver {
                           net::NetLog::EventParameters* params) OVERRIDE;
 
  private:
+  // Writes every entry queued so far, oldest first.  Runs on |thread_|, or on
+  // the destroying thread once |thread_| has stopped.
+  void WriteEntries();
+
+  void WriteEntry(const base::Value* entry);
+
   ScopedStdioHandle file_;
 
+  // Protects |pending_entries_|.
+  base::Lock lock_;
+
+  // Entries waiting to be written, oldest first.  WriteEntries() swaps them
+  // out all at once, so the lock is never held while writing.
+  ScopedVector<base::Value> pending_entries_;
+
+  base::Thread thread_;
+
   DISALLOW_COPY_AND_ASSIGN(NetLogLogger);
 };
 
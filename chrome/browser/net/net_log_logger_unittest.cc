@@ -0,0 +1,164 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "chrome/browser/net/net_log_logger.h"
+
+#include <string>
+#include <vector>
+
+#include "base/file_util.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/scoped_temp_dir.h"
+#include "base/string_number_conversions.h"
+#include "base/string_split.h"
+#include "base/threading/simple_thread.h"
+#include "base/values.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace {
+
+const int kThreads = 10;
+const int kEvents = 100;
+
+void AddEvent(NetLogLogger* logger, int source_id) {
+  logger->OnAddEntry(net::NetLog::TYPE_CANCELLED, base::TimeTicks::Now(),
+                     net::NetLog::Source(net::NetLog::SOURCE_NONE, source_id),
+                     net::NetLog::PHASE_NONE, NULL);
+}
+
+// Returns the source ids of the events written to |path|, in file order.
+std::vector<int> ReadSourceIds(const FilePath& path) {
+  std::string contents;
+  EXPECT_TRUE(file_util::ReadFileToString(path, &contents));
+
+  std::vector<int> ids;
+  std::vector<std::string> lines;
+  base::SplitString(contents, '\n', &lines);
+  const std::string kIdPrefix = "\"id\":";
+  for (size_t i = 0; i < lines.size(); ++i) {
+    if (lines[i].find("\"source\"") == std::string::npos)
+      continue;
+    size_t start = lines[i].find(kIdPrefix);
+    EXPECT_NE(std::string::npos, start);
+    start += kIdPrefix.size();
+    size_t end = lines[i].find_first_not_of("0123456789", start);
+    int id;
+    EXPECT_TRUE(base::StringToInt(lines[i].substr(start, end - start), &id));
+    ids.push_back(id);
+  }
+  return ids;
+}
+
+// A thread that adds |kEvents| events with its own source id.
+class AddEventsThread : public base::SimpleThread {
+ public:
+  AddEventsThread(NetLogLogger* logger, int source_id)
+      : base::SimpleThread("NetLogLoggerTest"),
+        logger_(logger),
+        source_id_(source_id) {
+  }
+
+  virtual void Run() OVERRIDE {
+    for (int i = 0; i < kEvents; ++i)
+      AddEvent(logger_, source_id_);
+  }
+
+ private:
+  NetLogLogger* logger_;
+  const int source_id_;
+
+  DISALLOW_COPY_AND_ASSIGN(AddEventsThread);
+};
+
+// Parameters whose value can change after they have been logged, as response
+// headers can.
+class MutableParameters : public net::NetLog::EventParameters {
+ public:
+  explicit MutableParameters(const std::string& value) : value_(value) {}
+
+  void set_value(const std::string& value) { value_ = value; }
+
+  virtual base::Value* ToValue() const OVERRIDE {
+    DictionaryValue* dict = new DictionaryValue();
+    dict->SetString("value", value_);
+    return dict;
+  }
+
+ private:
+  virtual ~MutableParameters() {}
+
+  std::string value_;
+
+  DISALLOW_COPY_AND_ASSIGN(MutableParameters);
+};
+
+}  // namespace
+
+// Events added on one thread are written in the order they were added.
+TEST(NetLogLoggerTest, WritesEventsInOrder) {
+  ScopedTempDir temp_dir;
+  ASSERT_TRUE(temp_dir.CreateUniqueTempDir());
+  FilePath log_path = temp_dir.path().AppendASCII("net_log.json");
+
+  {
+    NetLogLogger logger(log_path);
+    for (int i = 0; i < kEvents; ++i)
+      AddEvent(&logger, i);
+  }
+
+  std::vector<int> ids = ReadSourceIds(log_path);
+  ASSERT_EQ(static_cast<size_t>(kEvents), ids.size());
+  for (int i = 0; i < kEvents; ++i)
+    EXPECT_EQ(i, ids[i]);
+}
+
+// No events are lost when several threads add them at once.
+TEST(NetLogLoggerTest, AddEventsFromManyThreads) {
+  ScopedTempDir temp_dir;
+  ASSERT_TRUE(temp_dir.CreateUniqueTempDir());
+  FilePath log_path = temp_dir.path().AppendASCII("net_log.json");
+
+  {
+    NetLogLogger logger(log_path);
+    scoped_ptr<AddEventsThread> threads[kThreads];
+    for (int i = 0; i < kThreads; ++i) {
+      threads[i].reset(new AddEventsThread(&logger, i));
+      threads[i]->Start();
+    }
+    for (int i = 0; i < kThreads; ++i)
+      threads[i]->Join();
+  }
+
+  std::vector<int> ids = ReadSourceIds(log_path);
+  ASSERT_EQ(static_cast<size_t>(kThreads * kEvents), ids.size());
+  std::vector<int> counts(kThreads, 0);
+  for (size_t i = 0; i < ids.size(); ++i) {
+    ASSERT_LE(0, ids[i]);
+    ASSERT_GT(kThreads, ids[i]);
+    counts[ids[i]]++;
+  }
+  for (int i = 0; i < kThreads; ++i)
+    EXPECT_EQ(kEvents, counts[i]);
+}
+
+// Parameters are written as they were when the event was added.
+TEST(NetLogLoggerTest, SerializesParametersWhenAdded) {
+  ScopedTempDir temp_dir;
+  ASSERT_TRUE(temp_dir.CreateUniqueTempDir());
+  FilePath log_path = temp_dir.path().AppendASCII("net_log.json");
+
+  {
+    NetLogLogger logger(log_path);
+    scoped_refptr<MutableParameters> params(new MutableParameters("before"));
+    logger.OnAddEntry(net::NetLog::TYPE_CANCELLED, base::TimeTicks::Now(),
+                      net::NetLog::Source(net::NetLog::SOURCE_NONE, 1),
+                      net::NetLog::PHASE_NONE, params);
+    params->set_value("after");
+  }
+
+  std::string contents;
+  ASSERT_TRUE(file_util::ReadFileToString(log_path, &contents));
+  EXPECT_NE(std::string::npos, contents.find("\"value\":\"before\""));
+  EXPECT_EQ(std::string::npos, contents.find("after"));
+}
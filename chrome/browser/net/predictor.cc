@@ -31,6 +31,7 @@
 #include "content/public/browser/browser_thread.h"
 #include "net/base/address_list.h"
 #include "net/base/completion_callback.h"
+#include "net/base/host_cache.h"
 #include "net/base/host_port_pair.h"
 #include "net/base/host_resolver.h"
 #include "net/base/net_errors.h"
@@ -157,6 +158,8 @@ void Predictor::RegisterUserPrefs(PrefService* user_prefs) {
                                PrefService::UNSYNCABLE_PREF);
   user_prefs->RegisterListPref(prefs::kDnsPrefetchingHostReferralList,
                                PrefService::UNSYNCABLE_PREF);
+  user_prefs->RegisterListPref(prefs::kDnsPrefetchingHostCache,
+                               PrefService::UNSYNCABLE_PREF);
 }
 
 // --------------------- Start UI methods. ------------------------------------
@@ -179,13 +182,17 @@ void Predictor::InitNetworkPredictor(PrefService* user_prefs,
       static_cast<base::ListValue*>(user_prefs->GetList(
           prefs::kDnsPrefetchingHostReferralList)->DeepCopy());
 
+  base::ListValue* host_cache_list =
+      static_cast<base::ListValue*>(user_prefs->GetList(
+          prefs::kDnsPrefetchingHostCache)->DeepCopy());
+
   BrowserThread::PostTask(
       BrowserThread::IO,
       FROM_HERE,
       base::Bind(
           &Predictor::FinalizeInitializationOnIOThread,
           base::Unretained(this),
-          urls, referral_list,
+          urls, referral_list, host_cache_list,
           io_thread, predictor_enabled));
 }
 
@@ -650,6 +657,7 @@ void Predictor::DiscardInitialNavigationHistory() {
 void Predictor::FinalizeInitializationOnIOThread(
     const UrlList& startup_urls,
     base::ListValue* referral_list,
+    base::ListValue* host_cache_list,
     IOThread* io_thread,
     bool predictor_enabled) {
   DCHECK(BrowserThread::CurrentlyOn(BrowserThread::IO));
@@ -658,6 +666,13 @@ void Predictor::FinalizeInitializationOnIOThread(
   initial_observer_.reset(new InitialObserver());
   host_resolver_ = io_thread->globals()->host_resolver.get();
 
+  // Restore last session's resolutions before anything is resolved, so that
+  // the startup prefetches below can be served from (possibly stale) entries.
+  net::HostCache* host_cache = host_resolver_->GetHostCache();
+  if (predictor_enabled_ && host_cache)
+    host_cache->RestoreFromListValue(*host_cache_list);
+  delete host_cache_list;
+
   // base::WeakPtrFactory instances need to be created and destroyed
   // on the same thread. The predictor lives on the IO thread and will die
   // from there so now that we're on the IO thread we need to properly
@@ -728,6 +743,7 @@ void Predictor::DnsPrefetchMotivatedList(
 static void SaveDnsPrefetchStateForNextStartupAndTrimOnIOThread(
     base::ListValue* startup_list,
     base::ListValue* referral_list,
+    base::ListValue* host_cache_list,
     base::WaitableEvent* completion,
     Predictor* predictor) {
   DCHECK(BrowserThread::CurrentlyOn(BrowserThread::IO));
@@ -737,7 +753,7 @@ static void SaveDnsPrefetchStateForNextStartupAndTrimOnIOThread(
     return;
   }
   predictor->SaveDnsPrefetchStateForNextStartupAndTrim(
-      startup_list, referral_list, completion);
+      startup_list, referral_list, host_cache_list, completion);
 }
 
 void Predictor::SaveStateForNextStartupAndTrim(PrefService* prefs) {
@@ -749,10 +765,13 @@ void Predictor::SaveStateForNextStartupAndTrim(PrefService* prefs) {
   ListPrefUpdate update_startup_list(prefs, prefs::kDnsPrefetchingStartupList);
   ListPrefUpdate update_referral_list(prefs,
                                       prefs::kDnsPrefetchingHostReferralList);
+  ListPrefUpdate update_host_cache_list(prefs,
+                                        prefs::kDnsPrefetchingHostCache);
   if (BrowserThread::CurrentlyOn(BrowserThread::IO)) {
     SaveDnsPrefetchStateForNextStartupAndTrimOnIOThread(
         update_startup_list.Get(),
         update_referral_list.Get(),
+        update_host_cache_list.Get(),
         &completion,
         this);
   } else {
@@ -763,6 +782,7 @@ void Predictor::SaveStateForNextStartupAndTrim(PrefService* prefs) {
             &SaveDnsPrefetchStateForNextStartupAndTrimOnIOThread,
             update_startup_list.Get(),
             update_referral_list.Get(),
+            update_host_cache_list.Get(),
             &completion,
             this));
 
@@ -780,6 +800,7 @@ void Predictor::SaveStateForNextStartupAndTrim(PrefService* prefs) {
 void Predictor::SaveDnsPrefetchStateForNextStartupAndTrim(
     base::ListValue* startup_list,
     base::ListValue* referral_list,
+    base::ListValue* host_cache_list,
     base::WaitableEvent* completion) {
   DCHECK(BrowserThread::CurrentlyOn(BrowserThread::IO));
   if (initial_observer_.get())
@@ -790,6 +811,30 @@ void Predictor::SaveDnsPrefetchStateForNextStartupAndTrim(
   TrimReferrersNow();
   SerializeReferrers(referral_list);
 
+  host_cache_list->Clear();
+  net::HostCache* host_cache =
+      host_resolver_ ? host_resolver_->GetHostCache() : NULL;
+  if (host_cache) {
+    // The host cache is shared with off the record profiles, which have no
+    // Predictor. Only the names saved in the lists above are known to come
+    // from this profile, so only their resolutions are saved.
+    std::set<std::string> hostnames;
+    for (size_t i = 0; i < startup_list->GetSize(); ++i) {
+      std::string url_spec;
+      if (startup_list->GetString(i, &url_spec))
+        hostnames.insert(GURL(url_spec).host());
+    }
+    for (Referrers::const_iterator it = referrers_.begin();
+         it != referrers_.end(); ++it) {
+      hostnames.insert(it->first.host());
+      for (Referrer::const_iterator sub = it->second.begin();
+           sub != it->second.end(); ++sub) {
+        hostnames.insert(sub->first.host());
+      }
+    }
+    host_cache->GetAsListValue(hostnames, host_cache_list);
+  }
+
   completion->Signal();
 }
 
@@ -4,6 +4,7 @@
 
 #include "chrome/browser/net/sqlite_persistent_cookie_store.h"
 
+#include <algorithm>
 #include <list>
 #include <map>
 #include <set>
@@ -52,10 +53,16 @@ using content::BrowserThread;
 // CompleteLoadForKeyOnIOThread to the IO thread to notify the caller of
 // SQLitePersistentCookieStore::LoadCookiesForKey that that load is complete.
 //
+// The full load goes through the domain keys starting with the most recently
+// used ones, which are the most likely to be needed by the first navigations.
+//
 // Subsequent to loading, mutations may be queued by any thread using
-// AddCookie, UpdateCookieAccessTime, and DeleteCookie. These are flushed to
-// disk on the DB thread every 30 seconds, 512 operations, or call to Flush(),
-// whichever occurs first.
+// AddCookie, UpdateCookieAccessTime, and DeleteCookie. Operations on a cookie
+// that is already waiting to be written are merged with the pending one (for
+// instance, only the last access time update of a cookie is written, and a
+// cookie deleted before it was written never reaches the disk). These are
+// flushed to disk on the DB thread every 30 seconds, 512 operations, or call
+// to Flush(), whichever occurs first.
 class SQLitePersistentCookieStore::Backend
     : public base::RefCountedThreadSafe<SQLitePersistentCookieStore::Backend> {
  public:
@@ -66,6 +73,7 @@ class SQLitePersistentCookieStore::Backend
         clear_local_state_on_exit_(false),
         initialized_(false),
         restore_old_session_cookies_(restore_old_session_cookies),
+        use_write_ahead_log_(false),
         num_cookies_read_(0),
         num_priority_waiting_(0),
         total_priority_requests_(0) {
@@ -96,6 +104,10 @@ class SQLitePersistentCookieStore::Backend
 
   void SetClearLocalStateOnExit(bool clear_local_state);
 
+  // Uses a write-ahead log instead of a rollback journal. Must be called
+  // before Load().
+  void EnableWriteAheadLog();
+
  private:
   friend class base::RefCountedThreadSafe<SQLitePersistentCookieStore::Backend>;
 
@@ -121,7 +133,9 @@ class SQLitePersistentCookieStore::Backend
         : op_(op), cc_(cc) { }
 
     OperationType op() const { return op_; }
+    void set_op(OperationType op) { op_ = op; }
     const net::CookieMonster::CanonicalCookie& cc() const { return cc_; }
+    void set_cc(const net::CookieMonster::CanonicalCookie& cc) { cc_ = cc; }
 
    private:
     OperationType op_;
@@ -176,6 +190,10 @@ class SQLitePersistentCookieStore::Backend
   // Batch a cookie operation (add or delete)
   void BatchOperation(PendingOperation::OperationType op,
                       const net::CookieMonster::CanonicalCookie& cc);
+  // Merges |op| on |cc| into the pending operation for the same cookie, if
+  // possible. Returns false if |op| has to be queued on its own.
+  bool CoalesceOperation(PendingOperation::OperationType op,
+                         const net::CookieMonster::CanonicalCookie& cc);
   // Commit our pending operations to the database.
   void Commit();
   // Close() executed on the background thread.
@@ -190,9 +208,13 @@ class SQLitePersistentCookieStore::Backend
   typedef std::list<PendingOperation*> PendingOperationsList;
   PendingOperationsList pending_;
   PendingOperationsList::size_type num_pending_;
+  // The last pending operation of each cookie, by creation time.
+  typedef std::map<int64, PendingOperationsList::iterator> PendingCookiesMap;
+  PendingCookiesMap pending_cookies_;
   // True if the persistent store should be deleted upon destruction.
   bool clear_local_state_on_exit_;
-  // Guard |cookies_|, |pending_|, |num_pending_|, |clear_local_state_on_exit_|
+  // Guard |cookies_|, |pending_|, |num_pending_|, |pending_cookies_|,
+  // |clear_local_state_on_exit_|
   base::Lock lock_;
 
   // Temporary buffer for cookies loaded from DB. Accumulates cookies to reduce
@@ -203,12 +225,19 @@ class SQLitePersistentCookieStore::Backend
   // Map of domain keys(eTLD+1) to domains/hosts that are to be loaded from DB.
   std::map<std::string, std::set<std::string> > keys_to_load_;
 
+  // The domain keys in the order used by ChainLoadCookies(): most recently
+  // accessed first. Keys that were already loaded on demand are skipped.
+  std::list<std::string> keys_load_order_;
+
   // Indicates if DB has been initialized.
   bool initialized_;
 
   // If false, we should filter out session cookies when reading the DB.
   bool restore_old_session_cookies_;
 
+  // If true, the database uses WAL journaling (see EnableWriteAheadLog()).
+  bool use_write_ahead_log_;
+
   // The cumulative time spent loading the cookies on the DB thread. Incremented
   // and reported from the DB thread.
   base::TimeDelta cookie_load_duration_;
@@ -487,6 +516,15 @@ bool SQLitePersistentCookieStore::Backend::InitializeDatabase() {
 
   db_->set_error_delegate(GetErrorHandlerForCookieDb());
 
+  // With a write-ahead log, a commit appends to the log instead of writing
+  // the journal and the database, and it only needs to be synced when the log
+  // is copied back to the database.
+  if (use_write_ahead_log_ &&
+      (!db_->Execute("PRAGMA journal_mode = WAL") ||
+       !db_->Execute("PRAGMA synchronous = NORMAL"))) {
+    LOG(WARNING) << "Unable to use a write-ahead log for the cookie DB.";
+  }
+
   if (!EnsureDatabaseVersion() || !InitTable(db_.get())) {
     NOTREACHED() << "Unable to open cookie DB.";
     db_.reset();
@@ -501,9 +539,9 @@ bool SQLitePersistentCookieStore::Backend::InitializeDatabase() {
 
   start = base::Time::Now();
 
-  // Retrieve all the domains
+  // Retrieve all the domains, along with the last time they were used.
   sql::Statement smt(db_->GetUniqueStatement(
-    "SELECT DISTINCT host_key FROM cookies"));
+    "SELECT host_key, MAX(last_access_utc) FROM cookies GROUP BY host_key"));
 
   if (!smt.is_valid()) {
     db_.reset();
@@ -511,6 +549,7 @@ bool SQLitePersistentCookieStore::Backend::InitializeDatabase() {
   }
 
   // Build a map of domain keys (always eTLD+1) to domains.
+  std::map<std::string, int64> last_access;
   while (smt.Step()) {
     std::string domain = smt.ColumnString(0);
     std::string key =
@@ -522,8 +561,20 @@ bool SQLitePersistentCookieStore::Backend::InitializeDatabase() {
       it = keys_to_load_.insert(std::make_pair
                                 (key, std::set<std::string>())).first;
     it->second.insert(domain);
+
+    int64& key_last_access = last_access[key];
+    key_last_access = std::max(key_last_access, smt.ColumnInt64(1));
   }
 
+  std::vector<std::pair<int64, std::string> > keys_by_access;
+  for (std::map<std::string, int64>::const_iterator it = last_access.begin();
+       it != last_access.end(); ++it) {
+    keys_by_access.push_back(std::make_pair(it->second, it->first));
+  }
+  std::sort(keys_by_access.begin(), keys_by_access.end());
+  for (size_t i = keys_by_access.size(); i > 0; --i)
+    keys_load_order_.push_back(keys_by_access[i - 1].second);
+
   UMA_HISTOGRAM_CUSTOM_TIMES(
     "Cookie.TimeInitializeDomainMap",
     base::Time::Now() - start,
@@ -545,9 +596,15 @@ void SQLitePersistentCookieStore::Backend::ChainLoadCookies(
     // Close() has been called on this store.
     load_success = false;
   } else if (keys_to_load_.size() > 0) {
-    // Load cookies for the first domain key.
+    // Load cookies for the most recently used domain key that is not loaded
+    // yet.
     std::map<std::string, std::set<std::string> >::iterator
-      it = keys_to_load_.begin();
+      it = keys_to_load_.end();
+    while (it == keys_to_load_.end()) {
+      DCHECK(!keys_load_order_.empty());
+      it = keys_to_load_.find(keys_load_order_.front());
+      keys_load_order_.pop_front();
+    }
     load_success = LoadCookiesForDomains(it->second);
     keys_to_load_.erase(it);
   }
@@ -760,13 +817,15 @@ void SQLitePersistentCookieStore::Backend::BatchOperation(
   static const size_t kCommitAfterBatchSize = 512;
   DCHECK(!BrowserThread::CurrentlyOn(BrowserThread::DB));
 
-  // We do a full copy of the cookie here, and hopefully just here.
-  scoped_ptr<PendingOperation> po(new PendingOperation(op, cc));
-
   PendingOperationsList::size_type num_pending;
   {
     base::AutoLock locked(lock_);
-    pending_.push_back(po.release());
+    if (CoalesceOperation(op, cc))
+      return;
+
+    // We do a full copy of the cookie here, and hopefully just here.
+    pending_.push_back(new PendingOperation(op, cc));
+    pending_cookies_[cc.CreationDate().ToInternalValue()] = --pending_.end();
     num_pending = ++num_pending_;
   }
 
@@ -784,6 +843,47 @@ void SQLitePersistentCookieStore::Backend::BatchOperation(
   }
 }
 
+bool SQLitePersistentCookieStore::Backend::CoalesceOperation(
+    PendingOperation::OperationType op,
+    const net::CookieMonster::CanonicalCookie& cc) {
+  lock_.AssertAcquired();
+
+  // The creation time is the primary key of the cookies table.
+  PendingCookiesMap::iterator it =
+      pending_cookies_.find(cc.CreationDate().ToInternalValue());
+  if (it == pending_cookies_.end())
+    return false;
+
+  PendingOperation* po = *it->second;
+  switch (op) {
+    case PendingOperation::COOKIE_UPDATEACCESS:
+      // Writing the cookie that is already queued with its new access time
+      // takes care of this update.
+      if (po->op() == PendingOperation::COOKIE_DELETE)
+        return false;
+      po->set_cc(cc);
+      return true;
+
+    case PendingOperation::COOKIE_DELETE:
+      if (po->op() == PendingOperation::COOKIE_UPDATEACCESS) {
+        po->set_op(PendingOperation::COOKIE_DELETE);
+        return true;
+      }
+      if (po->op() == PendingOperation::COOKIE_ADD) {
+        // The cookie never made it to the database.
+        pending_.erase(it->second);
+        pending_cookies_.erase(it);
+        delete po;
+        num_pending_--;
+        return true;
+      }
+      return false;
+
+    default:
+      return false;
+  }
+}
+
 void SQLitePersistentCookieStore::Backend::Commit() {
   DCHECK(BrowserThread::CurrentlyOn(BrowserThread::DB));
 
@@ -791,6 +891,7 @@ void SQLitePersistentCookieStore::Backend::Commit() {
   {
     base::AutoLock locked(lock_);
     pending_.swap(ops);
+    pending_cookies_.clear();
     num_pending_ = 0;
   }
 
@@ -913,6 +1014,11 @@ void SQLitePersistentCookieStore::Backend::SetClearLocalStateOnExit(
   clear_local_state_on_exit_ = clear_local_state;
 }
 
+void SQLitePersistentCookieStore::Backend::EnableWriteAheadLog() {
+  DCHECK(!initialized_);
+  use_write_ahead_log_ = true;
+}
+
 void SQLitePersistentCookieStore::Backend::DeleteSessionCookies() {
   DCHECK(BrowserThread::CurrentlyOn(BrowserThread::DB));
   if (!db_->Execute("DELETE FROM cookies WHERE persistent == 0"))
@@ -959,6 +1065,11 @@ void SQLitePersistentCookieStore::SetClearLocalStateOnExit(
     backend_->SetClearLocalStateOnExit(clear_local_state);
 }
 
+void SQLitePersistentCookieStore::EnableWriteAheadLog() {
+  if (backend_.get())
+    backend_->EnableWriteAheadLog();
+}
+
 void SQLitePersistentCookieStore::Flush(const base::Closure& callback) {
   if (backend_.get())
     backend_->Flush(callback);
@@ -1,4 +1,4 @@
-// Copyright (c) 2011 The Chromium Authors. All rights reserved.
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
@@ -6,6 +6,7 @@
 #include "base/message_loop.h"
 #include "base/perftimer.h"
 #include "base/scoped_temp_dir.h"
+#include "base/stl_util.h"
 #include "base/stringprintf.h"
 #include "base/synchronization/waitable_event.h"
 #include "base/test/thread_test_helper.h"
@@ -23,7 +24,8 @@ class SQLitePersistentCookieStorePerfTest : public testing::Test {
       : db_thread_(BrowserThread::DB),
         io_thread_(BrowserThread::IO),
         loaded_event_(false, false),
-        key_loaded_event_(false, false) {
+        key_loaded_event_(false, false),
+        flushed_event_(false, false) {
   }
 
   void OnLoaded(
@@ -38,6 +40,10 @@ class SQLitePersistentCookieStorePerfTest : public testing::Test {
     key_loaded_event_.Signal();
   }
 
+  void OnFlushed() {
+    flushed_event_.Signal();
+  }
+
   void Load() {
     store_->Load(base::Bind(&SQLitePersistentCookieStorePerfTest::OnLoaded,
                                 base::Unretained(this)));
@@ -49,7 +55,7 @@ class SQLitePersistentCookieStorePerfTest : public testing::Test {
     io_thread_.Start();
     ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
     store_ = new SQLitePersistentCookieStore(
-      temp_dir_.path().Append(chrome::kCookieFilename));
+      temp_dir_.path().Append(chrome::kCookieFilename), false);
     std::vector<net::CookieMonster::CanonicalCookie*> cookies;
     Load();
     ASSERT_EQ(0u, cookies_.size());
@@ -64,7 +70,7 @@ class SQLitePersistentCookieStorePerfTest : public testing::Test {
           net::CookieMonster::CanonicalCookie(gurl,
             base::StringPrintf("Cookie_%d", cookie_num), "1",
             domain_name, "/", std::string(), std::string(),
-            t, t, t, false, false, true));
+            t, t, t, false, false, true, true));
       }
     }
     // Replace the store effectively destroying the current one and forcing it
@@ -77,7 +83,7 @@ class SQLitePersistentCookieStorePerfTest : public testing::Test {
     ASSERT_TRUE(helper->Run());
 
     store_ = new SQLitePersistentCookieStore(
-      temp_dir_.path().Append(chrome::kCookieFilename));
+      temp_dir_.path().Append(chrome::kCookieFilename), false);
   }
 
  protected:
@@ -85,6 +91,7 @@ class SQLitePersistentCookieStorePerfTest : public testing::Test {
   content::TestBrowserThread io_thread_;
   base::WaitableEvent loaded_event_;
   base::WaitableEvent key_loaded_event_;
+  base::WaitableEvent flushed_event_;
   std::vector<net::CookieMonster::CanonicalCookie*> cookies_;
   ScopedTempDir temp_dir_;
   scoped_refptr<SQLitePersistentCookieStore> store_;
@@ -114,3 +121,54 @@ TEST_F(SQLitePersistentCookieStorePerfTest, TestLoadPerformance) {
 
   ASSERT_EQ(15000U, cookies_.size());
 }
+
+// Test the performance of writing the access time updates of a browsing
+// session: every loaded cookie is used many times before the next commit.
+TEST_F(SQLitePersistentCookieStorePerfTest, TestUpdateAccessTimePerformance) {
+  Load();
+  ASSERT_EQ(15000U, cookies_.size());
+
+  PerfTimeLogger timer("Update access time of all cookies 10 times");
+  base::Time t = base::Time::Now();
+  for (int i = 0; i < 10; ++i) {
+    t += base::TimeDelta::FromSeconds(1);
+    for (size_t j = 0; j < cookies_.size(); ++j) {
+      cookies_[j]->SetLastAccessDate(t);
+      store_->UpdateCookieAccessTime(*cookies_[j]);
+    }
+  }
+  store_->Flush(base::Bind(&SQLitePersistentCookieStorePerfTest::OnFlushed,
+                           base::Unretained(this)));
+  flushed_event_.Wait();
+  timer.Done();
+
+  STLDeleteContainerPointers(cookies_.begin(), cookies_.end());
+  cookies_.clear();
+}
+
+// Same as above, with the database in write-ahead log mode.
+TEST_F(SQLitePersistentCookieStorePerfTest,
+       TestUpdateAccessTimeWriteAheadLogPerformance) {
+  store_ = new SQLitePersistentCookieStore(
+    temp_dir_.path().Append(chrome::kCookieFilename), false);
+  store_->EnableWriteAheadLog();
+  Load();
+  ASSERT_EQ(15000U, cookies_.size());
+
+  PerfTimeLogger timer("Update access time of all cookies 10 times, WAL");
+  base::Time t = base::Time::Now();
+  for (int i = 0; i < 10; ++i) {
+    t += base::TimeDelta::FromSeconds(1);
+    for (size_t j = 0; j < cookies_.size(); ++j) {
+      cookies_[j]->SetLastAccessDate(t);
+      store_->UpdateCookieAccessTime(*cookies_[j]);
+    }
+  }
+  store_->Flush(base::Bind(&SQLitePersistentCookieStorePerfTest::OnFlushed,
+                           base::Unretained(this)));
+  flushed_event_.Wait();
+  timer.Done();
+
+  STLDeleteContainerPointers(cookies_.begin(), cookies_.end());
+  cookies_.clear();
+}
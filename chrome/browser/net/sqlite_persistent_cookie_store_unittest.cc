@@ -208,6 +208,70 @@ TEST_F(SQLitePersistentCookieStoreTest, TestPersistance) {
   ASSERT_EQ(0U, cookies.size());
 }
 
+// Test that operations on a cookie that is waiting to be written are merged.
+TEST_F(SQLitePersistentCookieStoreTest, TestCoalescePendingOperations) {
+  InitializeStore(false);
+  base::Time t = base::Time::Now();
+  net::CookieMonster::CanonicalCookie updated(
+      GURL(), "A", "B", "http://foo.bar", "/", std::string(), std::string(),
+      t, t, t, false, false, true, true);
+  net::CookieMonster::CanonicalCookie deleted(
+      GURL(), "C", "D", "http://foo.bar", "/", std::string(), std::string(),
+      t + base::TimeDelta::FromInternalValue(10), t, t,
+      false, false, true, true);
+
+  // The cookie that is deleted before the commit is never written, and only
+  // the last access time of the other one is.
+  store_->AddCookie(updated);
+  store_->AddCookie(deleted);
+  for (int i = 1; i <= 10; i++) {
+    updated.SetLastAccessDate(t + base::TimeDelta::FromSeconds(i));
+    store_->UpdateCookieAccessTime(updated);
+  }
+  store_->DeleteCookie(deleted);
+  DestroyStore();
+
+  std::vector<net::CookieMonster::CanonicalCookie*> cookies;
+  CreateAndLoad(false, &cookies);
+  ASSERT_EQ(1U, cookies.size());
+  ASSERT_STREQ("A", cookies[0]->Name().c_str());
+  EXPECT_EQ(t + base::TimeDelta::FromSeconds(10),
+            cookies[0]->LastAccessDate());
+
+  // Updates followed by a delete of a cookie on disk remove it.
+  updated.SetLastAccessDate(t + base::TimeDelta::FromSeconds(20));
+  store_->UpdateCookieAccessTime(updated);
+  store_->DeleteCookie(updated);
+  DestroyStore();
+  STLDeleteContainerPointers(cookies.begin(), cookies.end());
+  cookies.clear();
+
+  CreateAndLoad(false, &cookies);
+  ASSERT_EQ(0U, cookies.size());
+}
+
+// Test that a store using a write-ahead log persists its cookies.
+TEST_F(SQLitePersistentCookieStoreTest, TestWriteAheadLog) {
+  store_ = new SQLitePersistentCookieStore(
+      temp_dir_.path().Append(chrome::kCookieFilename), false);
+  store_->EnableWriteAheadLog();
+  std::vector<net::CookieMonster::CanonicalCookie*> cookies;
+  Load(&cookies);
+  ASSERT_EQ(0U, cookies.size());
+  AddCookie("A", "B", "http://foo.bar", "/", base::Time::Now());
+  DestroyStore();
+
+  store_ = new SQLitePersistentCookieStore(
+      temp_dir_.path().Append(chrome::kCookieFilename), false);
+  store_->EnableWriteAheadLog();
+  Load(&cookies);
+  ASSERT_EQ(1U, cookies.size());
+  ASSERT_STREQ("A", cookies[0]->Name().c_str());
+  ASSERT_STREQ("B", cookies[0]->Value().c_str());
+  STLDeleteContainerPointers(cookies.begin(), cookies.end());
+  cookies.clear();
+}
+
 // Test that priority load of cookies for a specfic domain key could be
 // completed before the entire store is loaded
 TEST_F(SQLitePersistentCookieStoreTest, TestLoadCookiesForKey) {
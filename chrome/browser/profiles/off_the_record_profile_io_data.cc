@@ -6,6 +6,7 @@
 
 #include "base/bind.h"
 #include "base/command_line.h"
+#include "base/compiler_specific.h"
 #include "base/logging.h"
 #include "base/stl_util.h"
 #include "build/build_config.h"
@@ -23,6 +24,7 @@
 #include "content/public/browser/resource_context.h"
 #include "net/base/default_server_bound_cert_store.h"
 #include "net/base/server_bound_cert_service.h"
+#include "net/base/ssl_config_service.h"
 #include "net/ftp/ftp_network_layer.h"
 #include "net/http/http_cache.h"
 #include "net/http/http_server_properties_impl.h"
@@ -30,6 +32,45 @@
 
 using content::BrowserThread;
 
+namespace {
+
+// Hands out the profile's SSL configuration, except that TLS sessions are kept
+// out of the persistent session store.
+class OffTheRecordSSLConfigService : public net::SSLConfigService,
+                                     public net::SSLConfigService::Observer {
+ public:
+  explicit OffTheRecordSSLConfigService(net::SSLConfigService* service)
+      : service_(service) {
+    GetSSLConfig(&cached_config_);
+    service_->AddObserver(this);
+  }
+
+  virtual void GetSSLConfig(net::SSLConfig* config) OVERRIDE {
+    service_->GetSSLConfig(config);
+    config->persist_session = false;
+  }
+
+  virtual void OnSSLConfigChanged() OVERRIDE {
+    net::SSLConfig orig_config = cached_config_;
+    GetSSLConfig(&cached_config_);
+    ProcessConfigUpdate(orig_config, cached_config_);
+  }
+
+ private:
+  virtual ~OffTheRecordSSLConfigService() {
+    service_->RemoveObserver(this);
+  }
+
+  scoped_refptr<net::SSLConfigService> service_;
+
+  // The config last seen, so that changes can be passed on to observers.
+  net::SSLConfig cached_config_;
+
+  DISALLOW_COPY_AND_ASSIGN(OffTheRecordSSLConfigService);
+};
+
+}  // namespace
+
 OffTheRecordProfileIOData::Handle::Handle(Profile* profile)
     : io_data_(new OffTheRecordProfileIOData),
       profile_(profile),
@@ -164,6 +205,10 @@ void OffTheRecordProfileIOData::LazyInitializeInternal(
   ApplyProfileParamsToContext(main_context);
   ApplyProfileParamsToContext(extensions_context);
 
+  // For incognito, TLS sessions are not saved to disk.
+  main_context->set_ssl_config_service(
+      new OffTheRecordSSLConfigService(profile_params->ssl_config_service));
+
   main_context->set_transport_security_state(transport_security_state());
   extensions_context->set_transport_security_state(transport_security_state());
 
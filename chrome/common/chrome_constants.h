@@ -70,6 +70,7 @@ extern const FilePath::CharType kSafeBrowsingBaseFilename[];
 extern const FilePath::CharType kSingletonCookieFilename[];
 extern const FilePath::CharType kSingletonSocketFilename[];
 extern const FilePath::CharType kSingletonLockFilename[];
+extern const FilePath::CharType kSSLSessionStoreFilename[];
 extern const FilePath::CharType kThumbnailsFilename[];
 extern const FilePath::CharType kNewTabThumbnailsFilename[];
 extern const FilePath::CharType kTopSitesFilename[];
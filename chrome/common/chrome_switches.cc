@@ -620,6 +620,10 @@ const char kEnableSyncTabsForOtherClients[] =
 // Enables context menu for selecting groups of tabs.
 const char kEnableTabGroupsContextMenu[]    = "enable-tab-groups-context-menu";
 
+// Enables warming up sockets: groups that have needed several connections at
+// once get them connected as soon as the first request comes in.
+const char kEnableWarmSockets[]             = "enable-warm-sockets";
+
 // Spawns threads to watch for excessive delays in specified message loops.
 // User should set breakpoints on Alarm() to examine problematic thread.
 //
@@ -744,6 +748,10 @@ const char kHomePage[]                      = "homepage";
 // proxy connection, and the endpoint host in a SOCKS proxy connection).
 const char kHostRules[]                     = "host-rules";
 
+// The number of seconds an expired host resolver cache entry may still be used
+// while it is refreshed in the background. Defaults to zero.
+const char kHostResolverMaxStaleness[]      = "host-resolver-max-staleness";
+
 // The maximum number of concurrent host resolve requests (i.e. DNS) to allow
 // (not counting backup attempts which would also consume threads).
 // --host-resolver-retry-attempts must be set to zero for this to be exact.
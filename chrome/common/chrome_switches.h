@@ -178,6 +178,7 @@ extern const char kEnableSyncTabs[];
 extern const char kDisableSyncTabs[];
 extern const char kEnableSyncTabsForOtherClients[];
 extern const char kEnableTabGroupsContextMenu[];
+extern const char kEnableWarmSockets[];
 extern const char kEnableWatchdog[];
 extern const char kEnableWebsiteSettings[];
 extern const char kEnableWebSocketOverSpdy[];
@@ -205,6 +206,7 @@ extern const char kHelpShort[];
 extern const char kHideIcons[];
 extern const char kHomePage[];
 extern const char kHostRules[];
+extern const char kHostResolverMaxStaleness[];
 extern const char kHostResolverParallelism[];
 extern const char kHostResolverRetryAttempts[];
 extern const char kHostResolverRules[];
@@ -383,6 +383,11 @@ const char kDnsHostReferralList[] = "HostReferralList";
 const char kDnsPrefetchingHostReferralList[] =
     "dns_prefetching.host_referral_list";
 
+// The positive host resolver cache entries at shutdown for the names in
+// kDnsPrefetchingStartupList and kDnsPrefetchingHostReferralList, restored
+// during the next startup.
+const char kDnsPrefetchingHostCache[] = "dns_prefetching.host_cache";
+
 // Disables the SPDY protocol.
 const char kDisableSpdy[] = "spdy.disabled";
 
@@ -991,6 +996,10 @@ const char kCipherSuiteBlacklist[] = "ssl.cipher_suites.blacklist";
 const char kEnableOriginBoundCerts[] = "ssl.origin_bound_certs.enabled";
 const char kDisableSSLRecordSplitting[] = "ssl.ssl_record_splitting.disabled";
 
+// Base64 encoded key of the persisted TLS session store, encrypted with
+// Encryptor.  Only used on Windows and Mac.
+const char kSSLSessionStoreKey[] = "ssl.session_store.key";
+
 // The metrics client GUID and session ID.
 const char kMetricsClientID[] = "user_experience_metrics.client_id";
 const char kMetricsSessionID[] = "user_experience_metrics.session_id";
@@ -146,6 +146,7 @@ extern const char kDnsStartupPrefetchList[];  // OBSOLETE
 extern const char kDnsPrefetchingStartupList[];
 extern const char kDnsHostReferralList[];  // OBSOLETE
 extern const char kDnsPrefetchingHostReferralList[];
+extern const char kDnsPrefetchingHostCache[];
 extern const char kDisableSpdy[];
 extern const char kHttpServerProperties[];
 extern const char kSpdyServers[];
@@ -351,6 +352,7 @@ extern const char kTLS1Enabled[];
 extern const char kCipherSuiteBlacklist[];
 extern const char kEnableOriginBoundCerts[];
 extern const char kDisableSSLRecordSplitting[];
+extern const char kSSLSessionStoreKey[];
 extern const char kEnableMemoryInfo[];
 
 extern const char kMetricsClientID[];
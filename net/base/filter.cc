@@ -346,6 +346,10 @@ Filter::FilterStatus Filter::CopyOut(char* dest_buffer, int* dest_len) {
   }
 }
 
+bool Filter::IsPassThrough() const {
+  return false;
+}
+
 // static
 Filter* Filter::InitGZipFilter(FilterType type_id, int buffer_size) {
   scoped_ptr<GZipFilter> gz_filter(new GZipFilter());
@@ -397,6 +401,20 @@ void Filter::InitBuffer(int buffer_size) {
 }
 
 void Filter::PushDataIntoNextFilter() {
+  if (stream_data_len_ && IsPassThrough() &&
+      !next_filter_->stream_data_len() &&
+      next_filter_->stream_buffer_size() == stream_buffer_size_) {
+    // The next filter takes our pending input as is, and we take its empty
+    // buffer for the next round of input.
+    stream_buffer_.swap(next_filter_->stream_buffer_);
+    next_filter_->next_stream_data_ = next_stream_data_;
+    next_filter_->stream_data_len_ = stream_data_len_;
+    next_stream_data_ = NULL;
+    stream_data_len_ = 0;
+    last_status_ = FILTER_NEED_MORE_DATA;
+    return;
+  }
+
   IOBuffer* next_buffer = next_filter_->stream_buffer();
   int next_size = next_filter_->stream_buffer_size();
   last_status_ = ReadFilteredData(next_buffer->data(), &next_size);
@@ -158,7 +158,9 @@ class NET_EXPORT_PRIVATE Filter {
   // next_filter_, then it obtains data from this specific filter.
   FilterStatus ReadData(char* dest_buffer, int* dest_len);
 
-  // Returns a pointer to the stream_buffer_.
+  // Returns a pointer to the stream_buffer_.  A chain may swap the buffers of
+  // its filters while reading, so callers must get it again for each round
+  // of input rather than hold on to it.
   IOBuffer* stream_buffer() const { return stream_buffer_.get(); }
 
   // Returns the maximum size of stream_buffer_ in number of chars.
@@ -219,6 +221,11 @@ class NET_EXPORT_PRIVATE Filter {
   // Copy pre-filter data directly to destination buffer without decoding.
   FilterStatus CopyOut(char* dest_buffer, int* dest_len);
 
+  // Returns true if ReadFilteredData() currently copies its input out
+  // unchanged, with nothing buffered internally.  The chain then hands the
+  // input to the next filter without copying it.
+  virtual bool IsPassThrough() const;
+
   FilterStatus last_status() const { return last_status_; }
 
   // Buffer to hold the data to be filtered (the input queue).
@@ -254,7 +261,9 @@ class NET_EXPORT_PRIVATE Filter {
                                 const FilterContext& filter_context,
                                 int buffer_size);
 
-  // Helper function to empty our output into the next filter's input.
+  // Helper function to empty our output into the next filter's input.  If
+  // this filter is a pass through, its stream_buffer_ is swapped with the
+  // next filter's rather than copied into it.
   void PushDataIntoNextFilter();
 
   // Constructs a filter with an internal buffer of the given size.
@@ -151,6 +151,11 @@ Filter::FilterStatus GZipFilter::ReadFilteredData(char* dest_buffer,
   return status;
 }
 
+bool GZipFilter::IsPassThrough() const {
+  return decoding_status_ == DECODING_DONE &&
+      gzip_header_status_ == GZIP_GET_INVALID_HEADER;
+}
+
 Filter::FilterStatus GZipFilter::CheckGZipHeader() {
   DCHECK_EQ(gzip_header_status_, GZIP_CHECK_HEADER_IN_PROGRESS);
 
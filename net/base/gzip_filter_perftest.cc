@@ -0,0 +1,113 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <algorithm>
+#include <string>
+
+#if defined(USE_SYSTEM_ZLIB)
+#include <zlib.h>
+#else
+#include "third_party/zlib/zlib.h"
+#endif
+
+#include "base/logging.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/perftimer.h"
+#include "base/stringprintf.h"
+#include "net/base/filter.h"
+#include "net/base/io_buffer.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace net {
+
+namespace {
+
+const int kNumSmallResponses = 20000;
+const int kSmallResponseSize = 2 * 1024;
+const int kLargeResponseSize = 16 * 1024 * 1024;
+const int kOutputBufferSize = 32 * 1024;
+
+// Returns |size| bytes of text that compresses about as well as a web page.
+std::string MakeResponse(int size) {
+  std::string response;
+  for (int i = 0; static_cast<int>(response.size()) < size; ++i)
+    response.append(base::StringPrintf("<div id=\"item%d\">Item %d</div>\n",
+                                       i, i * 7919 % 10007));
+  response.resize(size);
+  return response;
+}
+
+// Returns |data| compressed with a gzip wrapper.
+std::string GZipCompress(const std::string& data) {
+  z_stream stream;
+  memset(&stream, 0, sizeof(stream));
+  // Adding 16 to the window bits makes zlib write a gzip header and trailer.
+  CHECK_EQ(Z_OK, deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+                              MAX_WBITS + 16, 8, Z_DEFAULT_STRATEGY));
+  std::string compressed(deflateBound(&stream, data.size()), '\0');
+  stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+  stream.avail_in = data.size();
+  stream.next_out = reinterpret_cast<Bytef*>(&compressed[0]);
+  stream.avail_out = compressed.size();
+  CHECK_EQ(Z_STREAM_END, deflate(&stream, Z_FINISH));
+  compressed.resize(compressed.size() - stream.avail_out);
+  deflateEnd(&stream);
+  return compressed;
+}
+
+// Decodes |compressed| with a new filter, feeding it as much input as its
+// buffer holds at a time, and returns the number of bytes decoded.
+int Decode(const std::string& compressed, char* output_buffer) {
+  scoped_ptr<Filter> filter(Filter::GZipFactory());
+  CHECK(filter.get());
+  int decoded = 0;
+  size_t offset = 0;
+  Filter::FilterStatus status = Filter::FILTER_NEED_MORE_DATA;
+  while (status != Filter::FILTER_DONE) {
+    if (status == Filter::FILTER_NEED_MORE_DATA) {
+      int input_size = std::min(static_cast<int>(compressed.size() - offset),
+                                filter->stream_buffer_size());
+      CHECK_GT(input_size, 0);
+      memcpy(filter->stream_buffer()->data(), compressed.data() + offset,
+             input_size);
+      filter->FlushStreamBuffer(input_size);
+      offset += input_size;
+    }
+    int output_size = kOutputBufferSize;
+    status = filter->ReadData(output_buffer, &output_size);
+    CHECK_NE(Filter::FILTER_ERROR, status);
+    decoded += output_size;
+  }
+  return decoded;
+}
+
+}  // namespace
+
+// Many small responses, where setting up a filter weighs the most.
+TEST(GZipFilterPerfTest, DecodeSmallResponses) {
+  std::string compressed = GZipCompress(MakeResponse(kSmallResponseSize));
+  scoped_array<char> output_buffer(new char[kOutputBufferSize]);
+
+  PerfTimer timer;
+  for (int i = 0; i < kNumSmallResponses; ++i)
+    ASSERT_EQ(kSmallResponseSize, Decode(compressed, output_buffer.get()));
+  LogPerfResult("GZipFilter_DecodeSmallResponses",
+                kNumSmallResponses / timer.Elapsed().InSecondsF(),
+                "responses/s");
+}
+
+// One large response, where inflate itself weighs the most.
+TEST(GZipFilterPerfTest, DecodeLargeResponse) {
+  std::string compressed = GZipCompress(MakeResponse(kLargeResponseSize));
+  scoped_array<char> output_buffer(new char[kOutputBufferSize]);
+
+  PerfTimer timer;
+  ASSERT_EQ(kLargeResponseSize, Decode(compressed, output_buffer.get()));
+  LogPerfResult("GZipFilter_DecodeLargeResponse",
+                kLargeResponseSize / timer.Elapsed().InSecondsF() /
+                    (1024 * 1024),
+                "MB/s");
+}
+
+}  // namespace net
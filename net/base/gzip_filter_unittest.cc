@@ -2,8 +2,10 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <algorithm>
 #include <fstream>
 #include <ostream>
+#include <vector>
 
 #if defined(USE_SYSTEM_ZLIB)
 #include <zlib.h>
@@ -239,6 +241,45 @@ class GZipUnitTest : public PlatformTest {
     ASSERT_TRUE(filter_.get());
   }
 
+  // The types are in Content-Encoding order, so |second| is the filter that
+  // reads the input.
+  void InitFilterChain(Filter::FilterType first, Filter::FilterType second,
+                       int buffer_size) {
+    std::vector<Filter::FilterType> filter_types;
+    filter_types.push_back(first);
+    filter_types.push_back(second);
+    filter_.reset(Filter::FactoryForTests(filter_types, filter_context_,
+                                          buffer_size));
+    ASSERT_TRUE(filter_.get());
+  }
+
+  // Feeds |input| to |filter_| a full stream buffer at a time, reading all the
+  // output after each round.  Records the stream buffer used for each round in
+  // |stream_buffers|.
+  std::string DecodeInRounds(const std::string& input,
+                             std::vector<IOBuffer*>* stream_buffers) {
+    const int buffer_size = filter_->stream_buffer_size();
+    std::string output;
+    for (size_t offset = 0; offset < input.size(); offset += buffer_size) {
+      int input_size = std::min(static_cast<int>(input.size() - offset),
+                                buffer_size);
+      stream_buffers->push_back(filter_->stream_buffer());
+      memcpy(filter_->stream_buffer()->data(), input.data() + offset,
+             input_size);
+      filter_->FlushStreamBuffer(input_size);
+      Filter::FilterStatus status;
+      do {
+        char output_buffer[kSmallBufferSize];
+        int output_size = sizeof(output_buffer);
+        status = filter_->ReadData(output_buffer, &output_size);
+        output.append(output_buffer, output_size);
+      } while (status == Filter::FILTER_OK);
+      if (status == Filter::FILTER_ERROR)
+        break;
+    }
+    return output;
+  }
+
   const char* source_buffer() const { return source_buffer_.data(); }
   int source_len() const { return static_cast<int>(source_buffer_.size()); }
 
@@ -394,4 +435,40 @@ TEST_F(GZipUnitTest, DecodeCorruptedHeader) {
   EXPECT_TRUE(code == Filter::FILTER_ERROR);
 }
 
+// A gzip filter helping sdch passes content that is not gzip through
+// unchanged.  Once it knows that, the chain hands each round of input on to
+// the next filter by swapping stream buffers instead of copying it.
+TEST_F(GZipUnitTest, PassThroughHandsInputDown) {
+  InitFilterChain(Filter::FILTER_TYPE_GZIP_HELPING_SDCH,
+                  Filter::FILTER_TYPE_GZIP_HELPING_SDCH, kSmallBufferSize);
+
+  std::string content;
+  for (int i = 0; i < 40; ++i)
+    content.append("Not gzip data. ");
+  std::vector<IOBuffer*> stream_buffers;
+  EXPECT_EQ(content, DecodeInRounds(content, &stream_buffers));
+
+  // The first round is copied, since the header has not been checked yet.
+  // From then on, the filters trade buffers at every round.
+  ASSERT_LE(3u, stream_buffers.size());
+  EXPECT_EQ(stream_buffers[0], stream_buffers[1]);
+  for (size_t i = 2; i < stream_buffers.size(); ++i)
+    EXPECT_NE(stream_buffers[i - 1], stream_buffers[i]);
+}
+
+// A gzip filter that is decoding never hands its input down.
+TEST_F(GZipUnitTest, DecodingKeepsStreamBuffer) {
+  InitFilterChain(Filter::FILTER_TYPE_GZIP_HELPING_SDCH,
+                  Filter::FILTER_TYPE_GZIP, kSmallBufferSize);
+
+  std::vector<IOBuffer*> stream_buffers;
+  std::string output = DecodeInRounds(
+      std::string(gzip_encode_buffer_, gzip_encode_len_), &stream_buffers);
+  EXPECT_EQ(source_buffer_, output);
+
+  ASSERT_LE(2u, stream_buffers.size());
+  for (size_t i = 1; i < stream_buffers.size(); ++i)
+    EXPECT_EQ(stream_buffers[0], stream_buffers[i]);
+}
+
 }  // namespace net
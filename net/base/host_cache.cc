@@ -5,10 +5,25 @@
 #include "net/base/host_cache.h"
 
 #include "base/logging.h"
+#include "base/string_number_conversions.h"
+#include "base/values.h"
 #include "net/base/net_errors.h"
+#include "net/base/net_util.h"
+#include "net/base/sys_addrinfo.h"
 
 namespace net {
 
+namespace {
+
+// Keys of the dictionaries written by GetAsListValue.
+const char kHostnameKey[] = "hostname";
+const char kAddressFamilyKey[] = "address_family";
+const char kFlagsKey[] = "flags";
+const char kExpirationKey[] = "expiration";
+const char kAddressesKey[] = "addresses";
+
+}  // namespace
+
 //-----------------------------------------------------------------------------
 
 HostCache::Entry::Entry(int error, const AddressList& addrlist)
@@ -30,11 +45,28 @@ HostCache::~HostCache() {
 
 const HostCache::Entry* HostCache::Lookup(const Key& key,
                                           base::TimeTicks now) {
+  bool is_stale;
+  const Entry* entry = LookupStale(key, now, &is_stale);
+  return is_stale ? NULL : entry;
+}
+
+const HostCache::Entry* HostCache::LookupStale(const Key& key,
+                                               base::TimeTicks now,
+                                               bool* is_stale) {
   DCHECK(CalledOnValidThread());
+  DCHECK(is_stale);
+  *is_stale = false;
   if (caching_is_disabled())
     return NULL;
 
-  return entries_.Get(key, now);
+  const Entry* entry = entries_.Get(key, now);
+  if (!entry)
+    return NULL;
+
+  // Only positive entries are kept past their expiration.
+  *is_stale = (entry->expiration <= now);
+  DCHECK(!*is_stale || entry->error == OK);
+  return entry;
 }
 
 void HostCache::Set(const Key& key,
@@ -46,7 +78,11 @@ void HostCache::Set(const Key& key,
   if (caching_is_disabled())
     return;
 
-  entries_.Put(key, Entry(error, addrlist), now, ttl);
+  Entry entry(error, addrlist);
+  entry.expiration = now + ttl;
+  if (error == OK)
+    ttl += max_staleness_;
+  entries_.Put(key, entry, now, ttl);
 }
 
 void HostCache::clear() {
@@ -54,6 +90,111 @@ void HostCache::clear() {
   entries_.Clear();
 }
 
+void HostCache::set_max_staleness(base::TimeDelta max_staleness) {
+  DCHECK(CalledOnValidThread());
+  DCHECK(max_staleness >= base::TimeDelta());
+  max_staleness_ = max_staleness;
+}
+
+base::TimeDelta HostCache::max_staleness() const {
+  DCHECK(CalledOnValidThread());
+  return max_staleness_;
+}
+
+void HostCache::GetAsListValue(const std::set<std::string>& hostnames,
+                               base::ListValue* list) const {
+  DCHECK(CalledOnValidThread());
+  DCHECK(list);
+  base::TimeTicks now = base::TimeTicks::Now();
+  base::Time wall_now = base::Time::Now();
+
+  for (EntryMap::Iterator it(entries_); it.HasNext(); it.Advance()) {
+    const Key& key = it.key();
+    const Entry& entry = it.value();
+    // Canonical names are not saved, so neither are entries that need them.
+    if (entry.error != OK || it.expiration() <= now ||
+        (key.host_resolver_flags & HOST_RESOLVER_CANONNAME) ||
+        hostnames.find(key.hostname) == hostnames.end()) {
+      continue;
+    }
+
+    base::ListValue* addresses = new base::ListValue();
+    for (const struct addrinfo* ai = entry.addrlist.head();
+         ai != NULL;
+         ai = ai->ai_next) {
+      addresses->Append(base::Value::CreateStringValue(NetAddressToString(ai)));
+    }
+
+    base::Time expiration = wall_now + (entry.expiration - now);
+    base::DictionaryValue* entry_dict = new base::DictionaryValue();
+    entry_dict->SetString(kHostnameKey, key.hostname);
+    entry_dict->SetInteger(kAddressFamilyKey, key.address_family);
+    entry_dict->SetInteger(kFlagsKey, key.host_resolver_flags);
+    entry_dict->SetString(kExpirationKey,
+                          base::Int64ToString(expiration.ToInternalValue()));
+    entry_dict->Set(kAddressesKey, addresses);
+    list->Append(entry_dict);
+  }
+}
+
+size_t HostCache::RestoreFromListValue(const base::ListValue& list) {
+  DCHECK(CalledOnValidThread());
+  if (caching_is_disabled())
+    return 0;
+
+  base::TimeTicks now = base::TimeTicks::Now();
+  base::Time wall_now = base::Time::Now();
+  size_t num_restored = 0;
+
+  for (size_t i = 0; i < list.GetSize(); ++i) {
+    base::DictionaryValue* entry_dict;
+    std::string hostname;
+    int address_family;
+    int flags;
+    std::string expiration_string;
+    int64 expiration_value;
+    base::ListValue* addresses;
+    if (!list.GetDictionary(i, &entry_dict) ||
+        !entry_dict->GetString(kHostnameKey, &hostname) ||
+        !entry_dict->GetInteger(kAddressFamilyKey, &address_family) ||
+        address_family < ADDRESS_FAMILY_UNSPECIFIED ||
+        address_family > ADDRESS_FAMILY_IPV6 ||
+        !entry_dict->GetInteger(kFlagsKey, &flags) ||
+        !entry_dict->GetString(kExpirationKey, &expiration_string) ||
+        !base::StringToInt64(expiration_string, &expiration_value) ||
+        !entry_dict->GetList(kAddressesKey, &addresses)) {
+      continue;
+    }
+
+    base::TimeDelta ttl =
+        base::Time::FromInternalValue(expiration_value) - wall_now;
+    if (ttl + max_staleness_ <= base::TimeDelta())
+      continue;
+
+    IPAddressList ip_addresses;
+    for (size_t j = 0; j < addresses->GetSize(); ++j) {
+      std::string address_string;
+      IPAddressNumber address;
+      if (addresses->GetString(j, &address_string) &&
+          ParseIPLiteralToNumber(address_string, &address)) {
+        ip_addresses.push_back(address);
+      }
+    }
+    if (ip_addresses.empty())
+      continue;
+
+    Key key(hostname, static_cast<AddressFamily>(address_family), flags);
+    if (entries_.Get(key, now))
+      continue;
+
+    Set(key, OK, AddressList::CreateFromIPAddressList(ip_addresses,
+                                                      std::string()),
+        now, ttl);
+    ++num_restored;
+  }
+  return num_restored;
+}
+
 size_t HostCache::size() const {
   DCHECK(CalledOnValidThread());
   return entries_.size();
@@ -6,6 +6,7 @@
 #define NET_BASE_HOST_CACHE_H_
 #pragma once
 
+#include <set>
 #include <string>
 
 #include "base/gtest_prod_util.h"
@@ -16,6 +17,10 @@
 #include "net/base/expiring_cache.h"
 #include "net/base/net_export.h"
 
+namespace base {
+class ListValue;
+}
+
 namespace net {
 
 // Cache used by HostResolver to map hostnames to their resolved result.
@@ -29,6 +34,10 @@ class NET_EXPORT HostCache : NON_EXPORTED_BASE(public base::NonThreadSafe) {
     // The resolve results for this entry.
     int error;
     AddressList addrlist;
+
+    // The time at which this entry stops being fresh. A positive entry may
+    // stay in the cache for up to |max_staleness()| longer.
+    base::TimeTicks expiration;
   };
 
   struct Key {
@@ -65,6 +74,12 @@ class NET_EXPORT HostCache : NON_EXPORTED_BASE(public base::NonThreadSafe) {
   // |now|. If there is no such entry, returns NULL.
   const Entry* Lookup(const Key& key, base::TimeTicks now);
 
+  // Same as Lookup, but also returns a positive entry that expired less than
+  // |max_staleness()| before |now|. Sets |is_stale| accordingly.
+  const Entry* LookupStale(const Key& key,
+                           base::TimeTicks now,
+                           bool* is_stale);
+
   // Overwrites or creates an entry for |key|.
   // (|error|, |addrlist|) is the value to set, |now| is the current time
   // |ttl| is the "time to live".
@@ -77,6 +92,23 @@ class NET_EXPORT HostCache : NON_EXPORTED_BASE(public base::NonThreadSafe) {
   // Empties the cache
   void clear();
 
+  // Positive entries set from now on are kept for |max_staleness| after they
+  // expire, to be returned by LookupStale. Defaults to zero.
+  void set_max_staleness(base::TimeDelta max_staleness);
+  base::TimeDelta max_staleness() const;
+
+  // Appends the positive entries for names in |hostnames| to |list| so that
+  // they can be restored in another session. The cache may be shared by
+  // off the record requests, so the caller must only pass names it is allowed
+  // to write to disk. Expiration times are stored in wall clock time.
+  void GetAsListValue(const std::set<std::string>& hostnames,
+                      base::ListValue* list) const;
+
+  // Adds the entries in |list|, as written by GetAsListValue, unless they are
+  // already in the cache or expired for longer than |max_staleness()|.
+  // Returns the number of entries added.
+  size_t RestoreFromListValue(const base::ListValue& list);
+
   // Returns the number of entries in the cache.
   size_t size() const;
 
@@ -100,6 +132,8 @@ class NET_EXPORT HostCache : NON_EXPORTED_BASE(public base::NonThreadSafe) {
   // a resolved result entry.
   EntryMap entries_;
 
+  base::TimeDelta max_staleness_;
+
   DISALLOW_COPY_AND_ASSIGN(HostCache);
 };
 
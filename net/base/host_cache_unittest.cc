@@ -8,7 +8,10 @@
 #include "base/stl_util.h"
 #include "base/string_util.h"
 #include "base/stringprintf.h"
+#include "base/values.h"
 #include "net/base/net_errors.h"
+#include "net/base/net_util.h"
+#include "net/base/sys_addrinfo.h"
 #include "testing/gtest/include/gtest/gtest.h"
 
 namespace net {
@@ -287,6 +290,90 @@ TEST(HostCacheTest, Clear) {
   EXPECT_EQ(0u, cache.size());
 }
 
+TEST(HostCacheTest, Stale) {
+  const base::TimeDelta kTTL = base::TimeDelta::FromSeconds(10);
+
+  HostCache cache(kMaxCacheEntries);
+  cache.set_max_staleness(base::TimeDelta::FromSeconds(5));
+
+  // Start at t=0.
+  base::TimeTicks now;
+  bool is_stale;
+
+  HostCache::Key key1 = Key("foobar.com");
+  HostCache::Key key2 = Key("foobar2.com");
+
+  cache.Set(key1, OK, AddressList(), now, kTTL);
+  cache.Set(key2, ERR_NAME_NOT_RESOLVED, AddressList(), now, kTTL);
+  EXPECT_TRUE(cache.LookupStale(key1, now, &is_stale));
+  EXPECT_FALSE(is_stale);
+
+  // Advance to t=10; both entries are expired, but only the positive one may
+  // still be used.
+  now += base::TimeDelta::FromSeconds(10);
+  EXPECT_FALSE(cache.Lookup(key1, now));
+  EXPECT_TRUE(cache.LookupStale(key1, now, &is_stale));
+  EXPECT_TRUE(is_stale);
+  EXPECT_FALSE(cache.LookupStale(key2, now, &is_stale));
+  EXPECT_FALSE(is_stale);
+
+  // Updating the entry makes it fresh again.
+  cache.Set(key1, OK, AddressList(), now, kTTL);
+  EXPECT_TRUE(cache.Lookup(key1, now));
+
+  // Advance to t=25; the entry has been stale for too long.
+  now += base::TimeDelta::FromSeconds(15);
+  EXPECT_FALSE(cache.LookupStale(key1, now, &is_stale));
+}
+
+TEST(HostCacheTest, SerializeAndRestore) {
+  const base::TimeDelta kTTL = base::TimeDelta::FromSeconds(100);
+
+  IPAddressNumber ip;
+  ASSERT_TRUE(ParseIPLiteralToNumber("192.168.1.1", &ip));
+  AddressList addrlist = AddressList::CreateFromIPAddress(ip, 0);
+
+  base::TimeTicks now = base::TimeTicks::Now();
+  HostCache cache(kMaxCacheEntries);
+  cache.Set(Key("foobar1.com"), OK, addrlist, now, kTTL);
+  cache.Set(Key("foobar2.com"), ERR_NAME_NOT_RESOLVED, AddressList(), now,
+            kTTL);
+  cache.Set(HostCache::Key("foobar3.com", ADDRESS_FAMILY_IPV4,
+                           HOST_RESOLVER_CANONNAME),
+            OK, addrlist, now, kTTL);
+  cache.Set(Key("foobar4.com"), OK, addrlist, now, kTTL);
+
+  std::set<std::string> hostnames;
+  hostnames.insert("foobar1.com");
+  hostnames.insert("foobar2.com");
+  hostnames.insert("foobar3.com");
+
+  // Negative entries, entries with a canonical name and names that were not
+  // asked for are not saved.
+  base::ListValue list;
+  cache.GetAsListValue(hostnames, &list);
+  EXPECT_EQ(1u, list.GetSize());
+
+  HostCache restored(kMaxCacheEntries);
+  EXPECT_EQ(1u, restored.RestoreFromListValue(list));
+  const HostCache::Entry* entry =
+      restored.Lookup(Key("foobar1.com"), base::TimeTicks::Now());
+  ASSERT_TRUE(entry);
+  EXPECT_EQ(OK, entry->error);
+  EXPECT_EQ("192.168.1.1", NetAddressToString(entry->addrlist.head()));
+  EXPECT_GE(now + kTTL + base::TimeDelta::FromSeconds(1), entry->expiration);
+
+  // Entries already in the cache are kept.
+  EXPECT_EQ(0u, restored.RestoreFromListValue(list));
+
+  // Invalid entries are skipped.
+  base::ListValue invalid_list;
+  invalid_list.Append(base::Value::CreateStringValue("foobar5.com"));
+  invalid_list.Append(new base::DictionaryValue());
+  HostCache restored2(kMaxCacheEntries);
+  EXPECT_EQ(0u, restored2.RestoreFromListValue(invalid_list));
+}
+
 // Tests the less than and equal operators for HostCache::Key work.
 TEST(HostCacheTest, KeyComparators) {
   struct {
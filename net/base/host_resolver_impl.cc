@@ -10,6 +10,7 @@
 #include <netdb.h>
 #endif
 
+#include <algorithm>
 #include <cmath>
 #include <utility>
 #include <vector>
@@ -28,6 +29,7 @@
 #include "base/string_util.h"
 #include "base/threading/worker_pool.h"
 #include "base/time.h"
+#include "base/timer.h"
 #include "base/utf_string_conversions.h"
 #include "base/values.h"
 #include "net/base/address_family.h"
@@ -63,6 +65,13 @@ const unsigned kCacheEntryTTLSeconds = 60;
 // Default TTL for unsuccessful resolutions with ProcTask.
 const unsigned kNegativeCacheEntryTTLSeconds = 0;
 
+// TTL for names that DnsTask found not to exist. The SOA record in the
+// authority section is not parsed, so its minimum TTL is not known.
+const unsigned kDnsNegativeCacheEntryTTLSeconds = 60;
+
+// How long DnsTask waits for the AAAA answer once the A query has succeeded.
+const int kDnsAAAAGracePeriodMs = 50;
+
 // Maximum of 6 concurrent resolver threads (excluding retries).
 // Some routers (or resolvers) appear to start to provide host-not-found if
 // too many simultaneous resolutions are pending.  This number needs to be
@@ -70,6 +79,11 @@ const unsigned kNegativeCacheEntryTTLSeconds = 0;
 // that limit this to 6, so we're temporarily holding it at that level.
 static const size_t kDefaultMaxProcTasks = 6u;
 
+// Maximum of 64 concurrent jobs when resolving with DnsTask, which does not
+// need a thread per lookup. ProcTasks are still limited to
+// kDefaultMaxProcTasks.
+static const size_t kDefaultMaxDnsJobs = 64u;
+
 // Helper to mutate the linked list contained by AddressList to the given
 // port. Note that in general this is dangerous since the AddressList's
 // data might be shared (and you should use AddressList::SetPort).
@@ -159,6 +173,17 @@ void UmaAsyncDnsResolveStatus(DnsResolveStatus result) {
                             RESOLVE_STATUS_MAX);
 }
 
+// Returns true if the system resolver might know |hostname| even when DNS says
+// that it does not exist. Single-label names could be NetBIOS or LLMNR names,
+// and ".local" names are resolved with multicast DNS.
+bool MayResolveOutsideDns(const std::string& hostname) {
+  std::string name = StringToLowerASCII(hostname);
+  if (!name.empty() && name[name.size() - 1] == '.')
+    name.resize(name.size() - 1);
+  return name.find('.') == std::string::npos ||
+         EndsWith(name, ".local", true);
+}
+
 // Wraps call to SystemHostResolverProc as an instance of HostResolverProc.
 // TODO(szym): This should probably be declared in host_resolver_proc.h.
 class CallSystemHostResolverProc : public HostResolverProc {
@@ -436,11 +461,12 @@ class PriorityTracker {
 
 //-----------------------------------------------------------------------------
 
-HostResolver* CreateHostResolver(size_t max_concurrent_resolves,
-                                 size_t max_retry_attempts,
-                                 HostCache* cache,
-                                 scoped_ptr<DnsConfigService> config_service,
-                                 NetLog* net_log) {
+HostResolverImpl* CreateHostResolver(
+    size_t max_concurrent_resolves,
+    size_t max_retry_attempts,
+    HostCache* cache,
+    scoped_ptr<DnsConfigService> config_service,
+    NetLog* net_log) {
   if (max_concurrent_resolves == HostResolver::kDefaultParallelism)
     max_concurrent_resolves = kDefaultMaxProcTasks;
 
@@ -486,13 +512,21 @@ HostResolver* CreateNonCachingSystemHostResolver(size_t max_concurrent_resolves,
 HostResolver* CreateAsyncHostResolver(size_t max_concurrent_resolves,
                                       size_t max_retry_attempts,
                                       NetLog* net_log) {
+  size_t max_proc_tasks = max_concurrent_resolves;
+  if (max_concurrent_resolves == HostResolver::kDefaultParallelism) {
+    max_concurrent_resolves = kDefaultMaxDnsJobs;
+    max_proc_tasks = kDefaultMaxProcTasks;
+  }
   scoped_ptr<DnsConfigService> config_service =
       DnsConfigService::CreateSystemService();
-  return CreateHostResolver(max_concurrent_resolves,
-                            max_retry_attempts,
-                            HostCache::CreateDefaultCache(),
-                            config_service.Pass(),
-                            net_log);
+  HostResolverImpl* resolver = CreateHostResolver(
+      max_concurrent_resolves,
+      max_retry_attempts,
+      HostCache::CreateDefaultCache(),
+      config_service.Pass(),
+      net_log);
+  resolver->SetMaxProcTasks(max_proc_tasks);
+  return resolver;
 }
 
 //-----------------------------------------------------------------------------
@@ -1043,7 +1077,8 @@ class HostResolverImpl::IPv6ProbeJob
 
 //-----------------------------------------------------------------------------
 
-// Resolves the hostname using DnsTransaction.
+// Resolves the hostname using DnsTransaction. For ADDRESS_FAMILY_UNSPECIFIED,
+// the A and AAAA queries run in parallel and their results are merged.
 // TODO(szym): This could be moved to separate source file as well.
 class HostResolverImpl::DnsTask {
  public:
@@ -1055,27 +1090,35 @@ class HostResolverImpl::DnsTask {
           const Key& key,
           const Callback& callback,
           const BoundNetLog& job_net_log)
-      : callback_(callback), net_log_(job_net_log) {
+      : callback_(callback), net_log_(job_net_log), num_pending_(0) {
     DCHECK(factory);
     DCHECK(!callback.is_null());
 
-    // For now we treat ADDRESS_FAMILY_UNSPEC as if it was IPV4.
-    uint16 qtype = (key.address_family == ADDRESS_FAMILY_IPV6)
-                   ? dns_protocol::kTypeAAAA
-                   : dns_protocol::kTypeA;
     // TODO(szym): Implement "happy eyeballs".
-    transaction_ = factory->CreateTransaction(
-        key.hostname,
-        qtype,
-        base::Bind(&DnsTask::OnTransactionComplete, base::Unretained(this),
-                   base::TimeTicks::Now()),
-        net_log_);
-    DCHECK(transaction_.get());
+    if (key.address_family != ADDRESS_FAMILY_IPV6) {
+      transaction_a_ = CreateTransaction(factory, key.hostname,
+                                         dns_protocol::kTypeA);
+    }
+    if (key.address_family != ADDRESS_FAMILY_IPV4) {
+      transaction_aaaa_ = CreateTransaction(factory, key.hostname,
+                                            dns_protocol::kTypeAAAA);
+    }
   }
 
   int Start() {
     net_log_.BeginEvent(NetLog::TYPE_HOST_RESOLVER_IMPL_DNS_TASK, NULL);
-    return transaction_->Start();
+    // Both transactions query the same name, so if one fails synchronously
+    // the other would too.
+    int rv = StartTransaction(transaction_a_.get());
+    if (rv == ERR_IO_PENDING)
+      rv = StartTransaction(transaction_aaaa_.get());
+    if (rv != ERR_IO_PENDING) {
+      transaction_a_.reset();
+      transaction_aaaa_.reset();
+      net_log_.EndEvent(NetLog::TYPE_HOST_RESOLVER_IMPL_DNS_TASK,
+                        new DnsTaskFailedParams(rv, DnsResponse::DNS_SUCCESS));
+    }
+    return rv;
   }
 
   void OnTransactionComplete(const base::TimeTicks& start_time,
@@ -1083,41 +1126,145 @@ class HostResolverImpl::DnsTask {
                              int net_error,
                              const DnsResponse* response) {
     DCHECK(transaction);
-    // Run |callback_| last since the owning Job will then delete this DnsTask.
-    DnsResponse::Result result = DnsResponse::DNS_SUCCESS;
+    DCHECK_GT(num_pending_, 0u);
+    TransactionResult* result = (transaction == transaction_a_.get()) ?
+        &result_a_ : &result_aaaa_;
     if (net_error == OK) {
       CHECK(response);
       DNS_HISTOGRAM("AsyncDNS.TransactionSuccess",
                     base::TimeTicks::Now() - start_time);
-      AddressList addr_list;
-      base::TimeDelta ttl;
-      result = response->ParseToAddressList(&addr_list, &ttl);
+      result->parse_result = response->ParseToAddressList(&result->addr_list,
+                                                          &result->ttl);
       UMA_HISTOGRAM_ENUMERATION("AsyncDNS.ParseToAddressList",
-                                result,
+                                result->parse_result,
                                 DnsResponse::DNS_PARSE_RESULT_MAX);
-      if (result == DnsResponse::DNS_SUCCESS) {
-        net_log_.EndEvent(NetLog::TYPE_HOST_RESOLVER_IMPL_DNS_TASK,
-                          new AddressListNetLogParam(addr_list));
-        callback_.Run(net_error, addr_list, ttl);
-        return;
-      }
-      net_error = ERR_DNS_MALFORMED_RESPONSE;
+      if (result->parse_result != DnsResponse::DNS_SUCCESS)
+        net_error = ERR_DNS_MALFORMED_RESPONSE;
     } else {
       DNS_HISTOGRAM("AsyncDNS.TransactionFailure",
                     base::TimeTicks::Now() - start_time);
     }
-    net_log_.EndEvent(NetLog::TYPE_HOST_RESOLVER_IMPL_DNS_TASK,
-                      new DnsTaskFailedParams(net_error, result));
-    callback_.Run(net_error, AddressList(), base::TimeDelta());
+    result->net_error = net_error;
+
+    if (--num_pending_ == 0) {
+      aaaa_grace_timer_.Stop();
+      OnComplete();
+      return;
+    }
+
+    // Some resolvers are slow to answer or drop AAAA queries, so do not hold
+    // up a usable IPv4 answer for long.
+    if (result == &result_a_ && result->succeeded()) {
+      aaaa_grace_timer_.Start(
+          FROM_HERE,
+          base::TimeDelta::FromMilliseconds(kDnsAAAAGracePeriodMs),
+          this,
+          &DnsTask::OnAAAAGracePeriodExpired);
+    }
   }
 
  private:
+  // The outcome of a single transaction.
+  struct TransactionResult {
+    TransactionResult()
+        : net_error(ERR_IO_PENDING),
+          parse_result(DnsResponse::DNS_SUCCESS) {}
+
+    bool succeeded() const { return net_error == OK; }
+
+    int net_error;
+    DnsResponse::Result parse_result;
+    AddressList addr_list;
+    base::TimeDelta ttl;
+  };
+
+  scoped_ptr<DnsTransaction> CreateTransaction(DnsTransactionFactory* factory,
+                                               const std::string& hostname,
+                                               uint16 qtype) {
+    scoped_ptr<DnsTransaction> transaction = factory->CreateTransaction(
+        hostname,
+        qtype,
+        base::Bind(&DnsTask::OnTransactionComplete, base::Unretained(this),
+                   base::TimeTicks::Now()),
+        net_log_);
+    DCHECK(transaction.get());
+    return transaction.Pass();
+  }
+
+  int StartTransaction(DnsTransaction* transaction) {
+    if (!transaction)
+      return ERR_IO_PENDING;
+    int rv = transaction->Start();
+    if (rv == ERR_IO_PENDING)
+      ++num_pending_;
+    return rv;
+  }
+
+  // Gives up on the AAAA transaction and completes with the A result.
+  void OnAAAAGracePeriodExpired() {
+    DCHECK_EQ(1u, num_pending_);
+    DCHECK(result_a_.succeeded());
+    net_log_.AddEvent(NetLog::TYPE_HOST_RESOLVER_IMPL_DNS_TASK_AAAA_TIMEOUT,
+                      NULL);
+    // Destroying the transaction cancels it.
+    transaction_aaaa_.reset();
+    num_pending_ = 0;
+    result_aaaa_.net_error = ERR_DNS_TIMED_OUT;
+    OnComplete();
+  }
+
+  // Merges the results of the transactions. An address family that failed is
+  // ignored as long as the other one has addresses.
+  void OnComplete() {
+    // Run |callback_| last since the owning Job will then delete this DnsTask.
+    AddressList addr_list;
+    base::TimeDelta ttl;
+    if (result_a_.succeeded() && result_aaaa_.succeeded()) {
+      // IPv4 addresses go first, so the first connection attempt is the same
+      // as when only the A record was queried.
+      addr_list = result_a_.addr_list;
+      addr_list.Append(result_aaaa_.addr_list.head());
+      ttl = std::min(result_a_.ttl, result_aaaa_.ttl);
+    } else if (result_a_.succeeded()) {
+      addr_list = result_a_.addr_list;
+      ttl = result_a_.ttl;
+    } else if (result_aaaa_.succeeded()) {
+      addr_list = result_aaaa_.addr_list;
+      ttl = result_aaaa_.ttl;
+    } else {
+      const TransactionResult* failed =
+          transaction_a_.get() ? &result_a_ : &result_aaaa_;
+      // NXDOMAIN for either query means the name does not exist at all.
+      if (result_aaaa_.net_error == ERR_NAME_NOT_RESOLVED)
+        failed = &result_aaaa_;
+      net_log_.EndEvent(NetLog::TYPE_HOST_RESOLVER_IMPL_DNS_TASK,
+                        new DnsTaskFailedParams(failed->net_error,
+                                                failed->parse_result));
+      callback_.Run(failed->net_error, AddressList(), base::TimeDelta());
+      return;
+    }
+    net_log_.EndEvent(NetLog::TYPE_HOST_RESOLVER_IMPL_DNS_TASK,
+                      new AddressListNetLogParam(addr_list));
+    callback_.Run(OK, addr_list, ttl);
+  }
+
   // The listener to the results of this DnsTask.
   Callback callback_;
 
   const BoundNetLog net_log_;
 
-  scoped_ptr<DnsTransaction> transaction_;
+  // NULL if the address family is not queried.
+  scoped_ptr<DnsTransaction> transaction_a_;
+  scoped_ptr<DnsTransaction> transaction_aaaa_;
+
+  // Number of transactions that have not completed yet.
+  size_t num_pending_;
+
+  TransactionResult result_a_;
+  TransactionResult result_aaaa_;
+
+  // Runs while the A result waits for the AAAA one.
+  base::OneShotTimer<DnsTask> aaaa_grace_timer_;
 };
 
 //-----------------------------------------------------------------------------
@@ -1126,14 +1273,18 @@ class HostResolverImpl::DnsTask {
 class HostResolverImpl::Job : public PrioritizedDispatcher::Job {
  public:
   // Creates new job for |key| where |request_net_log| is bound to the
-  // request that spawned it.
+  // request that spawned it. A refresh Job updates a stale cache entry and
+  // keeps running when it has no active Requests.
   Job(HostResolverImpl* resolver,
       const Key& key,
+      bool is_refresh,
       const BoundNetLog& request_net_log)
       : resolver_(resolver->AsWeakPtr()),
         key_(key),
+        is_refresh_(is_refresh),
         had_non_speculative_request_(false),
         had_dns_config_(false),
+        waiting_for_proc_slot_(false),
         net_log_(BoundNetLog::Make(request_net_log.net_log(),
                                    NetLog::SOURCE_HOST_RESOLVER_IMPL_JOB)) {
     request_net_log.AddEvent(NetLog::TYPE_HOST_RESOLVER_IMPL_CREATE_JOB, NULL);
@@ -1148,10 +1299,7 @@ class HostResolverImpl::Job : public PrioritizedDispatcher::Job {
     if (is_running()) {
       // |resolver_| was destroyed with this Job still in flight.
       // Clean-up, record in the log, but don't run any callbacks.
-      if (is_proc_running()) {
-        proc_task_->Cancel();
-        proc_task_ = NULL;
-      }
+      ReleaseProcSlot();
       // Clean up now for nice NetLog.
       dns_task_.reset(NULL);
       net_log_.EndEventWithNetErrorCode(NetLog::TYPE_HOST_RESOLVER_IMPL_JOB,
@@ -1227,7 +1375,7 @@ class HostResolverImpl::Job : public PrioritizedDispatcher::Job {
         make_scoped_refptr(new JobAttachParameters(
             req->request_net_log().source(), priority())));
 
-    if (num_active_requests() > 0) {
+    if (num_active_requests() > 0 || is_refresh_) {
       if (is_queued())
         handle_ = resolver_->dispatcher_.ChangePriority(handle_, priority());
     } else {
@@ -1263,7 +1411,9 @@ class HostResolverImpl::Job : public PrioritizedDispatcher::Job {
   // Attempts to serve the job from HOSTS. Returns true if succeeded and
   // this Job was destroyed.
   bool ServeFromHosts() {
-    DCHECK_GT(num_active_requests(), 0u);
+    DCHECK(is_refresh_ || num_active_requests() > 0);
+    if (requests_.empty())
+      return false;
     AddressList addr_list;
     if (resolver_->ServeFromHosts(key(),
                                   requests_->front()->info(),
@@ -1284,7 +1434,15 @@ class HostResolverImpl::Job : public PrioritizedDispatcher::Job {
   }
 
   bool is_running() const {
-    return is_dns_running() || is_proc_running();
+    return is_dns_running() || is_proc_running() || waiting_for_proc_slot_;
+  }
+
+  // Called by HostResolverImpl when a ProcTask slot was handed over to this
+  // Job.
+  void OnProcSlotAvailable() {
+    DCHECK(waiting_for_proc_slot_);
+    waiting_for_proc_slot_ = false;
+    RunProcTask();
   }
 
  private:
@@ -1304,12 +1462,20 @@ class HostResolverImpl::Job : public PrioritizedDispatcher::Job {
     }
   }
 
-  // TODO(szym): Since DnsTransaction does not consume threads, we can increase
-  // the limits on |dispatcher_|. But in order to keep the number of WorkerPool
-  // threads low, we will need to use an "inner" PrioritizedDispatcher with
-  // tighter limits.
+  // Since DnsTransaction does not consume threads, |dispatcher_| can run more
+  // Jobs than there are WorkerPool threads to spare for ProcTasks. If all
+  // ProcTask slots are taken, the Job waits in HostResolverImpl.
   void StartProcTask() {
     DCHECK(!is_dns_running());
+    DCHECK(!waiting_for_proc_slot_);
+    if (!resolver_->AcquireProcSlot(this)) {
+      waiting_for_proc_slot_ = true;
+      return;
+    }
+    RunProcTask();
+  }
+
+  void RunProcTask() {
     proc_task_ = new ProcTask(
         key_,
         resolver_->proc_params_,
@@ -1366,6 +1532,16 @@ class HostResolverImpl::Job : public PrioritizedDispatcher::Job {
                          base::TimeDelta ttl) {
     DCHECK(is_dns_running());
 
+    if (net_error == ERR_NAME_NOT_RESOLVED &&
+        !MayResolveOutsideDns(key_.hostname)) {
+      // The name does not exist, so the system resolver would only repeat
+      // the same queries on a worker thread.
+      UmaAsyncDnsResolveStatus(RESOLVE_STATUS_FAIL);
+      CompleteRequests(net_error, AddressList(), base::TimeDelta::FromSeconds(
+          kDnsNegativeCacheEntryTTLSeconds));
+      return;
+    }
+
     if (net_error != OK) {
       dns_task_.reset();
 
@@ -1402,10 +1578,7 @@ class HostResolverImpl::Job : public PrioritizedDispatcher::Job {
 
     if (is_running()) {
       DCHECK(!is_queued());
-      if (is_proc_running()) {
-        proc_task_->Cancel();
-        proc_task_ = NULL;
-      }
+      ReleaseProcSlot();
       dns_task_.reset();
 
       // Signal dispatcher that a slot has opened.
@@ -1415,7 +1588,7 @@ class HostResolverImpl::Job : public PrioritizedDispatcher::Job {
       handle_.Reset();
     }
 
-    if (num_active_requests() == 0) {
+    if (num_active_requests() == 0 && !is_refresh_) {
       net_log_.AddEvent(NetLog::TYPE_CANCELLED, NULL);
       net_log_.EndEventWithNetErrorCode(NetLog::TYPE_HOST_RESOLVER_IMPL_JOB,
                                         OK);
@@ -1425,15 +1598,17 @@ class HostResolverImpl::Job : public PrioritizedDispatcher::Job {
     net_log_.EndEventWithNetErrorCode(NetLog::TYPE_HOST_RESOLVER_IMPL_JOB,
                                       net_error);
 
-    DCHECK(!requests_.empty());
+    DCHECK(is_refresh_ || !requests_.empty());
 
     // We are the only consumer of |list|, so we can safely change the port
     // without copy-on-write. This pays off, when job has only one request.
-    if (net_error == OK)
+    if (net_error == OK && !requests_.empty())
       MutableSetPort(requests_->front()->info().port(), &list);
 
+    // A failed refresh leaves the stale entry in the cache.
     if ((net_error != ERR_ABORTED) &&
-        (net_error != ERR_HOST_RESOLVER_QUEUE_TOO_LARGE)) {
+        (net_error != ERR_HOST_RESOLVER_QUEUE_TOO_LARGE) &&
+        (net_error == OK || !is_refresh_)) {
       resolver_->CacheResult(key_, net_error, list, ttl);
     }
 
@@ -1476,10 +1651,27 @@ class HostResolverImpl::Job : public PrioritizedDispatcher::Job {
     return proc_task_.get() != NULL;
   }
 
+  // Cancels the ProcTask and frees its slot, or stops waiting for one.
+  void ReleaseProcSlot() {
+    if (is_proc_running()) {
+      proc_task_->Cancel();
+      proc_task_ = NULL;
+      if (resolver_)
+        resolver_->OnProcTaskFinished();
+    } else if (waiting_for_proc_slot_) {
+      waiting_for_proc_slot_ = false;
+      if (resolver_)
+        resolver_->RemoveFromProcQueue(this);
+    }
+  }
+
   base::WeakPtr<HostResolverImpl> resolver_;
 
   Key key_;
 
+  // True if this Job was started by StartRefreshJob.
+  const bool is_refresh_;
+
   // Tracks the highest priority across |requests_|.
   PriorityTracker priority_tracker_;
 
@@ -1488,6 +1680,9 @@ class HostResolverImpl::Job : public PrioritizedDispatcher::Job {
   // True if resolver had DnsConfig when the Job was started.
   bool had_dns_config_;
 
+  // True if queued in |HostResolverImpl::proc_queue_| for a ProcTask slot.
+  bool waiting_for_proc_slot_;
+
   BoundNetLog net_log_;
 
   // Resolves the host using a HostResolverProc.
@@ -1525,6 +1720,8 @@ HostResolverImpl::HostResolverImpl(
     : cache_(cache),
       dispatcher_(job_limits),
       max_queued_jobs_(job_limits.total_jobs * 100u),
+      max_proc_tasks_(job_limits.total_jobs),
+      num_proc_tasks_(0),
       proc_params_(proc_params),
       default_address_family_(ADDRESS_FAMILY_UNSPECIFIED),
       dns_client_(NULL),
@@ -1567,6 +1764,9 @@ HostResolverImpl::HostResolverImpl(
 HostResolverImpl::~HostResolverImpl() {
   DiscardIPv6ProbeJob();
 
+  // Don't start waiting ProcTasks when the running ones are cancelled.
+  proc_queue_.clear();
+
   // This will also cancel all outstanding requests.
   STLDeleteValues(&jobs_);
 
@@ -1582,6 +1782,12 @@ void HostResolverImpl::SetMaxQueuedJobs(size_t value) {
   max_queued_jobs_ = value;
 }
 
+void HostResolverImpl::SetMaxProcTasks(size_t value) {
+  DCHECK_EQ(0u, num_proc_tasks_);
+  DCHECK_GT(value, 0u);
+  max_proc_tasks_ = value;
+}
+
 int HostResolverImpl::Resolve(const RequestInfo& info,
                               AddressList* addresses,
                               const CompletionCallback& callback,
@@ -1614,7 +1820,7 @@ int HostResolverImpl::Resolve(const RequestInfo& info,
   Job* job;
   if (jobit == jobs_.end()) {
     // Create new Job.
-    job = new Job(this, key, request_net_log);
+    job = new Job(this, key, false, request_net_log);
     job->Schedule(info.priority());
 
     // Check for queue overflow.
@@ -1660,7 +1866,7 @@ int HostResolverImpl::ResolveHelper(const Key& key,
   int net_error = ERR_UNEXPECTED;
   if (ResolveAsIP(key, info, &net_error, addresses))
     return net_error;
-  if (ServeFromCache(key, info, &net_error, addresses)) {
+  if (ServeFromCache(key, info, &net_error, addresses, request_net_log)) {
     request_net_log.AddEvent(NetLog::TYPE_HOST_RESOLVER_IMPL_CACHE_HIT, NULL);
     return net_error;
   }
@@ -1768,17 +1974,22 @@ bool HostResolverImpl::ResolveAsIP(const Key& key,
 bool HostResolverImpl::ServeFromCache(const Key& key,
                                       const RequestInfo& info,
                                       int* net_error,
-                                      AddressList* addresses) {
+                                      AddressList* addresses,
+                                      const BoundNetLog& request_net_log) {
   DCHECK(addresses);
   DCHECK(net_error);
   if (!info.allow_cached_response() || !cache_.get())
     return false;
 
-  const HostCache::Entry* cache_entry = cache_->Lookup(
-      key, base::TimeTicks::Now());
+  bool is_stale;
+  const HostCache::Entry* cache_entry = cache_->LookupStale(
+      key, base::TimeTicks::Now(), &is_stale);
   if (!cache_entry)
     return false;
 
+  if (is_stale)
+    StartRefreshJob(key, request_net_log);
+
   *net_error = cache_entry->error;
   if (*net_error == OK)
     *addresses = CreateAddressListUsingPort(cache_entry->addrlist, info.port());
@@ -1818,6 +2029,19 @@ bool HostResolverImpl::ServeFromHosts(const Key& key,
   return true;
 }
 
+void HostResolverImpl::StartRefreshJob(const Key& key,
+                                       const BoundNetLog& request_net_log) {
+  if (jobs_.count(key))
+    return;
+  // Refreshing is opportunistic, so never evict a Job to make room for it.
+  if (dispatcher_.num_queued_jobs() >= max_queued_jobs_)
+    return;
+  request_net_log.AddEvent(NetLog::TYPE_HOST_RESOLVER_IMPL_CACHE_STALE, NULL);
+  Job* job = new Job(this, key, true, request_net_log);
+  job->Schedule(LOWEST);
+  jobs_.insert(std::make_pair(key, job));
+}
+
 void HostResolverImpl::CacheResult(const Key& key,
                                    int net_error,
                                    const AddressList& addr_list,
@@ -1868,6 +2092,34 @@ HostResolverImpl::Key HostResolverImpl::GetEffectiveKeyForRequest(
   return Key(info.hostname(), effective_address_family, effective_flags);
 }
 
+bool HostResolverImpl::AcquireProcSlot(Job* job) {
+  if (num_proc_tasks_ < max_proc_tasks_) {
+    ++num_proc_tasks_;
+    return true;
+  }
+  proc_queue_.push_back(job);
+  return false;
+}
+
+void HostResolverImpl::OnProcTaskFinished() {
+  DCHECK_GT(num_proc_tasks_, 0u);
+  if (proc_queue_.empty()) {
+    --num_proc_tasks_;
+    return;
+  }
+  // Hand the slot over to the longest waiting Job.
+  Job* job = proc_queue_.front();
+  proc_queue_.pop_front();
+  job->OnProcSlotAvailable();
+}
+
+void HostResolverImpl::RemoveFromProcQueue(Job* job) {
+  std::deque<Job*>::iterator it =
+      std::find(proc_queue_.begin(), proc_queue_.end(), job);
+  if (it != proc_queue_.end())
+    proc_queue_.erase(it);
+}
+
 void HostResolverImpl::AbortAllInProgressJobs() {
   // In Abort, a Request callback could spawn new Jobs with matching keys, so
   // first collect and remove all running jobs from |jobs_|.
@@ -1886,6 +2138,9 @@ void HostResolverImpl::AbortAllInProgressJobs() {
   // Check if no dispatcher slots leaked out.
   DCHECK_EQ(dispatcher_.num_running_jobs(), jobs_to_abort.size());
 
+  // All Jobs waiting for a ProcTask slot are about to be aborted.
+  proc_queue_.clear();
+
   // Life check to bail once |this| is deleted.
   base::WeakPtr<HostResolverImpl> self = AsWeakPtr();
 
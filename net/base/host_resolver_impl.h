@@ -6,6 +6,7 @@
 #define NET_BASE_HOST_RESOLVER_IMPL_H_
 #pragma once
 
+#include <deque>
 #include <map>
 
 #include "base/basictypes.h"
@@ -129,6 +130,12 @@ class NET_EXPORT HostResolverImpl
   // Only allowed when the queue is empty.
   void SetMaxQueuedJobs(size_t value);
 
+  // Configures maximum number of ProcTasks, that is resolutions on worker
+  // threads, running at once. Jobs that fall back to ProcTask beyond this
+  // limit wait for a running one to finish. Defaults to the total job limit.
+  // Only allowed when no ProcTasks are running.
+  void SetMaxProcTasks(size_t value);
+
   // HostResolver methods:
   virtual int Resolve(const RequestInfo& info,
                       AddressList* addresses,
@@ -178,11 +185,13 @@ class NET_EXPORT HostResolverImpl
 
   // If |key| is not found in cache returns false, otherwise returns
   // true, sets |net_error| to the cached error code and fills |addresses|
-  // if it is a positive entry.
+  // if it is a positive entry. If the entry is stale, also starts a Job to
+  // refresh it.
   bool ServeFromCache(const Key& key,
                       const RequestInfo& info,
                       int* net_error,
-                      AddressList* addresses);
+                      AddressList* addresses,
+                      const BoundNetLog& request_net_log);
 
   // If |key| is not found in the HOSTS file or no HOSTS file known, returns
   // false, otherwise returns true and fills |addresses|.
@@ -201,6 +210,10 @@ class NET_EXPORT HostResolverImpl
   // family when the request leaves it unspecified.
   Key GetEffectiveKeyForRequest(const RequestInfo& info) const;
 
+  // Starts a low priority Job to refresh the stale cache entry for |key|,
+  // unless a Job for |key| already exists or the queue is full.
+  void StartRefreshJob(const Key& key, const BoundNetLog& request_net_log);
+
   // Records the result in cache if cache is present.
   void CacheResult(const Key& key,
                    int net_error,
@@ -210,6 +223,16 @@ class NET_EXPORT HostResolverImpl
   // Removes |job| from |jobs_|, only if it exists.
   void RemoveJob(Job* job);
 
+  // Returns true if |job| can start a ProcTask now. Otherwise, queues |job|
+  // until a slot is handed over to it in OnProcTaskFinished.
+  bool AcquireProcSlot(Job* job);
+
+  // Called when a ProcTask is done. Passes its slot to the next waiting Job.
+  void OnProcTaskFinished();
+
+  // Removes |job| from the Jobs waiting for a ProcTask slot, if it is there.
+  void RemoveFromProcQueue(Job* job);
+
   // Aborts all in progress jobs and notifies their requests.
   // Might start new jobs.
   void AbortAllInProgressJobs();
@@ -246,6 +269,13 @@ class NET_EXPORT HostResolverImpl
   // Limit on the maximum number of jobs queued in |dispatcher_|.
   size_t max_queued_jobs_;
 
+  // Limit on the number of running ProcTasks, and their current number.
+  size_t max_proc_tasks_;
+  size_t num_proc_tasks_;
+
+  // Running Jobs waiting for a ProcTask slot, in order of arrival.
+  std::deque<Job*> proc_queue_;
+
   // Parameters for ProcTask.
   ProcTaskParams proc_params_;
 
@@ -12,18 +12,24 @@
 #include "base/memory/scoped_vector.h"
 #include "base/message_loop.h"
 #include "base/string_util.h"
+#include "base/stringprintf.h"
+#include "base/sys_byteorder.h"
 #include "base/synchronization/condition_variable.h"
 #include "base/synchronization/lock.h"
 #include "base/test/test_timeouts.h"
 #include "base/time.h"
 #include "net/base/address_list.h"
+#include "net/base/big_endian.h"
 #include "net/base/host_cache.h"
+#include "net/base/io_buffer.h"
 #include "net/base/mock_host_resolver.h"
 #include "net/base/net_errors.h"
 #include "net/base/net_util.h"
 #include "net/base/sys_addrinfo.h"
 #include "net/dns/dns_client.h"
+#include "net/dns/dns_protocol.h"
 #include "net/dns/dns_test_util.h"
+#include "net/udp/udp_server_socket.h"
 #include "testing/gtest/include/gtest/gtest.h"
 
 namespace net {
@@ -450,6 +456,103 @@ class LookupAttemptHostResolverProc : public HostResolverProc {
   base::ConditionVariable all_done_;
 };
 
+// A DNS server on the loopback interface which answers every A query with
+// 192.168.1.1 and every other query with no records.
+class LocalDnsServer {
+ public:
+  LocalDnsServer()
+      : socket_(NULL, NetLog::Source()),
+        buffer_(new IOBufferWithSize(dns_protocol::kMaxUDPSize)),
+        num_queries_(0) {
+  }
+
+  // Starts listening on a free port. Returns false on failure.
+  bool Start() {
+    IPAddressNumber loopback;
+    if (!ParseIPLiteralToNumber("127.0.0.1", &loopback))
+      return false;
+    if (socket_.Listen(IPEndPoint(loopback, 0)) != OK)
+      return false;
+    if (socket_.GetLocalAddress(&address_) != OK)
+      return false;
+    Read();
+    return true;
+  }
+
+  const IPEndPoint& address() const { return address_; }
+  int num_queries() const { return num_queries_; }
+
+ private:
+  void Read() {
+    int rv = OK;
+    while (rv == OK) {
+      rv = socket_.RecvFrom(buffer_, buffer_->size(), &client_,
+                            base::Bind(&LocalDnsServer::OnRead,
+                                       base::Unretained(this)));
+      if (rv == ERR_IO_PENDING)
+        return;
+      rv = Respond(rv);
+    }
+  }
+
+  void OnRead(int rv) {
+    if (Respond(rv) == OK)
+      Read();
+  }
+
+  void OnWrite(int rv) {
+    if (rv >= 0)
+      Read();
+  }
+
+  // Turns the query of |size| bytes in |buffer_| into a response and sends it.
+  // Returns OK if the next query can be read right away.
+  int Respond(int size) {
+    const size_t kAnswerSize = 12 + kIPv4AddressSize;
+    if (size < static_cast<int>(sizeof(dns_protocol::Header)) + 4 ||
+        size + kAnswerSize > static_cast<size_t>(buffer_->size())) {
+      return ERR_UNEXPECTED;
+    }
+    ++num_queries_;
+
+    char* data = buffer_->data();
+    dns_protocol::Header* header = reinterpret_cast<dns_protocol::Header*>(data);
+    header->flags |= base::HostToNet16(dns_protocol::kFlagResponse |
+                                       dns_protocol::kFlagRA);
+    // The query ends with the QTYPE and QCLASS of its only question.
+    uint16 qtype;
+    ReadBigEndian<uint16>(data + size - 4, &qtype);
+    int response_size = size;
+    if (qtype == dns_protocol::kTypeA) {
+      const uint16 kPointerToQueryName =
+          static_cast<uint16>(0xc000 | sizeof(dns_protocol::Header));
+      const uint8 kAddress[] = { 192, 168, 1, 1 };
+      header->ancount = base::HostToNet16(1);
+      BigEndianWriter writer(data + size, kAnswerSize);
+      writer.WriteU16(kPointerToQueryName);
+      writer.WriteU16(dns_protocol::kTypeA);
+      writer.WriteU16(dns_protocol::kClassIN);
+      writer.WriteU32(60);  // TTL
+      writer.WriteU16(kIPv4AddressSize);
+      writer.WriteBytes(kAddress, kIPv4AddressSize);
+      response_size += kAnswerSize;
+    }
+
+    int rv = socket_.SendTo(buffer_, response_size, client_,
+                            base::Bind(&LocalDnsServer::OnWrite,
+                                       base::Unretained(this)));
+    return rv < 0 ? rv : OK;
+  }
+
+  UDPServerSocket socket_;
+  IPEndPoint address_;
+  IPEndPoint client_;
+  scoped_refptr<IOBufferWithSize> buffer_;
+  int num_queries_;
+
+  DISALLOW_COPY_AND_ASSIGN(LocalDnsServer);
+};
+
 }  // namespace
 
 class HostResolverImplTest : public testing::Test {
@@ -844,6 +947,42 @@ TEST_F(HostResolverImplTest, BypassCache) {
   EXPECT_EQ(2u, proc_->GetCaptureList().size());
 }
 
+// Test that a stale cache entry is served while a Job refreshes it.
+TEST_F(HostResolverImplTest, ServeStaleWhileRefreshing) {
+  proc_->AddRuleForAllFamilies("just.testing", "192.168.1.42");
+
+  HostCache* cache = resolver_->GetHostCache();
+  cache->set_max_staleness(base::TimeDelta::FromSeconds(60));
+  AddressList stale_list;
+  ASSERT_EQ(OK, ParseAddressList("192.168.1.1", "", &stale_list));
+  cache->Set(HostCache::Key("just.testing", ADDRESS_FAMILY_UNSPECIFIED, 0),
+             OK, stale_list,
+             base::TimeTicks::Now() - base::TimeDelta::FromSeconds(20),
+             base::TimeDelta::FromSeconds(10));
+
+  // The stale entry is returned right away and a refresh Job is started.
+  Request* req = CreateRequest("just.testing", 80);
+  EXPECT_EQ(OK, req->Resolve());
+  EXPECT_TRUE(req->HasOneAddress("192.168.1.1", 80));
+  EXPECT_TRUE(proc_->WaitFor(1u));
+
+  // A request that bypasses the cache attaches to the refresh Job.
+  HostResolver::RequestInfo info(HostPortPair("just.testing", 81));
+  info.set_allow_cached_response(false);
+  req = CreateRequest(info);
+  EXPECT_EQ(ERR_IO_PENDING, req->Resolve());
+
+  proc_->SignalMultiple(1u);
+  EXPECT_EQ(OK, req->WaitForResult());
+  EXPECT_TRUE(req->HasOneAddress("192.168.1.42", 81));
+
+  // The refreshed entry is now served from the cache.
+  req = CreateRequest("just.testing", 82);
+  EXPECT_EQ(OK, req->Resolve());
+  EXPECT_TRUE(req->HasOneAddress("192.168.1.42", 82));
+  EXPECT_EQ(1u, proc_->GetCaptureList().size());
+}
+
 // Test that IP address changes flush the cache.
 TEST_F(HostResolverImplTest, FlushCacheOnIPAddressChange) {
   proc_->SignalMultiple(2u);  // One before the flush, one after.
@@ -1293,8 +1432,10 @@ TEST_F(HostResolverImplTest, DnsTask) {
   }
 
   EXPECT_EQ(OK, requests_[1]->result());
-  // Resolved by MockDnsClient.
-  EXPECT_TRUE(requests_[1]->HasOneAddress("127.0.0.1", 80));
+  // Resolved by MockDnsClient, both A and AAAA.
+  EXPECT_TRUE(requests_[1]->HasAddress("127.0.0.1", 80));
+  EXPECT_TRUE(requests_[1]->HasAddress("::1", 80));
+  EXPECT_EQ(2u, requests_[1]->NumberOfAddresses());
   EXPECT_EQ(ERR_NAME_NOT_RESOLVED, requests_[2]->result());
   EXPECT_EQ(ERR_NAME_NOT_RESOLVED, requests_[3]->result());
   EXPECT_EQ(OK, requests_[4]->result());
@@ -1303,6 +1444,122 @@ TEST_F(HostResolverImplTest, DnsTask) {
   EXPECT_TRUE(requests_[5]->HasOneAddress("192.168.1.102", 80));
 }
 
+// Test that DnsTask only queries the requested address family.
+TEST_F(HostResolverImplTest, DnsTaskAddressFamily) {
+  set_dns_client(CreateMockDnsClient(CreateValidDnsConfig()));
+
+  Request* req0 = CreateRequest("ok", 80, MEDIUM, ADDRESS_FAMILY_IPV4);
+  EXPECT_EQ(ERR_IO_PENDING, req0->Resolve());
+  Request* req1 = CreateRequest("ok", 80, MEDIUM, ADDRESS_FAMILY_IPV6);
+  EXPECT_EQ(ERR_IO_PENDING, req1->Resolve());
+
+  EXPECT_EQ(OK, req0->WaitForResult());
+  EXPECT_TRUE(req0->HasOneAddress("127.0.0.1", 80));
+  EXPECT_EQ(OK, req1->WaitForResult());
+  EXPECT_TRUE(req1->HasOneAddress("::1", 80));
+}
+
+// Test that DnsTask does not wait long for an AAAA answer once the A query has
+// succeeded.
+TEST_F(HostResolverImplTest, DnsTaskAAAAGracePeriod) {
+  set_dns_client(CreateMockDnsClient(CreateValidDnsConfig()));
+
+  Request* req = CreateRequest("ok.noaaaa", 80);
+  EXPECT_EQ(ERR_IO_PENDING, req->Resolve());
+  EXPECT_EQ(OK, req->WaitForResult());
+  EXPECT_TRUE(req->HasOneAddress("127.0.0.1", 80));
+  EXPECT_TRUE(proc_->GetCaptureList().empty());
+}
+
+// Test that names which DnsTask finds not to exist are cached and not resolved
+// again by ProcTask, unless the system might know them from outside DNS.
+TEST_F(HostResolverImplTest, DnsTaskNegativeCache) {
+  proc_->AddRuleForAllFamilies("nx.succeed", "192.168.1.102");
+  proc_->AddRuleForAllFamilies("nx.succeed.local", "192.168.1.103");
+  set_dns_client(CreateMockDnsClient(CreateValidDnsConfig()));
+
+  EXPECT_EQ(ERR_IO_PENDING, CreateRequest("nx.succeed", 80)->Resolve());
+  EXPECT_EQ(ERR_IO_PENDING, CreateRequest("nx.succeed.local", 80)->Resolve());
+  proc_->SignalMultiple(1u);  // For the ".local" name only.
+
+  EXPECT_EQ(ERR_NAME_NOT_RESOLVED, requests_[0]->WaitForResult());
+  EXPECT_EQ(OK, requests_[1]->WaitForResult());
+  EXPECT_TRUE(requests_[1]->HasOneAddress("192.168.1.103", 80));
+
+  // The failure is served from the cache.
+  EXPECT_EQ(ERR_NAME_NOT_RESOLVED, CreateRequest("nx.succeed", 80)->Resolve());
+
+  MockHostResolverProc::CaptureList capture_list = proc_->GetCaptureList();
+  ASSERT_EQ(1u, capture_list.size());
+  EXPECT_EQ("nx.succeed.local", capture_list[0].hostname);
+}
+
+// Test that Jobs beyond the ProcTask limit wait for a running ProcTask.
+TEST_F(HostResolverImplTest, MaxProcTasks) {
+  resolver_->SetMaxProcTasks(2u);
+
+  EXPECT_EQ(ERR_IO_PENDING, CreateRequest("a")->Resolve());
+  EXPECT_EQ(ERR_IO_PENDING, CreateRequest("b")->Resolve());
+  EXPECT_EQ(ERR_IO_PENDING, CreateRequest("c")->Resolve());
+  EXPECT_EQ(ERR_IO_PENDING, CreateRequest("d")->Resolve());
+
+  // All Jobs are running, but only two of them on worker threads.
+  EXPECT_TRUE(proc_->WaitFor(2u));
+  EXPECT_EQ(4u, num_running_jobs());
+  EXPECT_EQ(2u, proc_->GetCaptureList().size());
+
+  // Cancelling a waiting Job does not start its ProcTask later.
+  requests_[3]->Cancel();
+
+  proc_->SignalMultiple(3u);
+  for (size_t i = 0; i < 3; ++i)
+    EXPECT_EQ(OK, requests_[i]->WaitForResult()) << i;
+
+  MockHostResolverProc::CaptureList capture_list = proc_->GetCaptureList();
+  ASSERT_EQ(3u, capture_list.size());
+  EXPECT_EQ("c", capture_list[2].hostname);
+}
+
+// Test many concurrent resolutions by the real DnsClient against a DNS server
+// on the loopback interface. Each one uses two UDP sockets at once.
+TEST_F(HostResolverImplTest, DnsTaskWithLocalServer) {
+  LocalDnsServer server;
+  ASSERT_TRUE(server.Start());
+
+  const size_t kNumNames = 100;
+  resolver_.reset(new HostResolverImpl(
+      HostCache::CreateDefaultCache(),
+      PrioritizedDispatcher::Limits(NUM_PRIORITIES, kNumNames),
+      DefaultParams(proc_),
+      scoped_ptr<DnsConfigService>(NULL),
+      NULL));
+
+  DnsConfig config;
+  config.nameservers.push_back(server.address());
+  config.timeout = TestTimeouts::action_timeout();
+  scoped_ptr<DnsClient> client = DnsClient::CreateClient(NULL);
+  client->SetConfig(config);
+  set_dns_client(client.Pass());
+
+  for (size_t i = 0; i < kNumNames; ++i) {
+    std::string hostname =
+        base::StringPrintf("host%d.example", static_cast<int>(i));
+    EXPECT_EQ(ERR_IO_PENDING, CreateRequest(hostname, 80)->Resolve());
+  }
+  // No Job waits for another one to finish.
+  EXPECT_EQ(kNumNames, num_running_jobs());
+
+  for (size_t i = 0; i < kNumNames; ++i) {
+    EXPECT_EQ(OK, requests_[i]->WaitForResult()) << i;
+    EXPECT_TRUE(requests_[i]->HasOneAddress("192.168.1.1", 80)) << i;
+  }
+
+  // Both A and AAAA were queried for each name, and none fell back to
+  // ProcTask.
+  EXPECT_EQ(static_cast<int>(2 * kNumNames), server.num_queries());
+  EXPECT_TRUE(proc_->GetCaptureList().empty());
+}
+
 TEST_F(HostResolverImplTest, ServeFromHosts) {
   // Initially, there's DnsConfigService, but no DnsConfig.
   MockDnsConfigService* config_service = new MockDnsConfigService();
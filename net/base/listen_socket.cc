@@ -20,4 +20,16 @@ void ListenSocket::Send(const std::string& str, bool append_linefeed) {
   Send(str.data(), static_cast<int>(str.length()), append_linefeed);
 }
 
+void ListenSocket::SendWithHeader(const std::string& header,
+                                  const std::string& body) {
+  SendGatheredInternal(header.data(), static_cast<int>(header.length()),
+                       body.data(), static_cast<int>(body.length()));
+}
+
+void ListenSocket::SendGatheredInternal(const char* header, int header_len,
+                                        const char* body, int body_len) {
+  SendInternal(header, header_len);
+  SendInternal(body, body_len);
+}
+
 }  // namespace net
@@ -45,12 +45,21 @@ class NET_EXPORT ListenSocket
   void Send(const char* bytes, int len, bool append_linefeed = false);
   void Send(const std::string& str, bool append_linefeed = false);
 
+  // Send |header| immediately followed by |body|. Sockets that support
+  // gathered writes send both with a single system call.
+  void SendWithHeader(const std::string& header, const std::string& body);
+
  protected:
   ListenSocket(ListenSocketDelegate* del);
   virtual ~ListenSocket();
 
   virtual void SendInternal(const char* bytes, int len) = 0;
 
+  // Sends |header| followed by |body|. The default implementation calls
+  // SendInternal() once for each.
+  virtual void SendGatheredInternal(const char* header, int header_len,
+                                    const char* body, int body_len);
+
   ListenSocketDelegate* const socket_delegate_;
 
  private:
@@ -62,6 +62,10 @@ EVENT_TYPE(HOST_RESOLVER_IMPL_REQUEST)
 // This event is logged when a request is handled by a cache entry.
 EVENT_TYPE(HOST_RESOLVER_IMPL_CACHE_HIT)
 
+// This event is logged when a request is handled by a stale cache entry and a
+// Job is started in the background to refresh it.
+EVENT_TYPE(HOST_RESOLVER_IMPL_CACHE_STALE)
+
 // This event is logged when a request is handled by a HOSTS entry.
 EVENT_TYPE(HOST_RESOLVER_IMPL_HOSTS_HIT)
 
@@ -191,6 +195,10 @@ EVENT_TYPE(HOST_RESOLVER_IMPL_PROC_TASK)
 //   }
 EVENT_TYPE(HOST_RESOLVER_IMPL_DNS_TASK)
 
+// This event is logged when a HostResolverImpl::DnsTask stops waiting for the
+// AAAA answer and completes with the A answer alone.
+EVENT_TYPE(HOST_RESOLVER_IMPL_DNS_TASK_AAAA_TIMEOUT)
+
 // ------------------------------------------------------------------------
 // InitProxyResolver
 // ------------------------------------------------------------------------
@@ -1332,6 +1340,17 @@ EVENT_TYPE(DNS_TRANSACTION_QUERY)
 //   }
 EVENT_TYPE(DNS_TRANSACTION_ATTEMPT)
 
+// This event is created when DnsTransaction retries a query over TCP because
+// the response over UDP was truncated.
+//
+// It has the following parameters:
+//
+//   {
+//     "source_dependency": <Source id of the TCP socket created for the
+//                           attempt>,
+//   }
+EVENT_TYPE(DNS_TRANSACTION_TCP_ATTEMPT)
+
 // This event is created when DnsTransaction receives a matching response.
 //
 // It has the following parameters:
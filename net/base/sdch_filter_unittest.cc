@@ -908,6 +908,52 @@ TEST_F(SdchFilterTest, FilterChaining) {
   EXPECT_EQ(output, expanded_);
 }
 
+// When both filters of a chain pass their input through, the chain hands each
+// round of input from one filter to the next without copying it.
+TEST_F(SdchFilterTest, PassThroughChaining) {
+  std::vector<Filter::FilterType> filter_types;
+  filter_types.push_back(Filter::FILTER_TYPE_SDCH);
+  filter_types.push_back(Filter::FILTER_TYPE_GZIP_HELPING_SDCH);
+  MockFilterContext filter_context;
+  // A 404 lets the sdch filter pass through content that is not sdch.
+  filter_context.SetResponseCode(404);
+  filter_context.SetURL(GURL("http://ignore.com"));
+  const int kInputBufferSize(100);
+  scoped_ptr<Filter> filter(SdchFilterChainingTest::Factory(
+      filter_types, filter_context, kInputBufferSize));
+
+  std::string content;
+  for (int i = 0; i < 10; ++i)
+    content.append("Neither sdch nor gzip. ");
+  std::string output;
+  std::vector<IOBuffer*> stream_buffers;
+  for (size_t offset = 0; offset < content.size();
+       offset += kInputBufferSize) {
+    int input_size = std::min(static_cast<int>(content.size() - offset),
+                              kInputBufferSize);
+    stream_buffers.push_back(filter->stream_buffer());
+    memcpy(filter->stream_buffer()->data(), content.data() + offset,
+           input_size);
+    filter->FlushStreamBuffer(input_size);
+    Filter::FilterStatus status;
+    do {
+      char output_buffer[30];
+      int output_size = sizeof(output_buffer);
+      status = filter->ReadData(output_buffer, &output_size);
+      output.append(output_buffer, output_size);
+    } while (status == Filter::FILTER_OK);
+    EXPECT_EQ(Filter::FILTER_NEED_MORE_DATA, status);
+  }
+  EXPECT_EQ(content, output);
+
+  // The first round is copied while the filters find out they pass through.
+  // From then on, the filters trade buffers at every round.
+  ASSERT_LE(3u, stream_buffers.size());
+  EXPECT_EQ(stream_buffers[0], stream_buffers[1]);
+  for (size_t i = 2; i < stream_buffers.size(); ++i)
+    EXPECT_NE(stream_buffers[i - 1], stream_buffers[i]);
+}
+
 TEST_F(SdchFilterTest, DefaultGzipIfSdch) {
   // Construct a valid SDCH dictionary from a VCDIFF dictionary.
   const std::string kSampleDomain = "sdchtest.com";
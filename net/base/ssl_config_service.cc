@@ -26,7 +26,8 @@ SSLConfig::SSLConfig()
       send_client_cert(false),
       verify_ev_cert(false),
       ssl3_fallback(false),
-      cert_io_enabled(true) {
+      cert_io_enabled(true),
+      persist_session(true) {
 }
 
 SSLConfig::~SSLConfig() {
@@ -106,6 +106,12 @@ struct NET_EXPORT SSLConfig {
   // NOTE: currently only effective on Linux
   bool cert_io_enabled;
 
+  // If persist_session is false, the session negotiated with this config is
+  // neither saved to the store given to SSLClientSocket::SetSessionStore() nor
+  // resumed from it.  Contexts that must not leave traces on disk, such as off
+  // the record ones, clear it.
+  bool persist_session;
+
   // The list of application level protocols supported. If set, this will
   // enable Next Protocol Negotiation (if supported). The order of the
   // protocols doesn't matter expect for one case: if the server supports Next
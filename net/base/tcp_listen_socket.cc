@@ -12,6 +12,7 @@
 #include <errno.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include "net/base/net_errors.h"
@@ -161,18 +162,52 @@ void TCPListenSocket::SendInternal(const char* bytes, int len) {
   }
 }
 
+#if defined(OS_POSIX)
+void TCPListenSocket::SendGatheredInternal(const char* header, int header_len,
+                                           const char* body, int body_len) {
+  struct iovec iov[2];
+  iov[0].iov_base = const_cast<char*>(header);
+  iov[0].iov_len = header_len;
+  iov[1].iov_base = const_cast<char*>(body);
+  iov[1].iov_len = body_len;
+  int sent = HANDLE_EINTR(writev(socket_, iov, arraysize(iov)));
+  if (sent == header_len + body_len)
+    return;
+  if (sent == kSocketError) {
+    if (errno != EWOULDBLOCK && errno != EAGAIN) {
+      LOG(ERROR) << "writev failed: errno==" << errno;
+      return;
+    }
+    sent = 0;
+  }
+  // Leave the remainder to SendInternal(), which retries until it is sent.
+  if (sent < header_len) {
+    SendInternal(header + sent, header_len - sent);
+    sent = header_len;
+  }
+  if (sent < header_len + body_len)
+    SendInternal(body + sent - header_len, header_len + body_len - sent);
+}
+#endif
+
 void TCPListenSocket::Listen() {
-  int backlog = 10;  // TODO(erikkay): maybe don't allow any backlog?
-  listen(socket_, backlog);
+  // A short backlog drops connections when many clients connect at once.
+  listen(socket_, SOMAXCONN);
   // TODO(erikkay): error handling
 #if defined(OS_POSIX)
+  // Accept() drains the backlog until it would block.
+  SetNonBlocking(socket_);
   WatchSocket(WAITING_ACCEPT);
 #endif
 }
 
 void TCPListenSocket::Accept() {
-  SOCKET conn = Accept(socket_);
-  if (conn != kInvalidSocket) {
+  while (true) {
+    SOCKET conn = Accept(socket_);
+    if (conn == kInvalidSocket) {
+      // TODO(ibrar): some error handling required here
+      break;
+    }
     scoped_refptr<TCPListenSocket> sock(
         new TCPListenSocket(conn, socket_delegate_));
     // it's up to the delegate to AddRef if it wants to keep it around
@@ -180,8 +215,10 @@ void TCPListenSocket::Accept() {
     sock->WatchSocket(WAITING_READ);
 #endif
     socket_delegate_->DidAccept(this, sock);
-  } else {
-    // TODO(ibrar): some error handling required here
+#if defined(OS_WIN)
+    // FD_ACCEPT is signaled again while connections are pending.
+    break;
+#endif
   }
 }
 
@@ -72,6 +72,11 @@ class NET_EXPORT TCPListenSocket : public ListenSocket,
 
   // Implements ListenSocket::SendInternal.
   virtual void SendInternal(const char* bytes, int len) OVERRIDE;
+#if defined(OS_POSIX)
+  // Implements ListenSocket::SendGatheredInternal with writev().
+  virtual void SendGatheredInternal(const char* header, int header_len,
+                                    const char* body, int body_len) OVERRIDE;
+#endif
 
   virtual void Listen();
   virtual void Accept();
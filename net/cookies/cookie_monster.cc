@@ -108,6 +108,9 @@ typedef std::vector<CookieMonster::CanonicalCookie*> CanonicalCookieVector;
 // will update it again.
 const int kDefaultAccessUpdateThresholdSeconds = 60;
 
+// Number of hosts whose key is remembered by GetKeyForHost().
+const size_t kMaxHostKeys = 1000;
+
 // Comparator to sort cookies from highest creation date to lowest
 // creation date.
 struct OrderByCreationTimeDesc {
@@ -1258,7 +1261,6 @@ CookieList CookieMonster::GetAllCookiesForURLWithOptions(
 
   std::vector<CanonicalCookie*> cookie_ptrs;
   FindCookiesForHostAndDomain(url, options, false, &cookie_ptrs);
-  std::sort(cookie_ptrs.begin(), cookie_ptrs.end(), CookieSorter);
 
   CookieList cookies;
   for (std::vector<CanonicalCookie*>::const_iterator it = cookie_ptrs.begin();
@@ -1414,7 +1416,6 @@ std::string CookieMonster::GetCookiesWithOptions(const GURL& url,
 
   std::vector<CanonicalCookie*> cookies;
   FindCookiesForHostAndDomain(url, options, true, &cookies);
-  std::sort(cookies.begin(), cookies.end(), CookieSorter);
 
   std::string cookie_line = BuildCookieLine(cookies);
 
@@ -1441,7 +1442,6 @@ void CookieMonster::GetCookiesWithInfo(const GURL& url,
 
   std::vector<CanonicalCookie*> cookies;
   FindCookiesForHostAndDomain(url, options, true, &cookies);
-  std::sort(cookies.begin(), cookies.end(), CookieSorter);
   *cookie_line = BuildCookieLine(cookies);
 
   histogram_time_get_->AddTime(TimeTicks::Now() - start_time);
@@ -1772,7 +1772,7 @@ void CookieMonster::FindCookiesForHostAndDomain(
   RecordPeriodicStats(current_time);
 
   // Can just dispatch to FindCookiesForKey
-  const std::string key(GetKey(url.host()));
+  const std::string key(GetKeyForHost(url.host()));
   FindCookiesForKey(key, url, options, current_time,
                     update_access_time, cookies);
 }
@@ -1786,19 +1786,25 @@ void CookieMonster::FindCookiesForKey(
     std::vector<CanonicalCookie*>* cookies) {
   lock_.AssertAcquired();
 
+  CookieIndex::const_iterator index_it = cookie_index_.find(key);
+  if (index_it == cookie_index_.end())
+    return;
+
   const std::string scheme(url.scheme());
   const std::string host(url.host());
   bool secure = url.SchemeIsSecure();
 
-  for (CookieMapItPair its = cookies_.equal_range(key);
-       its.first != its.second; ) {
-    CookieMap::iterator curit = its.first;
-    CanonicalCookie* cc = curit->second;
-    ++its.first;
+  // The index is already in CookieSorter order, so the matching cookies come
+  // out sorted.
+  std::vector<CanonicalCookie*> expired_cookies;
+  const std::vector<CanonicalCookie*>& key_cookies = index_it->second;
+  for (std::vector<CanonicalCookie*>::const_iterator it = key_cookies.begin();
+       it != key_cookies.end(); ++it) {
+    CanonicalCookie* cc = *it;
 
-    // If the cookie is expired, delete it.
+    // If the cookie is expired, delete it (once we are done with the index).
     if (cc->IsExpired(current) && !keep_expired_cookies_) {
-      InternalDeleteCookie(curit, true, DELETE_COOKIE_EXPIRED);
+      expired_cookies.push_back(cc);
       continue;
     }
 
@@ -1824,6 +1830,16 @@ void CookieMonster::FindCookiesForKey(
     }
     cookies->push_back(cc);
   }
+
+  for (size_t i = 0; i < expired_cookies.size(); ++i) {
+    for (CookieMapItPair its = cookies_.equal_range(key);
+         its.first != its.second; ++its.first) {
+      if (its.first->second == expired_cookies[i]) {
+        InternalDeleteCookie(its.first, true, DELETE_COOKIE_EXPIRED);
+        break;
+      }
+    }
+  }
 }
 
 bool CookieMonster::DeleteAnyEquivalentCookie(const std::string& key,
@@ -1866,6 +1882,11 @@ void CookieMonster::InternalInsertCookie(const std::string& key,
       store_ && sync_to_store)
     store_->AddCookie(*cc);
   cookies_.insert(CookieMap::value_type(key, cc));
+
+  std::vector<CanonicalCookie*>& key_cookies = cookie_index_[key];
+  key_cookies.insert(std::upper_bound(key_cookies.begin(), key_cookies.end(),
+                                      cc, CookieSorter),
+                     cc);
   if (delegate_.get()) {
     delegate_->OnCookieChanged(
         *cc, false, CookieMonster::Delegate::CHANGE_COOKIE_EXPLICIT);
@@ -2011,6 +2032,14 @@ void CookieMonster::InternalDeleteCookie(CookieMap::iterator it,
     if (mapping.notify)
       delegate_->OnCookieChanged(*cc, true, mapping.cause);
   }
+
+  CookieIndex::iterator index_it = cookie_index_.find(it->first);
+  DCHECK(index_it != cookie_index_.end());
+  std::vector<CanonicalCookie*>& key_cookies = index_it->second;
+  key_cookies.erase(std::find(key_cookies.begin(), key_cookies.end(), cc));
+  if (key_cookies.empty())
+    cookie_index_.erase(index_it);
+
   cookies_.erase(it);
   delete cc;
 }
@@ -2172,6 +2201,21 @@ std::string CookieMonster::GetKey(const std::string& domain) const {
   return effective_domain;
 }
 
+const std::string& CookieMonster::GetKeyForHost(const std::string& host) {
+  lock_.AssertAcquired();
+
+  base::hash_map<std::string, std::string>::iterator it =
+      host_keys_.find(host);
+  if (it != host_keys_.end())
+    return it->second;
+
+  // Start over instead of tracking the least recently used host; a browsing
+  // session rarely goes through this many hosts.
+  if (host_keys_.size() >= kMaxHostKeys)
+    host_keys_.clear();
+  return host_keys_[host] = GetKey(host);
+}
+
 bool CookieMonster::HasCookieableScheme(const GURL& url) {
   lock_.AssertAcquired();
 
@@ -19,6 +19,7 @@
 #include "base/basictypes.h"
 #include "base/callback_forward.h"
 #include "base/gtest_prod_util.h"
+#include "base/hash_tables.h"
 #include "base/memory/ref_counted.h"
 #include "base/memory/scoped_ptr.h"
 #include "base/synchronization/lock.h"
@@ -295,6 +296,7 @@ class NET_EXPORT CookieMonster : public CookieStore {
   FRIEND_TEST_ALL_PREFIXES(CookieMonsterTest, TestTotalGarbageCollection);
   FRIEND_TEST_ALL_PREFIXES(CookieMonsterTest, GarbageCollectionTriggers);
   FRIEND_TEST_ALL_PREFIXES(CookieMonsterTest, TestGCTimes);
+  FRIEND_TEST_ALL_PREFIXES(CookieMonsterTest, TestLargeCookieJar);
 
   // For validation of key values.
   FRIEND_TEST_ALL_PREFIXES(CookieMonsterTest, TestDomainTree);
@@ -551,6 +553,10 @@ class NET_EXPORT CookieMonster : public CookieStore {
   // See comment on keys before the CookieMap typedef.
   std::string GetKey(const std::string& domain) const;
 
+  // Same as GetKey(), but remembers the key of recently seen hosts so that
+  // the registry lookup is done only once per host.
+  const std::string& GetKeyForHost(const std::string& host);
+
   bool HasCookieableScheme(const GURL& url);
 
   // Statistics support
@@ -593,6 +599,17 @@ class NET_EXPORT CookieMonster : public CookieStore {
 
   CookieMap cookies_;
 
+  // For every key of |cookies_|, the cookies stored under that key in the
+  // order they are sent to servers (longest path first, then oldest first).
+  // This lets FindCookiesForKey() return its results already sorted, and
+  // replaces the tree walk of |cookies_| with a single hash lookup.
+  typedef base::hash_map<std::string, std::vector<CanonicalCookie*> >
+      CookieIndex;
+  CookieIndex cookie_index_;
+
+  // Cache of GetKey() results for the hosts of recent requests.
+  base::hash_map<std::string, std::string> host_keys_;
+
   // Indicates whether the cookie store has been initialized. This happens
   // lazily in InitStoreIfNecessary().
   bool initialized_;
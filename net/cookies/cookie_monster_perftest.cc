@@ -321,6 +321,52 @@ TEST_F(CookieMonsterTest, TestDomainLine) {
   timer2.Done();
 }
 
+// Queries a jar that looks like the one of a heavy user: the global maximum
+// of cookies, spread over many sites, with a few sites close to the per-site
+// limit and cookies set for several paths and subdomains.
+TEST_F(CookieMonsterTest, TestLargeCookieJar) {
+  scoped_refptr<CookieMonster> cm(new CookieMonster(NULL, NULL));
+  SetCookieCallback setCookieCallback;
+  GetCookiesCallback getCookiesCallback;
+  const char* kPaths[] = { "/", "/a", "/a/b", "/c" };
+
+  std::vector<GURL> probe_gurls;
+  size_t num_cookies = 0;
+  for (int site = 0; num_cookies < CookieMonster::kMaxCookies; site++) {
+    // One site in ten is a big one.
+    int site_cookies = (site % 10) ? 20 : CookieMonster::kDomainMaxCookies;
+    for (int i = 0; i < site_cookies &&
+         num_cookies < CookieMonster::kMaxCookies; i++, num_cookies++) {
+      GURL gurl(base::StringPrintf("https://www%d.site%04d.izzle%s",
+                                   i % 3, site, kPaths[i % 4]));
+      // Half of the cookies are host cookies, the rest domain cookies.
+      std::string cookie = base::StringPrintf("c%03d=%d; path=%s", i, site,
+                                              kPaths[i % 4]);
+      if (i % 2)
+        cookie += base::StringPrintf("; domain=.site%04d.izzle", site);
+      setCookieCallback.SetCookie(cm, gurl, cookie);
+    }
+    probe_gurls.push_back(
+        GURL(base::StringPrintf("https://www1.site%04d.izzle/a/b/d", site)));
+  }
+  EXPECT_EQ(CookieMonster::kMaxCookies, cm->GetAllCookies().size());
+
+  PerfTimeLogger timer("Cookie_monster_query_large_jar");
+  for (int i = 0; i < kNumCookies; i++) {
+    getCookiesCallback.GetCookies(cm, probe_gurls[i % probe_gurls.size()]);
+  }
+  timer.Done();
+
+  // The same jar, but every request comes from a different subdomain.
+  PerfTimeLogger timer2("Cookie_monster_query_large_jar_many_hosts");
+  for (int i = 0; i < kNumCookies; i++) {
+    getCookiesCallback.GetCookies(cm, GURL(base::StringPrintf(
+        "https://x%d.site%04d.izzle/a",
+        i, static_cast<int>(i % probe_gurls.size()))));
+  }
+  timer2.Done();
+}
+
 TEST_F(CookieMonsterTest, TestImport) {
   scoped_refptr<MockPersistentCookieStore> store(new MockPersistentCookieStore);
   std::vector<CookieMonster::CanonicalCookie*> initial_cookies;
@@ -4,6 +4,8 @@
 
 #include "net/disk_cache/backend_impl.h"
 
+#include <algorithm>
+
 #include "base/bind.h"
 #include "base/bind_helpers.h"
 #include "base/file_path.h"
@@ -47,8 +49,22 @@ const int kMaxOldFolders = 100;
 // for most users.
 const int k64kEntriesStore = 240 * 1000 * 1000;
 const int kBaseTableLen = 64 * 1024;
+const int kMaxTableLen = kBaseTableLen * 16;
 const int kDefaultCacheSize = 80 * 1024 * 1024;
 
+// The index table is doubled when the number of entries goes over this
+// percentage of its length, regardless of the size of the cache.
+const int kMaxIndexLoad = 75;
+
+// While the index table grows, every new entry splits this many buckets. The
+// growth is over long before the new table is loaded enough to grow again.
+const int kIndexSplitStep = 8;
+
+// The key filter is sized for twice the number of entries, and no less than
+// this, and it is built this many buckets at a time.
+const int kMinKeyFilterCapacity = 4 * 1024;
+const int kKeyFilterStep = 4 * 1024;
+
 // Avoid trimming the cache for the first 5 minutes (10 timer ticks).
 const int kTrimDelay = 10;
 
@@ -63,7 +79,7 @@ int DesiredIndexTableLen(int32 storage_size) {
     return kBaseTableLen * 8;
 
   // The biggest storage_size for int32 requires a 4 MB table.
-  return kBaseTableLen * 16;
+  return kMaxTableLen;
 }
 
 int MaxStorageSizeForTable(int table_len) {
@@ -322,6 +338,9 @@ BackendImpl::BackendImpl(const FilePath& path,
       first_timer_(true),
       user_load_(false),
       net_log_(net_log),
+      key_filter_bucket_(0),
+      key_filter_failed_(false),
+      filtered_misses_(0),
       done_(true, false),
       ALLOW_THIS_IN_INITIALIZER_LIST(ptr_factory_(this)) {
 }
@@ -348,6 +367,9 @@ BackendImpl::BackendImpl(const FilePath& path,
       first_timer_(true),
       user_load_(false),
       net_log_(net_log),
+      key_filter_bucket_(0),
+      key_filter_failed_(false),
+      filtered_misses_(0),
       done_(true, false),
       ALLOW_THIS_IN_INITIALIZER_LIST(ptr_factory_(this)) {
 }
@@ -501,6 +523,9 @@ int BackendImpl::SyncInit() {
   trace_object_->EnableTracing(true);
 #endif
 
+  if (!disabled_)
+    StartKeyFilter();
+
   return disabled_ ? net::ERR_FAILED : net::OK;
 }
 
@@ -710,8 +735,16 @@ EntryImpl* BackendImpl::CreateEntryImpl(const std::string& key) {
   uint32 hash = Hash(key);
   Trace("Create hash 0x%x", hash);
 
+  // Entries may be created here directly, for sparse data.
+  AddToKeyFilter(hash);
+
+  if (data_->header.split_len)
+    SplitBuckets(kIndexSplitStep);
+  else if (ShouldGrowIndex())
+    GrowIndex();
+
   scoped_refptr<EntryImpl> parent;
-  Addr entry_address(data_->table[hash & mask_]);
+  Addr entry_address(data_->table[BucketForHash(hash)]);
   if (entry_address.is_initialized()) {
     // We have an entry already. It could be the one we are looking for, or just
     // a hash conflict.
@@ -724,7 +757,7 @@ EntryImpl* BackendImpl::CreateEntryImpl(const std::string& key) {
     DCHECK(!error);
     if (parent_entry) {
       parent.swap(&parent_entry);
-    } else if (data_->table[hash & mask_]) {
+    } else if (data_->table[BucketForHash(hash)]) {
       // We should have corrected the problem.
       NOTREACHED();
       return NULL;
@@ -786,7 +819,7 @@ EntryImpl* BackendImpl::CreateEntryImpl(const std::string& key) {
   if (parent.get()) {
     parent->SetNextAddress(entry_address);
   } else {
-    data_->table[hash & mask_] = entry_address.value();
+    data_->table[BucketForHash(hash)] = entry_address.value();
   }
 
   // Link this entry through the lists.
@@ -919,10 +952,10 @@ void BackendImpl::RecoveredEntry(CacheRankingsBlock* rankings) {
   cache_entry->Release();
 
   // Anything on the table means that this entry is there.
-  if (data_->table[hash & mask_])
+  if (data_->table[BucketForHash(hash)])
     return;
 
-  data_->table[hash & mask_] = address.value();
+  data_->table[BucketForHash(hash)] = address.value();
 }
 
 void BackendImpl::InternalDoomEntry(EntryImpl* entry) {
@@ -949,7 +982,7 @@ void BackendImpl::InternalDoomEntry(EntryImpl* entry) {
     parent_entry->SetNextAddress(Addr(child));
     parent_entry->Release();
   } else if (!error) {
-    data_->table[hash & mask_] = child;
+    data_->table[BucketForHash(hash)] = child;
   }
 }
 
@@ -971,7 +1004,7 @@ CacheAddr BackendImpl::GetNextAddr(Addr address) {
 
 void BackendImpl::NotLinked(EntryImpl* entry) {
   Addr entry_addr = entry->entry()->address();
-  uint32 i = entry->GetHash() & mask_;
+  uint32 i = BucketForHash(entry->GetHash());
   Addr address(data_->table[i]);
   if (!address.is_initialized())
     return;
@@ -1223,6 +1256,15 @@ void BackendImpl::OnStatsTimer() {
       ReportStats();
   }
 
+  // Replace the key filter once it has seen too many keys to be useful.
+  bool filter_is_full;
+  {
+    base::AutoLock lock(key_filter_lock_);
+    filter_is_full = key_filter_.get() && key_filter_->IsFull();
+  }
+  if (filter_is_full && !disabled_)
+    StartKeyFilter();
+
   // Save stats to disk at 5 min intervals.
   if (time % 10 == 0)
     stats_.Store();
@@ -1280,6 +1322,23 @@ void BackendImpl::TrimDeletedListForTest(bool empty) {
   eviction_.TrimDeletedList(empty);
 }
 
+void BackendImpl::GrowIndexForTest() {
+  if (!data_->header.split_len && !GrowIndex())
+    return;
+  while (data_->header.split_len)
+    SplitBuckets(kIndexSplitStep);
+}
+
+void BackendImpl::StartGrowIndexForTest(int num_buckets) {
+  if (GrowIndex())
+    SplitBuckets(num_buckets);
+}
+
+bool BackendImpl::HasKeyFilterForTest() {
+  base::AutoLock lock(key_filter_lock_);
+  return key_filter_.get() != NULL;
+}
+
 int BackendImpl::SelfCheck() {
   if (!init_) {
     LOG(ERROR) << "Init failed";
@@ -1324,6 +1383,11 @@ int32 BackendImpl::GetEntryCount() const {
 int BackendImpl::OpenEntry(const std::string& key, Entry** entry,
                            const CompletionCallback& callback) {
   DCHECK(!callback.is_null());
+  if (!MayHaveEntry(key)) {
+    filtered_misses_++;
+    return net::ERR_FAILED;
+  }
+
   background_queue_.OpenEntry(key, entry, callback);
   return net::ERR_IO_PENDING;
 }
@@ -1331,6 +1395,8 @@ int BackendImpl::OpenEntry(const std::string& key, Entry** entry,
 int BackendImpl::CreateEntry(const std::string& key, Entry** entry,
                              const CompletionCallback& callback) {
   DCHECK(!callback.is_null());
+  // Any OpenEntry() from now on has to wait for this entry.
+  AddToKeyFilter(Hash(key));
   background_queue_.CreateEntry(key, entry, callback);
   return net::ERR_IO_PENDING;
 }
@@ -1397,6 +1463,10 @@ void BackendImpl::GetStats(StatsItems* stats) {
   item.second = base::StringPrintf("%d", data_->header.num_bytes);
   stats->push_back(item);
 
+  item.first = "Filtered misses";
+  item.second = base::StringPrintf("%d", filtered_misses_);
+  stats->push_back(item);
+
   stats_.GetItems(stats);
 }
 
@@ -1502,6 +1572,256 @@ void BackendImpl::AdjustMaxCacheSize(int table_len) {
     max_size_= current_max_size;
 }
 
+bool BackendImpl::ShouldGrowIndex() const {
+  // A mask set by the user (for tests) is there to force collisions.
+  if ((user_flags_ & kMask) || read_only_)
+    return false;
+
+  int table_len = data_->header.table_len;
+  if (table_len >= kMaxTableLen)
+    return false;
+  return data_->header.num_entries > table_len / 100 * kMaxIndexLoad;
+}
+
+// The table is grown in place: the index file is extended (with zeros) and
+// mapped again, and then every chain is split between its bucket and the
+// matching bucket of the new half of the table, a few buckets at a time (see
+// SplitBuckets()), so that no single operation waits for the whole table.
+// Until a bucket is split, BucketForHash() keeps sending the entries of both
+// halves to it. The progress is recorded in the header as it goes, so a
+// growth that is interrupted by closing the cache carries on when it is
+// opened again. Each entry is read once, and only the entries whose
+// successor changes are written; a crash in the middle of a bucket only
+// loses the index links of its entries, which go away when they are evicted,
+// like any other unreachable entry.
+bool BackendImpl::GrowIndex() {
+  DCHECK(!data_->header.split_len);
+  // With a mask given by the user only part of the table is in use, and the
+  // file may already be big enough.
+  const uint32 old_len = mask_ + 1;
+  const uint32 new_len = old_len * 2;
+  const bool extend_file = new_len > static_cast<uint32>(
+      data_->header.table_len);
+  if (extend_file && new_len > static_cast<uint32>(kMaxTableLen))
+    return false;
+  Trace("Grow index to %d", new_len);
+
+  if (extend_file) {
+    if (!index_->SetLength(GetIndexSize(new_len))) {
+      LOG(ERROR) << "Unable to extend the index file";
+      return false;
+    }
+
+    scoped_refptr<MappedFile> new_index(new MappedFile());
+    Index* new_data = reinterpret_cast<Index*>(
+        new_index->Init(path_.AppendASCII(kIndexName), 0));
+    if (!new_data) {
+      // The old mapping is still there, so we keep going with the old table.
+      LOG(ERROR) << "Unable to map the grown index";
+      return false;
+    }
+
+    // The old mapping goes away only after data_ points to the new one.
+    index_.swap(new_index);
+    data_ = new_data;
+    data_->header.table_len = new_len;
+  }
+
+  data_->header.split_bucket = 0;
+  data_->header.split_len = old_len;
+  mask_ = new_len - 1;
+  eviction_.OnIndexResized();
+  rankings_.OnIndexResized();
+  return true;
+}
+
+void BackendImpl::SplitBuckets(int max_buckets) {
+  const int old_len = data_->header.split_len;
+  DCHECK_GT(old_len, 0);
+  TimeTicks start = TimeTicks::Now();
+
+  int last_bucket = std::min(data_->header.split_bucket + max_buckets,
+                             old_len);
+  while (data_->header.split_bucket < last_bucket) {
+    SplitBucket(data_->header.split_bucket, old_len);
+    data_->header.split_bucket++;
+  }
+
+  if (data_->header.split_bucket == old_len) {
+    Trace("Index grown to %d", mask_ + 1);
+    data_->header.split_len = 0;
+    data_->header.split_bucket = 0;
+  }
+  CACHE_UMA(AGE_MS, "SplitIndexTime", 0, start);
+}
+
+uint32 BackendImpl::BucketForHash(uint32 hash) const {
+  // A bucket that is still waiting to be split holds the entries of its new
+  // twin as well.
+  uint32 old_mask = data_->header.split_len - 1;
+  if (data_->header.split_len &&
+      (hash & old_mask) >= static_cast<uint32>(data_->header.split_bucket)) {
+    return hash & old_mask;
+  }
+  return hash & mask_;
+}
+
+void BackendImpl::SplitBucket(uint32 bucket, uint32 old_len) {
+  Addr address(data_->table[bucket]);
+  if (!address.is_initialized())
+    return;
+
+  // The chains that go to |bucket| and to |bucket| + |old_len|: their first
+  // entry, their last entry so far and the current link of that entry.
+  CacheAddr heads[2] = { 0, 0 };
+  Addr tails[2] = { Addr(0), Addr(0) };
+  CacheAddr tail_links[2] = { 0, 0 };
+  std::set<CacheAddr> visited;
+
+  while (address.is_initialized()) {
+    uint32 hash;
+    CacheAddr next;
+    // Anything after a broken entry or a loop is dropped, as MatchEntry does.
+    if (!visited.insert(address.value()).second ||
+        !ReadEntryLink(address, &hash, &next)) {
+      break;
+    }
+
+    int half = (hash & old_len) ? 1 : 0;
+    if (!tails[half].is_initialized()) {
+      heads[half] = address.value();
+    } else if (tail_links[half] != address.value()) {
+      WriteEntryLink(tails[half], address.value());
+    }
+    tails[half] = address;
+    tail_links[half] = next;
+    address.set_value(next);
+  }
+
+  for (int half = 0; half < 2; half++) {
+    if (tails[half].is_initialized() && tail_links[half])
+      WriteEntryLink(tails[half], 0);
+  }
+  data_->table[bucket] = heads[0];
+  data_->table[bucket + old_len] = heads[1];
+}
+
+bool BackendImpl::ReadEntryLink(Addr address, uint32* hash, CacheAddr* next) {
+  EntriesMap::iterator it = open_entries_.find(address.value());
+  if (it != open_entries_.end()) {
+    *hash = it->second->GetHash();
+    *next = it->second->GetNextAddress();
+    return true;
+  }
+
+  if (!address.SanityCheckForEntry())
+    return false;
+
+  CacheEntryBlock entry(File(address), address);
+  if (!entry.Load() || !entry.VerifyHash())
+    return false;
+  *hash = entry.Data()->hash;
+  *next = entry.Data()->next;
+  return true;
+}
+
+void BackendImpl::WriteEntryLink(Addr address, CacheAddr next) {
+  EntriesMap::iterator it = open_entries_.find(address.value());
+  if (it != open_entries_.end()) {
+    it->second->SetNextAddress(Addr(next));
+    return;
+  }
+
+  CacheEntryBlock entry(File(address), address);
+  if (!entry.Load())
+    return;
+  entry.Data()->next = next;
+  entry.Store();
+}
+
+bool BackendImpl::MayHaveEntry(const std::string& key) {
+  base::AutoLock lock(key_filter_lock_);
+  return !key_filter_.get() || key_filter_->MayContain(Hash(key));
+}
+
+void BackendImpl::AddToKeyFilter(uint32 hash) {
+  base::AutoLock lock(key_filter_lock_);
+  if (key_filter_.get())
+    key_filter_->Add(hash);
+  if (new_key_filter_.get())
+    new_key_filter_->Add(hash);
+}
+
+// The filter is built on the cache thread, while entries keep being created.
+// Every entry created from the moment the new filter exists is added to it
+// directly by AddToKeyFilter(), on the thread that asks for it (so that an
+// OpenEntry() posted right after a CreateEntry() is not answered before the
+// entry exists), and every other entry is on the index, where
+// BuildKeyFilter() finds it. Growing the index moves entries from buckets
+// that were already added to buckets that were not, so nothing is missed.
+void BackendImpl::StartKeyFilter() {
+  if ((user_flags_ & kNoKeyFilter) || key_filter_failed_)
+    return;
+
+  {
+    base::AutoLock lock(key_filter_lock_);
+    if (new_key_filter_.get())
+      return;
+    new_key_filter_.reset(new BloomFilter(
+        std::max(data_->header.num_entries * 2, kMinKeyFilterCapacity)));
+  }
+
+  key_filter_bucket_ = 0;
+  MessageLoop::current()->PostTask(
+      FROM_HERE, base::Bind(&BackendImpl::BuildKeyFilter, GetWeakPtr()));
+}
+
+void BackendImpl::BuildKeyFilter() {
+  if (disabled_) {
+    base::AutoLock lock(key_filter_lock_);
+    new_key_filter_.reset();
+    return;
+  }
+
+  // Reading the entries may have to wait for the disk, so the lock is only
+  // taken to update the filter.
+  std::vector<uint32> hashes;
+  int num_buckets = static_cast<int>(mask_ + 1);
+  int last_bucket = std::min(key_filter_bucket_ + kKeyFilterStep, num_buckets);
+  for (; key_filter_bucket_ < last_bucket; key_filter_bucket_++) {
+    CacheAddr address = data_->table[key_filter_bucket_];
+    int chain_length = 0;
+    while (address) {
+      uint32 hash;
+      if (++chain_length > data_->header.num_entries ||
+          !ReadEntryLink(Addr(address), &hash, &address)) {
+        // MatchEntry() fixes broken chains as it walks them, so from now on
+        // every OpenEntry() has to go to the index.
+        Trace("Key filter failed 0x%x", address);
+        key_filter_failed_ = true;
+        base::AutoLock lock(key_filter_lock_);
+        key_filter_.reset();
+        new_key_filter_.reset();
+        return;
+      }
+      hashes.push_back(hash);
+    }
+  }
+
+  base::AutoLock lock(key_filter_lock_);
+  for (size_t i = 0; i < hashes.size(); i++)
+    new_key_filter_->Add(hashes[i]);
+
+  if (key_filter_bucket_ < num_buckets) {
+    MessageLoop::current()->PostTask(
+        FROM_HERE, base::Bind(&BackendImpl::BuildKeyFilter, GetWeakPtr()));
+    return;
+  }
+
+  key_filter_.swap(new_key_filter_);
+  new_key_filter_.reset();
+}
+
 void BackendImpl::RestartCache(bool failure) {
   int64 errors = stats_.GetCounter(Stats::FATAL_ERROR);
   int64 full_dooms = stats_.GetCounter(Stats::DOOM_CACHE);
@@ -1627,7 +1947,7 @@ int BackendImpl::NewEntry(Addr address, EntryImpl** entry) {
 EntryImpl* BackendImpl::MatchEntry(const std::string& key, uint32 hash,
                                    bool find_parent, Addr entry_addr,
                                    bool* match_error) {
-  Addr address(data_->table[hash & mask_]);
+  Addr address(data_->table[BucketForHash(hash)]);
   scoped_refptr<EntryImpl> cache_entry, parent_entry;
   EntryImpl* tmp = NULL;
   bool found = false;
@@ -1667,7 +1987,7 @@ EntryImpl* BackendImpl::MatchEntry(const std::string& key, uint32 hash,
         parent_entry->SetNextAddress(child);
         parent_entry = NULL;
       } else {
-        data_->table[hash & mask_] = child.value();
+        data_->table[BucketForHash(hash)] = child.value();
       }
 
       Trace("MatchEntry dirty %d 0x%x 0x%x", find_parent, entry_addr.value(),
@@ -1683,12 +2003,13 @@ EntryImpl* BackendImpl::MatchEntry(const std::string& key, uint32 hash,
       }
 
       // Restart the search.
-      address.set_value(data_->table[hash & mask_]);
+      address.set_value(data_->table[BucketForHash(hash)]);
       visited.clear();
       continue;
     }
 
-    DCHECK_EQ(hash & mask_, cache_entry->entry()->Data()->hash & mask_);
+    DCHECK_EQ(BucketForHash(hash),
+              BucketForHash(cache_entry->entry()->Data()->hash));
     if (cache_entry->IsSameEntry(key, hash)) {
       if (!cache_entry->Update())
         cache_entry = NULL;
@@ -2085,6 +2406,15 @@ bool BackendImpl::CheckIndex() {
     return false;
   }
 
+  if (data_->header.split_len &&
+      (data_->header.split_len & (data_->header.split_len - 1) ||
+       data_->header.split_len > data_->header.table_len / 2 ||
+       data_->header.split_bucket < 0 ||
+       data_->header.split_bucket >= data_->header.split_len)) {
+    LOG(ERROR) << "Invalid index growth state";
+    return false;
+  }
+
   AdjustMaxCacheSize(data_->header.table_len);
 
 #if !defined(NET_BUILD_STRESS_CACHE)
@@ -2134,7 +2464,7 @@ int BackendImpl::CheckAllEntries() {
       else
         return ERR_INVALID_ENTRY;
 
-      DCHECK_EQ(i, cache_entry->entry()->Data()->hash & mask_);
+      DCHECK_EQ(i, BucketForHash(cache_entry->entry()->Data()->hash));
       address.set_value(cache_entry->GetNextAddress());
       if (!address.is_initialized())
         break;
@@ -10,8 +10,11 @@
 
 #include "base/file_path.h"
 #include "base/hash_tables.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/synchronization/lock.h"
 #include "base/timer.h"
 #include "net/disk_cache/block_files.h"
+#include "net/disk_cache/bloom_filter.h"
 #include "net/disk_cache/disk_cache.h"
 #include "net/disk_cache/eviction.h"
 #include "net/disk_cache/in_flight_backend_io.h"
@@ -35,7 +38,9 @@ enum BackendFlags {
   kNewEviction = 1 << 4,        // Use of new eviction was specified.
   kNoRandom = 1 << 5,           // Don't add randomness to the behavior.
   kNoLoadProtection = 1 << 6,   // Don't act conservatively under load.
-  kNoBuffering = 1 << 7         // Disable extended IO buffering.
+  kNoBuffering = 1 << 7,        // Disable extended IO buffering.
+  kNoKeyFilter = 1 << 8,        // Always look for the entry on OpenEntry().
+  kFrequencyEviction = 1 << 9   // Keep small, frequently used entries longer.
 };
 
 // This class implements the Backend interface. An object of this
@@ -249,6 +254,19 @@ class NET_EXPORT_PRIVATE BackendImpl : public Backend {
   // entries. This method should be called directly on the cache thread.
   void TrimDeletedListForTest(bool empty);
 
+  // Doubles the size of the index table and splits all its buckets, as if the
+  // cache had grown past its load limit. This method should be called
+  // directly on the cache thread.
+  void GrowIndexForTest();
+
+  // Like GrowIndexForTest(), but only splits |num_buckets| buckets, leaving
+  // the rest for the entries created next.
+  void StartGrowIndexForTest(int num_buckets);
+
+  // Returns true if OpenEntry() can already tell that a key is not stored
+  // without going to the cache thread.
+  bool HasKeyFilterForTest();
+
   // Performs a simple self-check, and returns the number of dirty items
   // or an error code (negative value).
   int SelfCheck();
@@ -281,6 +299,44 @@ class NET_EXPORT_PRIVATE BackendImpl : public Backend {
   bool InitBackingStore(bool* file_created);
   void AdjustMaxCacheSize(int table_len);
 
+  // Returns true if the index table is loaded enough to be grown.
+  bool ShouldGrowIndex() const;
+
+  // Doubles the size of the index table. The hash buckets are then split in
+  // two by SplitBuckets(), without touching the entries that stay where they
+  // are. Returns false if the table is left as it was.
+  bool GrowIndex();
+
+  // Splits up to |max_buckets| more buckets of the table that is growing,
+  // and ends the growth once they are all split.
+  void SplitBuckets(int max_buckets);
+
+  // Returns the bucket of the index table that holds the chain for |hash|.
+  uint32 BucketForHash(uint32 hash) const;
+
+  // Moves the entries of |bucket| that belong to |bucket| + |old_len| once
+  // the table is |old_len| * 2 buckets long.
+  void SplitBucket(uint32 bucket, uint32 old_len);
+
+  // Reads the hash and the |next| link of the entry at |address|, which may be
+  // open. Returns false if the entry cannot be trusted.
+  bool ReadEntryLink(Addr address, uint32* hash, CacheAddr* next);
+
+  // Sets the |next| link of the entry at |address|.
+  void WriteEntryLink(Addr address, CacheAddr next);
+
+  // Returns false if |key| is definitely not stored in the cache. This method
+  // may be called from any thread.
+  bool MayHaveEntry(const std::string& key);
+
+  // Records that an entry with the given hash may be stored. This method may
+  // be called from any thread.
+  void AddToKeyFilter(uint32 hash);
+
+  // Starts building a new key filter from the index, a few buckets at a time.
+  void StartKeyFilter();
+  void BuildKeyFilter();
+
   // Deletes the cache and starts again.
   void RestartCache(bool failure);
   void PrepareForRestart();
@@ -379,6 +435,16 @@ class NET_EXPORT_PRIVATE BackendImpl : public Backend {
 
   net::NetLog* net_log_;
 
+  // The filter used by OpenEntry(), and the one being built to replace it.
+  // Both are used from the cache thread and from the thread that owns the
+  // backend, so they are protected by |key_filter_lock_|.
+  base::Lock key_filter_lock_;
+  scoped_ptr<BloomFilter> key_filter_;
+  scoped_ptr<BloomFilter> new_key_filter_;
+  int key_filter_bucket_;  // The next bucket to add to |new_key_filter_|.
+  bool key_filter_failed_;  // The index could not be read.
+  int filtered_misses_;  // Misses answered by |key_filter_|.
+
   Stats stats_;  // Usage statistics.
   scoped_ptr<base::RepeatingTimer<BackendImpl> > timer_;  // Usage timer.
   base::WaitableEvent done_;  // Signals the end of background work.
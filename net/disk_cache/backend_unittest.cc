@@ -20,6 +20,7 @@
 #include "net/disk_cache/histogram_macros.h"
 #include "net/disk_cache/mapped_file.h"
 #include "net/disk_cache/mem_backend_impl.h"
+#include "net/disk_cache/sharded_backend.h"
 #include "testing/gtest/include/gtest/gtest.h"
 
 #if defined(OS_WIN)
@@ -41,6 +42,7 @@ class DiskCacheBackendTest : public DiskCacheTestWithCache {
   void BackendSetSize();
   void BackendLoad();
   void BackendChain();
+  void BackendGrowIndex();
   void BackendValidEntry();
   void BackendInvalidEntry();
   void BackendInvalidEntryRead();
@@ -242,6 +244,77 @@ TEST_F(DiskCacheTest, CreateBackend) {
   MessageLoop::current()->RunAllPending();
 }
 
+TEST_F(DiskCacheTest, ShardedBackend) {
+  // The shards' folders are not removed by CleanupCacheDir().
+  ASSERT_TRUE(file_util::Delete(cache_path_, true));
+  net::TestCompletionCallback cb;
+  disk_cache::Backend* cache = NULL;
+  const int kNumShards = 4;
+  int rv = disk_cache::ShardedBackend::CreateBackend(
+      cache_path_, kNumShards, false, 4 * 1024 * 1024, net::DISK_CACHE,
+      disk_cache::kNoRandom, NULL, &cache, cb.callback());
+  ASSERT_EQ(net::OK, cb.GetResult(rv));
+  ASSERT_TRUE(cache);
+  disk_cache::ShardedBackend* sharded =
+      static_cast<disk_cache::ShardedBackend*>(cache);
+  EXPECT_EQ(kNumShards, sharded->num_shards());
+
+  const int kNumEntries = 50;
+  std::string keys[kNumEntries];
+  int entries_per_shard[kNumShards] = { 0 };
+  disk_cache::Entry* entry;
+  for (int i = 0; i < kNumEntries; i++) {
+    keys[i] = base::StringPrintf("the key %d", i);
+    rv = cache->CreateEntry(keys[i], &entry, cb.callback());
+    ASSERT_EQ(net::OK, cb.GetResult(rv));
+    entry->Close();
+    entries_per_shard[sharded->ShardForKey(keys[i])]++;
+  }
+  EXPECT_EQ(kNumEntries, cache->GetEntryCount());
+  for (int i = 0; i < kNumShards; i++)
+    EXPECT_LT(0, entries_per_shard[i]) << i;
+
+  for (int i = 0; i < kNumEntries; i++) {
+    rv = cache->OpenEntry(keys[i], &entry, cb.callback());
+    ASSERT_EQ(net::OK, cb.GetResult(rv)) << i;
+    EXPECT_EQ(keys[i], entry->GetKey());
+    entry->Close();
+  }
+
+  rv = cache->DoomEntry(keys[0], cb.callback());
+  ASSERT_EQ(net::OK, cb.GetResult(rv));
+  rv = cache->OpenEntry(keys[0], &entry, cb.callback());
+  EXPECT_NE(net::OK, cb.GetResult(rv));
+
+  // The enumeration goes through every shard.
+  std::set<std::string> enumerated;
+  void* iter = NULL;
+  while (cb.GetResult(cache->OpenNextEntry(&iter, &entry, cb.callback())) ==
+         net::OK) {
+    enumerated.insert(entry->GetKey());
+    entry->Close();
+  }
+  EXPECT_FALSE(iter);
+  EXPECT_EQ(static_cast<size_t>(kNumEntries - 1), enumerated.size());
+
+  // And it can be ended early.
+  rv = cache->OpenNextEntry(&iter, &entry, cb.callback());
+  ASSERT_EQ(net::OK, cb.GetResult(rv));
+  entry->Close();
+  cache->EndEnumeration(&iter);
+  EXPECT_FALSE(iter);
+
+  rv = cache->DoomAllEntries(cb.callback());
+  ASSERT_EQ(net::OK, cb.GetResult(rv));
+  EXPECT_EQ(0, cache->GetEntryCount());
+
+  delete cache;
+  MessageLoop::current()->RunAllPending();
+  EXPECT_TRUE(file_util::PathExists(
+      cache_path_.AppendASCII("shard_3").AppendASCII("index")));
+  EXPECT_TRUE(file_util::Delete(cache_path_, true));
+}
+
 // Testst that re-creating the cache performs the expected cleanup.
 TEST_F(DiskCacheBackendTest, CreateBackend_MissingFile) {
   ASSERT_TRUE(CopyTestCache("bad_entry"));
@@ -620,6 +693,229 @@ TEST_F(DiskCacheBackendTest, AppCacheChain) {
   BackendChain();
 }
 
+void DiskCacheBackendTest::BackendGrowIndex() {
+  SetMask(0x1);  // 2-entry table, so that the chains are long.
+  InitCache();
+
+  const int kNumEntries = 100;
+  std::string keys[kNumEntries];
+  disk_cache::Entry* open_entry = NULL;
+  for (int i = 0; i < kNumEntries; i++) {
+    keys[i] = GenerateKey(true);
+    disk_cache::Entry* entry;
+    ASSERT_EQ(net::OK, CreateEntry(keys[i], &entry));
+    // Keep one entry open while the table grows.
+    if (i == kNumEntries / 2)
+      open_entry = entry;
+    else
+      entry->Close();
+  }
+
+  // Grow the table to 16 buckets.
+  GrowIndexForTest();
+  GrowIndexForTest();
+  GrowIndexForTest();
+  SetMask(0xf);
+  open_entry->Close();
+
+  disk_cache::Entry* entry;
+  for (int i = 0; i < kNumEntries; i++) {
+    ASSERT_EQ(net::OK, OpenEntry(keys[i], &entry)) << i;
+    entry->Close();
+  }
+  ASSERT_EQ(net::OK, DoomEntry(keys[0]));
+  ASSERT_EQ(net::OK, CreateEntry("a new key", &entry));
+  entry->Close();
+
+  // The links on disk must match the new table.
+  SimulateCrash();
+  for (int i = 1; i < kNumEntries; i++) {
+    ASSERT_EQ(net::OK, OpenEntry(keys[i], &entry)) << i;
+    entry->Close();
+  }
+  EXPECT_NE(net::OK, OpenEntry(keys[0], &entry));
+  EXPECT_EQ(kNumEntries, cache_->GetEntryCount());
+}
+
+TEST_F(DiskCacheBackendTest, GrowIndex) {
+  BackendGrowIndex();
+}
+
+TEST_F(DiskCacheBackendTest, NewEvictionGrowIndex) {
+  SetNewEviction();
+  BackendGrowIndex();
+}
+
+TEST_F(DiskCacheBackendTest, FrequencyEvictionGrowIndex) {
+  SetFrequencyEviction();
+  BackendGrowIndex();
+}
+
+// Tests that the index file grows when the whole table is in use.
+TEST_F(DiskCacheBackendTest, GrowIndexFile) {
+  SetDirectMode();
+  InitCache();
+
+  const int kNumEntries = 20;
+  std::string keys[kNumEntries];
+  for (int i = 0; i < kNumEntries; i++) {
+    keys[i] = GenerateKey(true);
+    disk_cache::Entry* entry;
+    ASSERT_EQ(net::OK, CreateEntry(keys[i], &entry));
+    entry->Close();
+  }
+
+  FilePath index_name = cache_path_.AppendASCII("index");
+  int64 old_size;
+  ASSERT_TRUE(file_util::GetFileSize(index_name, &old_size));
+  GrowIndexForTest();
+  int64 new_size;
+  ASSERT_TRUE(file_util::GetFileSize(index_name, &new_size));
+  EXPECT_EQ(old_size * 2 - static_cast<int64>(sizeof(disk_cache::IndexHeader)),
+            new_size);
+
+  // The new length is read back from the file.
+  SimulateCrash();
+  for (int i = 0; i < kNumEntries; i++) {
+    disk_cache::Entry* entry;
+    ASSERT_EQ(net::OK, OpenEntry(keys[i], &entry)) << i;
+    entry->Close();
+  }
+}
+
+// Tests that entries are found while only part of the index table is split,
+// also after the cache is opened again, and while new entries split the rest.
+TEST_F(DiskCacheBackendTest, GrowIndexInSteps) {
+  SetDirectMode();
+  InitCache();
+
+  const int kNumEntries = 200;
+  std::string keys[kNumEntries * 2];
+  disk_cache::Entry* entry;
+  for (int i = 0; i < kNumEntries; i++) {
+    keys[i] = GenerateKey(true);
+    ASSERT_EQ(net::OK, CreateEntry(keys[i], &entry));
+    entry->Close();
+  }
+
+  // Split a quarter of the 64k buckets.
+  StartGrowIndexForTest(16 * 1024);
+  for (int i = 0; i < kNumEntries; i++) {
+    ASSERT_EQ(net::OK, OpenEntry(keys[i], &entry)) << i;
+    entry->Close();
+  }
+
+  // The growth carries on from the header.
+  SimulateCrash();
+  for (int i = kNumEntries; i < kNumEntries * 2; i++) {
+    keys[i] = GenerateKey(true);
+    ASSERT_EQ(net::OK, CreateEntry(keys[i], &entry));
+    entry->Close();
+  }
+  for (int i = 0; i < kNumEntries * 2; i++) {
+    ASSERT_EQ(net::OK, OpenEntry(keys[i], &entry)) << i;
+    entry->Close();
+  }
+
+  GrowIndexForTest();
+  SimulateCrash();
+  for (int i = 0; i < kNumEntries * 2; i++) {
+    ASSERT_EQ(net::OK, OpenEntry(keys[i], &entry)) << i;
+    entry->Close();
+  }
+  EXPECT_EQ(kNumEntries * 2, cache_->GetEntryCount());
+}
+
+// Tests that OpenEntry() answers misses without going to the cache thread once
+// the key filter is built, and that it still finds every entry.
+TEST_F(DiskCacheBackendTest, KeyFilter) {
+  SetDirectMode();
+  InitCache();
+
+  const int kNumEntries = 20;
+  std::string keys[kNumEntries];
+  for (int i = 0; i < kNumEntries; i++) {
+    keys[i] = GenerateKey(true);
+    disk_cache::Entry* entry;
+    ASSERT_EQ(net::OK, CreateEntry(keys[i], &entry));
+    entry->Close();
+  }
+
+  for (int i = 0; i < 100 && !cache_impl_->HasKeyFilterForTest(); i++)
+    FlushQueueForTest();
+  ASSERT_TRUE(cache_impl_->HasKeyFilterForTest());
+
+  net::TestCompletionCallback cb;
+  disk_cache::Entry* entry;
+  EXPECT_EQ(net::ERR_FAILED,
+            cache_->OpenEntry("not there", &entry, cb.callback()));
+  for (int i = 0; i < kNumEntries; i++) {
+    ASSERT_EQ(net::OK, OpenEntry(keys[i], &entry)) << i;
+    entry->Close();
+  }
+
+  // An entry is found even before it is created on the cache thread.
+  net::TestCompletionCallback create_cb;
+  disk_cache::Entry* new_entry;
+  ASSERT_EQ(net::ERR_IO_PENDING,
+            cache_->CreateEntry("new key", &new_entry, create_cb.callback()));
+  ASSERT_EQ(net::ERR_IO_PENDING,
+            cache_->OpenEntry("new key", &entry, cb.callback()));
+  ASSERT_EQ(net::OK, create_cb.WaitForResult());
+  ASSERT_EQ(net::OK, cb.WaitForResult());
+  new_entry->Close();
+  entry->Close();
+
+  // And so are the children of sparse entries, created on the cache thread.
+  const int kSize = 1024;
+  scoped_refptr<net::IOBuffer> buffer(new net::IOBuffer(kSize));
+  CacheTestFillBuffer(buffer->data(), kSize, false);
+  ASSERT_EQ(net::OK, CreateEntry("sparse", &entry));
+  EXPECT_EQ(kSize, WriteSparseData(entry, 0, buffer, kSize));
+  entry->Close();
+
+  void* iter = NULL;
+  std::string child_key;
+  while (OpenNextEntry(&iter, &entry) == net::OK) {
+    if (entry->GetKey().find("Range_sparse") == 0)
+      child_key = entry->GetKey();
+    entry->Close();
+  }
+  ASSERT_FALSE(child_key.empty());
+  ASSERT_EQ(net::OK, OpenEntry(child_key, &entry));
+  entry->Close();
+
+  std::vector<std::pair<std::string, std::string> > stats;
+  cache_->GetStats(&stats);
+  bool found = false;
+  for (size_t i = 0; i < stats.size(); i++) {
+    if (stats[i].first == "Filtered misses") {
+      EXPECT_EQ("1", stats[i].second);
+      found = true;
+    }
+  }
+  EXPECT_TRUE(found);
+}
+
+// Tests that the key filter is not used when the index cannot be walked.
+TEST_F(DiskCacheBackendTest, KeyFilterBadNextEntry) {
+  ASSERT_TRUE(CopyTestCache("list_loop3"));
+  SetMask(0x1);  // 2-entry table.
+  SetMaxSize(0x3000);  // 12 kB.
+  DisableFirstCleanup();
+  SetDirectMode();
+  InitCache();
+
+  // There is a wide loop of 5 entries, so the missing key has to go to the
+  // cache thread, which breaks the loop.
+  for (int i = 0; i < 10; i++)
+    FlushQueueForTest();
+  EXPECT_FALSE(cache_impl_->HasKeyFilterForTest());
+
+  disk_cache::Entry* entry;
+  ASSERT_NE(net::OK, OpenEntry("Not present key", &entry));
+}
+
 TEST_F(DiskCacheBackendTest, NewEvictionTrim) {
   SetNewEviction();
   SetDirectMode();
@@ -651,6 +947,61 @@ TEST_F(DiskCacheBackendTest, NewEvictionTrim) {
   entry->Close();
 }
 
+// Tests that small entries that are used often are kept over the ones that
+// are used just once.
+TEST_F(DiskCacheBackendTest, FrequencyEvictionTrim) {
+  SetFrequencyEviction();
+  InitCache();
+
+  disk_cache::Entry* entry;
+  ASSERT_EQ(net::OK, CreateEntry("Key 0", &entry));
+  entry->Close();
+  for (int i = 0; i < 2; i++) {
+    ASSERT_EQ(net::OK, OpenEntry("Key 0", &entry));
+    entry->Close();
+  }
+
+  for (int i = 1; i < 10; i++) {
+    ASSERT_EQ(net::OK, CreateEntry(StringPrintf("Key %d", i), &entry));
+    entry->Close();
+  }
+
+  // "Key 0" is the least recently used entry, but it gets another chance.
+  TrimForTest(false);
+  EXPECT_NE(net::OK, OpenEntry("Key 1", &entry));
+  ASSERT_EQ(net::OK, OpenEntry("Key 0", &entry));
+  entry->Close();
+  ASSERT_EQ(net::OK, OpenEntry("Key 2", &entry));
+  entry->Close();
+}
+
+// Tests that large entries are evicted even if they are used often.
+TEST_F(DiskCacheBackendTest, FrequencyEvictionTrimLargeEntry) {
+  SetFrequencyEviction();
+  InitCache();
+
+  const int kSize = 1024 * 1024;
+  scoped_refptr<net::IOBuffer> buffer(new net::IOBuffer(kSize));
+  CacheTestFillBuffer(buffer->data(), kSize, false);
+
+  disk_cache::Entry* entry;
+  ASSERT_EQ(net::OK, CreateEntry("Key 0", &entry));
+  EXPECT_EQ(kSize, WriteData(entry, 1, 0, buffer, kSize, false));
+  entry->Close();
+  for (int i = 0; i < 2; i++) {
+    ASSERT_EQ(net::OK, OpenEntry("Key 0", &entry));
+    entry->Close();
+  }
+
+  ASSERT_EQ(net::OK, CreateEntry("Key 1", &entry));
+  entry->Close();
+
+  TrimForTest(false);
+  EXPECT_NE(net::OK, OpenEntry("Key 0", &entry));
+  ASSERT_EQ(net::OK, OpenEntry("Key 1", &entry));
+  entry->Close();
+}
+
 // Before looking for invalid entries, let's check a valid entry.
 void DiskCacheBackendTest::BackendValidEntry() {
   SetDirectMode();
@@ -0,0 +1,50 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_DISK_CACHE_BLOOM_FILTER_H_
+#define NET_DISK_CACHE_BLOOM_FILTER_H_
+#pragma once
+
+#include "base/basictypes.h"
+#include "net/base/net_export.h"
+#include "net/disk_cache/bitmap.h"
+
+namespace disk_cache {
+
+// This class keeps a summary of a set of key hashes. It never says that a
+// hash that was added is missing, but it may say that a hash that was never
+// added is present, and that gets more likely as more hashes are added.
+class NET_EXPORT_PRIVATE BloomFilter {
+ public:
+  // The filter is sized so that about 2% of the lookups for missing hashes are
+  // reported as present with |capacity| hashes in it.
+  explicit BloomFilter(int capacity);
+  ~BloomFilter();
+
+  void Add(uint32 hash);
+
+  // Returns false if |hash| was never added.
+  bool MayContain(uint32 hash) const;
+
+  // Returns true if more distinct hashes were added than the filter was sized
+  // for.
+  bool IsFull() const {
+    return num_hashes_ > capacity_;
+  }
+
+ private:
+  // Returns the |probe|th bit that stands for |hash|.
+  int GetBit(uint32 hash, int probe) const;
+
+  Bitmap bits_;
+  uint32 mask_;  // One less than the number of bits.
+  int capacity_;
+  int num_hashes_;
+
+  DISALLOW_COPY_AND_ASSIGN(BloomFilter);
+};
+
+}  // namespace disk_cache
+
+#endif  // NET_DISK_CACHE_BLOOM_FILTER_H_
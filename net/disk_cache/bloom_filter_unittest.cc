@@ -0,0 +1,64 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/stringprintf.h"
+#include "net/disk_cache/bloom_filter.h"
+#include "net/disk_cache/hash.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace {
+
+uint32 KeyHash(const char* prefix, int i) {
+  return disk_cache::Hash(base::StringPrintf("%s%d", prefix, i));
+}
+
+}  // namespace
+
+TEST(BloomFilterTest, Basics) {
+  disk_cache::BloomFilter filter(100);
+  EXPECT_FALSE(filter.MayContain(0));
+  EXPECT_FALSE(filter.MayContain(0x12345678));
+
+  filter.Add(0x12345678);
+  EXPECT_TRUE(filter.MayContain(0x12345678));
+  EXPECT_FALSE(filter.IsFull());
+}
+
+TEST(BloomFilterTest, NoFalseNegatives) {
+  const int kCapacity = 10000;
+  disk_cache::BloomFilter filter(kCapacity);
+  for (int i = 0; i < kCapacity; i++)
+    filter.Add(KeyHash("http://www.google.com/", i));
+
+  for (int i = 0; i < kCapacity; i++)
+    EXPECT_TRUE(filter.MayContain(KeyHash("http://www.google.com/", i)));
+}
+
+TEST(BloomFilterTest, FalsePositives) {
+  const int kCapacity = 10000;
+  disk_cache::BloomFilter filter(kCapacity);
+  for (int i = 0; i < kCapacity; i++)
+    filter.Add(KeyHash("http://www.google.com/", i));
+
+  int false_positives = 0;
+  for (int i = 0; i < kCapacity; i++)
+    false_positives += filter.MayContain(KeyHash("http://www.example.com/", i));
+
+  // This would be about 0.5% for a perfect hash.
+  EXPECT_LT(false_positives, kCapacity / 50);
+}
+
+TEST(BloomFilterTest, IsFull) {
+  disk_cache::BloomFilter filter(10);
+  for (int i = 0; i < 10; i++)
+    filter.Add(KeyHash("key", i));
+  EXPECT_FALSE(filter.IsFull());
+
+  // Adding the same hash again doesn't count.
+  filter.Add(KeyHash("key", 0));
+  EXPECT_FALSE(filter.IsFull());
+
+  filter.Add(KeyHash("key", 10));
+  EXPECT_TRUE(filter.IsFull());
+}
@@ -7,7 +7,10 @@
 #include "base/basictypes.h"
 #include "base/bind.h"
 #include "base/bind_helpers.h"
+#include "base/file_util.h"
+#include "base/message_loop.h"
 #include "base/perftimer.h"
+#include "base/stringprintf.h"
 #include "base/string_util.h"
 #include "base/threading/thread.h"
 #include "base/test/test_file_util.h"
@@ -21,6 +24,7 @@
 #include "net/disk_cache/disk_cache_test_base.h"
 #include "net/disk_cache/disk_cache_test_util.h"
 #include "net/disk_cache/hash.h"
+#include "net/disk_cache/sharded_backend.h"
 #include "testing/gtest/include/gtest/gtest.h"
 #include "testing/platform_test.h"
 
@@ -143,6 +147,102 @@ int BlockSize() {
   return (rand() & 0x3) + 1;
 }
 
+// Counts completed operations, and quits the message loop after the last one.
+class OperationCounter {
+ public:
+  explicit OperationCounter(int expected)
+      : expected_(expected), completed_(0), failed_(0) {}
+
+  void OnComplete(int result) {
+    if (result != net::OK)
+      failed_++;
+    if (++completed_ == expected_)
+      MessageLoop::current()->Quit();
+  }
+
+  // Counts an operation that completed without a callback.
+  void AddResult(int result) {
+    if (result != net::ERR_IO_PENDING)
+      OnComplete(result);
+  }
+
+  // Waits for all the operations to complete.
+  void Wait() {
+    if (completed_ < expected_)
+      MessageLoop::current()->Run();
+  }
+
+  int failed() const { return failed_; }
+
+ private:
+  int expected_;
+  int completed_;
+  int failed_;
+
+  DISALLOW_COPY_AND_ASSIGN(OperationCounter);
+};
+
+// Creates, opens and dooms an entry for each of |keys|, with all the
+// operations of each step in flight at the same time, and logs the rate of
+// each step with the given |name|.
+bool TimeIndexOperations(const std::string& name,
+                         const std::vector<std::string>& keys,
+                         disk_cache::Backend* cache) {
+  const int num_entries = static_cast<int>(keys.size());
+  std::vector<disk_cache::Entry*> entries(num_entries);
+  bool success = true;
+
+  OperationCounter creations(num_entries);
+  PerfTimer create_timer;
+  for (int i = 0; i < num_entries; i++) {
+    creations.AddResult(cache->CreateEntry(
+        keys[i], &entries[i],
+        base::Bind(&OperationCounter::OnComplete,
+                   base::Unretained(&creations))));
+  }
+  creations.Wait();
+  LogPerfResult((name + "_Create").c_str(),
+                num_entries / create_timer.Elapsed().InSecondsF(), "ops/s");
+  success &= !creations.failed();
+  for (int i = 0; i < num_entries; i++)
+    entries[i]->Close();
+
+  OperationCounter opens(num_entries);
+  PerfTimer open_timer;
+  for (int i = 0; i < num_entries; i++) {
+    opens.AddResult(cache->OpenEntry(
+        keys[i], &entries[i],
+        base::Bind(&OperationCounter::OnComplete, base::Unretained(&opens))));
+  }
+  opens.Wait();
+  LogPerfResult((name + "_Open").c_str(),
+                num_entries / open_timer.Elapsed().InSecondsF(), "ops/s");
+  success &= !opens.failed();
+  for (int i = 0; i < num_entries; i++)
+    entries[i]->Close();
+
+  OperationCounter dooms(num_entries);
+  PerfTimer doom_timer;
+  for (int i = 0; i < num_entries; i++) {
+    dooms.AddResult(cache->DoomEntry(
+        keys[i],
+        base::Bind(&OperationCounter::OnComplete, base::Unretained(&dooms))));
+  }
+  dooms.Wait();
+  LogPerfResult((name + "_Doom").c_str(),
+                num_entries / doom_timer.Elapsed().InSecondsF(), "ops/s");
+  success &= !dooms.failed();
+
+  return success;
+}
+
+std::vector<std::string> GenerateKeys(int num_entries) {
+  std::vector<std::string> keys;
+  for (int i = 0; i < num_entries; i++)
+    keys.push_back(GenerateKey(true));
+  return keys;
+}
+
 }  // namespace
 
 TEST_F(DiskCacheTest, Hash) {
@@ -248,3 +348,109 @@ TEST_F(DiskCacheTest, BlockFilesPerformance) {
   MessageLoop::current()->RunAllPending();
   delete[] address;
 }
+
+// Measures how the index copes with more and more entries, with a table that
+// grows with the cache and with one that is stuck at its initial size.
+TEST_F(DiskCacheTest, IndexScalingPerformance) {
+  base::Thread cache_thread("CacheThread");
+  ASSERT_TRUE(cache_thread.StartWithOptions(
+                  base::Thread::Options(MessageLoop::TYPE_IO, 0)));
+
+  const int kNumEntries[] = { 10000, 100000, 200000 };
+  for (size_t i = 0; i < arraysize(kNumEntries); i++) {
+    std::vector<std::string> keys = GenerateKeys(kNumEntries[i]);
+    for (int fixed = 0; fixed < 2; fixed++) {
+      ASSERT_TRUE(CleanupCacheDir());
+      // A mask stops the table from growing.
+      disk_cache::BackendImpl* cache = fixed ?
+          new disk_cache::BackendImpl(cache_path_, 0xffff,
+                                      cache_thread.message_loop_proxy(),
+                                      NULL) :
+          new disk_cache::BackendImpl(cache_path_,
+                                      cache_thread.message_loop_proxy(),
+                                      NULL);
+      cache->SetMaxSize(kint32max / 2);
+      cache->SetFlags(disk_cache::kNoRandom);
+      net::TestCompletionCallback cb;
+      ASSERT_EQ(net::OK, cb.GetResult(cache->Init(cb.callback())));
+
+      std::string name = base::StringPrintf(
+          "DiskCache_%s%dk", fixed ? "FixedIndex" : "GrowingIndex",
+          kNumEntries[i] / 1000);
+      EXPECT_TRUE(TimeIndexOperations(name, keys, cache));
+      MessageLoop::current()->RunAllPending();
+      delete cache;
+    }
+  }
+}
+
+// Measures the operations of a sharded backend as the number of shards, and
+// cache threads, grows.
+TEST_F(DiskCacheTest, ShardedBackendPerformance) {
+  const int kNumEntries = 50000;
+  std::vector<std::string> keys = GenerateKeys(kNumEntries);
+
+  const int kNumShards[] = { 1, 2, 4, 8 };
+  for (size_t i = 0; i < arraysize(kNumShards); i++) {
+    ASSERT_TRUE(file_util::Delete(cache_path_, true));
+    net::TestCompletionCallback cb;
+    disk_cache::Backend* cache;
+    int rv = disk_cache::ShardedBackend::CreateBackend(
+        cache_path_, kNumShards[i], false, kint32max / 2, net::DISK_CACHE,
+        disk_cache::kNoRandom, NULL, &cache, cb.callback());
+    ASSERT_EQ(net::OK, cb.GetResult(rv));
+
+    std::string name = base::StringPrintf("DiskCache_%dShards",
+                                          kNumShards[i]);
+    EXPECT_TRUE(TimeIndexOperations(name, keys, cache));
+    MessageLoop::current()->RunAllPending();
+    delete cache;
+  }
+  EXPECT_TRUE(file_util::Delete(cache_path_, true));
+}
+
+// Measures how long it takes to find out that a key is not stored, one key at
+// a time as HttpCache does, with and without the key filter.
+TEST_F(DiskCacheTest, MissPerformance) {
+  base::Thread cache_thread("CacheThread");
+  ASSERT_TRUE(cache_thread.StartWithOptions(
+                  base::Thread::Options(MessageLoop::TYPE_IO, 0)));
+
+  const int kNumEntries = 10000;
+  const int kNumMisses = 10000;
+  std::vector<std::string> keys = GenerateKeys(kNumEntries);
+  std::vector<std::string> missing_keys = GenerateKeys(kNumMisses);
+  for (int filter = 0; filter < 2; filter++) {
+    ASSERT_TRUE(CleanupCacheDir());
+    disk_cache::BackendImpl* cache =
+        new disk_cache::BackendImpl(cache_path_,
+                                    cache_thread.message_loop_proxy(), NULL);
+    cache->SetMaxSize(kint32max / 2);
+    cache->SetFlags(filter ? disk_cache::kNoRandom :
+                    disk_cache::kNoRandom | disk_cache::kNoKeyFilter);
+    net::TestCompletionCallback cb;
+    ASSERT_EQ(net::OK, cb.GetResult(cache->Init(cb.callback())));
+
+    for (int i = 0; i < kNumEntries; i++) {
+      disk_cache::Entry* entry;
+      ASSERT_EQ(net::OK,
+                cb.GetResult(cache->CreateEntry(keys[i], &entry,
+                                                cb.callback())));
+      entry->Close();
+    }
+    while (filter && !cache->HasKeyFilterForTest())
+      ASSERT_EQ(net::OK, cb.GetResult(cache->FlushQueueForTest(cb.callback())));
+
+    PerfTimer timer;
+    for (int i = 0; i < kNumMisses; i++) {
+      disk_cache::Entry* entry;
+      int rv = cache->OpenEntry(missing_keys[i], &entry, cb.callback());
+      EXPECT_NE(net::OK, cb.GetResult(rv));
+    }
+    LogPerfResult(filter ? "DiskCache_MissWithKeyFilter" :
+                           "DiskCache_MissWithoutKeyFilter",
+                  kNumMisses / timer.Elapsed().InSecondsF(), "misses/s");
+    MessageLoop::current()->RunAllPending();
+    delete cache;
+  }
+}
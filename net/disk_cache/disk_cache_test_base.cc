@@ -54,6 +54,7 @@ DiskCacheTestWithCache::DiskCacheTestWithCache()
       implementation_(false),
       force_creation_(false),
       new_eviction_(false),
+      frequency_eviction_(false),
       first_cleanup_(true),
       integrity_(true),
       use_current_thread_(false),
@@ -63,7 +64,7 @@ DiskCacheTestWithCache::DiskCacheTestWithCache()
 DiskCacheTestWithCache::~DiskCacheTestWithCache() {}
 
 void DiskCacheTestWithCache::InitCache() {
-  if (mask_ || new_eviction_)
+  if (mask_ || new_eviction_ || frequency_eviction_)
     implementation_ = true;
 
   if (memory_only_)
@@ -213,6 +214,16 @@ void DiskCacheTestWithCache::TrimDeletedListForTest(bool empty) {
                             empty));
 }
 
+void DiskCacheTestWithCache::GrowIndexForTest() {
+  RunTaskForTest(base::Bind(&disk_cache::BackendImpl::GrowIndexForTest,
+                            base::Unretained(cache_impl_)));
+}
+
+void DiskCacheTestWithCache::StartGrowIndexForTest(int num_buckets) {
+  RunTaskForTest(base::Bind(&disk_cache::BackendImpl::StartGrowIndexForTest,
+                            base::Unretained(cache_impl_), num_buckets));
+}
+
 void DiskCacheTestWithCache::TearDown() {
   MessageLoop::current()->RunAllPending();
   delete cache_;
@@ -286,6 +297,8 @@ void DiskCacheTestWithCache::InitDiskCacheImpl() {
 
   cache_impl_->SetType(type_);
   cache_impl_->SetFlags(disk_cache::kNoRandom);
+  if (frequency_eviction_)
+    cache_impl_->SetFlags(disk_cache::kFrequencyEviction);
   net::TestCompletionCallback cb;
   int rv = cache_impl_->Init(cb.callback());
   ASSERT_EQ(net::OK, cb.GetResult(rv));
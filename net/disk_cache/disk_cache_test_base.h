@@ -86,6 +86,10 @@ class DiskCacheTestWithCache : public DiskCacheTest {
     new_eviction_ = true;
   }
 
+  void SetFrequencyEviction() {
+    frequency_eviction_ = true;
+  }
+
   void DisableFirstCleanup() {
     first_cleanup_ = false;
   }
@@ -130,6 +134,13 @@ class DiskCacheTestWithCache : public DiskCacheTest {
   // true, the whole list is deleted.
   void TrimDeletedListForTest(bool empty);
 
+  // Asks the cache to double the size of its index table.
+  void GrowIndexForTest();
+
+  // Asks the cache to start doubling the size of its index table, splitting
+  // only |num_buckets| buckets right away.
+  void StartGrowIndexForTest(int num_buckets);
+
   // DiskCacheTest:
   virtual void TearDown() OVERRIDE;
 
@@ -146,6 +157,7 @@ class DiskCacheTestWithCache : public DiskCacheTest {
   bool implementation_;
   bool force_creation_;
   bool new_eviction_;
+  bool frequency_eviction_;
   bool first_cleanup_;
   bool integrity_;
   bool use_current_thread_;
@@ -94,7 +94,9 @@ struct NET_EXPORT_PRIVATE IndexHeader {
   int32       crash;         // Signals a previous crash.
   int32       experiment;    // Id of an ongoing test.
   uint64      create_time;   // Creation time for this set of files.
-  int32       pad[52];
+  int32       split_len;     // Table length before an ongoing growth, or 0.
+  int32       split_bucket;  // Next bucket to split while the table grows.
+  int32       pad[50];
   LruData     lru;           // Eviction control data.
 };
 
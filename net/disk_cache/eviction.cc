@@ -26,6 +26,13 @@
 // size so that we have a chance to see an element again and move it to another
 // list.
 
+// With kFrequencyEviction, either policy also counts how often each key is
+// used, with a FrequencySketch that remembers keys after their entries are
+// gone. When trimming, an entry that was used a few times recently and is
+// small for the number of uses gets another trip through its list instead of
+// being evicted, so that large entries that are used once don't push out the
+// small ones that are used all the time.
+
 #include "net/disk_cache/eviction.h"
 
 #include "base/bind.h"
@@ -49,6 +56,9 @@ const int kCleanUpMargin = 1024 * 1024;
 const int kHighUse = 10;  // Reuse count to be on the HIGH_USE list.
 const int kTargetTime = 24 * 7;  // Time to be evicted (hours since last use).
 const int kMaxDelayedTrims = 60;
+const int kMinUsesToSpare = 2;  // Recent uses to be kept by frequency.
+const int kSizePerUse = 128 * 1024;  // Largest size kept per recent use.
+const int kMaxSparedEntries = 20;  // Per trim.
 
 int LowWaterAdjust(int high_water) {
   if (high_water < kCleanUpMargin)
@@ -87,6 +97,11 @@ void Eviction::Init(BackendImpl* backend) {
   trim_delays_ = 0;
   init_ = true;
   test_mode_ = false;
+  spared_entries_ = 0;
+  if (backend->user_flags_ & kFrequencyEviction)
+    sketch_.reset(new FrequencySketch(index_size_));
+  else
+    sketch_.reset();
 }
 
 void Eviction::Stop() {
@@ -102,6 +117,13 @@ void Eviction::Stop() {
   ptr_factory_.InvalidateWeakPtrs();
 }
 
+void Eviction::OnIndexResized() {
+  header_ = &backend_->data_->header;
+  index_size_ = backend_->mask_ + 1;
+  if (sketch_.get())
+    sketch_->Resize(index_size_);
+}
+
 void Eviction::TrimCache(bool empty) {
   if (backend_->disabled_ || trimming_)
     return;
@@ -114,6 +136,7 @@ void Eviction::TrimCache(bool empty) {
 
   Trace("*** Trim Cache ***");
   trimming_ = true;
+  spared_entries_ = 0;
   TimeTicks start = TimeTicks::Now();
   Rankings::ScopedRankingsBlock node(rankings_);
   Rankings::ScopedRankingsBlock next(
@@ -130,10 +153,12 @@ void Eviction::TrimCache(bool empty) {
       // This entry is not being used by anybody.
       // Do NOT use node as an iterator after this point.
       rankings_->TrackRankingsBlock(node.get(), false);
-      if (EvictEntry(node.get(), empty, Rankings::NO_USE) && !test_mode_)
+      bool spared = false;
+      if (EvictEntry(node.get(), empty, Rankings::NO_USE, &spared) &&
+          !test_mode_)
         deleted_entries++;
 
-      if (!empty && test_mode_)
+      if (!empty && test_mode_ && !spared)
         break;
     }
     if (!empty && (deleted_entries > 20 ||
@@ -150,6 +175,8 @@ void Eviction::TrimCache(bool empty) {
     CACHE_UMA(AGE_MS, "TotalTrimTimeV1", 0, start);
   }
   CACHE_UMA(COUNTS, "TrimItemsV1", 0, deleted_entries);
+  if (sketch_.get())
+    CACHE_UMA(COUNTS, "TrimSparedItems", 0, spared_entries_);
 
   trimming_ = false;
   Trace("*** Trim Cache end ***");
@@ -164,11 +191,17 @@ void Eviction::UpdateRank(EntryImpl* entry, bool modified) {
 }
 
 void Eviction::OnOpenEntry(EntryImpl* entry) {
+  if (sketch_.get())
+    sketch_->Add(entry->GetHash());
+
   if (new_eviction_)
     return OnOpenEntryV2(entry);
 }
 
 void Eviction::OnCreateEntry(EntryImpl* entry) {
+  if (sketch_.get())
+    sketch_->Add(entry->GetHash());
+
   if (new_eviction_)
     return OnCreateEntryV2(entry);
 
@@ -271,13 +304,19 @@ Rankings::List Eviction::GetListForEntry(EntryImpl* entry) {
 }
 
 bool Eviction::EvictEntry(CacheRankingsBlock* node, bool empty,
-                          Rankings::List list) {
+                          Rankings::List list, bool* spared) {
   EntryImpl* entry = backend_->GetEnumeratedEntry(node, list);
   if (!entry) {
     Trace("NewEntry failed on Trim 0x%x", node->address().value());
     return false;
   }
 
+  if (!empty && SpareEntry(entry, list)) {
+    *spared = true;
+    entry->Release();
+    return false;
+  }
+
   ReportTrimTimes(entry);
   if (empty || !new_eviction_) {
     entry->DoomImpl();
@@ -299,11 +338,33 @@ bool Eviction::EvictEntry(CacheRankingsBlock* node, bool empty,
   return true;
 }
 
+bool Eviction::SpareEntry(EntryImpl* entry, Rankings::List list) {
+  if (!sketch_.get() || spared_entries_ >= kMaxSparedEntries)
+    return false;
+
+  int uses = sketch_->Estimate(entry->GetHash());
+  if (uses < kMinUsesToSpare)
+    return false;
+
+  EntryStore* info = entry->entry()->Data();
+  int64 size = 0;
+  for (size_t i = 0; i < arraysize(info->data_size); i++)
+    size += info->data_size[i];
+  if (size > static_cast<int64>(uses) * kSizePerUse)
+    return false;
+
+  Trace("Spare entry 0x%x", entry->entry()->address().value());
+  rankings_->UpdateRank(entry->rankings(), false, list);
+  spared_entries_++;
+  return true;
+}
+
 // -----------------------------------------------------------------------
 
 void Eviction::TrimCacheV2(bool empty) {
   Trace("*** Trim Cache ***");
   trimming_ = true;
+  spared_entries_ = 0;
   TimeTicks start = TimeTicks::Now();
 
   const int kListsToSearch = 3;
@@ -347,10 +408,13 @@ void Eviction::TrimCacheV2(bool empty) {
         // This entry is not being used by anybody.
         // Do NOT use node as an iterator after this point.
         rankings_->TrackRankingsBlock(node.get(), false);
-        if (EvictEntry(node.get(), empty, static_cast<Rankings::List>(list)))
+        bool spared = false;
+        if (EvictEntry(node.get(), empty, static_cast<Rankings::List>(list),
+                       &spared)) {
           deleted_entries++;
+        }
 
-        if (!empty && test_mode_)
+        if (!empty && test_mode_ && !spared)
           break;
       }
       if (!empty && (deleted_entries > 20 ||
@@ -377,6 +441,8 @@ void Eviction::TrimCacheV2(bool empty) {
     CACHE_UMA(AGE_MS, "TotalTrimTimeV2", 0, start);
   }
   CACHE_UMA(COUNTS, "TrimItemsV2", 0, deleted_entries);
+  if (sketch_.get())
+    CACHE_UMA(COUNTS, "TrimSparedItems", 0, spared_entries_);
 
   Trace("*** Trim Cache end ***");
   trimming_ = false;
@@ -7,8 +7,10 @@
 #pragma once
 
 #include "base/basictypes.h"
+#include "base/memory/scoped_ptr.h"
 #include "base/memory/weak_ptr.h"
 #include "net/disk_cache/disk_format.h"
+#include "net/disk_cache/frequency_sketch.h"
 #include "net/disk_cache/rankings.h"
 
 namespace disk_cache {
@@ -26,6 +28,9 @@ class Eviction {
   void Init(BackendImpl* backend);
   void Stop();
 
+  // Picks up the index header again after the backend resized its index.
+  void OnIndexResized();
+
   // Deletes entries from the cache until the current size is below the limit.
   // If empty is true, the whole cache will be trimmed, regardless of being in
   // use.
@@ -51,7 +56,12 @@ class Eviction {
   bool ShouldTrimDeleted();
   void ReportTrimTimes(EntryImpl* entry);
   Rankings::List GetListForEntry(EntryImpl* entry);
-  bool EvictEntry(CacheRankingsBlock* node, bool empty, Rankings::List list);
+  bool EvictEntry(CacheRankingsBlock* node, bool empty, Rankings::List list,
+                  bool* spared);
+
+  // Frequency aware eviction: returns true if |entry| should stay in the cache
+  // for now, in which case it is moved to the head of |list|.
+  bool SpareEntry(EntryImpl* entry, Rankings::List list);
 
   // We'll just keep for a while a separate set of methods that implement the
   // new eviction algorithm. This code will replace the original methods when
@@ -82,6 +92,8 @@ class Eviction {
   bool delay_trim_;
   bool init_;
   bool test_mode_;
+  scoped_ptr<FrequencySketch> sketch_;  // Recent uses, by key hash.
+  int spared_entries_;  // Entries kept by SpareEntry() on the current trim.
   base::WeakPtrFactory<Eviction> ptr_factory_;
 
   DISALLOW_COPY_AND_ASSIGN(Eviction);
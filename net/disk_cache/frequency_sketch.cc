@@ -0,0 +1,110 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/frequency_sketch.h"
+
+#include <algorithm>
+
+#include "base/logging.h"
+
+namespace {
+
+const int kCountersPerHash = 4;
+const int kNumProbes = 4;
+const int kCountersPerWord = 16;
+const int kSamplesPerHash = 10;
+
+int NumCounters(int capacity) {
+  int num_counters = kCountersPerWord;
+  while (num_counters < capacity * kCountersPerHash &&
+         num_counters < (1 << 30)) {
+    num_counters <<= 1;
+  }
+  return num_counters;
+}
+
+}  // namespace
+
+namespace disk_cache {
+
+// static
+const int FrequencySketch::kMaxCount;
+
+FrequencySketch::FrequencySketch(int capacity)
+    : table_(NumCounters(capacity) / kCountersPerWord),
+      mask_(NumCounters(capacity) - 1),
+      num_samples_(0),
+      max_samples_(std::max(capacity, 1) * kSamplesPerHash) {
+  DCHECK_GT(capacity, 0);
+}
+
+FrequencySketch::~FrequencySketch() {
+}
+
+void FrequencySketch::Add(uint32 hash) {
+  // Only the lowest counters go up (conservative update), which keeps hashes
+  // that share counters with a popular one from looking popular.
+  int min_value = Estimate(hash);
+  if (min_value < kMaxCount) {
+    for (int i = 0; i < kNumProbes; i++) {
+      uint32 counter = GetCounter(hash, i);
+      if (GetValue(counter) == min_value)
+        Increment(counter);
+    }
+  }
+
+  if (++num_samples_ >= max_samples_)
+    Age();
+}
+
+int FrequencySketch::Estimate(uint32 hash) const {
+  int value = kMaxCount;
+  for (int i = 0; i < kNumProbes; i++)
+    value = std::min(value, GetValue(GetCounter(hash, i)));
+  return value;
+}
+
+void FrequencySketch::Resize(int capacity) {
+  DCHECK_GT(capacity, 0);
+  max_samples_ = std::max(max_samples_, capacity * kSamplesPerHash);
+  size_t old_size = table_.size();
+  size_t new_size = NumCounters(capacity) / kCountersPerWord;
+  if (new_size <= old_size)
+    return;
+
+  // A counter keeps the low bits of its index when the table doubles, so
+  // every copy of the old table holds the right counts for its part of the
+  // new one. The copies also repeat the collisions of the small table, which
+  // would make new hashes look used, so the counts are aged right away.
+  table_.resize(new_size);
+  for (size_t i = old_size; i < new_size; i++)
+    table_[i] = table_[i % old_size];
+  mask_ = new_size * kCountersPerWord - 1;
+  Age();
+}
+
+uint32 FrequencySketch::GetCounter(uint32 hash, int probe) const {
+  // Same as BloomFilter: the low bits of the hash pick the bucket of the
+  // index, so the probes step by the high bits instead.
+  uint32 step = ((hash >> 16) | (hash << 16)) | 1;
+  return (hash + probe * step) & mask_;
+}
+
+int FrequencySketch::GetValue(uint32 counter) const {
+  int shift = (counter % kCountersPerWord) * 4;
+  return static_cast<int>((table_[counter / kCountersPerWord] >> shift) & 0xf);
+}
+
+void FrequencySketch::Increment(uint32 counter) {
+  int shift = (counter % kCountersPerWord) * 4;
+  table_[counter / kCountersPerWord] += GG_UINT64_C(1) << shift;
+}
+
+void FrequencySketch::Age() {
+  for (size_t i = 0; i < table_.size(); i++)
+    table_[i] = (table_[i] >> 1) & GG_UINT64_C(0x7777777777777777);
+  num_samples_ /= 2;
+}
+
+}  // namespace disk_cache
@@ -0,0 +1,61 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_DISK_CACHE_FREQUENCY_SKETCH_H_
+#define NET_DISK_CACHE_FREQUENCY_SKETCH_H_
+#pragma once
+
+#include <vector>
+
+#include "base/basictypes.h"
+#include "net/base/net_export.h"
+
+namespace disk_cache {
+
+// This class estimates how many times each key hash was seen recently, using a
+// small, fixed amount of memory (a count-min sketch of 4-bit counters). The
+// estimate for a hash is never lower than the real count (up to kMaxCount),
+// but it may be higher when other hashes share its counters. Every time the
+// number of recorded hashes reaches ten times the capacity of the sketch, all
+// the counts are halved, so old uses fade away.
+class NET_EXPORT_PRIVATE FrequencySketch {
+ public:
+  static const int kMaxCount = 15;
+
+  // The sketch is sized to track about |capacity| distinct hashes.
+  explicit FrequencySketch(int capacity);
+  ~FrequencySketch();
+
+  // Records one use of |hash|.
+  void Add(uint32 hash);
+
+  // Returns the number of recorded uses of |hash|.
+  int Estimate(uint32 hash) const;
+
+  // Sizes the sketch to track about |capacity| distinct hashes from now on.
+  // The counts recorded so far are kept, but halved as if they had aged. The
+  // sketch never shrinks.
+  void Resize(int capacity);
+
+ private:
+  // Returns the index of the |probe|th counter that stands for |hash|.
+  uint32 GetCounter(uint32 hash, int probe) const;
+
+  int GetValue(uint32 counter) const;
+  void Increment(uint32 counter);
+
+  // Halves all the counters.
+  void Age();
+
+  std::vector<uint64> table_;  // 16 counters per word.
+  uint32 mask_;  // One less than the number of counters.
+  int num_samples_;
+  int max_samples_;
+
+  DISALLOW_COPY_AND_ASSIGN(FrequencySketch);
+};
+
+}  // namespace disk_cache
+
+#endif  // NET_DISK_CACHE_FREQUENCY_SKETCH_H_
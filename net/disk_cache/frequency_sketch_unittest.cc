@@ -0,0 +1,102 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/frequency_sketch.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace {
+
+// Returns well distributed, distinct hashes for different values of |i|. Key
+// hashes of similar keys collide too often to tell the sketch errors apart.
+uint32 TestHash(uint32 seed, int i) {
+  uint32 hash = (seed + static_cast<uint32>(i)) * 0x9E3779B1;
+  return hash ^ (hash >> 15);
+}
+
+}  // namespace
+
+TEST(FrequencySketchTest, Basics) {
+  disk_cache::FrequencySketch sketch(100);
+  EXPECT_EQ(0, sketch.Estimate(0x12345678));
+
+  sketch.Add(0x12345678);
+  sketch.Add(0x12345678);
+  EXPECT_EQ(2, sketch.Estimate(0x12345678));
+  EXPECT_EQ(0, sketch.Estimate(0x87654321));
+}
+
+TEST(FrequencySketchTest, MaxCount) {
+  disk_cache::FrequencySketch sketch(100);
+  for (int i = 0; i < 3 * disk_cache::FrequencySketch::kMaxCount; i++)
+    sketch.Add(0x12345678);
+  EXPECT_EQ(disk_cache::FrequencySketch::kMaxCount,
+            sketch.Estimate(0x12345678));
+}
+
+TEST(FrequencySketchTest, Accuracy) {
+  const int kCapacity = 10000;
+  disk_cache::FrequencySketch sketch(kCapacity);
+
+  // One in ten hashes is used five times; the rest are used once.
+  for (int i = 0; i < kCapacity; i++) {
+    int uses = (i % 10) ? 1 : 5;
+    for (int j = 0; j < uses; j++)
+      sketch.Add(TestHash(0, i));
+  }
+
+  int overestimates = 0;
+  for (int i = 0; i < kCapacity; i++) {
+    int uses = (i % 10) ? 1 : 5;
+    int estimate = sketch.Estimate(TestHash(0, i));
+    EXPECT_LE(uses, estimate);
+    if (estimate > uses)
+      overestimates++;
+  }
+  EXPECT_LT(overestimates, kCapacity / 50);
+
+  // Hashes that were never added rarely look used more than once.
+  int reused = 0;
+  for (int i = 0; i < kCapacity; i++)
+    reused += (sketch.Estimate(TestHash(kCapacity, i)) > 1);
+  EXPECT_LT(reused, kCapacity / 100);
+}
+
+TEST(FrequencySketchTest, Aging) {
+  const int kCapacity = 100;
+  disk_cache::FrequencySketch sketch(kCapacity);
+  for (int i = 0; i < 8; i++)
+    sketch.Add(0x12345678);
+  EXPECT_EQ(8, sketch.Estimate(0x12345678));
+
+  // Filling up the sample halves the old counts.
+  for (int i = 0; i < kCapacity * 10 - 8; i++)
+    sketch.Add(TestHash(1000, i));
+  EXPECT_EQ(4, sketch.Estimate(0x12345678));
+}
+
+TEST(FrequencySketchTest, Resize) {
+  const int kCapacity = 1000;
+  disk_cache::FrequencySketch sketch(kCapacity);
+  for (int i = 0; i < kCapacity; i++) {
+    for (int j = 0; j <= i % 4; j++)
+      sketch.Add(TestHash(0, i));
+  }
+
+  // The counts survive growing the sketch, aged once.
+  sketch.Resize(kCapacity * 4);
+  for (int i = 0; i < kCapacity; i++)
+    EXPECT_LE((i % 4 + 1) / 2, sketch.Estimate(TestHash(0, i)));
+
+  // New hashes share counters with the old ones only as much as they did in
+  // the small sketch, and the aging keeps that from adding up to much.
+  for (int i = kCapacity; i < kCapacity * 4; i++)
+    sketch.Add(TestHash(0, i));
+  int overestimates = 0;
+  for (int i = kCapacity; i < kCapacity * 4; i++) {
+    int estimate = sketch.Estimate(TestHash(0, i));
+    EXPECT_LE(1, estimate);
+    overestimates += (estimate > 2);
+  }
+  EXPECT_LT(overestimates, kCapacity * 3 / 100);
+}
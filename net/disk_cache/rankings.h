@@ -109,6 +109,9 @@ class Rankings {
   // Restores original state, leaving the object ready for initialization.
   void Reset();
 
+  // Picks up the control data again after the backend resized its index.
+  void OnIndexResized();
+
   // Inserts a given entry at the head of the queue.
   void Insert(CacheRankingsBlock* node, bool modified, List list);
 
@@ -0,0 +1,299 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/disk_cache/sharded_backend.h"
+
+#include "base/bind.h"
+#include "base/logging.h"
+#include "base/memory/ref_counted.h"
+#include "base/stl_util.h"
+#include "base/stringprintf.h"
+#include "base/threading/thread.h"
+#include "net/base/net_errors.h"
+#include "net/disk_cache/backend_impl.h"
+#include "net/disk_cache/hash.h"
+
+namespace disk_cache {
+
+// Runs a callback once a set of operations, one per shard, completes, with the
+// first error returned by any of them. One more completion is expected from
+// whoever starts the operations, with Finish(), so that nothing is reported
+// before all of them are started.
+class ShardedBackend::Barrier : public base::RefCounted<Barrier> {
+ public:
+  Barrier(int num_operations, const CompletionCallback& callback)
+      : pending_(num_operations + 1),
+        result_(net::OK),
+        callback_(callback) {
+  }
+
+  // Returns a callback to give to one of the operations.
+  CompletionCallback NewCallback() {
+    return base::Bind(&Barrier::OnComplete, this);
+  }
+
+  // Records the result of an operation that completed synchronously.
+  void AddResult(int result) {
+    DCHECK_NE(net::ERR_IO_PENDING, result);
+    if (result_ == net::OK)
+      result_ = result;
+    pending_--;
+    DCHECK_GT(pending_, 0);
+  }
+
+  // Returns the final result if all the operations are done, or
+  // ERR_IO_PENDING if the callback will be invoked later.
+  int Finish() {
+    if (--pending_)
+      return net::ERR_IO_PENDING;
+    callback_.Reset();
+    return result_;
+  }
+
+ private:
+  friend class base::RefCounted<Barrier>;
+  ~Barrier() {}
+
+  void OnComplete(int result) {
+    if (result_ == net::OK)
+      result_ = result;
+    if (!--pending_)
+      callback_.Run(result_);
+  }
+
+  int pending_;
+  int result_;
+  CompletionCallback callback_;
+
+  DISALLOW_COPY_AND_ASSIGN(Barrier);
+};
+
+// The iterator handed out by OpenNextEntry().
+struct ShardedBackend::Iterator {
+  Iterator() : shard(0), shard_iter(NULL) {}
+
+  int shard;
+  void* shard_iter;  // The enumeration of the current shard.
+};
+
+ShardedBackend::~ShardedBackend() {
+  // The shards wait for their cache threads to clean up, so they go away
+  // before the threads.
+  STLDeleteElements(&shards_);
+}
+
+// static
+int ShardedBackend::CreateBackend(const FilePath& path, int num_shards,
+                                  bool force, int max_bytes,
+                                  net::CacheType type, uint32 flags,
+                                  net::NetLog* net_log, Backend** backend,
+                                  const CompletionCallback& callback) {
+  DCHECK_GT(num_shards, 0);
+  DCHECK(!callback.is_null());
+  ShardedBackend* cache = new ShardedBackend(path, num_shards);
+  if (!cache->StartThreads()) {
+    delete cache;
+    return net::ERR_FAILED;
+  }
+
+  scoped_refptr<Barrier> barrier(new Barrier(
+      num_shards,
+      base::Bind(&ShardedBackend::OnCreationComplete, cache, backend,
+                 callback)));
+  for (int i = 0; i < num_shards; i++) {
+    int rv = BackendImpl::CreateBackend(
+        cache->paths_[i], force, max_bytes / num_shards, type, flags,
+        cache->threads_[i]->message_loop_proxy(), net_log,
+        &cache->shards_[i], barrier->NewCallback());
+    if (rv != net::ERR_IO_PENDING)
+      barrier->AddResult(rv);
+  }
+
+  int rv = barrier->Finish();
+  if (rv == net::ERR_IO_PENDING)
+    return rv;
+  return FinishCreation(cache, backend, rv);
+}
+
+int ShardedBackend::ShardForKey(const std::string& key) const {
+  // Each shard uses the low bits of the hash for its own index, so take the
+  // high bits here.
+  uint64 hash = Hash(key);
+  return static_cast<int>((hash * shards_.size()) >> 32);
+}
+
+int32 ShardedBackend::GetEntryCount() const {
+  int32 count = 0;
+  for (size_t i = 0; i < shards_.size(); i++)
+    count += shards_[i]->GetEntryCount();
+  return count;
+}
+
+int ShardedBackend::OpenEntry(const std::string& key, Entry** entry,
+                              const CompletionCallback& callback) {
+  return shard_for_key(key)->OpenEntry(key, entry, callback);
+}
+
+int ShardedBackend::CreateEntry(const std::string& key, Entry** entry,
+                                const CompletionCallback& callback) {
+  return shard_for_key(key)->CreateEntry(key, entry, callback);
+}
+
+int ShardedBackend::DoomEntry(const std::string& key,
+                              const CompletionCallback& callback) {
+  return shard_for_key(key)->DoomEntry(key, callback);
+}
+
+int ShardedBackend::DoomAllEntries(const CompletionCallback& callback) {
+  scoped_refptr<Barrier> barrier(new Barrier(num_shards(), callback));
+  for (size_t i = 0; i < shards_.size(); i++) {
+    int rv = shards_[i]->DoomAllEntries(barrier->NewCallback());
+    if (rv != net::ERR_IO_PENDING)
+      barrier->AddResult(rv);
+  }
+  return barrier->Finish();
+}
+
+int ShardedBackend::DoomEntriesBetween(const base::Time initial_time,
+                                       const base::Time end_time,
+                                       const CompletionCallback& callback) {
+  scoped_refptr<Barrier> barrier(new Barrier(num_shards(), callback));
+  for (size_t i = 0; i < shards_.size(); i++) {
+    int rv = shards_[i]->DoomEntriesBetween(initial_time, end_time,
+                                            barrier->NewCallback());
+    if (rv != net::ERR_IO_PENDING)
+      barrier->AddResult(rv);
+  }
+  return barrier->Finish();
+}
+
+int ShardedBackend::DoomEntriesSince(const base::Time initial_time,
+                                     const CompletionCallback& callback) {
+  scoped_refptr<Barrier> barrier(new Barrier(num_shards(), callback));
+  for (size_t i = 0; i < shards_.size(); i++) {
+    int rv = shards_[i]->DoomEntriesSince(initial_time,
+                                          barrier->NewCallback());
+    if (rv != net::ERR_IO_PENDING)
+      barrier->AddResult(rv);
+  }
+  return barrier->Finish();
+}
+
+// The shards are enumerated one after the other.
+int ShardedBackend::OpenNextEntry(void** iter, Entry** next_entry,
+                                  const CompletionCallback& callback) {
+  DCHECK(iter);
+  if (!*iter)
+    *iter = new Iterator;
+  return OpenNextEntryFromShard(iter, next_entry, callback);
+}
+
+void ShardedBackend::EndEnumeration(void** iter) {
+  Iterator* iterator = reinterpret_cast<Iterator*>(*iter);
+  if (!iterator)
+    return;
+  if (iterator->shard < num_shards() && iterator->shard_iter)
+    shards_[iterator->shard]->EndEnumeration(&iterator->shard_iter);
+  delete iterator;
+  *iter = NULL;
+}
+
+void ShardedBackend::GetStats(
+    std::vector<std::pair<std::string, std::string> >* stats) {
+  for (size_t i = 0; i < shards_.size(); i++) {
+    std::vector<std::pair<std::string, std::string> > shard_stats;
+    shards_[i]->GetStats(&shard_stats);
+    for (size_t j = 0; j < shard_stats.size(); j++) {
+      stats->push_back(std::make_pair(
+          base::StringPrintf("Shard %d: %s", static_cast<int>(i),
+                             shard_stats[j].first.c_str()),
+          shard_stats[j].second));
+    }
+  }
+}
+
+void ShardedBackend::OnExternalCacheHit(const std::string& key) {
+  shard_for_key(key)->OnExternalCacheHit(key);
+}
+
+ShardedBackend::ShardedBackend(const FilePath& path, int num_shards)
+    : shards_(num_shards) {
+  for (int i = 0; i < num_shards; i++)
+    paths_.push_back(path.AppendASCII(base::StringPrintf("shard_%d", i)));
+}
+
+bool ShardedBackend::StartThreads() {
+  for (size_t i = 0; i < shards_.size(); i++) {
+    base::Thread* thread = new base::Thread(
+        base::StringPrintf("CacheThread_%d", static_cast<int>(i)).c_str());
+    threads_.push_back(thread);
+    if (!thread->StartWithOptions(
+            base::Thread::Options(MessageLoop::TYPE_IO, 0))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// static
+int ShardedBackend::FinishCreation(ShardedBackend* cache, Backend** backend,
+                                   int result) {
+  DCHECK_NE(net::ERR_IO_PENDING, result);
+  if (result == net::OK) {
+    *backend = cache;
+  } else {
+    LOG(ERROR) << "Unable to create a sharded cache";
+    *backend = NULL;
+    delete cache;
+  }
+  return result;
+}
+
+// static
+void ShardedBackend::OnCreationComplete(ShardedBackend* cache,
+                                        Backend** backend,
+                                        const CompletionCallback& callback,
+                                        int result) {
+  callback.Run(FinishCreation(cache, backend, result));
+}
+
+int ShardedBackend::OpenNextEntryFromShard(void** iter, Entry** next_entry,
+                                           const CompletionCallback& callback) {
+  Iterator* iterator = reinterpret_cast<Iterator*>(*iter);
+  while (iterator->shard < num_shards()) {
+    // The shards cancel their callbacks when they go away, so |this| outlives
+    // the callback.
+    int rv = shards_[iterator->shard]->OpenNextEntry(
+        &iterator->shard_iter, next_entry,
+        base::Bind(&ShardedBackend::OnOpenNextEntryComplete,
+                   base::Unretained(this), iter, next_entry, callback));
+    if (rv != net::ERR_FAILED)
+      return rv;
+
+    // This shard is done, and it has already released its iterator.
+    iterator->shard++;
+    iterator->shard_iter = NULL;
+  }
+
+  // Like the shards, release the iterator at the end of the enumeration.
+  delete iterator;
+  *iter = NULL;
+  return net::ERR_FAILED;
+}
+
+void ShardedBackend::OnOpenNextEntryComplete(
+    void** iter, Entry** next_entry, const CompletionCallback& callback,
+    int result) {
+  if (result == net::ERR_FAILED) {
+    Iterator* iterator = reinterpret_cast<Iterator*>(*iter);
+    iterator->shard++;
+    iterator->shard_iter = NULL;
+    result = OpenNextEntryFromShard(iter, next_entry, callback);
+    if (result == net::ERR_IO_PENDING)
+      return;
+  }
+  callback.Run(result);
+}
+
+}  // namespace disk_cache
@@ -0,0 +1,117 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// See net/disk_cache/disk_cache.h for the public interface of the cache.
+
+#ifndef NET_DISK_CACHE_SHARDED_BACKEND_H_
+#define NET_DISK_CACHE_SHARDED_BACKEND_H_
+#pragma once
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "base/compiler_specific.h"
+#include "base/file_path.h"
+#include "base/memory/scoped_vector.h"
+#include "net/base/cache_type.h"
+#include "net/disk_cache/disk_cache.h"
+
+namespace base {
+class Thread;
+}  // namespace base
+
+namespace net {
+class NetLog;
+}  // namespace net
+
+namespace disk_cache {
+
+// This class implements the Backend interface on top of a set of BackendImpl
+// shards. Every key belongs to a single shard, picked from its hash, and each
+// shard keeps its files on a sub-folder of the cache folder and runs on its
+// own cache thread, so operations on different shards don't wait for each
+// other.
+class NET_EXPORT_PRIVATE ShardedBackend : public Backend {
+ public:
+  virtual ~ShardedBackend();
+
+  // Returns a new backend with |num_shards| shards, stored at |path|. The
+  // shards split |max_bytes| evenly; if it is zero, each shard picks its own
+  // size. See BackendImpl::CreateBackend() for the rest of the arguments. The
+  // cache threads are owned by the backend.
+  static int CreateBackend(const FilePath& path, int num_shards, bool force,
+                           int max_bytes, net::CacheType type, uint32 flags,
+                           net::NetLog* net_log, Backend** backend,
+                           const CompletionCallback& callback);
+
+  int num_shards() const {
+    return static_cast<int>(shards_.size());
+  }
+
+  // Returns the index of the shard that stores |key|.
+  int ShardForKey(const std::string& key) const;
+
+  // Backend implementation.
+  virtual int32 GetEntryCount() const OVERRIDE;
+  virtual int OpenEntry(const std::string& key, Entry** entry,
+                        const CompletionCallback& callback) OVERRIDE;
+  virtual int CreateEntry(const std::string& key, Entry** entry,
+                          const CompletionCallback& callback) OVERRIDE;
+  virtual int DoomEntry(const std::string& key,
+                        const CompletionCallback& callback) OVERRIDE;
+  virtual int DoomAllEntries(const CompletionCallback& callback) OVERRIDE;
+  virtual int DoomEntriesBetween(const base::Time initial_time,
+                                 const base::Time end_time,
+                                 const CompletionCallback& callback) OVERRIDE;
+  virtual int DoomEntriesSince(const base::Time initial_time,
+                               const CompletionCallback& callback) OVERRIDE;
+  virtual int OpenNextEntry(void** iter, Entry** next_entry,
+                            const CompletionCallback& callback) OVERRIDE;
+  virtual void EndEnumeration(void** iter) OVERRIDE;
+  virtual void GetStats(
+      std::vector<std::pair<std::string, std::string> >* stats) OVERRIDE;
+  virtual void OnExternalCacheHit(const std::string& key) OVERRIDE;
+
+ private:
+  class Barrier;
+  struct Iterator;
+
+  ShardedBackend(const FilePath& path, int num_shards);
+
+  // Starts the cache threads. Returns false on failure.
+  bool StartThreads();
+
+  // Hands the backend to the caller of CreateBackend() once every shard is
+  // initialized, or deletes it.
+  static int FinishCreation(ShardedBackend* cache, Backend** backend,
+                            int result);
+  static void OnCreationComplete(ShardedBackend* cache, Backend** backend,
+                                 const CompletionCallback& callback,
+                                 int result);
+
+  // Continues the enumeration |iter| with its current shard, moving on to
+  // the next shard whenever one runs out of entries.
+  int OpenNextEntryFromShard(void** iter, Entry** next_entry,
+                             const CompletionCallback& callback);
+  void OnOpenNextEntryComplete(void** iter, Entry** next_entry,
+                               const CompletionCallback& callback,
+                               int result);
+
+  Backend* shard_for_key(const std::string& key) const {
+    return shards_[ShardForKey(key)];
+  }
+
+  // The shards' folders. The CacheCreator of each shard keeps a reference to
+  // its path, so they must not move.
+  std::vector<FilePath> paths_;
+  ScopedVector<base::Thread> threads_;
+  std::vector<Backend*> shards_;
+
+  DISALLOW_COPY_AND_ASSIGN(ShardedBackend);
+};
+
+}  // namespace disk_cache
+
+#endif  // NET_DISK_CACHE_SHARDED_BACKEND_H_
@@ -100,6 +100,9 @@ class NET_EXPORT_PRIVATE DnsResponse {
   // one byte more than largest possible response, to detect malformed
   // responses.
   DnsResponse();
+  // Constructs an object with an IOBuffer of |length| bytes, one more than the
+  // size of a response received over TCP, which announces its length.
+  explicit DnsResponse(size_t length);
   // Constructs response from |data|. Used for testing purposes only!
   DnsResponse(const void* data, size_t length, size_t answer_offset);
   ~DnsResponse();
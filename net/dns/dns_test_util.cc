@@ -9,6 +9,7 @@
 #include "base/bind.h"
 #include "base/memory/weak_ptr.h"
 #include "base/message_loop.h"
+#include "base/string_util.h"
 #include "base/sys_byteorder.h"
 #include "net/base/big_endian.h"
 #include "net/base/dns_util.h"
@@ -27,7 +28,7 @@ namespace {
 
 // A DnsTransaction which responds with loopback to all queries starting with
 // "ok", fails synchronously on all queries starting with "er", and NXDOMAIN to
-// all others.
+// all others. AAAA queries for names ending in ".noaaaa" never complete.
 class MockTransaction : public DnsTransaction,
                         public base::SupportsWeakPtr<MockTransaction> {
  public:
@@ -53,6 +54,10 @@ class MockTransaction : public DnsTransaction,
     started_ = true;
     if (hostname_.substr(0, 2) == "er")
       return ERR_NAME_NOT_RESOLVED;
+    if (qtype_ == dns_protocol::kTypeAAAA &&
+        EndsWith(hostname_, ".noaaaa", true)) {
+      return ERR_IO_PENDING;
+    }
     // Using WeakPtr to cleanly cancel when transaction is destroyed.
     MessageLoop::current()->PostTask(
         FROM_HERE,
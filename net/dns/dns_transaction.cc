@@ -20,6 +20,8 @@
 #include "base/threading/non_thread_safe.h"
 #include "base/timer.h"
 #include "base/values.h"
+#include "net/base/address_list.h"
+#include "net/base/big_endian.h"
 #include "net/base/completion_callback.h"
 #include "net/base/dns_util.h"
 #include "net/base/io_buffer.h"
@@ -31,6 +33,7 @@
 #include "net/dns/dns_response.h"
 #include "net/dns/dns_session.h"
 #include "net/socket/client_socket_factory.h"
+#include "net/socket/stream_socket.h"
 #include "net/udp/datagram_client_socket.h"
 
 namespace net {
@@ -95,10 +98,43 @@ class ResponseParameters : public NetLog::EventParameters {
 
 // ----------------------------------------------------------------------------
 
-// A single asynchronous DNS exchange over UDP, which consists of sending out a
-// DNS query, waiting for a response, and returning the response that it
+// Maps the rcode of a valid |response| to a net error.
+int RcodeToNetError(const DnsResponse& response) {
+  // TODO(szym): Extract TTL for NXDOMAIN results. http://crbug.com/115051
+  if (response.rcode() == dns_protocol::kRcodeNXDOMAIN)
+    return ERR_NAME_NOT_RESOLVED;
+  if (response.rcode() != dns_protocol::kRcodeNOERROR)
+    return ERR_DNS_SERVER_FAILED;
+  return OK;
+}
+
+// A single asynchronous DNS exchange with a server, which consists of sending
+// out a DNS query, waiting for a response, and returning the response that it
 // matches. Logging is done in the socket and in the outer DnsTransaction.
-class DnsUDPAttempt {
+class DnsAttempt {
+ public:
+  DnsAttempt() {}
+  virtual ~DnsAttempt() {}
+
+  // Starts the attempt. Returns ERR_IO_PENDING if cannot complete synchronously
+  // and calls |callback| upon completion.
+  virtual int Start() = 0;
+
+  virtual const DnsQuery* query() const = 0;
+
+  // Returns the response or NULL if has not received a matching response from
+  // the server.
+  virtual const DnsResponse* response() const = 0;
+
+  // Returns the net log bound to the source of the socket.
+  virtual const BoundNetLog& GetSocketNetLog() const = 0;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(DnsAttempt);
+};
+
+// A DnsAttempt over UDP.
+class DnsUDPAttempt : public DnsAttempt {
  public:
   DnsUDPAttempt(scoped_ptr<DatagramClientSocket> socket,
                 const IPEndPoint& server,
@@ -111,29 +147,26 @@ class DnsUDPAttempt {
         callback_(callback) {
   }
 
-  // Starts the attempt. Returns ERR_IO_PENDING if cannot complete synchronously
-  // and calls |callback| upon completion.
-  int Start() {
+  // DnsAttempt:
+  virtual int Start() OVERRIDE {
     DCHECK_EQ(STATE_NONE, next_state_);
     next_state_ = STATE_CONNECT;
     return DoLoop(OK);
   }
 
-  const DnsQuery* query() const {
+  virtual const DnsQuery* query() const OVERRIDE {
     return query_.get();
   }
 
-  const DatagramClientSocket* socket() const {
-    return socket_.get();
-  }
-
-  // Returns the response or NULL if has not received a matching response from
-  // the server.
-  const DnsResponse* response() const {
+  virtual const DnsResponse* response() const OVERRIDE {
     const DnsResponse* resp = response_.get();
     return (resp != NULL && resp->IsValid()) ? resp : NULL;
   }
 
+  virtual const BoundNetLog& GetSocketNetLog() const OVERRIDE {
+    return socket_->NetLog();
+  }
+
  private:
   enum State {
     STATE_CONNECT,
@@ -226,11 +259,9 @@ class DnsUDPAttempt {
     }
     if (response_->flags() & dns_protocol::kFlagTC)
       return ERR_DNS_SERVER_REQUIRES_TCP;
-    // TODO(szym): Extract TTL for NXDOMAIN results. http://crbug.com/115051
-    if (response_->rcode() == dns_protocol::kRcodeNXDOMAIN)
-      return ERR_NAME_NOT_RESOLVED;
-    if (response_->rcode() != dns_protocol::kRcodeNOERROR)
-      return ERR_DNS_SERVER_FAILED;
+    int result = RcodeToNetError(*response_);
+    if (result != OK)
+      return result;
 
     CHECK(response());
     return OK;
@@ -257,9 +288,231 @@ class DnsUDPAttempt {
 
 // ----------------------------------------------------------------------------
 
+// A DnsAttempt over TCP, used when the UDP response was truncated. Both the
+// query and the response are prefixed with their length in two bytes, as
+// described in RFC 1035 section 4.2.2.
+class DnsTCPAttempt : public DnsAttempt {
+ public:
+  DnsTCPAttempt(scoped_ptr<StreamSocket> socket,
+                scoped_ptr<DnsQuery> query,
+                const CompletionCallback& callback)
+      : next_state_(STATE_NONE),
+        socket_(socket.Pass()),
+        query_(query.Pass()),
+        length_buffer_(new IOBufferWithSize(sizeof(uint16))),
+        response_length_(0),
+        callback_(callback) {
+  }
+
+  // DnsAttempt:
+  virtual int Start() OVERRIDE {
+    DCHECK_EQ(STATE_NONE, next_state_);
+    next_state_ = STATE_CONNECT;
+    return DoLoop(OK);
+  }
+
+  virtual const DnsQuery* query() const OVERRIDE {
+    return query_.get();
+  }
+
+  virtual const DnsResponse* response() const OVERRIDE {
+    const DnsResponse* resp = response_.get();
+    return (resp != NULL && resp->IsValid()) ? resp : NULL;
+  }
+
+  virtual const BoundNetLog& GetSocketNetLog() const OVERRIDE {
+    return socket_->NetLog();
+  }
+
+ private:
+  enum State {
+    STATE_CONNECT,
+    STATE_CONNECT_COMPLETE,
+    STATE_SEND_QUERY,
+    STATE_SEND_QUERY_COMPLETE,
+    STATE_READ_LENGTH,
+    STATE_READ_LENGTH_COMPLETE,
+    STATE_READ_RESPONSE,
+    STATE_READ_RESPONSE_COMPLETE,
+    STATE_NONE,
+  };
+
+  int DoLoop(int result) {
+    CHECK_NE(STATE_NONE, next_state_);
+    int rv = result;
+    do {
+      State state = next_state_;
+      next_state_ = STATE_NONE;
+      switch (state) {
+        case STATE_CONNECT:
+          rv = DoConnect();
+          break;
+        case STATE_CONNECT_COMPLETE:
+          rv = DoConnectComplete(rv);
+          break;
+        case STATE_SEND_QUERY:
+          rv = DoSendQuery();
+          break;
+        case STATE_SEND_QUERY_COMPLETE:
+          rv = DoSendQueryComplete(rv);
+          break;
+        case STATE_READ_LENGTH:
+          rv = DoReadLength();
+          break;
+        case STATE_READ_LENGTH_COMPLETE:
+          rv = DoReadLengthComplete(rv);
+          break;
+        case STATE_READ_RESPONSE:
+          rv = DoReadResponse();
+          break;
+        case STATE_READ_RESPONSE_COMPLETE:
+          rv = DoReadResponseComplete(rv);
+          break;
+        default:
+          NOTREACHED();
+          break;
+      }
+    } while (rv != ERR_IO_PENDING && next_state_ != STATE_NONE);
+
+    return rv;
+  }
+
+  int DoConnect() {
+    next_state_ = STATE_CONNECT_COMPLETE;
+    return socket_->Connect(base::Bind(&DnsTCPAttempt::OnIOComplete,
+                                       base::Unretained(this)));
+  }
+
+  int DoConnectComplete(int rv) {
+    DCHECK_NE(ERR_IO_PENDING, rv);
+    if (rv < 0)
+      return rv;
+
+    // Send the length and the query in a single write.
+    int query_size = query_->io_buffer()->size();
+    scoped_refptr<IOBufferWithSize> buffer(
+        new IOBufferWithSize(sizeof(uint16) + query_size));
+    WriteBigEndian<uint16>(buffer->data(), static_cast<uint16>(query_size));
+    memcpy(buffer->data() + sizeof(uint16), query_->io_buffer()->data(),
+           query_size);
+    buffer_ = new DrainableIOBuffer(buffer, buffer->size());
+    next_state_ = STATE_SEND_QUERY;
+    return OK;
+  }
+
+  int DoSendQuery() {
+    next_state_ = STATE_SEND_QUERY_COMPLETE;
+    return socket_->Write(buffer_, buffer_->BytesRemaining(),
+                          base::Bind(&DnsTCPAttempt::OnIOComplete,
+                                     base::Unretained(this)));
+  }
+
+  int DoSendQueryComplete(int rv) {
+    DCHECK_NE(ERR_IO_PENDING, rv);
+    if (rv < 0)
+      return rv;
+
+    buffer_->DidConsume(rv);
+    if (buffer_->BytesRemaining() > 0) {
+      next_state_ = STATE_SEND_QUERY;
+      return OK;
+    }
+
+    buffer_ = new DrainableIOBuffer(length_buffer_, length_buffer_->size());
+    next_state_ = STATE_READ_LENGTH;
+    return OK;
+  }
+
+  int DoReadLength() {
+    next_state_ = STATE_READ_LENGTH_COMPLETE;
+    return socket_->Read(buffer_, buffer_->BytesRemaining(),
+                         base::Bind(&DnsTCPAttempt::OnIOComplete,
+                                    base::Unretained(this)));
+  }
+
+  int DoReadLengthComplete(int rv) {
+    DCHECK_NE(ERR_IO_PENDING, rv);
+    if (rv < 0)
+      return rv;
+    if (rv == 0)
+      return ERR_CONNECTION_CLOSED;
+
+    buffer_->DidConsume(rv);
+    if (buffer_->BytesRemaining() > 0) {
+      next_state_ = STATE_READ_LENGTH;
+      return OK;
+    }
+
+    ReadBigEndian<uint16>(length_buffer_->data(), &response_length_);
+    // Response includes query, it should be at least that size.
+    if (response_length_ < query_->io_buffer()->size())
+      return ERR_DNS_MALFORMED_RESPONSE;
+
+    response_.reset(new DnsResponse(response_length_));
+    buffer_ = new DrainableIOBuffer(response_->io_buffer(), response_length_);
+    next_state_ = STATE_READ_RESPONSE;
+    return OK;
+  }
+
+  int DoReadResponse() {
+    next_state_ = STATE_READ_RESPONSE_COMPLETE;
+    return socket_->Read(buffer_, buffer_->BytesRemaining(),
+                         base::Bind(&DnsTCPAttempt::OnIOComplete,
+                                    base::Unretained(this)));
+  }
+
+  int DoReadResponseComplete(int rv) {
+    DCHECK_NE(ERR_IO_PENDING, rv);
+    if (rv < 0)
+      return rv;
+    if (rv == 0)
+      return ERR_CONNECTION_CLOSED;
+
+    buffer_->DidConsume(rv);
+    if (buffer_->BytesRemaining() > 0) {
+      next_state_ = STATE_READ_RESPONSE;
+      return OK;
+    }
+
+    if (!response_->InitParse(response_length_, *query_))
+      return ERR_DNS_MALFORMED_RESPONSE;
+    int result = RcodeToNetError(*response_);
+    if (result != OK)
+      return result;
+
+    CHECK(response());
+    return OK;
+  }
+
+  void OnIOComplete(int rv) {
+    rv = DoLoop(rv);
+    if (rv != ERR_IO_PENDING)
+      callback_.Run(rv);
+  }
+
+  State next_state_;
+
+  scoped_ptr<StreamSocket> socket_;
+  scoped_ptr<DnsQuery> query_;
+
+  // Buffer used for the current read or write.
+  scoped_refptr<DrainableIOBuffer> buffer_;
+  scoped_refptr<IOBufferWithSize> length_buffer_;
+  uint16 response_length_;
+
+  scoped_ptr<DnsResponse> response_;
+
+  CompletionCallback callback_;
+
+  DISALLOW_COPY_AND_ASSIGN(DnsTCPAttempt);
+};
+
+// ----------------------------------------------------------------------------
+
 // Implements DnsTransaction. Configuration is supplied by DnsSession.
 // The suffix list is built according to the DnsConfig from the session.
 // The timeout for each DnsUDPAttempt is given by DnsSession::NextTimeout.
+// A truncated UDP response is retried over TCP with the same server.
 // The first server to attempt on each query is given by
 // DnsSession::NextFirstServerIndex, and the order is round-robin afterwards.
 // Each server is attempted DnsConfig::attempts times.
@@ -327,13 +580,13 @@ class DnsTransactionImpl : public DnsTransaction,
   }
 
  private:
-  // Wrapper for the result of a DnsUDPAttempt.
+  // Wrapper for the result of a DnsAttempt.
   struct AttemptResult {
-    AttemptResult(int rv, const DnsUDPAttempt* attempt)
+    AttemptResult(int rv, const DnsAttempt* attempt)
         : rv(rv), attempt(attempt) {}
 
     int rv;
-    const DnsUDPAttempt* attempt;
+    const DnsAttempt* attempt;
   };
 
   // Prepares |qnames_| according to the DnsConfig.
@@ -432,14 +685,50 @@ class DnsTransactionImpl : public DnsTransaction,
         new NetLogSourceParameter("source_dependency",
                                   socket->NetLog().source())));
 
-    const DnsConfig& config = session_->config();
+    DnsUDPAttempt* attempt = new DnsUDPAttempt(
+        socket.Pass(),
+        GetServer(attempt_number),
+        query.Pass(),
+        base::Bind(&DnsTransactionImpl::OnAttemptComplete,
+                   base::Unretained(this),
+                   attempt_number));
 
-    unsigned server_index = first_server_index_ +
-        (attempt_number % config.nameservers.size());
+    attempts_.push_back(attempt);
 
-    DnsUDPAttempt* attempt = new DnsUDPAttempt(
+    int rv = attempt->Start();
+    if (rv == ERR_IO_PENDING) {
+      timer_.Stop();
+      base::TimeDelta timeout = session_->NextTimeout(attempt_number);
+      timer_.Start(FROM_HERE, timeout, this, &DnsTransactionImpl::OnTimeout);
+    }
+    return AttemptResult(rv, attempt);
+  }
+
+  // Makes a TCP attempt at the current name, using the nameserver of
+  // |previous_attempt| which responded with a truncated message.
+  AttemptResult MakeTCPAttempt(const DnsAttempt* previous_attempt) {
+    unsigned attempt_number = attempts_.size();
+
+    unsigned previous_number = 0;
+    while (attempts_[previous_number] != previous_attempt)
+      ++previous_number;
+    const IPEndPoint& server = GetServer(previous_number);
+
+    scoped_ptr<StreamSocket> socket(
+        session_->socket_factory()->CreateTransportClientSocket(
+            AddressList::CreateFromIPAddress(server.address(), server.port()),
+            net_log_.net_log(),
+            net_log_.source()));
+
+    uint16 id = session_->NextQueryId();
+    scoped_ptr<DnsQuery> query(previous_attempt->query()->CloneWithNewId(id));
+
+    net_log_.AddEvent(NetLog::TYPE_DNS_TRANSACTION_TCP_ATTEMPT,
+                      make_scoped_refptr(new NetLogSourceParameter(
+                          "source_dependency", socket->NetLog().source())));
+
+    DnsTCPAttempt* attempt = new DnsTCPAttempt(
         socket.Pass(),
-        config.nameservers[server_index],
         query.Pass(),
         base::Bind(&DnsTransactionImpl::OnAttemptComplete,
                    base::Unretained(this),
@@ -456,6 +745,15 @@ class DnsTransactionImpl : public DnsTransaction,
     return AttemptResult(rv, attempt);
   }
 
+  // Returns the nameserver for the attempt number |attempt_number| at the
+  // current name.
+  const IPEndPoint& GetServer(unsigned attempt_number) const {
+    const DnsConfig& config = session_->config();
+    unsigned server_index = first_server_index_ +
+        (attempt_number % config.nameservers.size());
+    return config.nameservers[server_index];
+  }
+
   // Begins query for the current name. Makes the first attempt.
   AttemptResult StartQuery() {
     std::string dotted_qname = DNSDomainToString(qnames_.front());
@@ -473,20 +771,20 @@ class DnsTransactionImpl : public DnsTransaction,
     if (callback_.is_null())
       return;
     DCHECK_LT(attempt_number, attempts_.size());
-    const DnsUDPAttempt* attempt = attempts_[attempt_number];
+    const DnsAttempt* attempt = attempts_[attempt_number];
     AttemptResult result = FinishAttempt(AttemptResult(rv, attempt));
     if (result.rv != ERR_IO_PENDING)
       DoCallback(result);
   }
 
-  void LogResponse(const DnsUDPAttempt* attempt) {
+  void LogResponse(const DnsAttempt* attempt) {
     if (attempt && attempt->response()) {
       net_log_.AddEvent(
           NetLog::TYPE_DNS_TRANSACTION_RESPONSE,
           make_scoped_refptr(
               new ResponseParameters(attempt->response()->rcode(),
                                      attempt->response()->answer_count(),
-                                     attempt->socket()->NetLog().source())));
+                                     attempt->GetSocketNetLog().source())));
     }
   }
 
@@ -495,7 +793,7 @@ class DnsTransactionImpl : public DnsTransaction,
     return attempts_.size() < config.attempts * config.nameservers.size();
   }
 
-  // Resolves the result of a DnsUDPAttempt until a terminal result is reached
+  // Resolves the result of a DnsAttempt until a terminal result is reached
   // or it will complete asynchronously (ERR_IO_PENDING).
   AttemptResult FinishAttempt(AttemptResult result) {
     while (result.rv != ERR_IO_PENDING) {
@@ -519,6 +817,12 @@ class DnsTransactionImpl : public DnsTransaction,
             result = StartQuery();
           }
           break;
+        case ERR_DNS_SERVER_REQUIRES_TCP:
+          // Retry with the same server over TCP. DnsTCPAttempt never
+          // completes with this error, so this cannot loop.
+          DCHECK(result.attempt);
+          result = MakeTCPAttempt(result.attempt);
+          break;
         case ERR_DNS_TIMED_OUT:
           if (MoreAttemptsAllowed()) {
             result = MakeAttempt();
@@ -565,7 +869,7 @@ class DnsTransactionImpl : public DnsTransaction,
   std::deque<std::string> qnames_;
 
   // List of attempts for the current name.
-  ScopedVector<DnsUDPAttempt> attempts_;
+  ScopedVector<DnsAttempt> attempts_;
 
   // Index of the first server to try on each search query.
   int first_server_index_;
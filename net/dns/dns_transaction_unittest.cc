@@ -259,6 +259,45 @@ class DnsTransactionTest : public testing::Test {
     AddResponse(dotted_name, qtype, id, data, data_length, ASYNC);
   }
 
+  // Add expected query for |dotted_name| and |qtype| with |id| over TCP, and
+  // response taken verbatim from |data| of |data_length| bytes. Both are
+  // prefixed with their length.
+  void AddAsyncTCPResponse(const std::string& dotted_name,
+                           uint16 qtype,
+                           uint16 id,
+                           const char* data,
+                           size_t data_length) {
+    CHECK(socket_factory_.get());
+    DnsQuery* query = new DnsQuery(id, DomainFromDot(dotted_name), qtype);
+    queries_.push_back(query);
+
+    // The responses are only used to hold the IOBuffers.
+    std::string query_data(2, 0);
+    WriteBigEndian<uint16>(&query_data[0], query->io_buffer()->size());
+    query_data.append(query->io_buffer()->data(), query->io_buffer()->size());
+    DnsResponse* query_holder = new DnsResponse(query_data.data(),
+                                                query_data.size(),
+                                                0);
+    responses_.push_back(query_holder);
+
+    std::string response_data(2, 0);
+    WriteBigEndian<uint16>(&response_data[0], data_length);
+    response_data.append(data, data_length);
+    DnsResponse* response = new DnsResponse(response_data.data(),
+                                            response_data.size(),
+                                            0);
+    responses_.push_back(response);
+
+    writes_.push_back(MockWrite(ASYNC,
+                                query_holder->io_buffer()->data(),
+                                query_data.size()));
+    reads_.push_back(MockRead(ASYNC,
+                              response->io_buffer()->data(),
+                              response_data.size()));
+
+    transaction_ids_.push_back(id);
+  }
+
   // Add expected query of |dotted_name| and |qtype| and no response.
   void AddTimeout(const char* dotted_name, uint16 qtype) {
     CHECK(socket_factory_.get());
@@ -508,6 +547,40 @@ TEST_F(DnsTransactionTest, NoDomain) {
   EXPECT_TRUE(helper0.Run(transaction_factory_.get()));
 }
 
+TEST_F(DnsTransactionTest, TCPLookup) {
+  // The response over UDP is truncated.
+  AddAsyncRcode(kT0HostName, kT0Qtype,
+                dns_protocol::kRcodeNOERROR | dns_protocol::kFlagTC);
+  AddAsyncTCPResponse(kT0HostName,
+                      kT0Qtype,
+                      0 /* id */,
+                      reinterpret_cast<const char*>(kT0ResponseDatagram),
+                      arraysize(kT0ResponseDatagram));
+  PrepareSockets();
+
+  TransactionHelper helper0(kT0HostName,
+                            kT0Qtype,
+                            kT0RecordCount);
+  EXPECT_TRUE(helper0.Run(transaction_factory_.get()));
+}
+
+TEST_F(DnsTransactionTest, TCPMalformed) {
+  AddAsyncRcode(kT0HostName, kT0Qtype,
+                dns_protocol::kRcodeNOERROR | dns_protocol::kFlagTC);
+  // The response over TCP is shorter than the query.
+  AddAsyncTCPResponse(kT0HostName,
+                      kT0Qtype,
+                      0 /* id */,
+                      reinterpret_cast<const char*>(kT0ResponseDatagram),
+                      sizeof(dns_protocol::Header));
+  PrepareSockets();
+
+  TransactionHelper helper0(kT0HostName,
+                            kT0Qtype,
+                            ERR_DNS_SERVER_FAILED);
+  EXPECT_TRUE(helper0.Run(transaction_factory_.get()));
+}
+
 TEST_F(DnsTransactionTest, Timeout) {
   config_.attempts = 3;
   // Use short timeout to speed up the test.
@@ -106,7 +106,9 @@ HttpCache::ActiveEntry::ActiveEntry(disk_cache::Entry* entry)
     : disk_entry(entry),
       writer(NULL),
       will_process_pending_queue(false),
-      doomed(false) {
+      doomed(false),
+      readable_while_writing(false),
+      incomplete(false) {
 }
 
 HttpCache::ActiveEntry::~ActiveEntry() {
@@ -315,6 +317,7 @@ HttpCache::HttpCache(HostResolver* host_resolver,
       backend_factory_(backend_factory),
       building_backend_(false),
       mode_(NORMAL),
+      read_while_writing_(false),
       ssl_host_info_factory_(new SSLHostInfoFactoryAdaptor(
           cert_verifier,
           ALLOW_THIS_IN_INITIALIZER_LIST(this))),
@@ -343,6 +346,7 @@ HttpCache::HttpCache(HttpNetworkSession* session,
       backend_factory_(backend_factory),
       building_backend_(false),
       mode_(NORMAL),
+      read_while_writing_(false),
       ssl_host_info_factory_(new SSLHostInfoFactoryAdaptor(
           session->cert_verifier(),
           ALLOW_THIS_IN_INITIALIZER_LIST(this))),
@@ -356,6 +360,7 @@ HttpCache::HttpCache(HttpTransactionFactory* network_layer,
       backend_factory_(backend_factory),
       building_backend_(false),
       mode_(NORMAL),
+      read_while_writing_(false),
       network_layer_(network_layer) {
 }
 
@@ -816,11 +821,23 @@ int HttpCache::AddTransactionToEntry(ActiveEntry* entry, Transaction* trans) {
   // NOTE: If the transaction can only write, then the entry should not be in
   // use (since any existing entry should have already been doomed).
 
-  if (entry->writer || entry->will_process_pending_queue) {
+  if (entry->will_process_pending_queue) {
     entry->pending_queue.push_back(trans);
     return ERR_IO_PENDING;
   }
 
+  if (entry->writer) {
+    // Unless the writer is sharing the body as it stores it and nobody is
+    // ahead of this transaction, we have to wait for the writer to finish.
+    if (!entry->readable_while_writing || !entry->pending_queue.empty() ||
+        !trans->CanReadWhileWriting()) {
+      entry->pending_queue.push_back(trans);
+      return ERR_IO_PENDING;
+    }
+    entry->readers.push_back(trans);
+    return OK;
+  }
+
   if (trans->mode() & Transaction::WRITE) {
     // transaction needs exclusive access to the entry
     if (entry->readers.empty()) {
@@ -847,11 +864,11 @@ void HttpCache::DoneWithEntry(ActiveEntry* entry, Transaction* trans,
                               bool cancel) {
   // If we already posted a task to move on to the next transaction and this was
   // the writer, there is nothing to cancel.
-  if (entry->will_process_pending_queue && entry->readers.empty())
+  if (entry->will_process_pending_queue && !entry->writer &&
+      entry->readers.empty())
     return;
 
-  if (entry->writer) {
-    DCHECK(trans == entry->writer);
+  if (entry->writer == trans) {
 
     // Assume there was a failure.
     bool success = false;
@@ -868,21 +885,36 @@ void HttpCache::DoneWithEntry(ActiveEntry* entry, Transaction* trans,
 }
 
 void HttpCache::DoneWritingToEntry(ActiveEntry* entry, bool success) {
-  DCHECK(entry->readers.empty());
+  DCHECK(entry->readable_while_writing || entry->readers.empty());
 
-  entry->writer = NULL;
+  if (entry->readable_while_writing) {
+    // Let the readers that caught up with the writer see the end of the data.
+    entry->readable_while_writing = false;
+    entry->incomplete = !success;
+    ProcessWaitingReaders(entry);
+  }
 
   if (success) {
+    entry->writer = NULL;
     ProcessPendingQueue(entry);
   } else {
-    DCHECK(!entry->will_process_pending_queue);
-
     // We failed to create this entry.
     TransactionList pending_queue;
     pending_queue.swap(entry->pending_queue);
 
-    entry->disk_entry->Doom();
-    DestroyEntry(entry);
+    if (entry->readers.empty() && !entry->will_process_pending_queue) {
+      entry->writer = NULL;
+      entry->disk_entry->Doom();
+      DestroyEntry(entry);
+    } else {
+      // Readers are still going through the data stored so far, or there is a
+      // task about to look at the entry, so it goes away later.
+      if (!entry->doomed) {
+        int rv = DoomEntry(entry->disk_entry->GetKey(), NULL);
+        DCHECK_EQ(OK, rv);
+      }
+      entry->writer = NULL;
+    }
 
     // We need to do something about these pending entries, which now need to
     // be added to a new entry.
@@ -895,13 +927,14 @@ void HttpCache::DoneWritingToEntry(ActiveEntry* entry, bool success) {
 }
 
 void HttpCache::DoneReadingFromEntry(ActiveEntry* entry, Transaction* trans) {
-  DCHECK(!entry->writer);
+  DCHECK(!entry->writer || entry->readable_while_writing);
 
   TransactionList::iterator it =
       std::find(entry->readers.begin(), entry->readers.end(), trans);
   DCHECK(it != entry->readers.end());
 
   entry->readers.erase(it);
+  entry->waiting_readers.remove(trans);
 
   ProcessPendingQueue(entry);
 }
@@ -919,6 +952,35 @@ void HttpCache::ConvertWriterToReader(ActiveEntry* entry) {
   ProcessPendingQueue(entry);
 }
 
+void HttpCache::ShareEntryWithReaders(ActiveEntry* entry) {
+  DCHECK(entry->writer);
+  if (!read_while_writing_)
+    return;
+
+  entry->readable_while_writing = true;
+  entry->incomplete = false;
+  if (!entry->pending_queue.empty())
+    ProcessPendingQueue(entry);
+}
+
+void HttpCache::WaitForEntryData(ActiveEntry* entry, Transaction* trans) {
+  DCHECK(entry->readable_while_writing);
+  entry->waiting_readers.push_back(trans);
+}
+
+void HttpCache::ProcessWaitingReaders(ActiveEntry* entry) {
+  // The readers are notified asynchronously so that they don't run in the
+  // middle of the writer's work. Their IO callbacks are not invoked if they
+  // are deleted before that.
+  TransactionList waiting_readers;
+  waiting_readers.swap(entry->waiting_readers);
+  for (TransactionList::iterator it = waiting_readers.begin();
+       it != waiting_readers.end(); ++it) {
+    MessageLoop::current()->PostTask(
+        FROM_HERE, base::Bind((*it)->io_callback(), OK));
+  }
+}
+
 LoadState HttpCache::GetLoadStateForPendingTransaction(
       const Transaction* trans) {
   ActiveEntriesMap::const_iterator i = active_entries_.find(trans->key());
@@ -1014,17 +1076,30 @@ void HttpCache::ProcessPendingQueue(ActiveEntry* entry) {
 
 void HttpCache::OnProcessPendingQueue(ActiveEntry* entry) {
   entry->will_process_pending_queue = false;
-  DCHECK(!entry->writer);
+  DCHECK(!entry->writer || entry->readable_while_writing);
 
   // If no one is interested in this entry, then we can deactivate it.
   if (entry->pending_queue.empty()) {
-    if (entry->readers.empty())
+    if (!entry->writer && entry->readers.empty())
       DestroyEntry(entry);
     return;
   }
 
   // Promote next transaction from the pending queue.
   Transaction* next = entry->pending_queue.front();
+  if (entry->writer) {
+    if (!next->CanReadWhileWriting())
+      return;  // Have to wait for the writer.
+
+    // Join the writer, and let the rest of the queue follow.
+    entry->pending_queue.erase(entry->pending_queue.begin());
+    entry->readers.push_back(next);
+    if (!entry->pending_queue.empty())
+      ProcessPendingQueue(entry);
+    next->io_callback().Run(OK);
+    return;
+  }
+
   if ((next->mode() & Transaction::WRITE) && !entry->readers.empty())
     return;  // Have to wait.
 
@@ -179,6 +179,12 @@ class NET_EXPORT HttpCache : public HttpTransactionFactory,
   void set_mode(Mode value) { mode_ = value; }
   Mode mode() { return mode_; }
 
+  // When enabled, transactions waiting for a response that is being written to
+  // the cache start reading it as soon as its headers are stored, receiving
+  // the body as it arrives instead of waiting for the writer to finish.
+  void set_read_while_writing(bool value) { read_while_writing_ = value; }
+  bool read_while_writing() const { return read_while_writing_; }
+
   // Close currently active sockets so that fresh page loads will not use any
   // recycled connections.  For sockets currently in use, they may not close
   // immediately, but they will not be reusable. This is for debugging.
@@ -231,6 +237,16 @@ class NET_EXPORT HttpCache : public HttpTransactionFactory,
     TransactionList    pending_queue;
     bool               will_process_pending_queue;
     bool               doomed;
+
+    // True while |writer| lets |readers| read the response body it is
+    // storing. Readers that reach the end of the stored data wait in
+    // |waiting_readers| for more.
+    bool               readable_while_writing;
+    TransactionList    waiting_readers;
+
+    // True if a writer that was sharing the entry failed to store the whole
+    // response.
+    bool               incomplete;
   };
 
   typedef base::hash_map<std::string, ActiveEntry*> ActiveEntriesMap;
@@ -330,6 +346,18 @@ class NET_EXPORT HttpCache : public HttpTransactionFactory,
   // transactions can start reading from this entry.
   void ConvertWriterToReader(ActiveEntry* entry);
 
+  // Called by the writer of |entry| once the response headers are stored and
+  // the body can be read while it is being written.
+  void ShareEntryWithReaders(ActiveEntry* entry);
+
+  // Called by |trans|, a reader of |entry|, after reading all the data the
+  // writer has stored so far. |trans| will be notified via its IO callback
+  // when there is more data or the writer is done.
+  void WaitForEntryData(ActiveEntry* entry, Transaction* trans);
+
+  // Notifies the readers waiting for the writer of |entry|.
+  void ProcessWaitingReaders(ActiveEntry* entry);
+
   // Returns the LoadState of the provided pending transaction.
   LoadState GetLoadStateForPendingTransaction(const Transaction* trans);
 
@@ -379,6 +407,7 @@ class NET_EXPORT HttpCache : public HttpTransactionFactory,
   bool building_backend_;
 
   Mode mode_;
+  bool read_while_writing_;
 
   const scoped_ptr<SSLHostInfoFactoryAdaptor> ssl_host_info_factory_;
 
@@ -118,6 +118,7 @@ HttpCache::Transaction::Transaction(HttpCache* cache)
       handling_206_(false),
       cache_pending_(false),
       done_reading_(false),
+      joined_writer_(false),
       read_offset_(0),
       effective_load_flags_(0),
       write_len_(0),
@@ -199,6 +200,12 @@ bool HttpCache::Transaction::AddTruncatedFlag() {
   return true;
 }
 
+bool HttpCache::Transaction::CanReadWhileWriting() const {
+  // Ranges are served through PartialData, which expects a stable entry.
+  return (mode_ == READ || mode_ == READ_WRITE) && !partial_.get() &&
+         !range_requested_;
+}
+
 LoadState HttpCache::Transaction::GetWriterLoadState() const {
   if (network_trans_.get())
     return network_trans_->GetLoadState();
@@ -995,6 +1002,7 @@ int HttpCache::Transaction::DoAddToEntryComplete(int result) {
 
   entry_ = new_entry_;
   new_entry_ = NULL;
+  joined_writer_ = entry_->writer && entry_->writer != this;
 
   if (mode_ == WRITE) {
     if (partial_.get())
@@ -1167,8 +1175,14 @@ int HttpCache::Transaction::DoTruncateCachedMetadataComplete(int result) {
 
   // If this response is a redirect, then we can stop writing now.  (We don't
   // need to cache the response body of a redirect.)
-  if (response_.headers->IsRedirect(NULL))
+  if (response_.headers->IsRedirect(NULL)) {
     DoneWritingToEntry(true);
+  } else if (entry_ && mode_ == WRITE && !partial_.get() &&
+             response_.headers->response_code() == 200) {
+    // The stored headers are final and the old body is gone, so others can
+    // start reading while we write the body.
+    cache_->ShareEntryWithReaders(entry_);
+  }
   next_state_ = STATE_PARTIAL_HEADERS_RECEIVED;
   return OK;
 }
@@ -1349,8 +1363,27 @@ int HttpCache::Transaction::DoCacheReadDataComplete(int result) {
   if (result > 0) {
     read_offset_ += result;
   } else if (result == 0) {  // End of file.
+    if (entry_->writer) {
+      // The writer is still storing the body, so wait for more data.
+      next_state_ = STATE_CACHE_READ_DATA;
+      if (entry_->disk_entry->GetDataSize(kResponseContentIndex) > read_offset_)
+        return OK;
+      cache_->WaitForEntryData(entry_, this);
+      return ERR_IO_PENDING;
+    }
+    bool incomplete = false;
+    if (joined_writer_) {
+      int64 body_size = response_.headers->GetContentLength();
+      incomplete = entry_->incomplete ||
+                   (body_size >= 0 && read_offset_ < body_size);
+    }
     cache_->DoneReadingFromEntry(entry_, this);
     entry_ = NULL;
+    if (incomplete) {
+      // The writer went away without storing the whole response, and we
+      // cannot go back to the network after returning part of the body.
+      return ERR_CACHE_READ_FAILURE;
+    }
   } else {
     return OnCacheReadError(result, false);
   }
@@ -1382,11 +1415,16 @@ int HttpCache::Transaction::DoCacheWriteDataComplete(int result) {
     // We want to ignore errors writing to disk and just keep reading from
     // the network.
     result = write_len_;
-  } else if (!done_reading_ && entry_) {
-    int current_size = entry_->disk_entry->GetDataSize(kResponseContentIndex);
-    int64 body_size = response_.headers->GetContentLength();
-    if (body_size >= 0 && body_size <= current_size)
-      done_reading_ = true;
+  } else if (entry_) {
+    if (!done_reading_) {
+      int current_size =
+          entry_->disk_entry->GetDataSize(kResponseContentIndex);
+      int64 body_size = response_.headers->GetContentLength();
+      if (body_size >= 0 && body_size <= current_size)
+        done_reading_ = true;
+    }
+    if (result > 0 && entry_->readable_while_writing)
+      cache_->ProcessWaitingReaders(entry_);
   }
 
   if (partial_.get()) {
@@ -1580,11 +1618,19 @@ int HttpCache::Transaction::BeginCacheValidation() {
       next_state_ = STATE_PARTIAL_HEADERS_RECEIVED;
       return OK;
     }
-    cache_->ConvertWriterToReader(entry_);
+    if (!joined_writer_)
+      cache_->ConvertWriterToReader(entry_);
     mode_ = READ;
 
     if (entry_->disk_entry->GetDataSize(kMetadataIndex))
       next_state_ = STATE_CACHE_READ_METADATA;
+  } else if (joined_writer_) {
+    // The response is still being written, so we cannot update the entry.
+    // Just go to the network.
+    cache_->DoneReadingFromEntry(entry_, this);
+    entry_ = NULL;
+    mode_ = NONE;
+    next_state_ = STATE_SEND_REQUEST;
   } else {
     // Make the network request conditional, to see if we may reuse our cached
     // response.  If we cannot do so, then we just resort to a normal fetch.
@@ -88,6 +88,10 @@ class HttpCache::Transaction : public HttpTransaction {
   // success.
   bool AddTruncatedFlag();
 
+  // Returns true if this transaction can use a response that is still being
+  // written to the cache by another transaction.
+  bool CanReadWhileWriting() const;
+
   // Returns the LoadState of the writer transaction of a given ActiveEntry. In
   // other words, returns the LoadState of this transaction without asking the
   // http cache, because this transaction should be the one currently writing
@@ -360,6 +364,7 @@ class HttpCache::Transaction : public HttpTransaction {
   bool handling_206_;  // We must deal with this 206 response.
   bool cache_pending_;  // We are waiting for the HttpCache.
   bool done_reading_;
+  bool joined_writer_;  // The entry was still being written when we got it.
   scoped_refptr<IOBuffer> read_buf_;
   int io_buf_len_;
   int read_offset_;
@@ -1165,6 +1165,120 @@ TEST(HttpCache, SimpleGET_ManyWriters_CancelFirst) {
   }
 }
 
+// Tests that when reading while writing is enabled, the transactions waiting
+// for the writer start as soon as the headers are stored, and receive the body
+// as the writer stores it.
+TEST(HttpCache, SimpleGET_ReadWhileWriting) {
+  MockHttpCache cache;
+  cache.http_cache()->set_read_while_writing(true);
+
+  MockHttpRequest request(kSimpleGET_Transaction);
+
+  std::vector<Context*> context_list;
+  const int kNumTransactions = 3;
+
+  for (int i = 0; i < kNumTransactions; ++i) {
+    context_list.push_back(new Context());
+    Context* c = context_list[i];
+
+    c->result = cache.http_cache()->CreateTransaction(&c->trans);
+    EXPECT_EQ(net::OK, c->result);
+
+    c->result = c->trans->Start(
+        &request, c->callback.callback(), net::BoundNetLog());
+  }
+
+  // All the transactions get the headers before the writer reads the body.
+  for (int i = 0; i < kNumTransactions; ++i) {
+    Context* c = context_list[i];
+    if (c->result == net::ERR_IO_PENDING)
+      c->result = c->callback.WaitForResult();
+    EXPECT_EQ(net::OK, c->result);
+  }
+
+  EXPECT_EQ(1, cache.network_layer()->transaction_count());
+  EXPECT_EQ(0, cache.disk_cache()->open_count());
+  EXPECT_EQ(1, cache.disk_cache()->create_count());
+
+  // There is nothing to read yet.
+  std::vector<scoped_refptr<net::IOBuffer> > buffers;
+  for (int i = 1; i < kNumTransactions; ++i) {
+    Context* c = context_list[i];
+    buffers.push_back(new net::IOBuffer(256));
+    c->result = c->trans->Read(buffers.back(), 256, c->callback.callback());
+    EXPECT_EQ(net::ERR_IO_PENDING, c->result);
+  }
+
+  ReadAndVerifyTransaction(context_list[0]->trans.get(),
+                           kSimpleGET_Transaction);
+
+  std::string expected(kSimpleGET_Transaction.data);
+  for (int i = 1; i < kNumTransactions; ++i) {
+    Context* c = context_list[i];
+    c->result = c->callback.WaitForResult();
+    ASSERT_EQ(static_cast<int>(expected.size()), c->result);
+    EXPECT_EQ(expected, std::string(buffers[i - 1]->data(), c->result));
+
+    c->result = c->trans->Read(buffers[i - 1], 256, c->callback.callback());
+    EXPECT_EQ(0, c->callback.GetResult(c->result));
+  }
+
+  EXPECT_EQ(1, cache.network_layer()->transaction_count());
+  EXPECT_EQ(0, cache.disk_cache()->open_count());
+  EXPECT_EQ(1, cache.disk_cache()->create_count());
+
+  for (int i = 0; i < kNumTransactions; ++i)
+    delete context_list[i];
+}
+
+// Tests that the transactions reading while writing fail if the writer goes
+// away before storing the whole response.
+TEST(HttpCache, SimpleGET_ReadWhileWriting_CancelWriter) {
+  MockHttpCache cache;
+  cache.http_cache()->set_read_while_writing(true);
+
+  MockHttpRequest request(kSimpleGET_Transaction);
+
+  std::vector<Context*> context_list;
+  const int kNumTransactions = 2;
+
+  for (int i = 0; i < kNumTransactions; ++i) {
+    context_list.push_back(new Context());
+    Context* c = context_list[i];
+
+    c->result = cache.http_cache()->CreateTransaction(&c->trans);
+    EXPECT_EQ(net::OK, c->result);
+
+    c->result = c->trans->Start(
+        &request, c->callback.callback(), net::BoundNetLog());
+  }
+
+  for (int i = 0; i < kNumTransactions; ++i) {
+    Context* c = context_list[i];
+    if (c->result == net::ERR_IO_PENDING)
+      c->result = c->callback.WaitForResult();
+    EXPECT_EQ(net::OK, c->result);
+  }
+
+  Context* reader = context_list[1];
+  scoped_refptr<net::IOBuffer> buf(new net::IOBuffer(256));
+  reader->result = reader->trans->Read(buf, 256, reader->callback.callback());
+  EXPECT_EQ(net::ERR_IO_PENDING, reader->result);
+
+  // Destroy the writer without reading the body.
+  delete context_list[0];
+
+  EXPECT_EQ(net::ERR_CACHE_READ_FAILURE, reader->callback.WaitForResult());
+  delete reader;
+
+  // The entry was doomed, so the next request goes to the network.
+  RunTransactionTest(cache.http_cache(), kSimpleGET_Transaction);
+
+  EXPECT_EQ(2, cache.network_layer()->transaction_count());
+  EXPECT_EQ(0, cache.disk_cache()->open_count());
+  EXPECT_EQ(2, cache.disk_cache()->create_count());
+}
+
 // Tests that we can cancel requests that are queued waiting to open the disk
 // cache entry.
 TEST(HttpCache, SimpleGET_ManyWriters_CancelCreate) {
@@ -50,6 +50,7 @@ void HttpNetworkLayer::EnableSpdy(const std::string& mode) {
   static const char kSingleDomain[] = "single-domain";
 
   static const char kInitialMaxConcurrentStreams[] = "init-max-streams";
+  static const char kWeightedPriority[] = "weighted-priority";
 
   std::vector<std::string> spdy_options;
   base::SplitString(mode, ',', &spdy_options);
@@ -92,6 +93,8 @@ void HttpNetworkLayer::EnableSpdy(const std::string& mode) {
       int streams;
       if (base::StringToInt(value, &streams) && streams > 0)
         SpdySession::set_init_max_concurrent_streams(streams);
+    } else if (option == kWeightedPriority) {
+      SpdySession::set_enable_weighted_write_scheduling(true);
     } else if (option.empty() && it == spdy_options.begin()) {
       continue;
     } else {
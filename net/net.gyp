@@ -304,6 +304,8 @@
         'disk_cache/backend_impl.h',
         'disk_cache/bitmap.cc',
         'disk_cache/bitmap.h',
+        'disk_cache/bloom_filter.cc',
+        'disk_cache/bloom_filter.h',
         'disk_cache/block_files.cc',
         'disk_cache/block_files.h',
         'disk_cache/cache_util.h',
@@ -325,6 +327,8 @@
         'disk_cache/file_lock.h',
         'disk_cache/file_posix.cc',
         'disk_cache/file_win.cc',
+        'disk_cache/frequency_sketch.cc',
+        'disk_cache/frequency_sketch.h',
         'disk_cache/hash.cc',
         'disk_cache/hash.h',
         'disk_cache/histogram_macros.h',
@@ -345,6 +349,8 @@
         'disk_cache/net_log_parameters.h',
         'disk_cache/rankings.cc',
         'disk_cache/rankings.h',
+        'disk_cache/sharded_backend.cc',
+        'disk_cache/sharded_backend.h',
         'disk_cache/sparse_control.cc',
         'disk_cache/sparse_control.h',
         'disk_cache/stats.cc',
@@ -638,6 +644,8 @@
         'socket/ssl_server_socket_nss.cc',
         'socket/ssl_server_socket_nss.h',
         'socket/ssl_server_socket_openssl.cc',
+        'socket/ssl_session_store.cc',
+        'socket/ssl_session_store.h',
         'socket/ssl_socket.h',
         'socket/stream_socket.cc',
         'socket/stream_socket.h',
@@ -692,6 +700,8 @@
         'spdy/spdy_stream.h',
         'spdy/spdy_websocket_stream.cc',
         'spdy/spdy_websocket_stream.h',
+        'spdy/spdy_write_scheduler.cc',
+        'spdy/spdy_write_scheduler.h',
         'third_party/mozilla_security_manager/nsKeygenHandler.cpp',
         'third_party/mozilla_security_manager/nsKeygenHandler.h',
         'third_party/mozilla_security_manager/nsNSSCertTrust.cpp',
@@ -1020,6 +1030,7 @@
       'target_name': 'net_unittests',
       'type': 'executable',
       'dependencies': [
+        'http_server',
         'net',
         'net_test_support',
         '../base/base.gyp:base',
@@ -1096,9 +1107,11 @@
         'disk_cache/addr_unittest.cc',
         'disk_cache/backend_unittest.cc',
         'disk_cache/bitmap_unittest.cc',
+        'disk_cache/bloom_filter_unittest.cc',
         'disk_cache/block_files_unittest.cc',
         'disk_cache/cache_util_unittest.cc',
         'disk_cache/entry_unittest.cc',
+        'disk_cache/frequency_sketch_unittest.cc',
         'disk_cache/mapped_file_unittest.cc',
         'disk_cache/storage_block_unittest.cc',
         'dns/dns_config_service_posix_unittest.cc',
@@ -1188,6 +1201,7 @@
         'proxy/proxy_server_unittest.cc',
         'proxy/proxy_service_unittest.cc',
         'proxy/sync_host_resolver_bridge_unittest.cc',
+        'server/http_server_unittest.cc',
         'socket/buffered_write_stream_socket_unittest.cc',
         'socket/client_socket_pool_base_unittest.cc',
         'socket/deterministic_socket_data_unittest.cc',
@@ -1199,6 +1213,7 @@
         'socket/ssl_client_socket_pool_unittest.cc',
         'socket/ssl_client_socket_unittest.cc',
         'socket/ssl_server_socket_unittest.cc',
+        'socket/ssl_session_store_unittest.cc',
         'socket/tcp_client_socket_unittest.cc',
         'socket/tcp_server_socket_unittest.cc',
         'socket/transport_client_socket_pool_unittest.cc',
@@ -1233,6 +1248,7 @@
         'spdy/spdy_websocket_test_util_spdy2.h',
         'spdy/spdy_websocket_test_util_spdy3.cc',
         'spdy/spdy_websocket_test_util_spdy3.h',
+        'spdy/spdy_write_scheduler_unittest.cc',
         'test/python_utils_unittest.cc',
         'tools/dump_cache/url_to_filename_encoder.cc',
         'tools/dump_cache/url_to_filename_encoder.h',
@@ -1403,11 +1419,14 @@
         '../base/base.gyp:test_support_perf',
         '../build/temp_gyp/googleurl.gyp:googleurl',
         '../testing/gtest.gyp:gtest',
+        '../third_party/zlib/zlib.gyp:zlib',
       ],
       'sources': [
+        'base/gzip_filter_perftest.cc',
         'cookies/cookie_monster_perftest.cc',
         'disk_cache/disk_cache_perftest.cc',
         'proxy/proxy_resolver_perftest.cc',
+        'spdy/spdy_framer_perftest.cc',
       ],
       'conditions': [
         # This is needed to trigger the dll copy step on windows.
@@ -1456,6 +1475,18 @@
         'tools/crash_cache/crash_cache.cc',
       ],
     },
+    {
+      'target_name': 'cache_simulator',
+      'type': 'executable',
+      'dependencies': [
+        'net',
+        'net_test_support',
+        '../base/base.gyp:base',
+      ],
+      'sources': [
+        'tools/cache_simulator/cache_simulator.cc',
+      ],
+    },
     {
       'target_name': 'run_testserver',
       'type': 'executable',
@@ -1793,6 +1824,18 @@
              'curvecp/test_server.cc',
            ],
          },
+         {
+           'target_name': 'http_server_load',
+           'type': 'executable',
+           'dependencies': [
+             '../base/base.gyp:base',
+             'http_server',
+             'net',
+           ],
+           'sources': [
+             'tools/http_server_load/http_server_load.cc',
+           ],
+         },
        ]
      }],
     ['OS=="android"', {
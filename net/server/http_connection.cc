@@ -30,14 +30,14 @@ void HttpConnection::Send200(const std::string& data,
                              const std::string& content_type) {
   if (!socket_)
     return;
-  socket_->Send(base::StringPrintf(
+  socket_->SendWithHeader(base::StringPrintf(
       "HTTP/1.1 200 OK\r\n"
       "Content-Type:%s\r\n"
       "Content-Length:%d\r\n"
       "\r\n",
       content_type.c_str(),
-      static_cast<int>(data.length())));
-  socket_->Send(data);
+      static_cast<int>(data.length())),
+      data);
 }
 
 void HttpConnection::Send404() {
@@ -52,19 +52,20 @@ void HttpConnection::Send404() {
 void HttpConnection::Send500(const std::string& message) {
   if (!socket_)
     return;
-  socket_->Send(base::StringPrintf(
+  socket_->SendWithHeader(base::StringPrintf(
       "HTTP/1.1 500 Internal Error\r\n"
       "Content-Type:text/html\r\n"
       "Content-Length:%d\r\n"
-      "\r\n"
-      "%s",
-      static_cast<int>(message.length()),
-      message.c_str()));
+      "\r\n",
+      static_cast<int>(message.length())),
+      message);
 }
 
 HttpConnection::HttpConnection(HttpServer* server, ListenSocket* sock)
     : server_(server),
-      socket_(sock) {
+      socket_(sock),
+      parse_state_(0),
+      parse_pos_(0) {
   id_ = last_id_++;
 }
 
@@ -78,7 +79,8 @@ void HttpConnection::DetachSocket() {
 }
 
 void HttpConnection::Shift(int num_bytes) {
-  recv_data_ = recv_data_.substr(num_bytes);
+  // Erase in place so that the buffer keeps its capacity.
+  recv_data_.erase(0, num_bytes);
 }
 
 }  // namespace net
@@ -11,6 +11,7 @@
 #include "base/basictypes.h"
 #include "base/memory/ref_counted.h"
 #include "base/memory/scoped_ptr.h"
+#include "net/server/http_server_request_info.h"
 
 namespace net {
 
@@ -45,6 +46,16 @@ class HttpConnection {
   scoped_ptr<WebSocket> web_socket_;
   std::string recv_data_;
   int id_;
+
+  // State of HttpServer::ParseHeaders() for the request at the front of
+  // |recv_data_|, so that each read resumes parsing where the last one
+  // stopped instead of rescanning the buffered bytes.
+  int parse_state_;
+  size_t parse_pos_;
+  std::string parse_buffer_;
+  std::string parse_header_name_;
+  HttpServerRequestInfo parse_request_;
+
   DISALLOW_COPY_AND_ASSIGN(HttpConnection);
 };
 
@@ -4,6 +4,7 @@
 
 #include "net/server/http_server.h"
 
+#include "base/basictypes.h"
 #include "base/compiler_specific.h"
 #include "base/logging.h"
 #include "base/string_util.h"
@@ -17,10 +18,20 @@
 
 namespace net {
 
+namespace {
+
+// Limits on the receive buffers kept for reuse by later reads.
+const size_t kMaxPooledBuffers = 64;
+const size_t kMaxPooledBufferSize = 16 * 1024;
+
+}  // namespace
+
 HttpServer::HttpServer(const std::string& host,
                        int port,
                        HttpServer::Delegate* del)
     : delegate_(del) {
+  // Reserve up front so that the pooled strings are never copied.
+  buffer_pool_.reserve(kMaxPooledBuffers);
   server_ = TCPListenSocket::CreateAndListen(host, port, this);
 }
 
@@ -108,8 +119,14 @@ void HttpServer::DidRead(ListenSocket* socket,
   if (connection == NULL)
     return;
 
+  if (connection->recv_data_.empty())
+    AcquireBuffer(connection);
   connection->recv_data_.append(data, len);
+  // A single read may carry several pipelined requests. The delegate may
+  // close the connection from any of its callbacks, so look it up again
+  // after each one.
   while (connection->recv_data_.length()) {
+    int connection_id = connection->id();
     if (connection->web_socket_.get()) {
       std::string message;
       WebSocket::ParseResult result = connection->web_socket_->Read(&message);
@@ -118,10 +135,13 @@ void HttpServer::DidRead(ListenSocket* socket,
 
       if (result == WebSocket::FRAME_CLOSE ||
           result == WebSocket::FRAME_ERROR) {
-        Close(connection->id());
-        break;
+        Close(connection_id);
+        return;
       }
-      delegate_->OnWebSocketMessage(connection->id(), message);
+      delegate_->OnWebSocketMessage(connection_id, message);
+      connection = FindConnection(connection_id);
+      if (connection == NULL)
+        return;
       continue;
     }
 
@@ -138,14 +158,20 @@ void HttpServer::DidRead(ListenSocket* socket,
 
       if (!connection->web_socket_.get())  // Not enought data was received.
         break;
-      delegate_->OnWebSocketRequest(connection->id(), request);
       connection->Shift(pos);
-      continue;
+      delegate_->OnWebSocketRequest(connection_id, request);
+    } else {
+      // Request body is not supported. It is always empty.
+      connection->Shift(pos);
+      delegate_->OnHttpRequest(connection_id, request);
     }
-    // Request body is not supported. It is always empty.
-    delegate_->OnHttpRequest(connection->id(), request);
-    connection->Shift(pos);
+    connection = FindConnection(connection_id);
+    if (connection == NULL)
+      return;
   }
+
+  if (connection->recv_data_.empty())
+    ReleaseBuffer(connection);
 }
 
 void HttpServer::DidClose(ListenSocket* socket) {
@@ -153,6 +179,8 @@ void HttpServer::DidClose(ListenSocket* socket) {
   DCHECK(connection != NULL);
   id_to_connection_.erase(connection->id());
   socket_to_connection_.erase(connection->socket_);
+  connection->recv_data_.clear();
+  ReleaseBuffer(connection);
   delete connection;
 }
 
@@ -226,17 +254,21 @@ int charToInput(char ch) {
   return INPUT_DEFAULT;
 }
 
+// Connections start parsing in the state with value zero.
+COMPILE_ASSERT(ST_METHOD == 0, connections_start_parsing_at_st_method);
+
 bool HttpServer::ParseHeaders(HttpConnection* connection,
                               HttpServerRequestInfo* info,
                               size_t* ppos) {
-  size_t& pos = *ppos;
+  const char* data = connection->recv_data_.data();
   size_t data_len = connection->recv_data_.length();
-  int state = ST_METHOD;
-  std::string buffer;
-  std::string header_name;
-  std::string header_value;
+  size_t pos = connection->parse_pos_;
+  int state = connection->parse_state_;
+  std::string& buffer = connection->parse_buffer_;
+  std::string& header_name = connection->parse_header_name_;
+  HttpServerRequestInfo* request = &connection->parse_request_;
   while (pos < data_len) {
-    char ch = connection->recv_data_[pos++];
+    char ch = data[pos++];
     int input = charToInput(ch);
     int next_state = parser_state[state][input];
 
@@ -245,11 +277,11 @@ bool HttpServer::ParseHeaders(HttpConnection* connection,
       // Do any actions based on state transitions.
       switch (state) {
         case ST_METHOD:
-          info->method = buffer;
+          request->method = buffer;
           buffer.clear();
           break;
         case ST_URL:
-          info->path = buffer;
+          request->path = buffer;
           buffer.clear();
           break;
         case ST_PROTO:
@@ -262,10 +294,10 @@ bool HttpServer::ParseHeaders(HttpConnection* connection,
           buffer.clear();
           break;
         case ST_VALUE:
-          header_value = buffer;
           // TODO(mbelshe): Deal better with duplicate headers
-          DCHECK(info->headers.find(header_name) == info->headers.end());
-          info->headers[header_name] = header_value;
+          DCHECK(request->headers.find(header_name) ==
+                 request->headers.end());
+          request->headers[header_name] = buffer;
           buffer.clear();
           break;
         case ST_SEPARATOR:
@@ -280,21 +312,62 @@ bool HttpServer::ParseHeaders(HttpConnection* connection,
         case ST_URL:
         case ST_PROTO:
         case ST_VALUE:
-        case ST_NAME:
-          buffer.append(&ch, 1);
+        case ST_NAME: {
+          // Append the whole run of characters that stay in this state.
+          size_t run_end = pos;
+          while (run_end < data_len &&
+                 parser_state[state][charToInput(data[run_end])] == state) {
+            run_end++;
+          }
+          buffer.append(data + pos - 1, run_end - pos + 1);
+          pos = run_end;
           break;
+        }
         case ST_DONE:
           DCHECK(input == INPUT_LF);
+          info->method.swap(request->method);
+          info->path.swap(request->path);
+          info->headers.swap(request->headers);
+          *ppos = pos;
+          // Start over for the next request.
+          connection->parse_state_ = ST_METHOD;
+          connection->parse_pos_ = 0;
+          buffer.clear();
+          header_name.clear();
+          *request = HttpServerRequestInfo();
           return true;
         case ST_ERR:
+          connection->parse_state_ = state;
+          connection->parse_pos_ = pos;
           return false;
       }
     }
   }
   // No more characters, but we haven't finished parsing yet.
+  connection->parse_state_ = state;
+  connection->parse_pos_ = pos;
   return false;
 }
 
+void HttpServer::AcquireBuffer(HttpConnection* connection) {
+  if (buffer_pool_.empty())
+    return;
+  connection->recv_data_.swap(buffer_pool_.back());
+  buffer_pool_.pop_back();
+}
+
+void HttpServer::ReleaseBuffer(HttpConnection* connection) {
+  std::string& buffer = connection->recv_data_;
+  DCHECK(buffer.empty());
+  if (buffer_pool_.size() < kMaxPooledBuffers &&
+      buffer.capacity() > 0 && buffer.capacity() <= kMaxPooledBufferSize) {
+    buffer_pool_.push_back(std::string());
+    buffer_pool_.back().swap(buffer);
+  } else {
+    std::string().swap(buffer);
+  }
+}
+
 HttpConnection* HttpServer::FindConnection(int connection_id) {
   IdToConnectionMap::iterator it = id_to_connection_.find(connection_id);
   if (it == id_to_connection_.end())
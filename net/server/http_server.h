@@ -8,6 +8,8 @@
 
 #include <list>
 #include <map>
+#include <string>
+#include <vector>
 
 #include "base/basictypes.h"
 #include "base/memory/ref_counted.h"
@@ -67,13 +69,20 @@ class HttpServer : public ListenSocket::ListenSocketDelegate,
   friend class base::RefCountedThreadSafe<HttpServer>;
   friend class HttpConnection;
 
-  // Expects the raw data to be stored in recv_data_. If parsing is successful,
-  // will remove the data parsed from recv_data_, leaving only the unused
-  // recv data.
+  // Expects the raw data to be stored in recv_data_. Parsing resumes from the
+  // state saved in |connection| by the previous call. If a complete request
+  // has been received, moves it to |info|, sets |pos| to its length and
+  // returns true.
   bool ParseHeaders(HttpConnection* connection,
                     HttpServerRequestInfo* info,
                     size_t* pos);
 
+  // Gives |connection| a receive buffer from |buffer_pool_|, if any.
+  void AcquireBuffer(HttpConnection* connection);
+  // Returns the empty receive buffer of |connection| to |buffer_pool_|, so
+  // that idle connections do not hold on to memory.
+  void ReleaseBuffer(HttpConnection* connection);
+
   HttpConnection* FindConnection(int connection_id);
   HttpConnection* FindConnection(ListenSocket* socket);
 
@@ -83,6 +92,7 @@ class HttpServer : public ListenSocket::ListenSocketDelegate,
   IdToConnectionMap id_to_connection_;
   typedef std::map<ListenSocket*, HttpConnection*> SocketToConnectionMap;
   SocketToConnectionMap socket_to_connection_;
+  std::vector<std::string> buffer_pool_;
 
   DISALLOW_COPY_AND_ASSIGN(HttpServer);
 };
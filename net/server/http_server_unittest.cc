@@ -0,0 +1,240 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/server/http_server.h"
+
+#include <string>
+#include <vector>
+
+#include "base/compiler_specific.h"
+#include "base/memory/ref_counted.h"
+#include "net/base/listen_socket.h"
+#include "net/server/http_server_request_info.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace net {
+
+namespace {
+
+const char kRequest[] =
+    "GET /test HTTP/1.1\r\n"
+    "Host: example.com\r\n"
+    "User-Agent: test\r\n"
+    "\r\n";
+
+// A connected socket which records what the server sends on it.
+class TestListenSocket : public ListenSocket {
+ public:
+  explicit TestListenSocket(ListenSocketDelegate* del) : ListenSocket(del) {}
+
+  const std::string& sent_data() const { return sent_data_; }
+
+ protected:
+  virtual ~TestListenSocket() {}
+
+  virtual void SendInternal(const char* bytes, int len) OVERRIDE {
+    sent_data_.append(bytes, len);
+  }
+
+ private:
+  std::string sent_data_;
+
+  DISALLOW_COPY_AND_ASSIGN(TestListenSocket);
+};
+
+// Records the requests and messages it gets, and answers or closes
+// connections as told.
+class TestDelegate : public HttpServer::Delegate {
+ public:
+  TestDelegate() : server_(NULL), close_after_requests_(0), num_closed_(0) {}
+  virtual ~TestDelegate() {}
+
+  void set_server(HttpServer* server) { server_ = server; }
+
+  // Closes the connection from the callback for the |num_requests|th request.
+  void set_close_after_requests(size_t num_requests) {
+    close_after_requests_ = num_requests;
+  }
+
+  virtual void OnHttpRequest(int connection_id,
+                             const HttpServerRequestInfo& info) OVERRIDE {
+    requests_.push_back(info);
+    if (requests_.size() == close_after_requests_)
+      server_->Close(connection_id);
+    else
+      server_->Send200(connection_id, info.path, "text/plain");
+  }
+
+  virtual void OnWebSocketRequest(int connection_id,
+                                  const HttpServerRequestInfo& info) OVERRIDE {
+    web_socket_requests_.push_back(info);
+    server_->AcceptWebSocket(connection_id, info);
+  }
+
+  virtual void OnWebSocketMessage(int connection_id,
+                                  const std::string& data) OVERRIDE {
+    messages_.push_back(data);
+  }
+
+  virtual void OnClose(int connection_id) OVERRIDE {
+    ++num_closed_;
+  }
+
+  const std::vector<HttpServerRequestInfo>& requests() const {
+    return requests_;
+  }
+  const std::vector<HttpServerRequestInfo>& web_socket_requests() const {
+    return web_socket_requests_;
+  }
+  const std::vector<std::string>& messages() const { return messages_; }
+  int num_closed() const { return num_closed_; }
+
+ private:
+  HttpServer* server_;
+  size_t close_after_requests_;
+  std::vector<HttpServerRequestInfo> requests_;
+  std::vector<HttpServerRequestInfo> web_socket_requests_;
+  std::vector<std::string> messages_;
+  int num_closed_;
+
+  DISALLOW_COPY_AND_ASSIGN(TestDelegate);
+};
+
+// Returns a masked client frame carrying |message| as text.
+std::string MakeWebSocketFrame(const std::string& message) {
+  const char kMask[] = { 0x12, 0x34, 0x56, 0x78 };
+  std::string frame;
+  frame.push_back(static_cast<char>(0x81));  // Final text frame.
+  frame.push_back(static_cast<char>(0x80 | message.size()));
+  frame.append(kMask, sizeof(kMask));
+  for (size_t i = 0; i < message.size(); ++i)
+    frame.push_back(message[i] ^ kMask[i % sizeof(kMask)]);
+  return frame;
+}
+
+}  // namespace
+
+// The tests feed data to HttpServer as its sockets would, so that they
+// control exactly how the bytes are split into reads.
+class HttpServerTest : public testing::Test {
+ protected:
+  virtual void SetUp() OVERRIDE {
+    server_ = new HttpServer("127.0.0.1", 0, &delegate_);
+    delegate_.set_server(server_.get());
+  }
+
+  virtual void TearDown() OVERRIDE {
+    server_ = NULL;
+  }
+
+  scoped_refptr<TestListenSocket> Connect() {
+    scoped_refptr<TestListenSocket> socket(
+        new TestListenSocket(server_.get()));
+    server_->DidAccept(NULL, socket.get());
+    return socket;
+  }
+
+  void Read(TestListenSocket* socket, const std::string& data) {
+    ASSERT_FALSE(data.empty());
+    server_->DidRead(socket, data.data(), data.size());
+  }
+
+  void ExpectRequest(const HttpServerRequestInfo& info) {
+    EXPECT_EQ("GET", info.method);
+    EXPECT_EQ("/test", info.path);
+    EXPECT_EQ("example.com", info.GetHeaderValue("Host"));
+    EXPECT_EQ("test", info.GetHeaderValue("User-Agent"));
+  }
+
+  TestDelegate delegate_;
+  scoped_refptr<HttpServer> server_;
+};
+
+TEST_F(HttpServerTest, RequestSplitAcrossReads) {
+  const std::string request(kRequest);
+  for (size_t split = 1; split < request.size(); ++split) {
+    scoped_refptr<TestListenSocket> socket = Connect();
+    Read(socket, request.substr(0, split));
+    EXPECT_EQ(split - 1, delegate_.requests().size()) << split;
+    Read(socket, request.substr(split));
+    ASSERT_EQ(split, delegate_.requests().size()) << split;
+    ExpectRequest(delegate_.requests().back());
+    EXPECT_NE(std::string::npos,
+              socket->sent_data().find("HTTP/1.1 200 OK")) << split;
+  }
+}
+
+TEST_F(HttpServerTest, PipelinedRequestsInOneRead) {
+  const size_t kNumRequests = 3;
+  std::string data;
+  for (size_t i = 0; i < kNumRequests; ++i)
+    data.append(kRequest);
+
+  scoped_refptr<TestListenSocket> socket = Connect();
+  Read(socket, data);
+  ASSERT_EQ(kNumRequests, delegate_.requests().size());
+  for (size_t i = 0; i < kNumRequests; ++i)
+    ExpectRequest(delegate_.requests()[i]);
+
+  // Each request was answered, in order.
+  size_t pos = 0;
+  for (size_t i = 0; i < kNumRequests; ++i) {
+    pos = socket->sent_data().find("HTTP/1.1 200 OK", pos);
+    ASSERT_NE(std::string::npos, pos) << i;
+    pos++;
+  }
+  EXPECT_EQ(0, delegate_.num_closed());
+}
+
+// The requests pipelined behind the one whose callback closes the connection
+// are dropped.
+TEST_F(HttpServerTest, CloseInPipeline) {
+  std::string data;
+  for (int i = 0; i < 3; ++i)
+    data.append(kRequest);
+
+  delegate_.set_close_after_requests(2);
+  scoped_refptr<TestListenSocket> socket = Connect();
+  Read(socket, data);
+  EXPECT_EQ(2u, delegate_.requests().size());
+  EXPECT_EQ(1, delegate_.num_closed());
+
+  // The server keeps serving other connections.
+  scoped_refptr<TestListenSocket> socket2 = Connect();
+  Read(socket2, kRequest);
+  EXPECT_EQ(3u, delegate_.requests().size());
+  EXPECT_NE(std::string::npos, socket2->sent_data().find("HTTP/1.1 200 OK"));
+}
+
+TEST_F(HttpServerTest, WebSocketUpgradeInPieces) {
+  const std::string handshake(
+      "GET /socket HTTP/1.1\r\n"
+      "Host: example.com\r\n"
+      "Upgrade: websocket\r\n"
+      "Connection: Upgrade\r\n"
+      "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+      "Sec-WebSocket-Version: 13\r\n"
+      "\r\n");
+  const std::string data = handshake + MakeWebSocketFrame("hello") +
+      MakeWebSocketFrame("world");
+
+  // Feed everything a few bytes at a time.
+  const size_t kChunkSize = 3;
+  scoped_refptr<TestListenSocket> socket = Connect();
+  for (size_t pos = 0; pos < data.size(); pos += kChunkSize)
+    Read(socket, data.substr(pos, kChunkSize));
+
+  ASSERT_EQ(1u, delegate_.web_socket_requests().size());
+  EXPECT_EQ("/socket", delegate_.web_socket_requests()[0].path);
+  EXPECT_TRUE(delegate_.requests().empty());
+  // The accept key for the sample nonce of RFC 6455.
+  EXPECT_NE(std::string::npos, socket->sent_data().find(
+      "Sec-WebSocket-Accept: s3pPLMBiTxaQ9kYGzzhZRbK+xOo="));
+
+  ASSERT_EQ(2u, delegate_.messages().size());
+  EXPECT_EQ("hello", delegate_.messages()[0]);
+  EXPECT_EQ("world", delegate_.messages()[1]);
+}
+
+}  // namespace net
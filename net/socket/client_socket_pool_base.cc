@@ -39,6 +39,13 @@ const int kCleanupInterval = 10;  // DO NOT INCREASE THIS TIMEOUT.
 // after a certain timeout has passed without receiving an ACK.
 bool g_connect_backup_jobs_enabled = true;
 
+// Indicate whether pools that support it should warm up sockets for groups
+// that have needed several sockets at once before.
+bool g_warm_sockets_enabled = false;
+
+// The number of groups whose warm socket target is remembered.
+const size_t kMaxWarmSocketTargets = 64;
+
 double g_socket_reuse_policy_penalty_exponent = -1;
 int g_socket_reuse_policy = -1;
 
@@ -191,6 +198,8 @@ ClientSocketPoolBaseHelper::ClientSocketPoolBaseHelper(
       used_idle_socket_timeout_(used_idle_socket_timeout),
       connect_job_factory_(connect_job_factory),
       connect_backup_jobs_enabled_(false),
+      warm_sockets_enabled_(false),
+      warm_socket_targets_(kMaxWarmSocketTargets),
       pool_generation_number_(0),
       ALLOW_THIS_IN_INITIALIZER_LIST(weak_factory_(this)) {
   DCHECK_LE(0, max_sockets_per_group);
@@ -265,12 +274,19 @@ int ClientSocketPoolBaseHelper::RequestSocket(
   Group* group = GetOrCreateGroup(group_name);
 
   int rv = RequestSocketInternal(group_name, request);
+  if (rv == ERR_IO_PENDING)
+    InsertRequestIntoQueue(request, group->mutable_pending_requests());
+
+  // A synchronous error may have deleted the group.
+  if (warm_sockets_enabled_ && (rv == OK || rv == ERR_IO_PENDING)) {
+    UpdateWarmSocketTarget(group_name, group);
+    WarmUpGroup(group_name, *request, group);
+  }
+
   if (rv != ERR_IO_PENDING) {
     request->net_log().EndEventWithNetErrorCode(NetLog::TYPE_SOCKET_POOL, rv);
     CHECK(!request->handle()->is_initialized());
     delete request;
-  } else {
-    InsertRequestIntoQueue(request, group->mutable_pending_requests());
   }
   return rv;
 }
@@ -424,32 +440,47 @@ int ClientSocketPoolBaseHelper::RequestSocketInternal(
 
 bool ClientSocketPoolBaseHelper::AssignIdleSocketToGroup(
     const Request* request, Group* group) {
-  std::list<IdleSocket>* idle_sockets = group->mutable_idle_sockets();
-  std::list<IdleSocket>::iterator idle_socket_it = idle_sockets->end();
-  double max_score = -1;
-
-  // Iterate through the idle sockets forwards (oldest to newest)
-  //   * Delete any disconnected ones.
-  //   * If we find a used idle socket, assign to |idle_socket|.  At the end,
-  //   the |idle_socket_it| will be set to the newest used idle socket.
-  for (std::list<IdleSocket>::iterator it = idle_sockets->begin();
-       it != idle_sockets->end();) {
-    if (!it->socket->IsConnectedAndIdle()) {
-      DecrementIdleCount();
-      delete it->socket;
-      it = idle_sockets->erase(it);
-      continue;
-    }
+  IdleSocket idle_socket;
+  if (!TakeIdleSocket(group, &idle_socket))
+    return false;
+
+  base::TimeDelta idle_time =
+      base::TimeTicks::Now() - idle_socket.start_time;
+  HandOutSocket(
+      idle_socket.socket,
+      idle_socket.socket->WasEverUsed(),
+      request->handle(),
+      idle_time,
+      group,
+      request->net_log());
+  return true;
+}
+
+bool ClientSocketPoolBaseHelper::TakeIdleSocket(Group* group,
+                                                IdleSocket* idle_socket) {
+  IdleSocketList* used_idle_sockets = group->mutable_used_idle_sockets();
+
+  if (g_socket_reuse_policy_penalty_exponent >= 0) {
+    // Iterate through the used idle sockets forwards (oldest to newest)
+    //   * Delete any disconnected ones.
+    //   * Keep the one with the highest score.  Ties go to the newest one.
+    IdleSocketList::iterator idle_socket_it = used_idle_sockets->end();
+    double max_score = -1;
+    for (IdleSocketList::iterator it = used_idle_sockets->begin();
+         it != used_idle_sockets->end();) {
+      if (!it->socket->IsConnectedAndIdle()) {
+        DecrementIdleCount();
+        delete it->socket;
+        it = used_idle_sockets->erase(it);
+        continue;
+      }
 
-    if (it->socket->WasEverUsed()) {
-      // We found one we can reuse!
       double score = 0;
       int64 bytes_read = it->socket->NumBytesRead();
       double num_kb = static_cast<double>(bytes_read) / 1024.0;
       int idle_time_sec = (base::TimeTicks::Now() - it->start_time).InSeconds();
       idle_time_sec = std::max(1, idle_time_sec);
-
-      if (g_socket_reuse_policy_penalty_exponent >= 0 && num_kb >= 0) {
+      if (num_kb >= 0) {
         score = num_kb / pow(idle_time_sec,
                              g_socket_reuse_policy_penalty_exponent);
       }
@@ -459,31 +490,37 @@ bool ClientSocketPoolBaseHelper::AssignIdleSocketToGroup(
         idle_socket_it = it;
         max_score = score;
       }
+      ++it;
     }
 
-    ++it;
+    if (idle_socket_it != used_idle_sockets->end()) {
+      DecrementIdleCount();
+      *idle_socket = *idle_socket_it;
+      used_idle_sockets->erase(idle_socket_it);
+      return true;
+    }
   }
 
-  // If we haven't found an idle socket, that means there are no used idle
-  // sockets.  Pick the oldest (first) idle socket (FIFO).
-
-  if (idle_socket_it == idle_sockets->end() && !idle_sockets->empty())
-    idle_socket_it = idle_sockets->begin();
+  // Prefer the most recently used socket (LIFO), then the oldest socket that
+  // was never used (FIFO).  Disconnected sockets found on the way are
+  // deleted; the others are left for CleanupIdleSockets().
+  while (!used_idle_sockets->empty()) {
+    *idle_socket = used_idle_sockets->back();
+    used_idle_sockets->pop_back();
+    DecrementIdleCount();
+    if (idle_socket->socket->IsConnectedAndIdle())
+      return true;
+    delete idle_socket->socket;
+  }
 
-  if (idle_socket_it != idle_sockets->end()) {
+  IdleSocketList* unused_idle_sockets = group->mutable_unused_idle_sockets();
+  while (!unused_idle_sockets->empty()) {
+    *idle_socket = unused_idle_sockets->front();
+    unused_idle_sockets->pop_front();
     DecrementIdleCount();
-    base::TimeDelta idle_time =
-        base::TimeTicks::Now() - idle_socket_it->start_time;
-    IdleSocket idle_socket = *idle_socket_it;
-    idle_sockets->erase(idle_socket_it);
-    HandOutSocket(
-        idle_socket.socket,
-        idle_socket.socket->WasEverUsed(),
-        request->handle(),
-        idle_time,
-        group,
-        request->net_log());
-    return true;
+    if (idle_socket->socket->IsConnectedAndIdle())
+      return true;
+    delete idle_socket->socket;
   }
 
   return false;
@@ -549,7 +586,7 @@ int ClientSocketPoolBaseHelper::IdleSocketCountInGroup(
   GroupMap::const_iterator i = group_map_.find(group_name);
   CHECK(i != group_map_.end());
 
-  return i->second->idle_sockets().size();
+  return i->second->idle_socket_count();
 }
 
 LoadState ClientSocketPoolBaseHelper::GetLoadState(
@@ -621,12 +658,17 @@ DictionaryValue* ClientSocketPoolBaseHelper::GetInfoAsValue(
     group_dict->SetInteger("active_socket_count", group->active_socket_count());
 
     ListValue* idle_socket_list = new ListValue();
-    std::list<IdleSocket>::const_iterator idle_socket;
-    for (idle_socket = group->idle_sockets().begin();
-         idle_socket != group->idle_sockets().end();
-         idle_socket++) {
-      int source_id = idle_socket->socket->NetLog().source().id;
-      idle_socket_list->Append(Value::CreateIntegerValue(source_id));
+    const IdleSocketList* idle_socket_lists[] = {
+      &group->unused_idle_sockets(), &group->used_idle_sockets()
+    };
+    for (size_t list = 0; list < arraysize(idle_socket_lists); ++list) {
+      IdleSocketList::const_iterator idle_socket;
+      for (idle_socket = idle_socket_lists[list]->begin();
+           idle_socket != idle_socket_lists[list]->end();
+           idle_socket++) {
+        int source_id = idle_socket->socket->NetLog().source().id;
+        idle_socket_list->Append(Value::CreateIntegerValue(source_id));
+      }
     }
     group_dict->Set("idle_sockets", idle_socket_list);
 
@@ -672,18 +714,19 @@ void ClientSocketPoolBaseHelper::CleanupIdleSockets(bool force) {
   while (i != group_map_.end()) {
     Group* group = i->second;
 
-    std::list<IdleSocket>::iterator j = group->mutable_idle_sockets()->begin();
-    while (j != group->idle_sockets().end()) {
-      base::TimeDelta timeout =
-          j->socket->WasEverUsed() ?
-          used_idle_socket_timeout_ : unused_idle_socket_timeout_;
-      if (force || j->ShouldCleanup(now, timeout)) {
-        delete j->socket;
-        j = group->mutable_idle_sockets()->erase(j);
-        DecrementIdleCount();
-      } else {
-        ++j;
-      }
+    CleanupIdleSocketList(group->mutable_used_idle_sockets(), now,
+                          used_idle_socket_timeout_, force);
+    int timed_out_unused = CleanupIdleSocketList(
+        group->mutable_unused_idle_sockets(), now,
+        unused_idle_socket_timeout_, force);
+
+    // Sockets that were warmed up but timed out before anyone needed them
+    // mean the group is warmed up to more sockets than it needs.
+    if (timed_out_unused > 0) {
+      WarmSocketTargetMap::iterator target =
+          warm_socket_targets_.Peek(i->first);
+      if (target != warm_socket_targets_.end())
+        target->second = std::max(0, target->second - timed_out_unused);
     }
 
     // Delete group if no longer needed.
@@ -695,6 +738,27 @@ void ClientSocketPoolBaseHelper::CleanupIdleSockets(bool force) {
   }
 }
 
+int ClientSocketPoolBaseHelper::CleanupIdleSocketList(
+    IdleSocketList* idle_sockets,
+    base::TimeTicks now,
+    base::TimeDelta timeout,
+    bool force) {
+  int timed_out_unused = 0;
+  IdleSocketList::iterator j = idle_sockets->begin();
+  while (j != idle_sockets->end()) {
+    if (force || j->ShouldCleanup(now, timeout)) {
+      if (!force && !j->socket->WasEverUsed() && j->socket->IsConnected())
+        timed_out_unused++;
+      delete j->socket;
+      j = idle_sockets->erase(j);
+      DecrementIdleCount();
+    } else {
+      ++j;
+    }
+  }
+  return timed_out_unused;
+}
+
 ClientSocketPoolBaseHelper::Group* ClientSocketPoolBaseHelper::GetOrCreateGroup(
     const std::string& group_name) {
   GroupMap::iterator it = group_map_.find(group_name);
@@ -733,6 +797,64 @@ void ClientSocketPoolBaseHelper::EnableConnectBackupJobs() {
   connect_backup_jobs_enabled_ = g_connect_backup_jobs_enabled;
 }
 
+// static
+bool ClientSocketPoolBaseHelper::warm_sockets_enabled() {
+  return g_warm_sockets_enabled;
+}
+
+// static
+bool ClientSocketPoolBaseHelper::set_warm_sockets_enabled(bool enabled) {
+  bool old_value = g_warm_sockets_enabled;
+  g_warm_sockets_enabled = enabled;
+  return old_value;
+}
+
+void ClientSocketPoolBaseHelper::EnableWarmSockets() {
+  warm_sockets_enabled_ = g_warm_sockets_enabled;
+}
+
+int ClientSocketPoolBaseHelper::WarmSocketTarget(
+    const std::string& group_name) {
+  WarmSocketTargetMap::iterator it = warm_socket_targets_.Peek(group_name);
+  return it == warm_socket_targets_.end() ? 0 : it->second;
+}
+
+void ClientSocketPoolBaseHelper::UpdateWarmSocketTarget(
+    const std::string& group_name, const Group* group) {
+  // Requests that are waiting count too: they are sockets the group needs.
+  int in_use = std::min(
+      group->active_socket_count() +
+          static_cast<int>(group->pending_requests().size()),
+      max_sockets_per_group_);
+  WarmSocketTargetMap::iterator it = warm_socket_targets_.Get(group_name);
+  if (it == warm_socket_targets_.end())
+    warm_socket_targets_.Put(group_name, in_use);
+  else
+    it->second = std::max(it->second, in_use);
+}
+
+void ClientSocketPoolBaseHelper::WarmUpGroup(const std::string& group_name,
+                                             const Request& request,
+                                             Group* group) {
+  const int target = WarmSocketTarget(group_name);
+  while (group->NumActiveSocketSlots() < target &&
+         group->HasAvailableSocketSlot(max_sockets_per_group_) &&
+         !ReachedMaxSocketsLimit()) {
+    ConnectJob* job =
+        connect_job_factory_->NewConnectJob(group_name, request, this);
+    job->Initialize(true /* is_preconnect */);
+    int rv = job->Connect();
+    connecting_socket_count_++;
+    group->AddJob(job);
+    if (rv != ERR_IO_PENDING) {
+      // This may hand the socket to a pending request, which may be
+      // |request|, and may delete |group|.
+      OnConnectJobComplete(rv, job);
+      return;
+    }
+  }
+}
+
 void ClientSocketPoolBaseHelper::IncrementIdleCount() {
   if (++idle_socket_count_ == 1 && use_cleanup_timer_)
     StartIdleSocketTimer();
@@ -1015,7 +1137,10 @@ void ClientSocketPoolBaseHelper::AddIdleSocket(
   idle_socket.socket = socket;
   idle_socket.start_time = base::TimeTicks::Now();
 
-  group->mutable_idle_sockets()->push_back(idle_socket);
+  if (socket->WasEverUsed())
+    group->mutable_used_idle_sockets()->push_back(idle_socket);
+  else
+    group->mutable_unused_idle_sockets()->push_back(idle_socket);
   IncrementIdleCount();
 }
 
@@ -1088,7 +1213,11 @@ bool ClientSocketPoolBaseHelper::CloseOneIdleSocketExceptInGroup(
     Group* group = i->second;
     if (exception_group == group)
       continue;
-    std::list<IdleSocket>* idle_sockets = group->mutable_idle_sockets();
+    // Close the oldest socket that was never used, or else the least
+    // recently used one.
+    IdleSocketList* idle_sockets = group->mutable_unused_idle_sockets();
+    if (idle_sockets->empty())
+      idle_sockets = group->mutable_used_idle_sockets();
 
     if (!idle_sockets->empty()) {
       delete idle_sockets->front().socket;
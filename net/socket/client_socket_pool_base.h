@@ -31,6 +31,7 @@
 #include <vector>
 
 #include "base/basictypes.h"
+#include "base/memory/mru_cache.h"
 #include "base/memory/ref_counted.h"
 #include "base/memory/scoped_ptr.h"
 #include "base/memory/weak_ptr.h"
@@ -338,6 +339,20 @@ class NET_EXPORT_PRIVATE ClientSocketPoolBaseHelper
 
   void EnableConnectBackupJobs();
 
+  // Called to enable/disable warming up sockets.  When enabled, the pool
+  // learns how many sockets each group has had in use at once, and when a
+  // request for a group that has fewer sockets than that comes in, it
+  // connects the missing ones up front, so that the requests that follow find
+  // them idle.
+  static bool warm_sockets_enabled();
+  static bool set_warm_sockets_enabled(bool enabled);
+
+  void EnableWarmSockets();
+
+  // Returns the number of sockets that |group_name| is warmed up to.  Made
+  // public for testing.
+  int WarmSocketTarget(const std::string& group_name);
+
   // ConnectJob::Delegate methods:
   virtual void OnConnectJobComplete(int result, ConnectJob* job) OVERRIDE;
 
@@ -365,6 +380,9 @@ class NET_EXPORT_PRIVATE ClientSocketPoolBaseHelper
     base::TimeTicks start_time;
   };
 
+  // Idle sockets, from the one that became idle first to the last one.
+  typedef std::list<IdleSocket> IdleSocketList;
+
   typedef std::deque<const Request* > RequestQueue;
   typedef std::map<const ClientSocketHandle*, const Request*> RequestMap;
 
@@ -377,7 +395,7 @@ class NET_EXPORT_PRIVATE ClientSocketPoolBaseHelper
     ~Group();
 
     bool IsEmpty() const {
-      return active_socket_count_ == 0 && idle_sockets_.empty() &&
+      return active_socket_count_ == 0 && idle_socket_count() == 0 &&
           jobs_.empty() && pending_requests_.empty();
     }
 
@@ -387,7 +405,7 @@ class NET_EXPORT_PRIVATE ClientSocketPoolBaseHelper
 
     int NumActiveSocketSlots() const {
       return active_socket_count_ + static_cast<int>(jobs_.size()) +
-          static_cast<int>(idle_sockets_.size());
+          idle_socket_count();
     }
 
     bool IsStalledOnPoolMaxSockets(int max_sockets_per_group) const {
@@ -420,12 +438,25 @@ class NET_EXPORT_PRIVATE ClientSocketPoolBaseHelper
     void IncrementActiveSocketCount() { active_socket_count_++; }
     void DecrementActiveSocketCount() { active_socket_count_--; }
 
+    int idle_socket_count() const {
+      return static_cast<int>(used_idle_sockets_.size() +
+                              unused_idle_sockets_.size());
+    }
+
     const std::set<ConnectJob*>& jobs() const { return jobs_; }
-    const std::list<IdleSocket>& idle_sockets() const { return idle_sockets_; }
+    const IdleSocketList& used_idle_sockets() const {
+      return used_idle_sockets_;
+    }
+    const IdleSocketList& unused_idle_sockets() const {
+      return unused_idle_sockets_;
+    }
     const RequestQueue& pending_requests() const { return pending_requests_; }
     int active_socket_count() const { return active_socket_count_; }
     RequestQueue* mutable_pending_requests() { return &pending_requests_; }
-    std::list<IdleSocket>* mutable_idle_sockets() { return &idle_sockets_; }
+    IdleSocketList* mutable_used_idle_sockets() { return &used_idle_sockets_; }
+    IdleSocketList* mutable_unused_idle_sockets() {
+      return &unused_idle_sockets_;
+    }
 
    private:
     // Called when the backup socket timer fires.
@@ -433,7 +464,11 @@ class NET_EXPORT_PRIVATE ClientSocketPoolBaseHelper
         std::string group_name,
         ClientSocketPoolBaseHelper* pool);
 
-    std::list<IdleSocket> idle_sockets_;
+    // Idle sockets are split by whether they have ever been used, so that
+    // both the most recently used one and the oldest unused one are at an end
+    // of their list.
+    IdleSocketList used_idle_sockets_;
+    IdleSocketList unused_idle_sockets_;
     std::set<ConnectJob*> jobs_;
     RequestQueue pending_requests_;
     int active_socket_count_;  // number of active sockets used by clients
@@ -443,6 +478,10 @@ class NET_EXPORT_PRIVATE ClientSocketPoolBaseHelper
 
   typedef std::map<std::string, Group*> GroupMap;
 
+  // Number of sockets each recently used group is warmed up to, keyed by
+  // group name.  Entries outlive their Group.
+  typedef base::MRUCache<std::string, int> WarmSocketTargetMap;
+
   typedef std::set<ConnectJob*> ConnectJobSet;
 
   struct CallbackResultPair {
@@ -527,6 +566,31 @@ class NET_EXPORT_PRIVATE ClientSocketPoolBaseHelper
   // Returns |true| if an idle socket is available, false otherwise.
   bool AssignIdleSocketToGroup(const Request* request, Group* group);
 
+  // Removes the idle socket of |group| that the socket reuse policy picks
+  // and returns it in |idle_socket|, deleting the disconnected sockets it
+  // comes across.  Returns false if there is no usable idle socket.
+  bool TakeIdleSocket(Group* group, IdleSocket* idle_socket);
+
+  // Deletes the idle sockets of |idle_sockets| that should be cleaned up, or
+  // all of them if |force| is true.  Returns the number of unused sockets
+  // that timed out.
+  int CleanupIdleSocketList(IdleSocketList* idle_sockets,
+                            base::TimeTicks now,
+                            base::TimeDelta timeout,
+                            bool force);
+
+  // Raises the warm socket target of |group_name| to the number of sockets
+  // |group| has in use.
+  void UpdateWarmSocketTarget(const std::string& group_name,
+                              const Group* group);
+
+  // Starts preconnect ConnectJobs, using the parameters of |request|, until
+  // |group| has as many sockets left over for new requests as its warm socket
+  // target asks for.
+  void WarmUpGroup(const std::string& group_name,
+                   const Request& request,
+                   Group* group);
+
   static void LogBoundConnectJobToRequest(
       const NetLog::Source& connect_job_source, const Request* request);
 
@@ -589,6 +653,9 @@ class NET_EXPORT_PRIVATE ClientSocketPoolBaseHelper
   // TODO(vandebo) Remove when backup jobs move to TransportClientSocketPool
   bool connect_backup_jobs_enabled_;
 
+  bool warm_sockets_enabled_;
+  WarmSocketTargetMap warm_socket_targets_;
+
   // A unique id for the pool.  It gets incremented every time we Flush() the
   // pool.  This is so that when sockets get released back to the pool, we can
   // make sure that they are discarded rather than reused.
@@ -765,6 +832,12 @@ class ClientSocketPoolBase {
 
   void EnableConnectBackupJobs() { helper_.EnableConnectBackupJobs(); }
 
+  void EnableWarmSockets() { helper_.EnableWarmSockets(); }
+
+  int WarmSocketTarget(const std::string& group_name) {
+    return helper_.WarmSocketTarget(group_name);
+  }
+
   bool CloseOneIdleSocket() { return helper_.CloseOneIdleSocket(); }
 
   bool CloseOneIdleConnectionInLayeredPool() {
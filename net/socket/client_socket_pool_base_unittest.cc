@@ -541,6 +541,12 @@ class TestClientSocketPool : public ClientSocketPool {
 
   void EnableConnectBackupJobs() { base_.EnableConnectBackupJobs(); }
 
+  void EnableWarmSockets() { base_.EnableWarmSockets(); }
+
+  int WarmSocketTarget(const std::string& group_name) {
+    return base_.WarmSocketTarget(group_name);
+  }
+
   bool CloseOneIdleConnectionInLayeredPool() {
     return base_.CloseOneIdleConnectionInLayeredPool();
   }
@@ -739,6 +745,94 @@ TEST_F(ClientSocketPoolBaseTest, AssignIdleSocketToGroup_LastAccessedSocket) {
   ReleaseAllConnections(ClientSocketPoolTest::NO_KEEP_ALIVE);
 }
 
+// Unused idle sockets are only handed out once there is no used one left,
+// oldest first.
+TEST_F(ClientSocketPoolBaseTest, AssignIdleSocketToGroup_UnusedSocketsLast) {
+  CreatePool(4, 4);
+  net::SetSocketReusePolicy(2);
+
+  pool_->RequestSockets("a", &params_, 2, BoundNetLog());
+  ASSERT_EQ(2, pool_->IdleSocketCountInGroup("a"));
+
+  EXPECT_EQ(OK, StartRequest("a", kDefaultPriority));
+  StreamSocket* first_unused = request(0)->handle()->socket();
+  EXPECT_FALSE(first_unused->WasEverUsed());
+  first_unused->Read(NULL, 1024, CompletionCallback());
+  ReleaseOneConnection(ClientSocketPoolTest::KEEP_ALIVE);
+
+  EXPECT_EQ(OK, StartRequest("a", kDefaultPriority));
+  EXPECT_EQ(first_unused, request(1)->handle()->socket());
+  EXPECT_EQ(OK, StartRequest("a", kDefaultPriority));
+  EXPECT_FALSE(request(2)->handle()->socket()->WasEverUsed());
+  EXPECT_EQ(0, pool_->IdleSocketCountInGroup("a"));
+
+  ReleaseAllConnections(ClientSocketPoolTest::NO_KEEP_ALIVE);
+}
+
+// A group that has needed several sockets at once gets them connected as soon
+// as the next request for it comes in.
+TEST_F(ClientSocketPoolBaseTest, WarmSocketsConnectLearnedNumberOfSockets) {
+  bool warm_sockets_enabled =
+      internal::ClientSocketPoolBaseHelper::set_warm_sockets_enabled(true);
+  CreatePool(4, 4);
+  pool_->EnableWarmSockets();
+  internal::ClientSocketPoolBaseHelper::set_warm_sockets_enabled(
+      warm_sockets_enabled);
+
+  EXPECT_EQ(OK, StartRequest("a", kDefaultPriority));
+  EXPECT_EQ(OK, StartRequest("a", kDefaultPriority));
+  EXPECT_EQ(OK, StartRequest("a", kDefaultPriority));
+  EXPECT_EQ(3, pool_->WarmSocketTarget("a"));
+  ReleaseAllConnections(ClientSocketPoolTest::NO_KEEP_ALIVE);
+
+  connect_job_factory_->set_job_type(TestConnectJob::kMockPendingJob);
+  EXPECT_EQ(ERR_IO_PENDING, StartRequest("a", kDefaultPriority));
+  EXPECT_EQ(3, pool_->NumConnectJobsInGroup("a"));
+  EXPECT_EQ(OK, request(3)->WaitForResult());
+  MessageLoop::current()->RunAllPending();
+  EXPECT_EQ(0, pool_->NumConnectJobsInGroup("a"));
+  EXPECT_EQ(2, pool_->IdleSocketCountInGroup("a"));
+
+  // The next requests get the warm sockets without connecting.
+  connect_job_factory_->set_job_type(TestConnectJob::kMockFailingJob);
+  EXPECT_EQ(OK, StartRequest("a", kDefaultPriority));
+  EXPECT_EQ(OK, StartRequest("a", kDefaultPriority));
+  EXPECT_EQ(0, pool_->IdleSocketCountInGroup("a"));
+  EXPECT_EQ(0, pool_->NumConnectJobsInGroup("a"));
+
+  ReleaseAllConnections(ClientSocketPoolTest::NO_KEEP_ALIVE);
+}
+
+// Warm sockets that time out before they are used lower the target.
+TEST_F(ClientSocketPoolBaseTest, WarmSocketsTimingOutLowerTarget) {
+  bool warm_sockets_enabled =
+      internal::ClientSocketPoolBaseHelper::set_warm_sockets_enabled(true);
+  CreatePoolWithIdleTimeouts(
+      4, 4,
+      base::TimeDelta(),  // Time out unused sockets immediately.
+      base::TimeDelta::FromDays(1));  // Don't time out used sockets.
+  pool_->EnableWarmSockets();
+  internal::ClientSocketPoolBaseHelper::set_warm_sockets_enabled(
+      warm_sockets_enabled);
+
+  EXPECT_EQ(OK, StartRequest("a", kDefaultPriority));
+  EXPECT_EQ(OK, StartRequest("a", kDefaultPriority));
+  EXPECT_EQ(OK, StartRequest("a", kDefaultPriority));
+  ReleaseAllConnections(ClientSocketPoolTest::NO_KEEP_ALIVE);
+
+  connect_job_factory_->set_job_type(TestConnectJob::kMockPendingJob);
+  EXPECT_EQ(ERR_IO_PENDING, StartRequest("a", kDefaultPriority));
+  EXPECT_EQ(OK, request(3)->WaitForResult());
+  MessageLoop::current()->RunAllPending();
+  EXPECT_EQ(2, pool_->IdleSocketCountInGroup("a"));
+
+  pool_->CleanupTimedOutIdleSockets();
+  EXPECT_EQ(0, pool_->IdleSocketCountInGroup("a"));
+  EXPECT_EQ(1, pool_->WarmSocketTarget("a"));
+
+  ReleaseAllConnections(ClientSocketPoolTest::NO_KEEP_ALIVE);
+}
+
 // Even though a timeout is specified, it doesn't time out on a synchronous
 // completion.
 TEST_F(ClientSocketPoolBaseTest, ConnectJob_NoTimeoutOnSynchronousCompletion) {
@@ -23,6 +23,7 @@ class SSLCertRequestInfo;
 class SSLHostInfo;
 class SSLHostInfoFactory;
 class SSLInfo;
+class SSLSessionStore;
 class TransportSecurityState;
 
 // This struct groups together several fields which are used by various
@@ -118,6 +119,11 @@ class NET_EXPORT SSLClientSocket : public SSLSocket {
   // sessions.
   static void ClearSessionCache();
 
+  // Sets the store that sessions are persisted to, so that they can be
+  // resumed after a restart.  |store| may be NULL to stop persisting.  Only
+  // supported with OpenSSL.
+  static void SetSessionStore(SSLSessionStore* store);
+
   virtual bool was_npn_negotiated() const;
 
   virtual bool set_was_npn_negotiated(bool negotiated);
@@ -477,6 +477,11 @@ void SSLClientSocket::ClearSessionCache() {
   SSL_ClearSessionCache();
 }
 
+// static
+void SSLClientSocket::SetSessionStore(SSLSessionStore* store) {
+  // NSS keeps its own session cache, which is not persisted.
+}
+
 void SSLClientSocketNSS::GetSSLInfo(SSLInfo* ssl_info) {
   EnterFunction("");
   ssl_info->Reset();
@@ -24,6 +24,7 @@
 #include "net/base/ssl_info.h"
 #include "net/base/x509_certificate_net_log_param.h"
 #include "net/socket/ssl_error_params.h"
+#include "net/socket/ssl_session_store.h"
 
 namespace net {
 
@@ -206,30 +207,22 @@ class SSLSessionCache {
  public:
   SSLSessionCache() {}
 
+  // |session| is also saved to the store, if there is one and |persist| is
+  // true.
   void OnSessionAdded(const HostPortPair& host_and_port,
                       const std::string& shard,
+                      bool persist,
                       SSL_SESSION* session) {
     // Declare the session cleaner-upper before the lock, so any call into
     // OpenSSL to free the session will happen after the lock is released.
     crypto::ScopedOpenSSL<SSL_SESSION, SSL_SESSION_free> session_to_free;
     base::AutoLock lock(lock_);
 
-    DCHECK_EQ(0U, session_map_.count(session));
     const std::string cache_key = GetCacheKey(host_and_port, shard);
+    session_to_free.reset(AddSession(cache_key, session));
 
-    std::pair<HostPortMap::iterator, bool> res =
-        host_port_map_.insert(std::make_pair(cache_key, session));
-    if (!res.second) {  // Already exists: replace old entry.
-      session_to_free.reset(res.first->second);
-      session_map_.erase(session_to_free.get());
-      res.first->second = session;
-    }
-    DVLOG(2) << "Adding session " << session << " => "
-             << cache_key << ", new entry = " << res.second;
-    DCHECK(host_port_map_[cache_key] == session);
-    session_map_[session] = res.first;
-    DCHECK_EQ(host_port_map_.size(), session_map_.size());
-    DCHECK_LE(host_port_map_.size(), kSessionCacheMaxEntires);
+    if (store_ && persist)
+      StoreSession(cache_key, session);
   }
 
   void OnSessionRemoved(SSL_SESSION* session) {
@@ -250,14 +243,72 @@ class SSLSessionCache {
   }
 
   // Looks up the host:port in the cache, and if a session is found it is added
-  // to |ssl|, returning true on success.
+  // to |ssl|, returning true on success.  The store is only searched if
+  // |persist| is true.
   bool SetSSLSession(SSL* ssl, const HostPortPair& host_and_port,
-                     const std::string& shard) {
-    base::AutoLock lock(lock_);
+                     const std::string& shard, bool persist) {
     const std::string cache_key = GetCacheKey(host_and_port, shard);
-    HostPortMap::iterator it = host_port_map_.find(cache_key);
-    if (it == host_port_map_.end())
-      return false;
+    {
+      base::AutoLock lock(lock_);
+      HostPortMap::iterator it = host_port_map_.find(cache_key);
+      if (it != host_port_map_.end())
+        return SetCachedSSLSession(ssl, cache_key, it);
+    }
+    return persist && SetStoredSSLSession(ssl, cache_key);
+  }
+
+  // Flush removes all entries from the cache. This is called when a client
+  // certificate is added.
+  void Flush() {
+    for (HostPortMap::iterator i = host_port_map_.begin();
+         i != host_port_map_.end(); i++) {
+      SSL_SESSION_free(i->second);
+    }
+    host_port_map_.clear();
+    session_map_.clear();
+    if (store_)
+      store_->Clear();
+  }
+
+  // Sets the store that sessions are saved to, and looked up in when they are
+  // not in memory, e.g. after a restart.  |store| may be NULL.
+  void SetStore(SSLSessionStore* store) {
+    base::AutoLock lock(lock_);
+    store_ = store;
+  }
+
+ private:
+  typedef std::map<std::string, SSL_SESSION*> HostPortMap;
+  typedef std::map<SSL_SESSION*, HostPortMap::iterator> SessionMap;
+
+  // Makes |session| the entry for |cache_key|, taking over the caller's
+  // reference to it.  Returns the session it replaces, whose reference the
+  // caller must free once |lock_| is released, or NULL.
+  SSL_SESSION* AddSession(const std::string& cache_key, SSL_SESSION* session) {
+    lock_.AssertAcquired();
+    DCHECK_EQ(0U, session_map_.count(session));
+
+    SSL_SESSION* replaced = NULL;
+    std::pair<HostPortMap::iterator, bool> res =
+        host_port_map_.insert(std::make_pair(cache_key, session));
+    if (!res.second) {  // Already exists: replace old entry.
+      replaced = res.first->second;
+      session_map_.erase(replaced);
+      res.first->second = session;
+    }
+    DVLOG(2) << "Adding session " << session << " => "
+             << cache_key << ", new entry = " << res.second;
+    DCHECK(host_port_map_[cache_key] == session);
+    session_map_[session] = res.first;
+    DCHECK_EQ(host_port_map_.size(), session_map_.size());
+    DCHECK_LE(host_port_map_.size(), kSessionCacheMaxEntires);
+    return replaced;
+  }
+
+  // Adds the session of the cache entry |it| to |ssl|.
+  bool SetCachedSSLSession(SSL* ssl, const std::string& cache_key,
+                           HostPortMap::iterator it) {
+    lock_.AssertAcquired();
     DVLOG(2) << "Lookup session: " << it->second << " => " << cache_key;
     SSL_SESSION* session = it->second;
     DCHECK(session);
@@ -270,18 +321,58 @@ class SSLSessionCache {
     return SSL_set_session(ssl, session) == 1;
   }
 
-  // Flush removes all entries from the cache. This is called when a client
-  // certificate is added.
-  void Flush() {
-    for (HostPortMap::iterator i = host_port_map_.begin();
-         i != host_port_map_.end(); i++) {
-      SSL_SESSION_free(i->second);
+  // Saves |session| to |store_|, to expire with the session itself.
+  void StoreSession(const std::string& cache_key, SSL_SESSION* session) {
+    lock_.AssertAcquired();
+    int length = i2d_SSL_SESSION(session, NULL);
+    if (length <= 0)
+      return;
+    std::string der(length, '\0');
+    unsigned char* p = reinterpret_cast<unsigned char*>(&der[0]);
+    if (i2d_SSL_SESSION(session, &p) != length)
+      return;
+    base::Time expiration = base::Time::FromTimeT(
+        SSL_SESSION_get_time(session) + SSL_SESSION_get_timeout(session));
+    store_->Add(cache_key, der, expiration);
+  }
+
+  // Looks up |cache_key| in |store_|, and if a session is found it is
+  // deserialized and added to |ssl|, returning true on success.  The session
+  // is then cached as if it had just been negotiated, so later connections
+  // reuse it from memory.  Must be called without |lock_| held, since adding
+  // the session to OpenSSL's cache may evict others through
+  // OnSessionRemoved().
+  bool SetStoredSSLSession(SSL* ssl, const std::string& cache_key) {
+    std::string der;
+    {
+      base::AutoLock lock(lock_);
+      if (!store_ || !store_->Lookup(cache_key, &der))
+        return false;
     }
-    host_port_map_.clear();
-    session_map_.clear();
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(der.data());
+    SSL_SESSION* session = d2i_SSL_SESSION(NULL, &p, der.size());
+    if (!session)
+      return false;
+    if (SSL_set_session(ssl, session) != 1) {
+      SSL_SESSION_free(session);
+      return false;
+    }
+    DVLOG(2) << "Loaded stored session " << session << " => " << cache_key;
+
+    // OpenSSL's cache takes its own reference.  Being in it means that
+    // OnSessionRemoved() is called if the session later fails or is evicted,
+    // just as for the sessions OnSessionAdded() is told about.
+    SSL_CTX_add_session(SSL_get_SSL_CTX(ssl), session);
+
+    // Declare the session cleaner-upper before the lock, so any call into
+    // OpenSSL to free the session will happen after the lock is released.
+    crypto::ScopedOpenSSL<SSL_SESSION, SSL_SESSION_free> session_to_free;
+    base::AutoLock lock(lock_);
+    // The reference from d2i_SSL_SESSION() now belongs to the cache.
+    session_to_free.reset(AddSession(cache_key, session));
+    return true;
   }
 
- private:
   static std::string GetCacheKey(const HostPortPair& host_and_port,
                                  const std::string& shard) {
     return host_and_port.ToString() + "/" + shard;
@@ -289,12 +380,13 @@ class SSLSessionCache {
 
   // A pair of maps to allow bi-directional lookups between host:port and an
   // associated session.
-  typedef std::map<std::string, SSL_SESSION*> HostPortMap;
-  typedef std::map<SSL_SESSION*, HostPortMap::iterator> SessionMap;
   HostPortMap host_port_map_;
   SessionMap session_map_;
 
-  // Protects access to both the above maps.
+  // Persists sessions across restarts.  May be NULL.
+  scoped_refptr<SSLSessionStore> store_;
+
+  // Protects access to both the above maps and |store_|.
   base::Lock lock_;
 
   DISALLOW_COPY_AND_ASSIGN(SSLSessionCache);
@@ -350,6 +442,7 @@ class SSLContext {
     SSLClientSocketOpenSSL* socket = GetClientSocketFromSSL(ssl);
     session_cache_.OnSessionAdded(socket->host_and_port(),
                                   socket->ssl_session_cache_shard(),
+                                  socket->persist_session(),
                                   session);
     return 1;  // 1 => We took ownership of |session|.
   }
@@ -409,6 +502,12 @@ void SSLClientSocket::ClearSessionCache() {
   context->session_cache()->Flush();
 }
 
+// static
+void SSLClientSocket::SetSessionStore(SSLSessionStore* store) {
+  SSLContext* context = SSLContext::GetInstance();
+  context->session_cache()->SetStore(store);
+}
+
 SSLClientSocketOpenSSL::SSLClientSocketOpenSSL(
     ClientSocketHandle* transport_socket,
     const HostPortPair& host_and_port,
@@ -451,7 +550,8 @@ bool SSLClientSocketOpenSSL::Init() {
 
   trying_cached_session_ =
       context->session_cache()->SetSSLSession(ssl_, host_and_port_,
-                                              ssl_session_cache_shard_);
+                                              ssl_session_cache_shard_,
+                                              ssl_config_.persist_session);
 
   BIO* ssl_bio = NULL;
   // 0 => use default buffer sizes.
@@ -46,6 +46,7 @@ class SSLClientSocketOpenSSL : public SSLClientSocket {
   const std::string& ssl_session_cache_shard() const {
     return ssl_session_cache_shard_;
   }
+  bool persist_session() const { return ssl_config_.persist_session; }
 
   // Callback from the SSL layer that indicates the remote server is requesting
   // a certificate for this client.
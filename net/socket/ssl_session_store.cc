@@ -0,0 +1,280 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/socket/ssl_session_store.h"
+
+#include "base/bind.h"
+#include "base/file_util.h"
+#include "base/location.h"
+#include "base/logging.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/pickle.h"
+#include "base/rand_util.h"
+#include "base/sequenced_task_runner.h"
+#include "crypto/encryptor.h"
+#include "crypto/hmac.h"
+#include "crypto/symmetric_key.h"
+
+namespace net {
+
+namespace {
+
+// Bump when the layout of the pickle changes; older files are then ignored.
+const int kVersion = 1;
+
+const size_t kAesKeySize = 32;
+const size_t kIvSize = 16;
+const size_t kMacSize = 32;
+
+// Delay before writing changes, so that a burst of handshakes is written
+// once.
+const int kCommitIntervalSeconds = 10;
+
+}  // namespace
+
+// static
+const size_t SSLSessionStore::kKeySize = 64;
+// static
+const size_t SSLSessionStore::kDefaultMaxEntries = 10000;
+
+SSLSessionStore::SSLSessionStore(const FilePath& path,
+                                 const std::string& key,
+                                 size_t max_entries,
+                                 base::SequencedTaskRunner* file_task_runner)
+    : path_(path),
+      encryption_key_(key.substr(0, kAesKeySize)),
+      mac_key_(key.substr(kAesKeySize)),
+      file_task_runner_(file_task_runner),
+      entries_(max_entries),
+      load_started_(false),
+      save_pending_(false),
+      clear_count_(0) {
+  DCHECK_EQ(kKeySize, key.size());
+}
+
+SSLSessionStore::~SSLSessionStore() {
+}
+
+bool SSLSessionStore::Lookup(const std::string& cache_key,
+                             std::string* session) {
+  base::AutoLock lock(lock_);
+  StartLoad();
+
+  EntryMap::iterator it = entries_.Get(cache_key);
+  if (it == entries_.end())
+    return false;
+  if (it->second.expiration <= base::Time::Now()) {
+    entries_.Erase(it);
+    return false;
+  }
+  *session = it->second.session;
+  return true;
+}
+
+void SSLSessionStore::Add(const std::string& cache_key,
+                          const std::string& session,
+                          base::Time expiration) {
+  base::AutoLock lock(lock_);
+  // Loading first makes sure that the next save does not overwrite the
+  // sessions on disk before they have been read.
+  StartLoad();
+
+  Entry entry;
+  entry.session = session;
+  entry.expiration = expiration;
+  entries_.Put(cache_key, entry);
+  ScheduleSave();
+}
+
+void SSLSessionStore::Clear() {
+  base::AutoLock lock(lock_);
+  entries_.Clear();
+  clear_count_++;
+  // There is nothing left to load.
+  load_started_ = true;
+  ScheduleSave();
+}
+
+void SSLSessionStore::Flush() {
+  base::AutoLock lock(lock_);
+  if (!save_pending_)
+    return;
+  file_task_runner_->PostTask(
+      FROM_HERE, base::Bind(&SSLSessionStore::SaveOnFileThread, this));
+}
+
+size_t SSLSessionStore::size() const {
+  base::AutoLock lock(lock_);
+  return entries_.size();
+}
+
+void SSLSessionStore::StartLoad() {
+  lock_.AssertAcquired();
+  if (load_started_)
+    return;
+  load_started_ = true;
+  file_task_runner_->PostTask(
+      FROM_HERE,
+      base::Bind(&SSLSessionStore::LoadOnFileThread, this, clear_count_));
+}
+
+void SSLSessionStore::ScheduleSave() {
+  lock_.AssertAcquired();
+  if (save_pending_)
+    return;
+  save_pending_ = true;
+  file_task_runner_->PostDelayedTask(
+      FROM_HERE,
+      base::Bind(&SSLSessionStore::SaveOnFileThread, this),
+      base::TimeDelta::FromSeconds(kCommitIntervalSeconds));
+}
+
+void SSLSessionStore::LoadOnFileThread(int clear_count) {
+  DCHECK(file_task_runner_->RunsTasksOnCurrentThread());
+  std::string data;
+  EntryList loaded;
+  if (!file_util::ReadFileToString(path_, &data) ||
+      !Deserialize(data, &loaded)) {
+    return;
+  }
+
+  base::AutoLock lock(lock_);
+  if (clear_count != clear_count_)
+    return;
+
+  // Sessions added while the file was being read are more recent than the
+  // loaded ones, so they go last.
+  EntryList added;
+  for (EntryMap::reverse_iterator it = entries_.rbegin();
+       it != entries_.rend(); ++it) {
+    added.push_back(*it);
+  }
+  entries_.Clear();
+  for (size_t i = 0; i < loaded.size(); ++i)
+    entries_.Put(loaded[i].first, loaded[i].second);
+  for (size_t i = 0; i < added.size(); ++i)
+    entries_.Put(added[i].first, added[i].second);
+}
+
+void SSLSessionStore::SaveOnFileThread() {
+  DCHECK(file_task_runner_->RunsTasksOnCurrentThread());
+  EntryList entries;
+  {
+    base::AutoLock lock(lock_);
+    save_pending_ = false;
+    entries.reserve(entries_.size());
+    for (EntryMap::reverse_iterator it = entries_.rbegin();
+         it != entries_.rend(); ++it) {
+      entries.push_back(*it);
+    }
+  }
+
+  std::string data;
+  if (!Serialize(entries, &data))
+    return;
+
+  // Write to a temporary file first, so that a crash never leaves a
+  // truncated file behind.
+  FilePath temp_path = path_.AddExtension(FILE_PATH_LITERAL("tmp"));
+  int size = static_cast<int>(data.size());
+  if (file_util::WriteFile(temp_path, data.data(), size) != size ||
+      !file_util::Move(temp_path, path_)) {
+    LOG(WARNING) << "Failed to write " << path_.value();
+    file_util::Delete(temp_path, false);
+  }
+}
+
+bool SSLSessionStore::Serialize(const EntryList& entries,
+                                std::string* data) const {
+  base::Time now = base::Time::Now();
+  Pickle pickle;
+  pickle.WriteInt(kVersion);
+  int count = 0;
+  for (size_t i = 0; i < entries.size(); ++i)
+    count += entries[i].second.expiration > now;
+  pickle.WriteInt(count);
+  for (size_t i = 0; i < entries.size(); ++i) {
+    const Entry& entry = entries[i].second;
+    if (entry.expiration <= now)
+      continue;
+    pickle.WriteString(entries[i].first);
+    pickle.WriteString(entry.session);
+    pickle.WriteInt64(entry.expiration.ToInternalValue());
+  }
+
+  scoped_ptr<crypto::SymmetricKey> key(
+      crypto::SymmetricKey::Import(crypto::SymmetricKey::AES,
+                                   encryption_key_));
+  std::string iv = base::RandBytesAsString(kIvSize);
+  crypto::Encryptor encryptor;
+  std::string ciphertext;
+  if (!key.get() || !encryptor.Init(key.get(), crypto::Encryptor::CBC, iv) ||
+      !encryptor.Encrypt(base::StringPiece(
+                             static_cast<const char*>(pickle.data()),
+                             pickle.size()),
+                         &ciphertext)) {
+    return false;
+  }
+
+  // Encrypt-then-MAC, covering the IV too.
+  std::string signed_data = iv + ciphertext;
+  crypto::HMAC hmac(crypto::HMAC::SHA256);
+  unsigned char mac[kMacSize];
+  if (!hmac.Init(mac_key_) || !hmac.Sign(signed_data, mac, kMacSize))
+    return false;
+
+  data->swap(signed_data);
+  data->append(reinterpret_cast<const char*>(mac), kMacSize);
+  return true;
+}
+
+bool SSLSessionStore::Deserialize(const std::string& data,
+                                  EntryList* entries) const {
+  if (data.size() <= kIvSize + kMacSize)
+    return false;
+  base::StringPiece signed_data(data.data(), data.size() - kMacSize);
+  base::StringPiece mac(data.data() + signed_data.size(), kMacSize);
+  crypto::HMAC hmac(crypto::HMAC::SHA256);
+  if (!hmac.Init(mac_key_) || !hmac.Verify(signed_data, mac))
+    return false;
+
+  scoped_ptr<crypto::SymmetricKey> key(
+      crypto::SymmetricKey::Import(crypto::SymmetricKey::AES,
+                                   encryption_key_));
+  crypto::Encryptor encryptor;
+  std::string plaintext;
+  if (!key.get() ||
+      !encryptor.Init(key.get(), crypto::Encryptor::CBC,
+                      signed_data.substr(0, kIvSize)) ||
+      !encryptor.Decrypt(signed_data.substr(kIvSize), &plaintext)) {
+    return false;
+  }
+
+  Pickle pickle(plaintext.data(), plaintext.size());
+  PickleIterator iter(pickle);
+  int version;
+  int count;
+  if (!pickle.ReadInt(&iter, &version) || version != kVersion ||
+      !pickle.ReadInt(&iter, &count) || count < 0) {
+    return false;
+  }
+
+  base::Time now = base::Time::Now();
+  for (int i = 0; i < count; ++i) {
+    std::string cache_key;
+    Entry entry;
+    int64 expiration;
+    if (!pickle.ReadString(&iter, &cache_key) ||
+        !pickle.ReadString(&iter, &entry.session) ||
+        !pickle.ReadInt64(&iter, &expiration)) {
+      return false;
+    }
+    entry.expiration = base::Time::FromInternalValue(expiration);
+    if (entry.expiration > now)
+      entries->push_back(std::make_pair(cache_key, entry));
+  }
+  return true;
+}
+
+}  // namespace net
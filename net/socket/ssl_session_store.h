@@ -0,0 +1,133 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_SOCKET_SSL_SESSION_STORE_H_
+#define NET_SOCKET_SSL_SESSION_STORE_H_
+#pragma once
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/file_path.h"
+#include "base/memory/mru_cache.h"
+#include "base/memory/ref_counted.h"
+#include "base/synchronization/lock.h"
+#include "base/time.h"
+#include "net/base/net_export.h"
+
+namespace base {
+class SequencedTaskRunner;
+}
+
+namespace net {
+
+// SSLSessionStore keeps serialized TLS sessions, keyed by the session cache
+// key of the socket that negotiated them, and saves them to disk so that
+// abbreviated handshakes keep working across restarts.  The file is shared by
+// every profile, but not meant to be shared between processes: each save
+// replaces it with the sessions in memory, so if two processes use the same
+// path, the last one to save wins.
+//
+// The file is read in the background the first time a session is looked up.
+// Lookups that happen before it has been read simply miss.  Changes are
+// written back in batches.  The file is encrypted with AES-CBC and
+// authenticated with HMAC-SHA256, using the key given to the constructor.  It
+// is only as private as that key: anyone who can read the key can read the
+// sessions.
+//
+// All methods are thread safe.
+class NET_EXPORT SSLSessionStore
+    : public base::RefCountedThreadSafe<SSLSessionStore> {
+ public:
+  // Size of the key passed to the constructor: an AES-256 key followed by an
+  // HMAC-SHA256 key.
+  static const size_t kKeySize;
+
+  // Default number of sessions kept, least recently used first out.
+  static const size_t kDefaultMaxEntries;
+
+  // Reads and writes |path| on |file_task_runner|.  |key| must be kKeySize
+  // bytes long.
+  SSLSessionStore(const FilePath& path,
+                  const std::string& key,
+                  size_t max_entries,
+                  base::SequencedTaskRunner* file_task_runner);
+
+  // Returns the serialized session stored for |cache_key| in |session| and
+  // returns true, if there is one that has not expired.
+  bool Lookup(const std::string& cache_key, std::string* session);
+
+  // Stores the serialized |session| for |cache_key|, replacing any previous
+  // one.  It is dropped after |expiration|.
+  void Add(const std::string& cache_key,
+           const std::string& session,
+           base::Time expiration);
+
+  // Removes every session, from memory and from disk.
+  void Clear();
+
+  // Writes any pending change to disk now.
+  void Flush();
+
+  // Number of sessions in memory.
+  size_t size() const;
+
+ private:
+  friend class base::RefCountedThreadSafe<SSLSessionStore>;
+
+  struct Entry {
+    std::string session;
+    base::Time expiration;
+  };
+
+  typedef base::MRUCache<std::string, Entry> EntryMap;
+  // Sessions ordered from least to most recently used.
+  typedef std::vector<std::pair<std::string, Entry> > EntryList;
+
+  ~SSLSessionStore();
+
+  // Posts LoadOnFileThread() if it has not been posted yet.  Must be called
+  // with |lock_| held.
+  void StartLoad();
+
+  // Posts SaveOnFileThread() if no save is pending.  Must be called with
+  // |lock_| held.
+  void ScheduleSave();
+
+  // Reads |path_| and merges its sessions with the ones added since, unless
+  // the store has been cleared since |clear_count| was read.
+  void LoadOnFileThread(int clear_count);
+
+  // Replaces the contents of |path_| with the sessions in memory.
+  void SaveOnFileThread();
+
+  // Serialize() produces the encrypted contents of the file for |entries|.
+  // Deserialize() parses them back into |entries|, skipping expired sessions.
+  // It returns false if |data| is corrupt or was written with another key.
+  bool Serialize(const EntryList& entries, std::string* data) const;
+  bool Deserialize(const std::string& data, EntryList* entries) const;
+
+  const FilePath path_;
+  const std::string encryption_key_;
+  const std::string mac_key_;
+  scoped_refptr<base::SequencedTaskRunner> file_task_runner_;
+
+  // Protects everything below.
+  mutable base::Lock lock_;
+
+  EntryMap entries_;
+  bool load_started_;
+  bool save_pending_;
+  // Number of calls to Clear(), so that a load started before a Clear()
+  // does not bring the cleared sessions back.
+  int clear_count_;
+
+  DISALLOW_COPY_AND_ASSIGN(SSLSessionStore);
+};
+
+}  // namespace net
+
+#endif  // NET_SOCKET_SSL_SESSION_STORE_H_
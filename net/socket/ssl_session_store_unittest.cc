@@ -0,0 +1,164 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/socket/ssl_session_store.h"
+
+#include <string>
+
+#include "base/file_util.h"
+#include "base/message_loop.h"
+#include "base/message_loop_proxy.h"
+#include "base/scoped_temp_dir.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace net {
+
+namespace {
+
+const char kKey1[] = "www.example.com:443/";
+const char kKey2[] = "mail.example.com:443/";
+const char kKey3[] = "news.example.com:443/";
+
+base::Time Expiration() {
+  return base::Time::Now() + base::TimeDelta::FromHours(1);
+}
+
+}  // namespace
+
+class SSLSessionStoreTest : public testing::Test {
+ protected:
+  virtual void SetUp() OVERRIDE {
+    ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+    path_ = temp_dir_.path().AppendASCII("TLS Sessions");
+  }
+
+  SSLSessionStore* CreateStore(char key_byte, size_t max_entries) {
+    return new SSLSessionStore(
+        path_, std::string(SSLSessionStore::kKeySize, key_byte), max_entries,
+        base::MessageLoopProxy::current());
+  }
+
+  MessageLoop message_loop_;
+  ScopedTempDir temp_dir_;
+  FilePath path_;
+};
+
+TEST_F(SSLSessionStoreTest, AddAndLookup) {
+  scoped_refptr<SSLSessionStore> store(CreateStore('k', 10));
+  std::string session;
+  EXPECT_FALSE(store->Lookup(kKey1, &session));
+
+  store->Add(kKey1, "session1", Expiration());
+  EXPECT_TRUE(store->Lookup(kKey1, &session));
+  EXPECT_EQ("session1", session);
+
+  store->Add(kKey1, "session2", Expiration());
+  EXPECT_TRUE(store->Lookup(kKey1, &session));
+  EXPECT_EQ("session2", session);
+  EXPECT_EQ(1U, store->size());
+
+  // Expired sessions are dropped.
+  store->Add(kKey2, "expired",
+             base::Time::Now() - base::TimeDelta::FromSeconds(1));
+  EXPECT_FALSE(store->Lookup(kKey2, &session));
+  EXPECT_EQ(1U, store->size());
+}
+
+TEST_F(SSLSessionStoreTest, EvictsLeastRecentlyUsed) {
+  scoped_refptr<SSLSessionStore> store(CreateStore('k', 2));
+  std::string session;
+  store->Add(kKey1, "session1", Expiration());
+  store->Add(kKey2, "session2", Expiration());
+  // Using |kKey1| makes |kKey2| the least recently used.
+  EXPECT_TRUE(store->Lookup(kKey1, &session));
+  store->Add(kKey3, "session3", Expiration());
+
+  EXPECT_EQ(2U, store->size());
+  EXPECT_TRUE(store->Lookup(kKey1, &session));
+  EXPECT_FALSE(store->Lookup(kKey2, &session));
+  EXPECT_TRUE(store->Lookup(kKey3, &session));
+}
+
+TEST_F(SSLSessionStoreTest, PersistsAcrossInstances) {
+  scoped_refptr<SSLSessionStore> store(CreateStore('k', 10));
+  store->Add(kKey1, "session1", Expiration());
+  store->Add(kKey2, "session2", Expiration());
+  store->Flush();
+  MessageLoop::current()->RunAllPending();
+  store = NULL;
+
+  std::string contents;
+  ASSERT_TRUE(file_util::ReadFileToString(path_, &contents));
+  EXPECT_EQ(std::string::npos, contents.find("session1"));
+
+  // The file is only read once a session is looked up.
+  store = CreateStore('k', 10);
+  std::string session;
+  EXPECT_FALSE(store->Lookup(kKey1, &session));
+  // A session added before the file is read takes precedence.
+  store->Add(kKey2, "session2b", Expiration());
+  MessageLoop::current()->RunAllPending();
+
+  EXPECT_EQ(2U, store->size());
+  EXPECT_TRUE(store->Lookup(kKey1, &session));
+  EXPECT_EQ("session1", session);
+  EXPECT_TRUE(store->Lookup(kKey2, &session));
+  EXPECT_EQ("session2b", session);
+}
+
+TEST_F(SSLSessionStoreTest, IgnoresFileWithOtherKey) {
+  scoped_refptr<SSLSessionStore> store(CreateStore('k', 10));
+  store->Add(kKey1, "session1", Expiration());
+  store->Flush();
+  MessageLoop::current()->RunAllPending();
+
+  store = CreateStore('x', 10);
+  std::string session;
+  EXPECT_FALSE(store->Lookup(kKey1, &session));
+  MessageLoop::current()->RunAllPending();
+  EXPECT_FALSE(store->Lookup(kKey1, &session));
+  EXPECT_EQ(0U, store->size());
+}
+
+TEST_F(SSLSessionStoreTest, IgnoresCorruptFile) {
+  scoped_refptr<SSLSessionStore> store(CreateStore('k', 10));
+  store->Add(kKey1, "session1", Expiration());
+  store->Flush();
+  MessageLoop::current()->RunAllPending();
+
+  std::string contents;
+  ASSERT_TRUE(file_util::ReadFileToString(path_, &contents));
+  contents[contents.size() / 2] ^= 1;
+  ASSERT_EQ(static_cast<int>(contents.size()),
+            file_util::WriteFile(path_, contents.data(), contents.size()));
+
+  store = CreateStore('k', 10);
+  std::string session;
+  EXPECT_FALSE(store->Lookup(kKey1, &session));
+  MessageLoop::current()->RunAllPending();
+  EXPECT_FALSE(store->Lookup(kKey1, &session));
+}
+
+TEST_F(SSLSessionStoreTest, Clear) {
+  scoped_refptr<SSLSessionStore> store(CreateStore('k', 10));
+  store->Add(kKey1, "session1", Expiration());
+  store->Flush();
+  MessageLoop::current()->RunAllPending();
+
+  store = CreateStore('k', 10);
+  std::string session;
+  // Clearing before the file has been read drops its sessions too.
+  EXPECT_FALSE(store->Lookup(kKey1, &session));
+  store->Clear();
+  store->Flush();
+  MessageLoop::current()->RunAllPending();
+  EXPECT_FALSE(store->Lookup(kKey1, &session));
+
+  store = CreateStore('k', 10);
+  EXPECT_FALSE(store->Lookup(kKey1, &session));
+  MessageLoop::current()->RunAllPending();
+  EXPECT_FALSE(store->Lookup(kKey1, &session));
+}
+
+}  // namespace net
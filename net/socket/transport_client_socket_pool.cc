@@ -385,6 +385,7 @@ TransportClientSocketPool::TransportClientSocketPool(
             new TransportConnectJobFactory(client_socket_factory,
                                      host_resolver, net_log)) {
   base_.EnableConnectBackupJobs();
+  base_.EnableWarmSockets();
 }
 
 TransportClientSocketPool::~TransportClientSocketPool() {}
@@ -263,7 +263,8 @@ void BufferedSpdyFramer::set_enable_compression_default(bool value) {
 }
 
 void BufferedSpdyFramer::InitHeaderStreaming(const SpdyControlFrame* frame) {
-  memset(header_buffer_, 0, kHeaderBufferSize);
+  // Only the first |header_buffer_used_| bytes of |header_buffer_| are read,
+  // so there is no need to clear it for every frame.
   header_buffer_used_ = 0;
   header_buffer_valid_ = true;
   header_stream_id_ = SpdyFramer::GetControlFrameStreamId(frame);
@@ -284,7 +285,12 @@ void BufferedSpdyFramer::InitHeaderStreaming(const SpdyControlFrame* frame) {
       DCHECK(false);  // Error!
       break;
   }
-  control_frame_.reset(new SpdyFrame(frame_size_without_header_block));
+  // SYN_STREAM has the largest fixed part, so one buffer of that size holds
+  // any of them and is reused across frames.
+  DCHECK_LE(frame_size_without_header_block,
+            static_cast<int32>(SpdySynStreamControlFrame::size()));
+  if (!control_frame_.get())
+    control_frame_.reset(new SpdyFrame(SpdySynStreamControlFrame::size()));
   memcpy(control_frame_.get()->data(), frame->data(),
          frame_size_without_header_block);
 }
@@ -934,35 +934,40 @@ bool SpdyFramer::ParseHeaderBlockInBuffer(const char* header_data,
 
   // Read each header.
   for (uint32 index = 0; index < num_headers; ++index) {
-    base::StringPiece temp;
+    base::StringPiece name;
+    base::StringPiece value;
 
     // Read header name.
-    if ((spdy_version_ < 3) ? !reader.ReadStringPiece16(&temp)
-                            : !reader.ReadStringPiece32(&temp)) {
+    if ((spdy_version_ < 3) ? !reader.ReadStringPiece16(&name)
+                            : !reader.ReadStringPiece32(&name)) {
       DLOG(INFO) << "Unable to read header name (" << index + 1 << " of "
                  << num_headers << ").";
       return false;
     }
-    std::string name = temp.as_string();
 
     // Read header value.
-    if ((spdy_version_ < 3) ? !reader.ReadStringPiece16(&temp)
-                            : !reader.ReadStringPiece32(&temp)) {
+    if ((spdy_version_ < 3) ? !reader.ReadStringPiece16(&value)
+                            : !reader.ReadStringPiece32(&value)) {
       DLOG(INFO) << "Unable to read header value (" << index + 1 << " of "
                  << num_headers << ").";
       return false;
     }
-    std::string value = temp.as_string();
+
+    // Store header. Senders serialize their header blocks in order, so hinting
+    // at the end of |block| makes most insertions constant time. The value is
+    // filled in place once the name is known not to be a duplicate.
+    size_t old_size = block->size();
+    SpdyHeaderBlock::iterator it = block->insert(
+        block->end(),
+        SpdyHeaderBlock::value_type(name.as_string(), std::string()));
 
     // Ensure no duplicates.
-    if (block->find(name) != block->end()) {
+    if (block->size() == old_size) {
       DLOG(INFO) << "Duplicate header '" << name << "' (" << index + 1 << " of "
                  << num_headers << ").";
       return false;
     }
-
-    // Store header.
-    (*block)[name] = value;
+    it->second.assign(value.data(), value.size());
   }
   return true;
 }
@@ -1051,7 +1056,9 @@ SpdySynStreamControlFrame* SpdyFramer::CreateSynStream(
 
   scoped_ptr<SpdySynStreamControlFrame> syn_frame(
       reinterpret_cast<SpdySynStreamControlFrame*>(frame.take()));
-  if (compressed) {
+  // With compression disabled, CompressControlFrame() would only copy the
+  // frame, so hand back the one just built.
+  if (compressed && enable_compression_) {
     return reinterpret_cast<SpdySynStreamControlFrame*>(
         CompressControlFrame(*syn_frame.get()));
   }
@@ -1084,7 +1091,7 @@ SpdySynReplyControlFrame* SpdyFramer::CreateSynReply(
 
   scoped_ptr<SpdySynReplyControlFrame> reply_frame(
       reinterpret_cast<SpdySynReplyControlFrame*>(frame.take()));
-  if (compressed) {
+  if (compressed && enable_compression_) {
     return reinterpret_cast<SpdySynReplyControlFrame*>(
         CompressControlFrame(*reply_frame.get()));
   }
@@ -1180,7 +1187,7 @@ SpdyHeadersControlFrame* SpdyFramer::CreateHeaders(
 
   scoped_ptr<SpdyHeadersControlFrame> headers_frame(
       reinterpret_cast<SpdyHeadersControlFrame*>(frame.take()));
-  if (compressed) {
+  if (compressed && enable_compression_) {
     return reinterpret_cast<SpdyHeadersControlFrame*>(
         CompressControlFrame(*headers_frame.get()));
   }
@@ -0,0 +1,161 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <algorithm>
+#include <string>
+
+#include "base/memory/scoped_ptr.h"
+#include "base/perftimer.h"
+#include "net/spdy/spdy_framer.h"
+#include "net/spdy/spdy_protocol.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace net {
+
+namespace {
+
+const int kNumStreams = 2000;
+const int kDataFramesPerStream = 4;
+const size_t kDataFrameSize = 4096;
+// The input is fed to the framer in socket sized reads.
+const size_t kReadSize = 16 * 1024;
+
+// A visitor which does the minimum a SPDY session needs to: it parses header
+// blocks and counts data bytes, without logging.
+class ThroughputSpdyVisitor : public SpdyFramerVisitorInterface {
+ public:
+  explicit ThroughputSpdyVisitor(SpdyFramer* framer)
+      : framer_(framer),
+        error_count_(0),
+        header_blocks_count_(0),
+        data_bytes_(0) {
+  }
+
+  virtual void OnError(SpdyFramer* framer) OVERRIDE {
+    ++error_count_;
+  }
+
+  virtual void OnControl(const SpdyControlFrame* frame) OVERRIDE {
+    header_buffer_.clear();
+  }
+
+  virtual bool OnControlFrameHeaderData(SpdyStreamId stream_id,
+                                        const char* header_data,
+                                        size_t len) OVERRIDE {
+    if (len > 0) {
+      header_buffer_.append(header_data, len);
+      return true;
+    }
+    SpdyHeaderBlock headers;
+    if (!framer_->ParseHeaderBlockInBuffer(header_buffer_.data(),
+                                           header_buffer_.size(),
+                                           &headers)) {
+      return false;
+    }
+    ++header_blocks_count_;
+    return true;
+  }
+
+  virtual bool OnCredentialFrameData(const char* credential_data,
+                                     size_t len) OVERRIDE {
+    return false;
+  }
+
+  virtual void OnDataFrameHeader(const SpdyDataFrame* frame) OVERRIDE {}
+
+  virtual void OnStreamFrameData(SpdyStreamId stream_id,
+                                 const char* data,
+                                 size_t len) OVERRIDE {
+    data_bytes_ += len;
+  }
+
+  virtual void OnSetting(SpdySettingsIds id,
+                         uint8 flags,
+                         uint32 value) OVERRIDE {}
+
+  int error_count() const { return error_count_; }
+  int header_blocks_count() const { return header_blocks_count_; }
+  int64 data_bytes() const { return data_bytes_; }
+
+ private:
+  SpdyFramer* framer_;
+  std::string header_buffer_;
+  int error_count_;
+  int header_blocks_count_;
+  int64 data_bytes_;
+
+  DISALLOW_COPY_AND_ASSIGN(ThroughputSpdyVisitor);
+};
+
+// Measures how fast a framer for |spdy_version| parses a session of
+// compressed SYN_REPLY frames carrying typical response headers, each followed
+// by DATA frames.
+void RunParseThroughput(int spdy_version, const char* test_name) {
+  bool is_spdy2 = spdy_version < 3;
+  SpdyHeaderBlock headers;
+  headers[is_spdy2 ? "status" : ":status"] = "200 OK";
+  headers[is_spdy2 ? "version" : ":version"] = "HTTP/1.1";
+  headers["cache-control"] = "private, max-age=0";
+  headers["content-encoding"] = "gzip";
+  headers["content-type"] = "text/html; charset=UTF-8";
+  headers["date"] = "Mon, 16 Jul 2012 18:21:32 GMT";
+  headers["expires"] = "-1";
+  headers["server"] = "gws";
+  headers["set-cookie"] = "PREF=ID=0123456789abcdef:FF=0:TM=1342462892";
+  headers["x-xss-protection"] = "1; mode=block";
+  const std::string data(kDataFrameSize, 'x');
+
+  // Build the whole session up front, so only parsing is measured.
+  SpdyFramer send_framer(spdy_version);
+  send_framer.set_enable_compression(true);
+  std::string input;
+  for (int i = 0; i < kNumStreams; ++i) {
+    SpdyStreamId stream_id = 2 * i + 1;
+    scoped_ptr<SpdyFrame> reply(send_framer.CreateSynReply(
+        stream_id, CONTROL_FLAG_NONE, true, &headers));
+    input.append(reply->data(), reply->length() + SpdyFrame::kHeaderSize);
+    for (int j = 0; j < kDataFramesPerStream; ++j) {
+      SpdyDataFlags flags =
+          (j == kDataFramesPerStream - 1) ? DATA_FLAG_FIN : DATA_FLAG_NONE;
+      scoped_ptr<SpdyFrame> data_frame(send_framer.CreateDataFrame(
+          stream_id, data.data(), data.size(), flags));
+      input.append(data_frame->data(),
+                   data_frame->length() + SpdyFrame::kHeaderSize);
+    }
+  }
+
+  SpdyFramer framer(spdy_version);
+  framer.set_enable_compression(true);
+  ThroughputSpdyVisitor visitor(&framer);
+  framer.set_visitor(&visitor);
+
+  PerfTimeLogger timer(test_name);
+  for (size_t offset = 0; offset < input.size(); ) {
+    size_t len = std::min(kReadSize, input.size() - offset);
+    size_t processed = framer.ProcessInput(input.data() + offset, len);
+    ASSERT_EQ(SpdyFramer::SPDY_NO_ERROR, framer.error_code());
+    offset += processed;
+    if (framer.state() == SpdyFramer::SPDY_DONE)
+      framer.Reset();
+  }
+  timer.Done();
+
+  EXPECT_EQ(0, visitor.error_count());
+  EXPECT_EQ(kNumStreams, visitor.header_blocks_count());
+  EXPECT_EQ(static_cast<int64>(kNumStreams) * kDataFramesPerStream *
+                kDataFrameSize,
+            visitor.data_bytes());
+}
+
+}  // namespace
+
+TEST(SpdyFramerPerfTest, ParseThroughputV2) {
+  RunParseThroughput(2, "SpdyFramer_parse_throughput_v2");
+}
+
+TEST(SpdyFramerPerfTest, ParseThroughputV3) {
+  RunParseThroughput(3, "SpdyFramer_parse_throughput_v3");
+}
+
+}  // namespace net
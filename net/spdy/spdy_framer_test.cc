@@ -785,6 +785,47 @@ TEST_P(SpdyFramerTest, MultiValueHeader) {
   EXPECT_EQ(value, new_headers.find("name")->second);
 }
 
+// Header blocks are usually sorted, but the parser must not rely on it.
+TEST_P(SpdyFramerTest, UnsortedHeaderBlock) {
+  // Frame builder with plentiful buffer size.
+  SpdyFrameBuilder frame(SYN_STREAM, CONTROL_FLAG_NONE, 1, 1024);
+
+  frame.WriteUInt32(3);  // stream_id
+  frame.WriteUInt32(0);  // associated stream id
+  frame.WriteUInt16(0);  // Priority.
+
+  const char* const kNames[] = { "zeta", "content-type", "alpha", "date" };
+  if (IsSpdy2()) {
+    frame.WriteUInt16(arraysize(kNames));  // Number of headers.
+    for (size_t i = 0; i < arraysize(kNames); ++i) {
+      frame.WriteString(kNames[i]);
+      frame.WriteString(string("value-") + kNames[i]);
+    }
+  } else {
+    frame.WriteUInt32(arraysize(kNames));  // Number of headers.
+    for (size_t i = 0; i < arraysize(kNames); ++i) {
+      frame.WriteStringPiece32(kNames[i]);
+      frame.WriteStringPiece32(string("value-") + kNames[i]);
+    }
+  }
+  // write the length
+  frame.WriteUInt32ToOffset(4, frame.length() - SpdyFrame::kHeaderSize);
+
+  SpdyHeaderBlock new_headers;
+  scoped_ptr<SpdyFrame> control_frame(frame.take());
+  SpdySynStreamControlFrame syn_frame(control_frame->data(), false);
+  string serialized_headers(syn_frame.header_block(),
+                            syn_frame.header_block_len());
+  SpdyFramer framer(spdy_version_);
+  framer.set_enable_compression(false);
+  EXPECT_TRUE(framer.ParseHeaderBlockInBuffer(serialized_headers.c_str(),
+                                              serialized_headers.size(),
+                                              &new_headers));
+  ASSERT_EQ(arraysize(kNames), new_headers.size());
+  for (size_t i = 0; i < arraysize(kNames); ++i)
+    EXPECT_EQ(string("value-") + kNames[i], new_headers[kNames[i]]);
+}
+
 TEST_P(SpdyFramerTest, BasicCompression) {
   SpdyHeaderBlock headers;
   headers["server"] = "SpdyServer 1.0";
@@ -302,6 +302,7 @@ NextProto g_default_protocol = kProtoUnknown;
 size_t g_init_max_concurrent_streams = 10;
 size_t g_max_concurrent_stream_limit = 256;
 bool g_enable_ping_based_connection_checking = true;
+bool g_enable_weighted_write_scheduling = false;
 
 }  // namespace
 
@@ -320,6 +321,11 @@ void SpdySession::set_enable_ping_based_connection_checking(bool enable) {
   g_enable_ping_based_connection_checking = enable;
 }
 
+// static
+void SpdySession::set_enable_weighted_write_scheduling(bool enable) {
+  g_enable_weighted_write_scheduling = enable;
+}
+
 // static
 void SpdySession::set_init_max_concurrent_streams(size_t value) {
   g_init_max_concurrent_streams =
@@ -333,6 +339,7 @@ void SpdySession::ResetStaticSettingsToInit() {
   g_init_max_concurrent_streams = 10;
   g_max_concurrent_stream_limit = 256;
   g_enable_ping_based_connection_checking = true;
+  g_enable_weighted_write_scheduling = false;
 }
 
 SpdySession::SpdySession(const HostPortProxyPair& host_port_proxy_pair,
@@ -349,6 +356,7 @@ SpdySession::SpdySession(const HostPortProxyPair& host_port_proxy_pair,
       read_buffer_(new IOBuffer(kReadBufferSize)),
       read_pending_(false),
       stream_hi_water_mark_(1),  // Always start at 1 for the first stream id.
+      write_scheduler_(g_enable_weighted_write_scheduling),
       write_pending_(false),
       delayed_write_pending_(false),
       is_secure_(false),
@@ -1025,11 +1033,10 @@ void SpdySession::WriteSocket() {
   // Loop sending frames until we've sent everything or until the write
   // returns error (or ERR_IO_PENDING).
   DCHECK(buffered_spdy_framer_.get());
-  while (in_flight_write_.buffer() || !queue_.empty()) {
+  while (in_flight_write_.buffer() || !write_scheduler_.empty()) {
     if (!in_flight_write_.buffer()) {
       // Grab the next SpdyFrame to send.
-      SpdyIOBuffer next_buffer = queue_.top();
-      queue_.pop();
+      SpdyIOBuffer next_buffer = write_scheduler_.Pop();
 
       // We've deferred compression until just before we write it to the socket,
       // which is now.  At this time, we don't compress our data frames.
@@ -1117,8 +1124,7 @@ void SpdySession::CloseAllStreams(net::Error status) {
   }
 
   // We also need to drain the queue.
-  while (queue_.size())
-    queue_.pop();
+  write_scheduler_.Clear();
 }
 
 int SpdySession::GetNewStreamId() {
@@ -1135,7 +1141,7 @@ void SpdySession::QueueFrame(SpdyFrame* frame,
   int length = SpdyFrame::kHeaderSize + frame->length();
   IOBuffer* buffer = new IOBuffer(length);
   memcpy(buffer->data(), frame->data(), length);
-  queue_.push(SpdyIOBuffer(buffer, length, priority, stream));
+  write_scheduler_.Push(SpdyIOBuffer(buffer, length, priority, stream));
 
   WriteSocketLater();
 }
@@ -29,6 +29,7 @@
 #include "net/spdy/buffered_spdy_framer.h"
 #include "net/spdy/spdy_credential_state.h"
 #include "net/spdy/spdy_io_buffer.h"
+#include "net/spdy/spdy_write_scheduler.h"
 #include "net/spdy/spdy_protocol.h"
 #include "net/spdy/spdy_session_pool.h"
 
@@ -228,6 +229,11 @@ class NET_EXPORT SpdySession : public base::RefCounted<SpdySession>,
   // Enable sending of PING frame with each request.
   static void set_enable_ping_based_connection_checking(bool enable);
 
+  // Share the session between priorities in proportion to their weight
+  // instead of always writing the frames of the highest priority first. See
+  // SpdyWriteScheduler.
+  static void set_enable_weighted_write_scheduling(bool enable);
+
   // The initial max concurrent streams per session, can be overridden by the
   // server via SETTINGS.
   static void set_init_max_concurrent_streams(size_t value);
@@ -354,7 +360,6 @@ class NET_EXPORT SpdySession : public base::RefCounted<SpdySession>,
   typedef std::map<int, scoped_refptr<SpdyStream> > ActiveStreamMap;
   // Only HTTP push a stream.
   typedef std::map<std::string, scoped_refptr<SpdyStream> > PushedStreamMap;
-  typedef std::priority_queue<SpdyIOBuffer> OutputQueue;
 
   struct CallbackResultPair {
     CallbackResultPair(const CompletionCallback& callback_in, int result_in)
@@ -573,8 +578,8 @@ class NET_EXPORT SpdySession : public base::RefCounted<SpdySession>,
   // server, but do not have consumers yet.
   PushedStreamMap unclaimed_pushed_streams_;
 
-  // As we gather data to be sent, we put it into the output queue.
-  OutputQueue queue_;
+  // As we gather data to be sent, we put it into the write scheduler.
+  SpdyWriteScheduler write_scheduler_;
 
   // The packet we are currently sending.
   bool write_pending_;            // Will be true when a write is in progress.
@@ -0,0 +1,157 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/spdy/spdy_write_scheduler.h"
+
+#include "base/logging.h"
+#include "net/spdy/spdy_framer.h"
+
+namespace net {
+
+namespace {
+
+// Returns the stream |buffer| belongs to, or SpdyFramer::kInvalidStream.
+SpdyStreamId GetStreamId(const SpdyIOBuffer& buffer) {
+  SpdyFrame frame(buffer.buffer()->data(), false);
+  if (!frame.is_control_frame())
+    return SpdyDataFrame(buffer.buffer()->data(), false).stream_id();
+  return SpdyFramer::GetControlFrameStreamId(
+      reinterpret_cast<const SpdyControlFrame*>(&frame));
+}
+
+}  // namespace
+
+const int SpdyWriteScheduler::kStreamQuantum = 4 * 1024;
+const int SpdyWriteScheduler::kPriorityQuantum = 2 * 1024;
+
+SpdyWriteScheduler::Flow::Flow(SpdyStreamId stream_id)
+    : stream_id(stream_id),
+      credit(0) {
+}
+
+SpdyWriteScheduler::Flow::~Flow() {
+}
+
+SpdyWriteScheduler::Level::Level() : credit(0) {
+}
+
+SpdyWriteScheduler::Level::~Level() {
+}
+
+SpdyWriteScheduler::SpdyWriteScheduler(bool weighted)
+    : weighted_(weighted),
+      current_priority_(MINIMUM_PRIORITY),
+      size_(0) {
+}
+
+SpdyWriteScheduler::~SpdyWriteScheduler() {
+}
+
+void SpdyWriteScheduler::Push(const SpdyIOBuffer& buffer) {
+  DCHECK_GE(buffer.priority(), MINIMUM_PRIORITY);
+  DCHECK_LT(buffer.priority(), NUM_PRIORITIES);
+  Level& level = levels_[buffer.priority()];
+  ++size_;
+
+  if (!weighted_) {
+    level.frames.push_back(buffer);
+    return;
+  }
+
+  SpdyStreamId stream_id = GetStreamId(buffer);
+  if (stream_id == SpdyFramer::kInvalidStream) {
+    level.frames.push_back(buffer);
+    return;
+  }
+
+  std::map<SpdyStreamId, FlowList::iterator>::iterator it =
+      level.flow_index.find(stream_id);
+  if (it == level.flow_index.end()) {
+    // The stream joins the end of the round.
+    FlowList::iterator flow =
+        level.flows.insert(level.flows.end(), Flow(stream_id));
+    it = level.flow_index.insert(std::make_pair(stream_id, flow)).first;
+  }
+  it->second->frames.push_back(buffer);
+}
+
+SpdyIOBuffer SpdyWriteScheduler::Pop() {
+  DCHECK(!empty());
+  RequestPriority priority = NextPriority();
+  Level& level = levels_[priority];
+  SpdyIOBuffer buffer = PopFromLevel(&level);
+  --size_;
+
+  if (weighted_) {
+    level.credit -= static_cast<int>(buffer.size());
+    if (level.empty())
+      level.credit = 0;
+  }
+  return buffer;
+}
+
+void SpdyWriteScheduler::Clear() {
+  for (int i = 0; i < NUM_PRIORITIES; ++i) {
+    levels_[i].frames.clear();
+    levels_[i].flows.clear();
+    levels_[i].flow_index.clear();
+    levels_[i].credit = 0;
+  }
+  current_priority_ = MINIMUM_PRIORITY;
+  size_ = 0;
+}
+
+RequestPriority SpdyWriteScheduler::NextPriority() {
+  if (!weighted_) {
+    for (int i = HIGHEST; i > MINIMUM_PRIORITY; --i) {
+      if (!levels_[i].empty())
+        return static_cast<RequestPriority>(i);
+    }
+    DCHECK(!levels_[MINIMUM_PRIORITY].empty());
+    return MINIMUM_PRIORITY;
+  }
+
+  // Keep the turn while the current priority has frames and credit left.
+  // Otherwise pass it down, wrapping around to HIGHEST, and give the next
+  // priority with frames its quantum. Since some priority has frames and
+  // every turn adds credit, this terminates.
+  while (levels_[current_priority_].empty() ||
+         levels_[current_priority_].credit <= 0) {
+    current_priority_ = (current_priority_ == MINIMUM_PRIORITY) ?
+        HIGHEST : static_cast<RequestPriority>(current_priority_ - 1);
+    Level& level = levels_[current_priority_];
+    if (!level.empty())
+      level.credit += kPriorityQuantum << (current_priority_ - MINIMUM_PRIORITY);
+  }
+  return current_priority_;
+}
+
+SpdyIOBuffer SpdyWriteScheduler::PopFromLevel(Level* level) {
+  DCHECK(!level->empty());
+  if (!level->frames.empty()) {
+    SpdyIOBuffer buffer = level->frames.front();
+    level->frames.pop_front();
+    return buffer;
+  }
+
+  FlowList::iterator flow = level->flows.begin();
+  if (flow->credit <= 0)
+    flow->credit += kStreamQuantum;  // A new turn.
+  SpdyIOBuffer buffer = flow->frames.front();
+  flow->frames.pop_front();
+  flow->credit -= static_cast<int>(buffer.size());
+
+  if (flow->frames.empty()) {
+    // The stream has nothing more to write for now. It starts afresh at the
+    // end of the round when it queues another frame.
+    level->flow_index.erase(flow->stream_id);
+    level->flows.erase(flow);
+  } else if (flow->credit <= 0) {
+    // The turn is over.
+    level->flows.splice(level->flows.end(), level->flows, flow);
+  }
+  return buffer;
+}
+
+}  // namespace net
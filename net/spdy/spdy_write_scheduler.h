@@ -0,0 +1,118 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef NET_SPDY_SPDY_WRITE_SCHEDULER_H_
+#define NET_SPDY_SPDY_WRITE_SCHEDULER_H_
+#pragma once
+
+#include <deque>
+#include <list>
+#include <map>
+
+#include "base/basictypes.h"
+#include "net/base/net_export.h"
+#include "net/base/request_priority.h"
+#include "net/spdy/spdy_io_buffer.h"
+#include "net/spdy/spdy_protocol.h"
+
+namespace net {
+
+// Decides the order in which a SpdySession writes its queued frames.
+//
+// The scheduler is either strict or weighted. In strict mode, the frames of
+// a priority are written in the order they were queued, and a priority is
+// only served once every higher priority has nothing to write.
+//
+// In weighted mode, each priority gets turns in proportion to its weight so
+// that a busy high priority stream cannot starve the rest of the session.
+// Frames which belong to no stream (SETTINGS, PING, GOAWAY, CREDENTIAL) are
+// written before the stream frames of their priority. The streams of a
+// priority take turns. A turn lasts until the stream has written
+// |kStreamQuantum| bytes, so that a stream writing large frames does not get
+// more than its share of the session, and a stream whose queue runs dry (for
+// instance because it is stalled on its send window) gives up its turn and
+// any credit left in it.
+//
+// In both modes the frames of one stream are written in the order they were
+// queued.
+class NET_EXPORT_PRIVATE SpdyWriteScheduler {
+ public:
+  // Number of bytes a stream may write in one turn, in weighted mode.
+  static const int kStreamQuantum;
+
+  // Number of bytes the lowest priority may write in one turn in weighted
+  // mode. Each higher priority gets twice as many as the one below it.
+  static const int kPriorityQuantum;
+
+  explicit SpdyWriteScheduler(bool weighted);
+  ~SpdyWriteScheduler();
+
+  bool weighted() const { return weighted_; }
+
+  // Queues |buffer|, which must contain a complete, uncompressed frame.
+  void Push(const SpdyIOBuffer& buffer);
+
+  // Removes and returns the next frame to write. Must not be called when the
+  // scheduler is empty.
+  SpdyIOBuffer Pop();
+
+  // Drops all queued frames.
+  void Clear();
+
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+ private:
+  // The queued frames of one stream.
+  struct Flow {
+    explicit Flow(SpdyStreamId stream_id);
+    ~Flow();
+
+    SpdyStreamId stream_id;
+    std::deque<SpdyIOBuffer> frames;
+    // Bytes left in the current turn. May be negative when a frame was larger
+    // than what was left; the debt is paid off in the next turn.
+    int credit;
+  };
+
+  typedef std::list<Flow> FlowList;
+
+  // The queued frames of one priority.
+  struct Level {
+    Level();
+    ~Level();
+
+    bool empty() const { return frames.empty() && flows.empty(); }
+
+    // Frames to write in the order they were queued, before those in |flows|.
+    // In strict mode these are all the frames of the priority, and in
+    // weighted mode those which belong to no stream.
+    std::deque<SpdyIOBuffer> frames;
+    // Streams with queued frames, in turn order. The front one has the turn.
+    // Only used in weighted mode.
+    FlowList flows;
+    std::map<SpdyStreamId, FlowList::iterator> flow_index;
+    // Bytes left in the current turn of this priority, in weighted mode.
+    int credit;
+  };
+
+  // Returns the priority whose frame should be written next.
+  RequestPriority NextPriority();
+
+  // Removes and returns the next frame of |level|.
+  SpdyIOBuffer PopFromLevel(Level* level);
+
+  const bool weighted_;
+  Level levels_[NUM_PRIORITIES];
+  // The priority which has the turn, in weighted mode. Starts at the lowest
+  // priority so that the first turn goes to HIGHEST.
+  RequestPriority current_priority_;
+  size_t size_;
+
+  DISALLOW_COPY_AND_ASSIGN(SpdyWriteScheduler);
+};
+
+}  // namespace net
+
+#endif  // NET_SPDY_SPDY_WRITE_SCHEDULER_H_
@@ -0,0 +1,184 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net/spdy/spdy_write_scheduler.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "base/memory/scoped_ptr.h"
+#include "net/spdy/spdy_framer.h"
+#include "testing/platform_test.h"
+
+namespace net {
+
+namespace {
+
+// Payload size which makes a DATA frame exactly one stream quantum long.
+const int kQuantumPayload =
+    SpdyWriteScheduler::kStreamQuantum - SpdyFrame::kHeaderSize;
+
+SpdyIOBuffer MakeFrameBuffer(const SpdyFrame& frame,
+                             RequestPriority priority) {
+  int length = SpdyFrame::kHeaderSize + frame.length();
+  IOBuffer* buffer = new IOBuffer(length);
+  memcpy(buffer->data(), frame.data(), length);
+  return SpdyIOBuffer(buffer, length, priority, NULL);
+}
+
+SpdyIOBuffer MakeDataFrame(SpdyStreamId stream_id,
+                           int payload_size,
+                           RequestPriority priority) {
+  SpdyFramer framer(2);
+  std::string payload(payload_size, 'x');
+  scoped_ptr<SpdyFrame> frame(framer.CreateDataFrame(
+      stream_id, payload.data(), payload_size, DATA_FLAG_NONE));
+  return MakeFrameBuffer(*frame, priority);
+}
+
+SpdyIOBuffer MakePingFrame(RequestPriority priority) {
+  SpdyFramer framer(2);
+  scoped_ptr<SpdyFrame> frame(framer.CreatePingFrame(1));
+  return MakeFrameBuffer(*frame, priority);
+}
+
+// Returns the stream of a DATA frame, or 0 for a control frame.
+SpdyStreamId PoppedStreamId(SpdyWriteScheduler* scheduler) {
+  SpdyIOBuffer buffer = scheduler->Pop();
+  SpdyFrame frame(buffer.buffer()->data(), false);
+  if (frame.is_control_frame())
+    return 0;
+  return SpdyDataFrame(buffer.buffer()->data(), false).stream_id();
+}
+
+}  // namespace
+
+class SpdyWriteSchedulerTest : public PlatformTest {
+};
+
+TEST_F(SpdyWriteSchedulerTest, StrictPriority) {
+  SpdyWriteScheduler scheduler(false);
+  EXPECT_TRUE(scheduler.empty());
+
+  scheduler.Push(MakeDataFrame(1, 10, LOW));
+  scheduler.Push(MakeDataFrame(3, 10, HIGHEST));
+  scheduler.Push(MakePingFrame(LOW));
+  scheduler.Push(MakeDataFrame(5, 10, IDLE));
+  EXPECT_EQ(4u, scheduler.size());
+
+  // Frames of the same priority go in the order they were queued.
+  EXPECT_EQ(3u, PoppedStreamId(&scheduler));
+  EXPECT_EQ(1u, PoppedStreamId(&scheduler));
+  EXPECT_EQ(0u, PoppedStreamId(&scheduler));
+  EXPECT_EQ(5u, PoppedStreamId(&scheduler));
+  EXPECT_TRUE(scheduler.empty());
+}
+
+// Without weights, a stream writing large frames keeps the priority until it
+// has written them all.
+TEST_F(SpdyWriteSchedulerTest, FifoWithinPriority) {
+  SpdyWriteScheduler scheduler(false);
+  for (int i = 0; i < 3; ++i)
+    scheduler.Push(MakeDataFrame(1, kQuantumPayload, MEDIUM));
+  scheduler.Push(MakeDataFrame(3, kQuantumPayload, MEDIUM));
+  scheduler.Push(MakeDataFrame(1, kQuantumPayload, MEDIUM));
+
+  const SpdyStreamId kExpected[] = { 1, 1, 1, 3, 1 };
+  for (size_t i = 0; i < arraysize(kExpected); ++i)
+    EXPECT_EQ(kExpected[i], PoppedStreamId(&scheduler)) << i;
+  EXPECT_TRUE(scheduler.empty());
+}
+
+TEST_F(SpdyWriteSchedulerTest, SessionFramesFirstWhenWeighted) {
+  SpdyWriteScheduler scheduler(true);
+  scheduler.Push(MakeDataFrame(1, 10, LOW));
+  scheduler.Push(MakePingFrame(LOW));
+
+  // Frames without a stream go before the streams of their priority.
+  EXPECT_EQ(0u, PoppedStreamId(&scheduler));
+  EXPECT_EQ(1u, PoppedStreamId(&scheduler));
+  EXPECT_TRUE(scheduler.empty());
+}
+
+TEST_F(SpdyWriteSchedulerTest, RoundRobinWithinPriority) {
+  SpdyWriteScheduler scheduler(true);
+  for (int i = 0; i < 3; ++i)
+    scheduler.Push(MakeDataFrame(1, kQuantumPayload, MEDIUM));
+  for (int i = 0; i < 2; ++i)
+    scheduler.Push(MakeDataFrame(3, kQuantumPayload, MEDIUM));
+  scheduler.Push(MakeDataFrame(5, kQuantumPayload, MEDIUM));
+
+  const SpdyStreamId kExpected[] = { 1, 3, 5, 1, 3, 1 };
+  for (size_t i = 0; i < arraysize(kExpected); ++i)
+    EXPECT_EQ(kExpected[i], PoppedStreamId(&scheduler)) << i;
+  EXPECT_TRUE(scheduler.empty());
+}
+
+// Small frames share a turn, and the credit of a stream whose queue runs dry
+// is not kept for later.
+TEST_F(SpdyWriteSchedulerTest, ByteQuantum) {
+  SpdyWriteScheduler scheduler(true);
+  const int kSmallPayload = kQuantumPayload / 4;
+  for (int i = 0; i < 4; ++i)
+    scheduler.Push(MakeDataFrame(1, kSmallPayload, MEDIUM));
+  scheduler.Push(MakeDataFrame(3, kQuantumPayload, MEDIUM));
+  scheduler.Push(MakeDataFrame(3, kQuantumPayload, MEDIUM));
+
+  // Stream 1 writes its four small frames in one turn.
+  for (int i = 0; i < 4; ++i)
+    EXPECT_EQ(1u, PoppedStreamId(&scheduler)) << i;
+  EXPECT_EQ(3u, PoppedStreamId(&scheduler));
+
+  // Stream 1 comes back after its queue ran dry. It joins the end of the
+  // round, behind stream 3.
+  scheduler.Push(MakeDataFrame(1, kQuantumPayload, MEDIUM));
+  scheduler.Push(MakeDataFrame(1, kQuantumPayload, MEDIUM));
+  EXPECT_EQ(3u, PoppedStreamId(&scheduler));
+  EXPECT_EQ(1u, PoppedStreamId(&scheduler));
+  EXPECT_EQ(1u, PoppedStreamId(&scheduler));
+  EXPECT_TRUE(scheduler.empty());
+}
+
+// A busy high priority stream does not starve a low priority one.
+TEST_F(SpdyWriteSchedulerTest, WeightedPriority) {
+  const int kNumFrames = 40;
+  // HIGHEST may write 16 times as much as IDLE in one turn.
+  const int kHighestFramesPerTurn =
+      (SpdyWriteScheduler::kPriorityQuantum << (HIGHEST - IDLE)) /
+      SpdyWriteScheduler::kStreamQuantum;
+
+  for (int weighted = 0; weighted < 2; ++weighted) {
+    SpdyWriteScheduler scheduler(weighted != 0);
+    for (int i = 0; i < kNumFrames; ++i)
+      scheduler.Push(MakeDataFrame(1, kQuantumPayload, HIGHEST));
+    scheduler.Push(MakeDataFrame(3, kQuantumPayload, IDLE));
+
+    std::vector<SpdyStreamId> order;
+    while (!scheduler.empty())
+      order.push_back(PoppedStreamId(&scheduler));
+    ASSERT_EQ(static_cast<size_t>(kNumFrames + 1), order.size());
+
+    size_t idle_position =
+        std::find(order.begin(), order.end(), 3u) - order.begin();
+    if (weighted)
+      EXPECT_EQ(static_cast<size_t>(kHighestFramesPerTurn), idle_position);
+    else
+      EXPECT_EQ(static_cast<size_t>(kNumFrames), idle_position);
+  }
+}
+
+TEST_F(SpdyWriteSchedulerTest, Clear) {
+  SpdyWriteScheduler scheduler(true);
+  scheduler.Push(MakeDataFrame(1, 10, LOW));
+  scheduler.Push(MakePingFrame(HIGHEST));
+  scheduler.Clear();
+  EXPECT_TRUE(scheduler.empty());
+
+  scheduler.Push(MakeDataFrame(3, 10, LOW));
+  EXPECT_EQ(3u, PoppedStreamId(&scheduler));
+  EXPECT_TRUE(scheduler.empty());
+}
+
+}  // namespace net
@@ -0,0 +1,249 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// This command-line program replays a trace of cache accesses against the disk
+// cache, once per eviction policy, and reports the hit ratio of each one.
+//
+// Usage: cache_simulator --trace=<file> [--max-size=<bytes>]
+//                        [--policy=<name>] [--cache-dir=<dir>]
+//
+// Each line of the trace is a request for a resource: "<key> <size>", where
+// size is the number of bytes of the response. A request is a hit if the
+// cache has an entry for the key with the same size; otherwise the entry is
+// stored again. Empty lines and lines starting with '#' are ignored.
+
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "base/at_exit.h"
+#include "base/command_line.h"
+#include "base/file_path.h"
+#include "base/file_util.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/message_loop.h"
+#include "base/message_loop_proxy.h"
+#include "base/scoped_temp_dir.h"
+#include "base/string_number_conversions.h"
+#include "base/string_split.h"
+#include "net/base/io_buffer.h"
+#include "net/base/net_errors.h"
+#include "net/base/test_completion_callback.h"
+#include "net/disk_cache/backend_impl.h"
+#include "net/disk_cache/disk_cache.h"
+
+namespace {
+
+enum Errors {
+  ALL_GOOD = 0,
+  INVALID_ARGUMENT = 1,
+  TRACE_ERROR,
+  CACHE_ERROR
+};
+
+const char kTrace[] = "trace";
+const char kMaxSize[] = "max-size";
+const char kPolicy[] = "policy";
+const char kCacheDir[] = "cache-dir";
+
+const int kDefaultMaxSize = 50 * 1024 * 1024;
+const int kBufferSize = 64 * 1024;
+
+struct Policy {
+  const char* name;
+  bool new_eviction;
+  uint32 flags;
+};
+
+const Policy kPolicies[] = {
+  { "lru", false, 0 },
+  { "new", true, 0 },
+  { "frequency", false, disk_cache::kFrequencyEviction },
+  { "new-frequency", true, disk_cache::kFrequencyEviction },
+};
+
+struct Access {
+  std::string key;
+  int size;
+};
+
+struct Results {
+  Results() : requests(0), hits(0), bytes(0), hit_bytes(0) {}
+
+  int requests;
+  int hits;
+  int64 bytes;
+  int64 hit_bytes;
+};
+
+bool LoadTrace(const FilePath& path, std::vector<Access>* trace) {
+  std::string contents;
+  if (!file_util::ReadFileToString(path, &contents))
+    return false;
+
+  std::vector<std::string> lines;
+  base::SplitString(contents, '\n', &lines);
+  for (size_t i = 0; i < lines.size(); i++) {
+    if (lines[i].empty() || lines[i][0] == '#')
+      continue;
+
+    std::vector<std::string> fields;
+    base::SplitStringAlongWhitespace(lines[i], &fields);
+    Access access;
+    if (fields.size() != 2 || !base::StringToInt(fields[1], &access.size) ||
+        access.size < 0) {
+      printf("Invalid trace line %d: %s\n", static_cast<int>(i + 1),
+             lines[i].c_str());
+      return false;
+    }
+    access.key = fields[0];
+    trace->push_back(access);
+  }
+  return true;
+}
+
+// Stores |size| bytes for |key|, replacing any previous entry.
+void StoreEntry(disk_cache::Backend* cache, const std::string& key, int size,
+                net::IOBuffer* buffer) {
+  net::TestCompletionCallback cb;
+  int rv = cache->DoomEntry(key, cb.callback());
+  cb.GetResult(rv);
+
+  disk_cache::Entry* entry;
+  rv = cache->CreateEntry(key, &entry, cb.callback());
+  if (cb.GetResult(rv) != net::OK)
+    return;
+
+  for (int offset = 0; offset < size; offset += kBufferSize) {
+    int len = std::min(kBufferSize, size - offset);
+    rv = entry->WriteData(1, offset, buffer, len, cb.callback(), false);
+    if (cb.GetResult(rv) != len)
+      break;  // The entry may be too big for this cache.
+  }
+  entry->Close();
+}
+
+bool Simulate(const Policy& policy, const std::vector<Access>& trace,
+              const FilePath& path, int max_size, Results* results) {
+  if (!file_util::Delete(path, true) || !file_util::CreateDirectory(path))
+    return false;
+
+  scoped_ptr<disk_cache::BackendImpl> cache(new disk_cache::BackendImpl(
+      path, base::MessageLoopProxy::current(), NULL));
+  if (!cache->SetMaxSize(max_size))
+    return false;
+  if (policy.new_eviction)
+    cache->SetNewEviction();
+  cache->SetFlags(disk_cache::kNoRandom | disk_cache::kNoLoadProtection |
+                  policy.flags);
+
+  net::TestCompletionCallback cb;
+  int rv = cache->Init(cb.callback());
+  if (cb.GetResult(rv) != net::OK)
+    return false;
+
+  scoped_refptr<net::IOBuffer> buffer(new net::IOBuffer(kBufferSize));
+  memset(buffer->data(), 'k', kBufferSize);
+
+  for (size_t i = 0; i < trace.size(); i++) {
+    const Access& access = trace[i];
+    results->requests++;
+    results->bytes += access.size;
+
+    disk_cache::Entry* entry;
+    rv = cache->OpenEntry(access.key, &entry, cb.callback());
+    bool hit = false;
+    if (cb.GetResult(rv) == net::OK) {
+      hit = (entry->GetDataSize(1) == access.size);
+      entry->Close();
+    }
+
+    if (hit) {
+      results->hits++;
+      results->hit_bytes += access.size;
+    } else {
+      StoreEntry(cache.get(), access.key, access.size, buffer);
+    }
+
+    // Let the cache trim itself.
+    MessageLoop::current()->RunAllPending();
+  }
+
+  cache.reset();
+  MessageLoop::current()->RunAllPending();
+  return true;
+}
+
+double Percent(int64 part, int64 total) {
+  return total ? 100.0 * part / total : 0.0;
+}
+
+}  // namespace
+
+int main(int argc, const char* argv[]) {
+  // Setup an AtExitManager so Singleton objects will be destructed.
+  base::AtExitManager at_exit_manager;
+  CommandLine::Init(argc, argv);
+  const CommandLine& command_line = *CommandLine::ForCurrentProcess();
+
+  FilePath trace_path = command_line.GetSwitchValuePath(kTrace);
+  if (trace_path.empty()) {
+    printf("Usage: cache_simulator --trace=<file> [--max-size=<bytes>] "
+           "[--policy=<name>] [--cache-dir=<dir>]\n");
+    return INVALID_ARGUMENT;
+  }
+
+  int max_size = kDefaultMaxSize;
+  if (command_line.HasSwitch(kMaxSize) &&
+      (!base::StringToInt(command_line.GetSwitchValueASCII(kMaxSize),
+                          &max_size) || max_size <= 0)) {
+    printf("Invalid maximum size\n");
+    return INVALID_ARGUMENT;
+  }
+
+  std::string policy_name = command_line.GetSwitchValueASCII(kPolicy);
+  std::vector<Policy> policies;
+  for (size_t i = 0; i < arraysize(kPolicies); i++) {
+    if (policy_name.empty() || policy_name == kPolicies[i].name)
+      policies.push_back(kPolicies[i]);
+  }
+  if (policies.empty()) {
+    printf("Unknown policy: %s\n", policy_name.c_str());
+    return INVALID_ARGUMENT;
+  }
+
+  std::vector<Access> trace;
+  if (!LoadTrace(trace_path, &trace)) {
+    printf("Unable to read the trace\n");
+    return TRACE_ERROR;
+  }
+
+  ScopedTempDir temp_dir;
+  FilePath cache_path = command_line.GetSwitchValuePath(kCacheDir);
+  if (cache_path.empty()) {
+    if (!temp_dir.CreateUniqueTempDir())
+      return CACHE_ERROR;
+    cache_path = temp_dir.path();
+  }
+
+  MessageLoop message_loop(MessageLoop::TYPE_IO);
+  printf("%d requests, %d MB cache\n", static_cast<int>(trace.size()),
+         max_size / (1024 * 1024));
+  for (size_t i = 0; i < policies.size(); i++) {
+    Results results;
+    if (!Simulate(policies[i], trace, cache_path.AppendASCII("cache"),
+                  max_size, &results)) {
+      printf("Unable to create the cache\n");
+      return CACHE_ERROR;
+    }
+    printf("%-14s hits: %6.2f%%  byte hits: %6.2f%%\n", policies[i].name,
+           Percent(results.hits, results.requests),
+           Percent(results.hit_bytes, results.bytes));
+  }
+
+  return ALL_GOOD;
+}
@@ -0,0 +1,480 @@
+// Copyright (c) 2012 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// This command-line program runs net::HttpServer on a thread of its own and
+// loads it from a local client that keeps many keep-alive connections busy,
+// then reports the request rate and the request latency percentiles.
+//
+// Usage: http_server_load [--connections=<n>] [--requests=<n>]
+//                         [--pipeline=<n>] [--response-size=<bytes>]
+//                         [--port=<port>]
+//
+// Every connection sends |requests| requests, keeping up to |pipeline| of
+// them in flight. All the connections are established before the first
+// request is sent.
+
+#include <errno.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+
+#include <algorithm>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "base/at_exit.h"
+#include "base/basictypes.h"
+#include "base/bind.h"
+#include "base/command_line.h"
+#include "base/compiler_specific.h"
+#include "base/eintr_wrapper.h"
+#include "base/logging.h"
+#include "base/memory/ref_counted.h"
+#include "base/message_loop.h"
+#include "base/stl_util.h"
+#include "base/string_number_conversions.h"
+#include "base/stringprintf.h"
+#include "base/synchronization/waitable_event.h"
+#include "base/sys_byteorder.h"
+#include "base/threading/thread.h"
+#include "base/time.h"
+#include "net/base/net_util.h"
+#include "net/server/http_server.h"
+#include "net/server/http_server_request_info.h"
+
+namespace {
+
+enum Errors {
+  ALL_GOOD = 0,
+  INVALID_ARGUMENT = 1,
+  RESOURCE_ERROR,
+  CONNECTION_ERROR
+};
+
+const char kConnections[] = "connections";
+const char kRequests[] = "requests";
+const char kPipeline[] = "pipeline";
+const char kResponseSize[] = "response-size";
+const char kPort[] = "port";
+
+const int kDefaultConnections = 10000;
+const int kDefaultRequests = 10;
+const int kDefaultPipeline = 1;
+const int kDefaultResponseSize = 1024;
+const int kDefaultPort = 9123;
+
+// Connects that may be in progress at once, so that the listen backlog does
+// not overflow while the connections are being established.
+const int kMaxPendingConnects = 256;
+
+// File descriptors needed besides two per connection.
+const int kSpareDescriptors = 64;
+
+const char kRequest[] =
+    "GET /status HTTP/1.1\r\n"
+    "Host: 127.0.0.1\r\n"
+    "Connection: keep-alive\r\n"
+    "\r\n";
+
+// Answers every request with the same body.
+class StaticServer : public net::HttpServer::Delegate {
+ public:
+  explicit StaticServer(int response_size) : body_(response_size, 'x') {}
+  virtual ~StaticServer() {}
+
+  void Start(int port) {
+    server_ = new net::HttpServer("127.0.0.1", port, this);
+  }
+
+  void Stop() {
+    server_ = NULL;
+  }
+
+  // net::HttpServer::Delegate implementation.
+  virtual void OnHttpRequest(int connection_id,
+                             const net::HttpServerRequestInfo& info) OVERRIDE {
+    server_->Send200(connection_id, body_, "text/plain");
+  }
+
+  virtual void OnWebSocketRequest(
+      int connection_id,
+      const net::HttpServerRequestInfo& info) OVERRIDE {
+    server_->Send404(connection_id);
+  }
+
+  virtual void OnWebSocketMessage(int connection_id,
+                                  const std::string& data) OVERRIDE {}
+
+  virtual void OnClose(int connection_id) OVERRIDE {}
+
+ private:
+  scoped_refptr<net::HttpServer> server_;
+  const std::string body_;
+
+  DISALLOW_COPY_AND_ASSIGN(StaticServer);
+};
+
+class LoadGenerator;
+
+// A client connection that sends requests and times their responses.
+class Connection : public MessageLoopForIO::Watcher {
+ public:
+  Connection(LoadGenerator* generator, int requests, int pipeline)
+      : generator_(generator),
+        fd_(-1),
+        connected_(false),
+        requests_to_send_(requests),
+        pipeline_(pipeline) {}
+
+  virtual ~Connection() {
+    watcher_.StopWatchingFileDescriptor();
+    if (fd_ >= 0)
+      close(fd_);
+  }
+
+  // Starts connecting to |port|. Returns false on failure.
+  bool Connect(int port);
+
+  // Sends the first requests.
+  bool Start();
+
+  // MessageLoopForIO::Watcher implementation.
+  virtual void OnFileCanReadWithoutBlocking(int fd) OVERRIDE;
+  virtual void OnFileCanWriteWithoutBlocking(int fd) OVERRIDE;
+
+ private:
+  // Sends requests until |pipeline_| are in flight.
+  bool SendRequests();
+
+  // Consumes the complete responses at the front of |recv_data_|.
+  bool ParseResponses();
+
+  LoadGenerator* generator_;
+  int fd_;
+  bool connected_;
+  int requests_to_send_;
+  const int pipeline_;
+  std::string recv_data_;
+  // The time each request in flight was sent at, oldest first.
+  std::deque<base::TimeTicks> send_times_;
+  MessageLoopForIO::FileDescriptorWatcher watcher_;
+
+  DISALLOW_COPY_AND_ASSIGN(Connection);
+};
+
+// Establishes all the connections, then runs the requests on them.
+class LoadGenerator {
+ public:
+  LoadGenerator(int port, int connections, int requests, int pipeline)
+      : port_(port),
+        num_connections_(connections),
+        requests_(requests),
+        pipeline_(pipeline),
+        connects_started_(0),
+        connected_(0),
+        finished_(0),
+        failed_(false) {}
+
+  ~LoadGenerator() {
+    STLDeleteElements(&connections_);
+  }
+
+  // Runs the whole load on the current message loop. Returns false if a
+  // connection failed.
+  bool Run() {
+    int pending = std::min(kMaxPendingConnects, num_connections_);
+    for (int i = 0; i < pending && !failed_; i++)
+      ConnectNext();
+    if (!failed_)
+      MessageLoop::current()->Run();
+    end_time_ = base::TimeTicks::Now();
+    return !failed_;
+  }
+
+  void OnConnected() {
+    connected_++;
+    if (connects_started_ < num_connections_) {
+      ConnectNext();
+      return;
+    }
+    if (connected_ != num_connections_)
+      return;
+
+    start_time_ = base::TimeTicks::Now();
+    for (size_t i = 0; i < connections_.size() && !failed_; i++) {
+      if (!connections_[i]->Start())
+        Fail("send");
+    }
+  }
+
+  void OnResponse(base::TimeDelta latency) {
+    latencies_.push_back(latency.InMicroseconds());
+  }
+
+  void OnFinished() {
+    finished_++;
+    if (finished_ == num_connections_)
+      MessageLoop::current()->Quit();
+  }
+
+  void Fail(const char* operation) {
+    if (failed_)
+      return;
+    printf("Connection %s failed: %s\n", operation, strerror(errno));
+    failed_ = true;
+    MessageLoop::current()->Quit();
+  }
+
+  void PrintResults() {
+    std::sort(latencies_.begin(), latencies_.end());
+    double seconds = (end_time_ - start_time_).InSecondsF();
+    printf("%d connections, %d requests each, pipeline depth %d\n",
+           num_connections_, requests_, pipeline_);
+    printf("%d requests in %.2f s: %.0f requests/s\n",
+           static_cast<int>(latencies_.size()), seconds,
+           seconds > 0 ? latencies_.size() / seconds : 0.0);
+    printf("latency p50: %.2f ms  p99: %.2f ms  max: %.2f ms\n",
+           Percentile(50) / 1000.0, Percentile(99) / 1000.0,
+           Percentile(100) / 1000.0);
+  }
+
+ private:
+  void ConnectNext() {
+    Connection* connection = new Connection(this, requests_, pipeline_);
+    connections_.push_back(connection);
+    connects_started_++;
+    if (!connection->Connect(port_))
+      Fail("connect");
+  }
+
+  int64 Percentile(int percent) const {
+    if (latencies_.empty())
+      return 0;
+    size_t index = (latencies_.size() - 1) * percent / 100;
+    return latencies_[index];
+  }
+
+  const int port_;
+  const int num_connections_;
+  const int requests_;
+  const int pipeline_;
+  int connects_started_;
+  int connected_;
+  int finished_;
+  bool failed_;
+  std::vector<Connection*> connections_;
+  std::vector<int64> latencies_;
+  base::TimeTicks start_time_;
+  base::TimeTicks end_time_;
+
+  DISALLOW_COPY_AND_ASSIGN(LoadGenerator);
+};
+
+bool Connection::Connect(int port) {
+  fd_ = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  if (fd_ < 0 || net::SetNonBlocking(fd_))
+    return false;
+
+  sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+  addr.sin_port = base::HostToNet16(port);
+  int rv = HANDLE_EINTR(
+      connect(fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)));
+  if (rv < 0 && errno != EINPROGRESS)
+    return false;
+
+  return MessageLoopForIO::current()->WatchFileDescriptor(
+      fd_, false, MessageLoopForIO::WATCH_WRITE, &watcher_, this);
+}
+
+bool Connection::Start() {
+  if (!SendRequests())
+    return false;
+  return MessageLoopForIO::current()->WatchFileDescriptor(
+      fd_, true, MessageLoopForIO::WATCH_READ, &watcher_, this);
+}
+
+bool Connection::SendRequests() {
+  std::string requests;
+  base::TimeTicks now = base::TimeTicks::Now();
+  while (requests_to_send_ > 0 &&
+         static_cast<int>(send_times_.size()) < pipeline_) {
+    requests.append(kRequest, arraysize(kRequest) - 1);
+    send_times_.push_back(now);
+    requests_to_send_--;
+  }
+  if (requests.empty())
+    return true;
+
+  // The requests are small enough to always fit in the socket buffer.
+  int rv = HANDLE_EINTR(send(fd_, requests.data(), requests.size(), 0));
+  return rv == static_cast<int>(requests.size());
+}
+
+bool Connection::ParseResponses() {
+  while (!send_times_.empty()) {
+    size_t header_end = recv_data_.find("\r\n\r\n");
+    if (header_end == std::string::npos)
+      return true;
+    header_end += 4;
+
+    static const char kContentLength[] = "Content-Length:";
+    size_t length_pos = recv_data_.find(kContentLength);
+    if (length_pos == std::string::npos || length_pos > header_end)
+      return false;
+    length_pos += arraysize(kContentLength) - 1;
+    size_t length_end = recv_data_.find("\r\n", length_pos);
+    int body_length;
+    if (!base::StringToInt(recv_data_.substr(length_pos,
+                                             length_end - length_pos),
+                           &body_length)) {
+      return false;
+    }
+    if (recv_data_.size() < header_end + body_length)
+      return true;
+
+    recv_data_.erase(0, header_end + body_length);
+    generator_->OnResponse(base::TimeTicks::Now() - send_times_.front());
+    send_times_.pop_front();
+  }
+  return recv_data_.empty();
+}
+
+void Connection::OnFileCanReadWithoutBlocking(int fd) {
+  char buf[16 * 1024];
+  while (true) {
+    int rv = HANDLE_EINTR(recv(fd_, buf, sizeof(buf), 0));
+    if (rv < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+      break;
+    if (rv <= 0) {
+      generator_->Fail("read");
+      return;
+    }
+    recv_data_.append(buf, rv);
+  }
+
+  if (!ParseResponses()) {
+    errno = EPROTO;
+    generator_->Fail("read");
+    return;
+  }
+  if (!SendRequests()) {
+    generator_->Fail("send");
+    return;
+  }
+  if (send_times_.empty()) {
+    watcher_.StopWatchingFileDescriptor();
+    generator_->OnFinished();
+  }
+}
+
+void Connection::OnFileCanWriteWithoutBlocking(int fd) {
+  DCHECK(!connected_);
+  // Start() watches for reads instead.
+  watcher_.StopWatchingFileDescriptor();
+  int error = 0;
+  socklen_t error_len = sizeof(error);
+  if (getsockopt(fd_, SOL_SOCKET, SO_ERROR, &error, &error_len) || error) {
+    if (error)
+      errno = error;
+    generator_->Fail("connect");
+    return;
+  }
+  connected_ = true;
+  generator_->OnConnected();
+}
+
+// Raises the limit on open files to at least |descriptors|.
+bool RaiseDescriptorLimit(int descriptors) {
+  struct rlimit limit;
+  if (getrlimit(RLIMIT_NOFILE, &limit))
+    return false;
+  if (limit.rlim_cur >= static_cast<rlim_t>(descriptors))
+    return true;
+  if (limit.rlim_max < static_cast<rlim_t>(descriptors))
+    return false;
+  limit.rlim_cur = descriptors;
+  return setrlimit(RLIMIT_NOFILE, &limit) == 0;
+}
+
+bool GetIntSwitch(const CommandLine& command_line, const char* name,
+                  int default_value, int* value) {
+  *value = default_value;
+  if (!command_line.HasSwitch(name))
+    return true;
+  return base::StringToInt(command_line.GetSwitchValueASCII(name), value) &&
+         *value > 0;
+}
+
+void StartServer(StaticServer* server, int port,
+                 base::WaitableEvent* event) {
+  server->Start(port);
+  event->Signal();
+}
+
+void StopServer(StaticServer* server, base::WaitableEvent* event) {
+  server->Stop();
+  event->Signal();
+}
+
+}  // namespace
+
+int main(int argc, const char* argv[]) {
+  // Setup an AtExitManager so Singleton objects will be destructed.
+  base::AtExitManager at_exit_manager;
+  CommandLine::Init(argc, argv);
+  const CommandLine& command_line = *CommandLine::ForCurrentProcess();
+
+  int connections, requests, pipeline, response_size, port;
+  if (!GetIntSwitch(command_line, kConnections, kDefaultConnections,
+                    &connections) ||
+      !GetIntSwitch(command_line, kRequests, kDefaultRequests, &requests) ||
+      !GetIntSwitch(command_line, kPipeline, kDefaultPipeline, &pipeline) ||
+      !GetIntSwitch(command_line, kResponseSize, kDefaultResponseSize,
+                    &response_size) ||
+      !GetIntSwitch(command_line, kPort, kDefaultPort, &port)) {
+    printf("Usage: http_server_load [--connections=<n>] [--requests=<n>] "
+           "[--pipeline=<n>] [--response-size=<bytes>] [--port=<port>]\n");
+    return INVALID_ARGUMENT;
+  }
+
+  // Both ends of every connection live in this process.
+  if (!RaiseDescriptorLimit(2 * connections + kSpareDescriptors)) {
+    printf("Unable to open %d connections, raise the open files limit\n",
+           connections);
+    return RESOURCE_ERROR;
+  }
+
+  base::Thread server_thread("server");
+  if (!server_thread.StartWithOptions(
+          base::Thread::Options(MessageLoop::TYPE_IO, 0))) {
+    return RESOURCE_ERROR;
+  }
+  StaticServer server(response_size);
+  base::WaitableEvent event(false, false);
+  server_thread.message_loop()->PostTask(
+      FROM_HERE, base::Bind(&StartServer, &server, port, &event));
+  event.Wait();
+
+  MessageLoopForIO message_loop;
+  int result = ALL_GOOD;
+  {
+    LoadGenerator generator(port, connections, requests, pipeline);
+    if (generator.Run())
+      generator.PrintResults();
+    else
+      result = CONNECTION_ERROR;
+  }
+
+  server_thread.message_loop()->PostTask(
+      FROM_HERE, base::Bind(&StopServer, &server, &event));
+  event.Wait();
+  return result;
+}